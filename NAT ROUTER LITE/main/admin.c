@@ -0,0 +1,100 @@
+#include "admin.h"
+#include "esp_log.h"
+#include "lwip/sockets.h"
+#include "sdkconfig.h"
+#include <string.h>
+#include <strings.h>
+
+// Tags para logging
+static const char *TAG_ADMIN = "ADMIN";
+
+// Variables globales
+static esp_netif_t *ap = NULL;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// La petición ha llegado a la IP del punto de acceso (con el servidor en IPv6, como dirección IPv4 mapeada)
+static bool from_ap(httpd_req_t *req)
+{
+    esp_netif_ip_info_t ip_info;
+    if (ap == NULL || esp_netif_get_ip_info(ap, &ip_info) != ESP_OK)
+    {
+        return false;
+    }
+
+    struct sockaddr_storage local;
+    socklen_t len = sizeof(local);
+    if (getsockname(httpd_req_to_sockfd(req), (struct sockaddr *)&local, &len) != 0)
+    {
+        return false;
+    }
+
+    if (local.ss_family == AF_INET)
+    {
+        return ((struct sockaddr_in *)&local)->sin_addr.s_addr == ip_info.ip.addr;
+    }
+#if CONFIG_LWIP_IPV6
+    if (local.ss_family == AF_INET6)
+    {
+        static const uint8_t mapped_prefix[12] = {[10] = 0xff, [11] = 0xff};
+        const uint8_t *addr = ((struct sockaddr_in6 *)&local)->sin6_addr.s6_addr;
+        return memcmp(addr, mapped_prefix, sizeof(mapped_prefix)) == 0 && memcmp(&addr[12], &ip_info.ip.addr, 4) == 0;
+    }
+#endif
+    return false;
+}
+
+// Compara en tiempo constante: el tiempo de respuesta no dice cuántos caracteres acertados lleva el secreto
+static bool token_matches(const char *token)
+{
+    const char *expected = CONFIG_ROUTER_ADMIN_TOKEN;
+    size_t expected_len = strlen(expected);
+    size_t len = strlen(token);
+    uint8_t diff = expected_len != len;
+    for (size_t i = 0; i < expected_len; i++)
+    {
+        diff |= expected[i] ^ (i < len ? token[i] : 0);
+    }
+    return diff == 0;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void admin_start(esp_netif_t *ap_netif)
+{
+    ap = ap_netif;
+    if (CONFIG_ROUTER_ADMIN_TOKEN[0] == '\0')
+    {
+        ESP_LOGW(TAG_ADMIN, "Sin contraseña de administración (CONFIG_ROUTER_ADMIN_TOKEN): rutas de administración desactivadas");
+    }
+}
+
+bool admin_authorize(httpd_req_t *req, const char *content_type)
+{
+    if (!from_ap(req))
+    {
+        ESP_LOGW(TAG_ADMIN, "%s rechazada: no llega por el punto de acceso", req->uri);
+        httpd_resp_send_err(req, HTTPD_403_FORBIDDEN, "Solo desde el punto de acceso");
+        return false;
+    }
+
+    char token[ADMIN_TOKEN_MAX + 1] = "";
+    size_t token_len = httpd_req_get_hdr_value_len(req, ADMIN_TOKEN_HEADER);
+    if (CONFIG_ROUTER_ADMIN_TOKEN[0] == '\0' || token_len == 0 || token_len > ADMIN_TOKEN_MAX ||
+        httpd_req_get_hdr_value_str(req, ADMIN_TOKEN_HEADER, token, sizeof(token)) != ESP_OK || !token_matches(token))
+    {
+        ESP_LOGW(TAG_ADMIN, "%s rechazada: contraseña de administración incorrecta", req->uri);
+        httpd_resp_send_err(req, HTTPD_401_UNAUTHORIZED, CONFIG_ROUTER_ADMIN_TOKEN[0] == '\0' ? "Sin contraseña de administración configurada" : "Contraseña incorrecta");
+        return false;
+    }
+
+    char type[64] = "";
+    if (content_type != NULL &&
+        (httpd_req_get_hdr_value_str(req, "Content-Type", type, sizeof(type)) != ESP_OK || strncasecmp(type, content_type, strlen(content_type)) != 0))
+    {
+        httpd_resp_set_status(req, "415 Unsupported Media Type");
+        httpd_resp_send(req, "Tipo de contenido no admitido", HTTPD_RESP_USE_STRLEN);
+        return false;
+    }
+    return true;
+}
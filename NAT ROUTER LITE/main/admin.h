@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_netif.h"
+
+// Control de acceso de las rutas de administración: las que escriben la flash o exponen el tráfico de los clientes.
+// Cualquier equipo que llegue al servidor web (un cliente del AP, la red de subida o una página web abierta en un
+// cliente, con una petición entre orígenes) podría usarlas. Cada petición debe cumplir tres condiciones:
+// - llegar por el punto de acceso: la dirección local del socket es la IP del AP (nunca la STA ni Ethernet);
+// - traer en X-Admin-Token el secreto de CONFIG_ROUTER_ADMIN_TOKEN (sin secreto configurado se rechaza siempre);
+// - si la ruta recibe datos binarios, declarar el tipo de contenido esperado.
+// Una página de otro origen no puede añadir X-Admin-Token ni usar application/octet-stream sin una petición previa
+// OPTIONS (CORS), que este servidor no acepta, así que no puede lanzar estas peticiones desde el navegador.
+
+// Definiciones del control de acceso
+#define ADMIN_TOKEN_HEADER "X-Admin-Token"
+#define ADMIN_TOKEN_MAX 64 // Longitud máxima del secreto
+
+void admin_start(esp_netif_t *ap_netif); // Interfaz del punto de acceso, la única desde la que se administra
+
+// Comprueba la interfaz, el secreto y, si content_type no es NULL, el tipo de contenido. Si la petición no cumple,
+// responde con el error y devuelve false: la ruta debe devolver ESP_FAIL para cerrar la conexión sin leer el cuerpo
+bool admin_authorize(httpd_req_t *req, const char *content_type);
@@ -0,0 +1,323 @@
+#include "blocklist.h"
+#include "admin.h"
+#include "blocklist_index.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+// Tags para logging
+static const char *TAG_BLOCKLIST = "BLOCKLIST";
+
+static const char *state_names[] = {
+    [BLOCKLIST_STATE_EMPTY] = "empty",
+    [BLOCKLIST_STATE_ACTIVE] = "active",
+    [BLOCKLIST_STATE_UPDATING] = "updating",
+    [BLOCKLIST_STATE_FAILED] = "failed",
+};
+
+// Variables globales
+static const esp_partition_t *partition = NULL;
+static SemaphoreHandle_t image_mutex = NULL; // Protege la proyección y los contadores
+static const uint8_t *image = NULL;          // Imagen activa proyectada desde la flash, NULL sin lista
+static esp_partition_mmap_handle_t mmap_handle;
+static blocklist_stats_t stats;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Proyecta la imagen de la partición y la activa si la cabecera, el índice y el CRC son válidos (con el mutex tomado)
+static esp_err_t map_image(void)
+{
+    const void *ptr = NULL;
+    esp_err_t err = esp_partition_mmap(partition, 0, partition->size, ESP_PARTITION_MMAP_DATA, &ptr, &mmap_handle);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    const blocklist_header_t *header = ptr;
+    if (!blocklist_index_check(ptr, partition->size))
+    {
+        esp_partition_munmap(mmap_handle);
+        return ESP_ERR_NOT_FOUND;
+    }
+    uint32_t size = blocklist_index_size(header);
+    if (esp_rom_crc32_le(0, (const uint8_t *)ptr + BLOCKLIST_HEADER_SIZE, size - BLOCKLIST_HEADER_SIZE) != header->crc32)
+    {
+        esp_partition_munmap(mmap_handle);
+        return ESP_ERR_INVALID_CRC;
+    }
+
+    image = ptr;
+    stats.state = BLOCKLIST_STATE_ACTIVE;
+    stats.entries = header->count;
+    stats.created = header->created;
+    stats.size = size;
+    return ESP_OK;
+}
+
+// Deja de usar la imagen activa antes de borrar la partición (con el mutex tomado)
+static void unmap_image(void)
+{
+    if (image != NULL)
+    {
+        esp_partition_munmap(mmap_handle);
+        image = NULL;
+    }
+    stats.entries = 0;
+    stats.created = 0;
+    stats.size = 0;
+}
+
+// Termina una actualización fallida: si la lista anterior sigue proyectada se sigue usando
+static void fail(const char *error)
+{
+    ESP_LOGE(TAG_BLOCKLIST, "Actualización de la lista fallida: %s", error);
+    xSemaphoreTake(image_mutex, portMAX_DELAY);
+    stats.state = image != NULL ? BLOCKLIST_STATE_ACTIVE : BLOCKLIST_STATE_FAILED;
+    snprintf(stats.error, sizeof(stats.error), "%s", error);
+    xSemaphoreGive(image_mutex);
+}
+
+// Recibe exactamente len bytes del cuerpo de la petición
+static bool receive(httpd_req_t *req, uint8_t *buffer, size_t len, int *timeouts)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        int received = httpd_req_recv(req, (char *)buffer + done, len - done);
+        if (received == HTTPD_SOCK_ERR_TIMEOUT && ++(*timeouts) < BLOCKLIST_RECV_RETRIES)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            return false;
+        }
+        done += received;
+    }
+    return true;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t blocklist_start(void)
+{
+    image_mutex = xSemaphoreCreateMutex();
+    if (image_mutex == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_UNDEFINED, BLOCKLIST_PARTITION_LABEL);
+    if (partition == NULL)
+    {
+        ESP_LOGW(TAG_BLOCKLIST, "No hay partición \"%s\": el DNS no filtra", BLOCKLIST_PARTITION_LABEL);
+        return ESP_ERR_NOT_FOUND;
+    }
+    stats.capacity = partition->size;
+
+    xSemaphoreTake(image_mutex, portMAX_DELAY);
+    esp_err_t err = map_image();
+    xSemaphoreGive(image_mutex);
+    if (err == ESP_OK)
+    {
+        ESP_LOGI(TAG_BLOCKLIST, "Lista de bloqueo activa: %lu dominios, %lu bytes", stats.entries, stats.size);
+    }
+    else if (err == ESP_ERR_NOT_FOUND)
+    {
+        ESP_LOGI(TAG_BLOCKLIST, "Sin lista de bloqueo guardada");
+    }
+    else
+    {
+        ESP_LOGE(TAG_BLOCKLIST, "Error al cargar la lista de bloqueo. Error %s", esp_err_to_name(err));
+    }
+    return ESP_OK;
+}
+
+bool blocklist_check(const uint8_t *name, int len)
+{
+    if (image_mutex == NULL)
+    {
+        return false;
+    }
+
+    bool blocked = false;
+    xSemaphoreTake(image_mutex, portMAX_DELAY);
+    if (image != NULL)
+    {
+        uint32_t start = esp_cpu_get_cycle_count();
+        blocked = blocklist_index_match(image, name, len);
+        stats.cycles += esp_cpu_get_cycle_count() - start;
+        stats.lookups++;
+        stats.blocked += blocked;
+    }
+    xSemaphoreGive(image_mutex);
+    return blocked;
+}
+
+void blocklist_get_stats(blocklist_stats_t *out)
+{
+    if (image_mutex == NULL)
+    {
+        memset(out, 0, sizeof(*out));
+        return;
+    }
+    xSemaphoreTake(image_mutex, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(image_mutex);
+}
+
+esp_err_t blocklist_get_handler(httpd_req_t *req)
+{
+    blocklist_stats_t s;
+    blocklist_get_stats(&s);
+    uint32_t lookup_ns = s.lookups ? (uint32_t)(s.cycles * 1000 / CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ / s.lookups) : 0;
+
+    char text[384];
+    snprintf(text, sizeof(text),
+             "state %s\nentries %lu\ncreated %lu\nsize %lu\ncapacity %lu\nusage %lu%%\nlookups %lu\nblocked %lu\nlookup_ns %lu\nerror %s\n",
+             state_names[s.state], s.entries, s.created, s.size, s.capacity, s.capacity ? (uint32_t)((uint64_t)s.size * 100 / s.capacity) : 0, s.lookups,
+             s.blocked, lookup_ns, s.error[0] ? s.error : "-");
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_send(req, text, HTTPD_RESP_USE_STRLEN);
+}
+
+// Cuerpo: la imagen de tools/blocklist.py en binario (application/octet-stream).
+// Borra la partición: solo desde el punto de acceso y con la contraseña de administración (admin.h)
+esp_err_t blocklist_post_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, "application/octet-stream"))
+    {
+        return ESP_FAIL; // Se cierra la conexión sin recibir la imagen
+    }
+    if (partition == NULL)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No hay partición para la lista");
+    }
+    if (req->content_len == 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_411_LENGTH_REQUIRED, "Falta la imagen");
+    }
+    if (req->content_len > partition->size)
+    {
+        return httpd_resp_send_err(req, HTTPD_413_CONTENT_TOO_LARGE, "La imagen no cabe en la partición");
+    }
+
+    // Una sola actualización a la vez
+    xSemaphoreTake(image_mutex, portMAX_DELAY);
+    bool was_busy = stats.state == BLOCKLIST_STATE_UPDATING;
+    if (!was_busy)
+    {
+        stats.state = BLOCKLIST_STATE_UPDATING;
+        stats.error[0] = '\0';
+    }
+    xSemaphoreGive(image_mutex);
+    if (was_busy)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, "Ya hay una actualización en curso", HTTPD_RESP_USE_STRLEN);
+    }
+
+    uint8_t *buffer = malloc(BLOCKLIST_BUFFER_SIZE);
+    if (buffer == NULL)
+    {
+        fail("Sin memoria para la actualización");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sin memoria para la actualización");
+    }
+
+    // La cabecera se guarda aparte y se escribe la última
+    blocklist_header_t header;
+    int timeouts = 0;
+    if (req->content_len < sizeof(header) || !receive(req, (uint8_t *)&header, sizeof(header), &timeouts))
+    {
+        free(buffer);
+        fail("Error al recibir la imagen");
+        return ESP_FAIL; // Se cierra la conexión
+    }
+    if (blocklist_index_size(&header) != req->content_len)
+    {
+        free(buffer);
+        fail("Imagen no válida");
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Imagen no válida");
+    }
+
+    ESP_LOGI(TAG_BLOCKLIST, "Recibiendo lista de %lu dominios (%u bytes)", header.count, req->content_len);
+    int64_t start_us = esp_timer_get_time();
+    xSemaphoreTake(image_mutex, portMAX_DELAY);
+    unmap_image();
+    xSemaphoreGive(image_mutex);
+
+    // Borrado sector a sector al escribir: el primero invalida la cabecera anterior
+    uint32_t offset = sizeof(header);
+    uint32_t erased = 0;
+    uint32_t crc = 0;
+    esp_err_t err = ESP_OK;
+    bool recv_failed = false;
+    while (offset < req->content_len && err == ESP_OK)
+    {
+        size_t len = MIN(req->content_len - offset, BLOCKLIST_BUFFER_SIZE);
+        if (!receive(req, buffer, len, &timeouts))
+        {
+            recv_failed = true;
+            break;
+        }
+        crc = esp_rom_crc32_le(crc, buffer, len);
+
+        while (erased < offset + len && err == ESP_OK)
+        {
+            err = esp_partition_erase_range(partition, erased, BLOCKLIST_BUFFER_SIZE);
+            erased += BLOCKLIST_BUFFER_SIZE;
+        }
+        if (err == ESP_OK)
+        {
+            err = esp_partition_write(partition, offset, buffer, len);
+        }
+        offset += len;
+    }
+    free(buffer);
+
+    if (recv_failed)
+    {
+        fail("Error al recibir la imagen");
+        return ESP_FAIL;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_BLOCKLIST, "Error al escribir la lista. Error %s", esp_err_to_name(err));
+        fail("Error al escribir la lista");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Error al escribir la lista");
+    }
+    if (crc != header.crc32)
+    {
+        fail("El CRC no coincide");
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "El CRC no coincide");
+    }
+
+    err = esp_partition_write(partition, 0, &header, sizeof(header));
+    if (err == ESP_OK)
+    {
+        xSemaphoreTake(image_mutex, portMAX_DELAY);
+        err = map_image();
+        xSemaphoreGive(image_mutex);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_BLOCKLIST, "Error al activar la lista. Error %s", esp_err_to_name(err));
+        fail("Error al activar la lista");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Error al activar la lista");
+    }
+
+    ESP_LOGI(TAG_BLOCKLIST, "Lista de bloqueo activa: %lu dominios en %lu ms", header.count, (uint32_t)((esp_timer_get_time() - start_us) / 1000));
+    return blocklist_get_handler(req);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Lista de bloqueo del reenviador DNS.
+// Las consultas de los clientes cuyo nombre (o un dominio padre) está en la lista se responden con NXDOMAIN sin
+// llegar al servidor de subida. La lista es el índice de blocklist_index.h, guardado en la partición "blocklist" y
+// proyectado en memoria desde la flash: no ocupa RAM y en 384 KB caben unos 120.000 dominios. POST /blocklist
+// recibe una imagen nueva de tools/blocklist.py y la graba sector a sector sin reiniciar; la cabecera se escribe
+// al final, cuando el CRC de la imagen coincide, así una imagen incompleta nunca llega a usarse. Mientras se graba
+// la lista no filtra. GET /blocklist muestra el estado y el coste medido de las búsquedas.
+
+// Definiciones de la lista de bloqueo
+#define BLOCKLIST_PARTITION_LABEL "blocklist"
+#define BLOCKLIST_BUFFER_SIZE 4096       // Un sector de flash
+#define BLOCKLIST_RECV_RETRIES 5         // Esperas del socket (recv_wait_timeout) antes de abandonar
+
+// Estado de la lista
+typedef enum
+{
+    BLOCKLIST_STATE_EMPTY = 0, // Sin partición o sin imagen válida
+    BLOCKLIST_STATE_ACTIVE,
+    BLOCKLIST_STATE_UPDATING,
+    BLOCKLIST_STATE_FAILED,    // La última actualización falló: sin lista hasta la siguiente
+} blocklist_state_t;
+
+typedef struct
+{
+    blocklist_state_t state;
+    uint32_t entries;    // Dominios en la lista
+    uint32_t created;    // Fecha de generación de la imagen
+    uint32_t size;       // Tamaño de la imagen
+    uint32_t capacity;   // Tamaño de la partición
+    uint32_t lookups;    // Consultas comprobadas
+    uint32_t blocked;    // Consultas bloqueadas
+    uint64_t cycles;     // Ciclos de CPU de las búsquedas
+    char error[48];      // Motivo del último fallo
+} blocklist_stats_t;
+
+esp_err_t blocklist_start(void);                         // Proyecta la lista guardada, si la hay
+bool blocklist_check(const uint8_t *name, int len);     // El nombre (formato de red, en minúsculas) está bloqueado
+void blocklist_get_stats(blocklist_stats_t *stats);     // Copia el estado y los contadores
+esp_err_t blocklist_get_handler(httpd_req_t *req);      // GET /blocklist: estado y coste de las búsquedas
+esp_err_t blocklist_post_handler(httpd_req_t *req);     // POST /blocklist: recibe y activa una imagen nueva
@@ -0,0 +1,132 @@
+#include "blocklist_index.h"
+#include <stddef.h>
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline const uint32_t *index_table(const uint8_t *image)
+{
+    return (const uint32_t *)(image + BLOCKLIST_HEADER_SIZE);
+}
+
+static inline const uint8_t *remainders(const uint8_t *image, uint8_t index_bits)
+{
+    return image + BLOCKLIST_HEADER_SIZE + ((1u << index_bits) + 1) * sizeof(uint32_t);
+}
+
+// Las huellas se guardan en big-endian: el orden de los bytes es el de los valores
+static inline uint32_t read24(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2];
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// FNV-1a de 64 bits seguido del mezclador final de MurmurHash3: FNV por sí solo reparte mal los bits altos, que son los
+// que eligen el cubo
+uint64_t blocklist_index_hash(const uint8_t *name, int len)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (int i = 0; i < len; i++)
+    {
+        hash = (hash ^ name[i]) * 1099511628211ull;
+    }
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+uint32_t blocklist_index_size(const blocklist_header_t *header)
+{
+    if (header->magic != BLOCKLIST_MAGIC || header->version != BLOCKLIST_VERSION || header->index_bits < BLOCKLIST_MIN_INDEX_BITS ||
+        header->index_bits > BLOCKLIST_MAX_INDEX_BITS || header->count > UINT32_MAX / 4)
+    {
+        return 0;
+    }
+    return BLOCKLIST_HEADER_SIZE + ((1u << header->index_bits) + 1) * sizeof(uint32_t) + header->count * 3;
+}
+
+bool blocklist_index_check(const uint8_t *image, uint32_t size)
+{
+    const blocklist_header_t *header = (const blocklist_header_t *)image;
+    uint32_t expected = blocklist_index_size(header);
+    if (expected == 0 || expected > size)
+    {
+        return false;
+    }
+
+    // Desplazamientos crecientes y el último igual al número de huellas: una búsqueda nunca sale de la imagen
+    const uint32_t *index = index_table(image);
+    uint32_t buckets = 1u << header->index_bits;
+    if (index[0] != 0 || index[buckets] != header->count)
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < buckets; i++)
+    {
+        if (index[i] > index[i + 1])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool blocklist_index_contains(const uint8_t *image, uint64_t hash)
+{
+    const blocklist_header_t *header = (const blocklist_header_t *)image;
+    uint8_t bits = header->index_bits;
+    uint32_t bucket = hash >> (64 - bits);
+    uint32_t remainder = (hash >> (64 - bits - BLOCKLIST_REMAINDER_BITS)) & ((1u << BLOCKLIST_REMAINDER_BITS) - 1);
+
+    const uint32_t *index = index_table(image);
+    const uint8_t *entries = remainders(image, bits);
+    uint32_t low = index[bucket];
+    uint32_t high = index[bucket + 1];
+    while (low < high)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        uint32_t value = read24(&entries[mid * 3]);
+        if (value == remainder)
+        {
+            return true;
+        }
+        if (value < remainder)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return false;
+}
+
+// Se comprueba el nombre completo y cada dominio padre hasta el de dos etiquetas: bloquear "example.com" bloquea
+// "ads.example.com"; los dominios de primer nivel solos no se comprueban (solo añadirían falsos positivos)
+bool blocklist_index_match(const uint8_t *image, const uint8_t *name, int len)
+{
+    int labels = 0;
+    for (int off = 0; off < len && name[off] != 0; off += 1 + name[off])
+    {
+        labels++;
+    }
+
+    int off = 0;
+    for (int remaining = labels; off < len; remaining--)
+    {
+        if (blocklist_index_contains(image, blocklist_index_hash(&name[off], len - off)))
+        {
+            return true;
+        }
+        if (remaining <= 2)
+        {
+            break;
+        }
+        off += 1 + name[off];
+    }
+    return false;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Índice de la lista de bloqueo DNS: huellas de 64 bits de los dominios, ordenadas y comprimidas por cociente.
+// Los primeros index_bits de la huella eligen un cubo del índice (desplazamientos de 32 bits) y los 24 bits
+// siguientes se guardan ordenados dentro del cubo, en 3 bytes por dominio; la búsqueda es una búsqueda binaria
+// en un cubo de una decena de entradas. Con n dominios la probabilidad de falso positivo por consulta es de unas
+// n / 2^(index_bits + 24) por cada sufijo comprobado. La imagen la genera tools/blocklist.py y se lee tal cual,
+// proyectada desde la flash. Como uplink_policy, no depende de ESP-IDF: tools/blocklist_bench.c la usa en el host.
+//
+// Imagen (little-endian): cabecera de 64 bytes | índice: (2^index_bits + 1) x uint32 | huellas: count x 3 bytes
+
+// Definiciones del índice
+#define BLOCKLIST_MAGIC 0x42534E44u   // "DNSB"
+#define BLOCKLIST_VERSION 1
+#define BLOCKLIST_HEADER_SIZE 64
+#define BLOCKLIST_REMAINDER_BITS 24   // Bits de la huella guardados por dominio
+#define BLOCKLIST_MIN_INDEX_BITS 4
+#define BLOCKLIST_MAX_INDEX_BITS 16
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint8_t index_bits; // Cubos del índice: 2^index_bits
+    uint8_t reserved;
+    uint32_t count;     // Huellas guardadas
+    uint32_t crc32;     // CRC-32 (el de zlib) de todo lo que sigue a la cabecera
+    uint32_t created;   // Fecha de generación (segundos desde 1970)
+    uint8_t padding[BLOCKLIST_HEADER_SIZE - 20];
+} blocklist_header_t;
+
+_Static_assert(sizeof(blocklist_header_t) == BLOCKLIST_HEADER_SIZE, "Cabecera de la lista de bloqueo");
+
+uint64_t blocklist_index_hash(const uint8_t *name, int len);                  // Huella de un nombre en formato de red (en minúsculas, con el 0 final)
+uint32_t blocklist_index_size(const blocklist_header_t *header);             // Tamaño de la imagen que describe la cabecera, 0 si no es válida
+bool blocklist_index_check(const uint8_t *image, uint32_t size);             // Cabecera e índice coherentes (el CRC no se comprueba)
+bool blocklist_index_contains(const uint8_t *image, uint64_t hash);          // La huella está en la lista
+bool blocklist_index_match(const uint8_t *image, const uint8_t *name, int len); // El nombre o uno de sus dominios padre (de dos etiquetas o más) está en la lista
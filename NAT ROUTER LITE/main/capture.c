@@ -0,0 +1,522 @@
+#include "capture.h"
+#include "admin.h"
+#include "form.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/def.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/ip4.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+#include <sys/time.h>
+
+// Definiciones internas
+#define CAPTURE_PCAP_MAGIC 0xa1b2c3d4 // Marcas de tiempo en microsegundos, orden de bytes nativo
+#define CAPTURE_LINKTYPE_ETHERNET 1
+
+// Estructuras
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version_major;
+    uint16_t version_minor;
+    int32_t thiszone;
+    uint32_t sigfigs;
+    uint32_t snaplen;
+    uint32_t linktype;
+} pcap_file_header_t;
+
+// Cabecera de registro pcap
+typedef struct
+{
+    uint32_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t incl_len;
+    uint32_t orig_len;
+} pcap_record_t;
+
+// Ranura del anillo: número de secuencia, cabecera de registro pcap y trama recortada
+typedef struct
+{
+    uint32_t seq; // Posición + 1 con la trama completa; 0 mientras se escribe o sin trama
+    pcap_record_t record;
+    uint8_t data[];
+} capture_slot_t;
+
+typedef struct
+{
+    uint8_t mac[6];
+    bool has_mac;
+    uint32_t ip;     // Orden de red, 0 para cualquiera
+    uint16_t port;   // Orden de red, 0 para cualquiera
+    uint32_t points; // Interfaces y sentidos capturados
+} capture_filter_t;
+
+// Tags para logging
+static const char *TAG_CAPTURE = "CAPTURE";
+
+// Variables globales
+bool capture_active = false;
+static portMUX_TYPE capture_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint8_t *ring = NULL;
+static uint32_t slot_size = 0;
+static uint32_t slots = 0;
+static uint32_t snaplen = CAPTURE_SNAPLEN_DEFAULT;
+static uint32_t head = 0;       // Tramas escritas desde el inicio de la captura
+static uint32_t generation = 0; // Cambia con cada inicio o liberación (invalida descargas en curso)
+static uint32_t writers = 0;    // Tramas copiándose fuera de la sección crítica
+static capture_filter_t filter = {.points = CAPTURE_ALL};
+static uint32_t filtered = 0;
+static uint64_t cycles = 0;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Comprueba el filtro con las cabeceras del primer segmento del buffer
+static bool matches(uint32_t point, const struct pbuf *p)
+{
+    if (!(point & filter.points))
+    {
+        return false;
+    }
+    if (!filter.has_mac && filter.ip == 0 && filter.port == 0)
+    {
+        return true;
+    }
+    if (p->len < SIZEOF_ETH_HDR)
+    {
+        return false;
+    }
+
+    const struct eth_hdr *eth = (const struct eth_hdr *)p->payload;
+    if (filter.has_mac && memcmp(eth->dest.addr, filter.mac, sizeof(filter.mac)) != 0 && memcmp(eth->src.addr, filter.mac, sizeof(filter.mac)) != 0)
+    {
+        return false;
+    }
+    if (filter.ip == 0 && filter.port == 0)
+    {
+        return true;
+    }
+
+    const struct ip_hdr *ip = (const struct ip_hdr *)((const uint8_t *)p->payload + SIZEOF_ETH_HDR);
+    if (eth->type != PP_HTONS(ETHTYPE_IP) || p->len < SIZEOF_ETH_HDR + IP_HLEN)
+    {
+        return false;
+    }
+    if (filter.ip != 0 && ip->src.addr != filter.ip && ip->dest.addr != filter.ip)
+    {
+        return false;
+    }
+    if (filter.port == 0)
+    {
+        return true;
+    }
+
+    // Los puertos de origen y destino están al principio tanto en TCP como en UDP
+    uint16_t ip_hlen = IPH_HL_BYTES(ip);
+    if ((IPH_PROTO(ip) != IP_PROTO_TCP && IPH_PROTO(ip) != IP_PROTO_UDP) || p->len < SIZEOF_ETH_HDR + ip_hlen + 4)
+    {
+        return false;
+    }
+    uint16_t ports[2];
+    memcpy(ports, (const uint8_t *)ip + ip_hlen, sizeof(ports));
+    return ports[0] == filter.port || ports[1] == filter.port;
+}
+
+// Espera a que terminen las copias en curso: después nadie escribe en el anillo
+static void wait_writers(void)
+{
+    while (__atomic_load_n(&writers, __ATOMIC_ACQUIRE) != 0)
+    {
+        vTaskDelay(1);
+    }
+}
+
+// Para la captura y libera el anillo
+static void capture_free(void)
+{
+    portENTER_CRITICAL(&capture_lock);
+    capture_active = false;
+    uint8_t *old = ring;
+    ring = NULL;
+    slots = 0;
+    head = 0;
+    generation++;
+    portEXIT_CRITICAL(&capture_lock);
+
+    wait_writers();
+    free(old);
+}
+
+// Inicia una captura nueva con el filtro indicado; reserva el anillo si no existe o cambia snaplen
+static esp_err_t capture_start(const capture_filter_t *new_filter, uint32_t new_snaplen)
+{
+    if (ring != NULL && new_snaplen != snaplen)
+    {
+        capture_free();
+    }
+
+    uint8_t *buffer = ring;
+    if (buffer == NULL)
+    {
+        buffer = malloc(CAPTURE_RING_BYTES);
+        if (buffer == NULL)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+    }
+
+    // Se reutiliza el anillo: se para la escritura y se invalidan las ranuras antes de reiniciar las posiciones
+    portENTER_CRITICAL(&capture_lock);
+    capture_active = false;
+    ring = NULL;
+    generation++;
+    portEXIT_CRITICAL(&capture_lock);
+    wait_writers();
+
+    uint32_t new_slot_size = (sizeof(capture_slot_t) + new_snaplen + 3) & ~3u;
+    uint32_t new_slots = CAPTURE_RING_BYTES / new_slot_size;
+    for (uint32_t i = 0; i < new_slots; i++)
+    {
+        ((capture_slot_t *)(buffer + i * new_slot_size))->seq = 0;
+    }
+
+    portENTER_CRITICAL(&capture_lock);
+    ring = buffer;
+    snaplen = new_snaplen;
+    slot_size = new_slot_size;
+    slots = new_slots;
+    head = 0;
+    generation++;
+    filter = *new_filter;
+    filtered = 0;
+    cycles = 0;
+    capture_active = true;
+    portEXIT_CRITICAL(&capture_lock);
+
+    ESP_LOGI(TAG_CAPTURE, "Captura iniciada. Snaplen: %lu, capacidad: %lu tramas", new_snaplen, slots);
+    return ESP_OK;
+}
+
+// Lee una MAC con separadores ":" o "-"
+static bool parse_mac(const char *text, uint8_t mac[6])
+{
+    unsigned int b[6];
+    char extra;
+    if (sscanf(text, "%2x%*[:-]%2x%*[:-]%2x%*[:-]%2x%*[:-]%2x%*[:-]%2x%c", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5], &extra) != 6)
+    {
+        return false;
+    }
+    for (int i = 0; i < 6; i++)
+    {
+        mac[i] = b[i];
+    }
+    return true;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void capture_frame(uint32_t point, struct pbuf *p)
+{
+    uint32_t start = esp_cpu_get_cycle_count();
+    bool keep = matches(point, p);
+
+    struct timeval tv = {0};
+    if (keep)
+    {
+        gettimeofday(&tv, NULL);
+    }
+
+    // En la sección crítica solo se reserva la ranura; la trama se copia fuera
+    capture_slot_t *slot = NULL;
+    uint32_t index = 0;
+    uint32_t len = 0;
+    portENTER_CRITICAL(&capture_lock);
+    if (ring != NULL && capture_active)
+    {
+        if (keep)
+        {
+            index = head++;
+            slot = (capture_slot_t *)(ring + (index % slots) * slot_size);
+            __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+            len = snaplen;
+            writers++;
+        }
+        else
+        {
+            filtered++;
+            cycles += esp_cpu_get_cycle_count() - start;
+        }
+    }
+    portEXIT_CRITICAL(&capture_lock);
+
+    if (slot == NULL)
+    {
+        return;
+    }
+
+    slot->record.ts_sec = tv.tv_sec;
+    slot->record.ts_usec = tv.tv_usec;
+    slot->record.orig_len = p->tot_len;
+    slot->record.incl_len = pbuf_copy_partial(p, slot->data, MIN(p->tot_len, len), 0);
+    __atomic_store_n(&slot->seq, index + 1, __ATOMIC_RELEASE);
+
+    portENTER_CRITICAL(&capture_lock);
+    writers--;
+    cycles += esp_cpu_get_cycle_count() - start;
+    portEXIT_CRITICAL(&capture_lock);
+}
+
+void capture_get_stats(capture_stats_t *stats)
+{
+    portENTER_CRITICAL(&capture_lock);
+    stats->active = capture_active;
+    stats->snaplen = snaplen;
+    stats->slots = slots;
+    stats->stored = MIN(head, slots);
+    stats->captured = head;
+    stats->filtered = filtered;
+    stats->overwritten = head > slots ? head - slots : 0;
+    stats->cycles = cycles;
+    portEXIT_CRITICAL(&capture_lock);
+}
+
+esp_err_t capture_get_handler(httpd_req_t *req)
+{
+    capture_stats_t stats;
+    capture_get_stats(&stats);
+    portENTER_CRITICAL(&capture_lock);
+    capture_filter_t current = filter;
+    portEXIT_CRITICAL(&capture_lock);
+
+    uint32_t frames = stats.captured + stats.filtered;
+    char line[160];
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    snprintf(line, sizeof(line), "active %d\nsnaplen %lu\nslots %lu\nstored %lu\ncaptured %lu\nfiltered %lu\noverwritten %lu\n",
+             stats.active, stats.snaplen, stats.slots, stats.stored, stats.captured, stats.filtered, stats.overwritten);
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+
+    // Coste medio por trama inspeccionada con la captura activa (con la captura parada es una comparación)
+    snprintf(line, sizeof(line), "cycles_total %llu\ncycles_per_frame %llu\n", stats.cycles, frames ? stats.cycles / frames : 0);
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+
+    snprintf(line, sizeof(line), "filter_points 0x%lx\n", current.points);
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    if (current.has_mac)
+    {
+        snprintf(line, sizeof(line), "filter_mac " MACSTR "\n", MAC2STR(current.mac));
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+    if (current.ip != 0)
+    {
+        snprintf(line, sizeof(line), "filter_ip " IPSTR "\n", IP2STR((esp_ip4_addr_t *)&current.ip));
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+    if (current.port != 0)
+    {
+        snprintf(line, sizeof(line), "filter_port %u\n", lwip_ntohs(current.port));
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Campos: action (start, stop o free) y, al iniciar, mac, ip, port, iface (ap, sta o all) y snaplen.
+// Solo desde el punto de acceso y con la contraseña de administración (admin.h)
+esp_err_t capture_post_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, NULL))
+    {
+        return ESP_FAIL;
+    }
+
+    char action[6], mac_text[18], ip_text[16], port_text[6], iface[4], snaplen_text[5];
+    form_field_t fields[] = {
+        {.name = "action", .value = action, .size = sizeof(action)},
+        {.name = "mac", .value = mac_text, .size = sizeof(mac_text)},
+        {.name = "ip", .value = ip_text, .size = sizeof(ip_text)},
+        {.name = "port", .value = port_text, .size = sizeof(port_text)},
+        {.name = "iface", .value = iface, .size = sizeof(iface)},
+        {.name = "snaplen", .value = snaplen_text, .size = sizeof(snaplen_text)},
+    };
+    const int field_count = sizeof(fields) / sizeof(fields[0]);
+
+    if (form_recv(req, fields, field_count) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < field_count; i++)
+    {
+        if (fields[i].truncated)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Valor demasiado largo");
+        }
+    }
+
+    if (strcmp(action, "stop") == 0)
+    {
+        capture_active = false;
+        ESP_LOGI(TAG_CAPTURE, "Captura detenida");
+        return capture_get_handler(req);
+    }
+    if (strcmp(action, "free") == 0)
+    {
+        capture_free();
+        return capture_get_handler(req);
+    }
+    if (strcmp(action, "start") != 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Acción no válida");
+    }
+
+    capture_filter_t new_filter = {.points = CAPTURE_ALL};
+    if (mac_text[0] != '\0')
+    {
+        if (!parse_mac(mac_text, new_filter.mac))
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "MAC no válida");
+        }
+        new_filter.has_mac = true;
+    }
+    if (ip_text[0] != '\0')
+    {
+        new_filter.ip = esp_ip4addr_aton(ip_text);
+        if (new_filter.ip == 0)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "IP no válida");
+        }
+    }
+    if (port_text[0] != '\0')
+    {
+        unsigned long port = strtoul(port_text, NULL, 10);
+        if (port == 0 || port > 65535)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Puerto no válido");
+        }
+        new_filter.port = lwip_htons(port);
+    }
+    if (strcmp(iface, "ap") == 0)
+    {
+        new_filter.points = CAPTURE_AP_IN | CAPTURE_AP_OUT;
+    }
+    else if (strcmp(iface, "sta") == 0)
+    {
+        new_filter.points = CAPTURE_STA_IN | CAPTURE_STA_OUT;
+    }
+    else if (iface[0] != '\0' && strcmp(iface, "all") != 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Interfaz no válida");
+    }
+
+    uint32_t new_snaplen = CAPTURE_SNAPLEN_DEFAULT;
+    if (snaplen_text[0] != '\0')
+    {
+        new_snaplen = strtoul(snaplen_text, NULL, 10);
+        if (new_snaplen < SIZEOF_ETH_HDR || new_snaplen > CAPTURE_SNAPLEN_MAX)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Snaplen no válido");
+        }
+    }
+
+    if (capture_start(&new_filter, new_snaplen) != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sin memoria para la captura");
+    }
+    return capture_get_handler(req);
+}
+
+// Expone el tráfico de todos los clientes: solo desde el punto de acceso y con la contraseña de administración
+esp_err_t capture_pcap_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, NULL))
+    {
+        return ESP_FAIL;
+    }
+
+    portENTER_CRITICAL(&capture_lock);
+    uint32_t gen = generation;
+    uint32_t end = head;
+    uint32_t first = head > slots ? head - slots : 0;
+    uint32_t size = slot_size;
+    uint32_t len = snaplen;
+    uint32_t count = slots;
+    const uint8_t *frames = ring;
+    portEXIT_CRITICAL(&capture_lock);
+
+    if (frames == NULL)
+    {
+        return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "No hay ninguna captura");
+    }
+
+    // La descarga se hace en bloques; las tramas se copian de una en una para no parar la captura
+    char *buffer = malloc(CAPTURE_STREAM_CHUNK + size);
+    if (buffer == NULL)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sin memoria para la descarga");
+    }
+
+    httpd_resp_set_type(req, "application/vnd.tcpdump.pcap");
+    httpd_resp_set_hdr(req, "Content-Disposition", "attachment; filename=\"capture.pcap\"");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    pcap_file_header_t header = {
+        .magic = CAPTURE_PCAP_MAGIC,
+        .version_major = 2,
+        .version_minor = 4,
+        .snaplen = len,
+        .linktype = CAPTURE_LINKTYPE_ETHERNET,
+    };
+    memcpy(buffer, &header, sizeof(header));
+    size_t used = sizeof(header);
+    esp_err_t err = ESP_OK;
+
+    // Las tramas se copian sin la sección crítica: el anillo solo se libera o reinicia desde el servidor web, que
+    // atiende las peticiones de una en una, y la secuencia de cada ranura descarta las tramas a medio escribir o
+    // sobrescritas durante la copia
+    for (uint32_t index = first; index < end && err == ESP_OK; index++)
+    {
+        if (__atomic_load_n(&generation, __ATOMIC_RELAXED) != gen)
+        {
+            break;
+        }
+        const capture_slot_t *slot = (const capture_slot_t *)(frames + (index % count) * size);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != index + 1)
+        {
+            continue;
+        }
+
+        pcap_record_t record = slot->record;
+        record.incl_len = MIN(record.incl_len, len);
+        memcpy(buffer + used, &record, sizeof(record));
+        memcpy(buffer + used + sizeof(record), slot->data, record.incl_len);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != index + 1)
+        {
+            continue;
+        }
+
+        used += sizeof(record) + record.incl_len;
+        if (used >= CAPTURE_STREAM_CHUNK)
+        {
+            err = httpd_resp_send_chunk(req, buffer, used);
+            used = 0;
+        }
+    }
+
+    if (err == ESP_OK && used > 0)
+    {
+        err = httpd_resp_send_chunk(req, buffer, used);
+    }
+    free(buffer);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "lwip/pbuf.h"
+
+// Captura de paquetes en el propio router.
+// Los ganchos de la ruta de reenvío copian las tramas (recortadas a snaplen y con marca de tiempo) en un anillo
+// de ranuras de tamaño fijo reservado al iniciar la captura; en la ruta de los paquetes no se reserva memoria y,
+// con la captura parada, el coste es una única comparación. Las tramas se pueden filtrar por MAC, IP, puerto
+// e interfaz, y el anillo se descarga en formato pcap por /capture.pcap. El coste medido con la captura activa
+// se publica en /capture y en /metrics.
+
+// Definiciones de la captura
+#define CAPTURE_RING_BYTES 32768     // Memoria del anillo, reservada al iniciar la captura
+#define CAPTURE_SNAPLEN_DEFAULT 96   // Bytes guardados de cada trama
+#define CAPTURE_SNAPLEN_MAX 1514
+#define CAPTURE_STREAM_CHUNK 1024    // Bytes por bloque de la descarga
+
+// Interfaz y sentido de una trama (máscara para el filtro)
+#define CAPTURE_AP_IN (1u << 0)
+#define CAPTURE_AP_OUT (1u << 1)
+#define CAPTURE_STA_IN (1u << 2)
+#define CAPTURE_STA_OUT (1u << 3)
+#define CAPTURE_ALL (CAPTURE_AP_IN | CAPTURE_AP_OUT | CAPTURE_STA_IN | CAPTURE_STA_OUT)
+
+// Contadores de la captura
+typedef struct
+{
+    bool active;
+    uint32_t snaplen;
+    uint32_t slots;       // Tramas que caben en el anillo
+    uint32_t stored;      // Tramas en el anillo
+    uint32_t captured;    // Tramas guardadas desde el inicio
+    uint32_t filtered;    // Tramas descartadas por el filtro
+    uint32_t overwritten; // Tramas sobrescritas antes de descargarse
+    uint64_t cycles;      // Ciclos de CPU consumidos por la captura en la ruta de los paquetes
+} capture_stats_t;
+
+extern bool capture_active;
+
+void capture_frame(uint32_t point, struct pbuf *p); // Filtra y guarda una trama
+
+// Punto de captura en la ruta de los paquetes: con la captura parada solo cuesta una comparación
+static inline void capture_tap(uint32_t point, struct pbuf *p)
+{
+    if (__builtin_expect(capture_active, 0))
+    {
+        capture_frame(point, p);
+    }
+}
+
+void capture_get_stats(capture_stats_t *stats);        // Copia los contadores
+esp_err_t capture_get_handler(httpd_req_t *req);       // GET /capture: estado, filtro y coste
+esp_err_t capture_post_handler(httpd_req_t *req);      // POST /capture: inicia, para o libera la captura
+esp_err_t capture_pcap_handler(httpd_req_t *req);      // GET /capture.pcap: descarga el anillo
@@ -0,0 +1,146 @@
+#include "clients.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include <stdio.h>
+
+_Static_assert((CLIENTS_INDEX_SIZE & (CLIENTS_INDEX_SIZE - 1)) == 0 && CLIENTS_INDEX_SIZE >= 2 * CLIENTS_MAX, "CLIENTS_INDEX_SIZE debe ser potencia de 2 y al menos el doble de CLIENTS_MAX");
+_Static_assert(CONFIG_LWIP_DHCPS_MAX_STATION_NUM >= CLIENTS_MAX, "El servidor DHCP debe admitir todos los clientes (CONFIG_LWIP_DHCPS_MAX_STATION_NUM)");
+
+// Tags para logging
+static const char *TAG_CLIENTS = "CLIENTS";
+
+// Variables globales
+static client_info_t entries[CLIENTS_MAX];
+static uint8_t index_slots[CLIENTS_INDEX_SIZE];
+static clients_table_t table = {.entries = entries, .index = index_slots, .capacity = CLIENTS_MAX, .index_mask = CLIENTS_INDEX_SIZE - 1};
+static portMUX_TYPE clients_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void clients_connected(const uint8_t *mac, uint8_t aid)
+{
+    uint32_t now_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+    portENTER_CRITICAL(&clients_lock);
+    bool full = clients_table_add(&table, mac, aid, now_s) == NULL;
+    portEXIT_CRITICAL(&clients_lock);
+
+    if (full)
+    {
+        ESP_LOGW(TAG_CLIENTS, "Tabla de clientes llena (%d), " MACSTR " no se contabiliza", CLIENTS_MAX, MAC2STR(mac));
+    }
+}
+
+void clients_disconnected(const uint8_t *mac)
+{
+    portENTER_CRITICAL(&clients_lock);
+    clients_table_remove(&table, mac);
+    portEXIT_CRITICAL(&clients_lock);
+}
+
+void clients_set_ip(const uint8_t *mac, uint32_t ip)
+{
+    portENTER_CRITICAL(&clients_lock);
+    client_info_t *entry = clients_table_find(&table, mac);
+    if (entry != NULL)
+    {
+        entry->ip = ip;
+    }
+    portEXIT_CRITICAL(&clients_lock);
+}
+
+int clients_index(const uint8_t *mac)
+{
+    portENTER_CRITICAL(&clients_lock);
+    int slot = clients_table_slot(&table, mac);
+    portEXIT_CRITICAL(&clients_lock);
+    return slot;
+}
+
+void clients_count_up(const uint8_t *mac, uint32_t src_ip, uint16_t len)
+{
+    portENTER_CRITICAL(&clients_lock);
+    client_info_t *entry = clients_table_find(&table, mac);
+    if (entry != NULL)
+    {
+        entry->up_packets++;
+        entry->up_bytes += len;
+        if (entry->ip == 0) // Clientes con IP fija, que no pasan por el DHCP
+        {
+            entry->ip = src_ip;
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+}
+
+void clients_count_down(const uint8_t *mac, uint16_t len)
+{
+    portENTER_CRITICAL(&clients_lock);
+    client_info_t *entry = clients_table_find(&table, mac);
+    if (entry != NULL)
+    {
+        entry->down_packets++;
+        entry->down_bytes += len;
+    }
+    portEXIT_CRITICAL(&clients_lock);
+}
+
+int clients_get(client_info_t *info, int max)
+{
+    // El RSSI solo lo conoce el driver; se lee fuera de la sección crítica (solo desde la tarea del servidor HTTP)
+    static wifi_sta_list_t list;
+    if (esp_wifi_ap_get_sta_list(&list) != ESP_OK)
+    {
+        list.num = 0;
+    }
+
+    int count = 0;
+    portENTER_CRITICAL(&clients_lock);
+    for (int i = 0; i < list.num; i++)
+    {
+        client_info_t *entry = clients_table_find(&table, list.sta[i].mac);
+        if (entry != NULL)
+        {
+            entry->rssi = list.sta[i].rssi;
+        }
+    }
+    for (int slot = 0; slot < CLIENTS_MAX && count < max; slot++)
+    {
+        if (entries[slot].aid != 0)
+        {
+            info[count++] = entries[slot];
+        }
+    }
+    portEXIT_CRITICAL(&clients_lock);
+
+    return count;
+}
+
+esp_err_t clients_handler(httpd_req_t *req)
+{
+    static client_info_t info[CLIENTS_MAX]; // Fuera de la pila de la tarea del servidor HTTP
+    int count = clients_get(info, CLIENTS_MAX);
+    uint32_t now_s = (uint32_t)(esp_timer_get_time() / 1000000);
+
+    char line[192];
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    snprintf(line, sizeof(line), "clients %d\ncapacity %d\ntable_bytes %u\n", count, CLIENTS_MAX, (unsigned)(sizeof(entries) + sizeof(index_slots)));
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+
+    for (int i = 0; i < count; i++)
+    {
+        const client_info_t *client = &info[i];
+        snprintf(line, sizeof(line), "client " MACSTR " ip " IPSTR " aid %u rssi %d connected_s %lu up %lu/%llu down %lu/%llu\n", MAC2STR(client->mac),
+                 IP2STR((esp_ip4_addr_t *)&client->ip), client->aid, client->rssi, now_s - client->connected_s, client->up_packets, client->up_bytes,
+                 client->down_packets, client->down_bytes);
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
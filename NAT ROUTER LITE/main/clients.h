@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include "clients_table.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "sdkconfig.h"
+
+// Tabla de clientes del punto de acceso.
+// Capacidad fija elegida al compilar (CONFIG_ROUTER_MAX_CLIENTS, en menuconfig "NAT Router"). Cada cliente
+// ocupa una ranura que conserva mientras está conectado, y un índice de direccionamiento abierto sobre la MAC
+// la encuentra en tiempo constante desde la ruta de reenvío (contadores de bytes) y desde los eventos del
+// DHCP. El control de tráfico usa la misma ranura para su estado por cliente.
+// tools/clients_load.c conecta estaciones simuladas hasta llenar la tabla y mide el coste por paquete.
+//
+// Memoria por cliente:
+//   - Esta tabla (clients_table.c): 40 bytes (client_info_t), más 32 bytes fijos del índice.
+//   - Control de tráfico (shaper.c): unos 180 bytes, más los paquetes que tenga en cola.
+//   - Estado en vivo (status.c): 12 bytes en el último estado enviado.
+//   - Servidor DHCP de lwIP y driver WiFi: reservados por ESP-IDF según CONFIG_LWIP_DHCPS_MAX_STATION_NUM
+//     y max_connection; se ven en router_heap_free_bytes de /metrics al conectar clientes.
+
+// Definiciones de la tabla
+#define CLIENTS_MAX CONFIG_ROUTER_MAX_CLIENTS // Clientes conectados a la vez (máximo del driver: 15)
+#define CLIENTS_INDEX_SIZE 32                 // Ranuras del índice (potencia de 2, al menos el doble de CLIENTS_MAX)
+
+void clients_connected(const uint8_t *mac, uint8_t aid);                    // Ocupa una ranura para el cliente
+void clients_disconnected(const uint8_t *mac);                              // Libera la ranura del cliente
+void clients_set_ip(const uint8_t *mac, uint32_t ip);                       // IP asignada por el DHCP
+int clients_index(const uint8_t *mac);                                      // Ranura del cliente (0..CLIENTS_MAX-1), -1 si no está
+void clients_count_up(const uint8_t *mac, uint32_t src_ip, uint16_t len);   // Cuenta un paquete de subida
+void clients_count_down(const uint8_t *mac, uint16_t len);                  // Cuenta un paquete de bajada
+int clients_get(client_info_t *info, int max);                              // Copia los clientes conectados y devuelve cuántos
+esp_err_t clients_handler(httpd_req_t *req);                                // GET /clients
@@ -0,0 +1,114 @@
+#include "clients_table.h"
+#include <string.h>
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Los tres primeros bytes identifican al fabricante; se mezclan los últimos cuatro
+static inline uint32_t mac_hash(const clients_table_t *table, const uint8_t *mac)
+{
+    uint32_t h = ((uint32_t)mac[2] << 24) | ((uint32_t)mac[3] << 16) | ((uint32_t)mac[4] << 8) | mac[5];
+    return ((h * 0x9e3779b1u) >> 16) & table->index_mask;
+}
+
+// Posición del cliente en el índice, -1 si no está
+static int index_find(const clients_table_t *table, const uint8_t *mac)
+{
+    uint32_t pos = mac_hash(table, mac);
+    for (uint32_t probe = 0; probe <= table->index_mask; probe++, pos = (pos + 1) & table->index_mask)
+    {
+        if (table->index[pos] == 0)
+        {
+            return -1;
+        }
+        if (memcmp(table->entries[table->index[pos] - 1].mac, mac, sizeof(table->entries[0].mac)) == 0)
+        {
+            return pos;
+        }
+    }
+    return -1;
+}
+
+// Quita una posición del índice desplazando hacia atrás las siguientes de la misma cadena de sondeo
+static void index_remove(clients_table_t *table, uint32_t pos)
+{
+    uint32_t mask = table->index_mask;
+    table->index[pos] = 0;
+    for (uint32_t next = (pos + 1) & mask; table->index[next] != 0; next = (next + 1) & mask)
+    {
+        uint32_t home = mac_hash(table, table->entries[table->index[next] - 1].mac);
+        if (((next - home) & mask) >= ((next - pos) & mask))
+        {
+            table->index[pos] = table->index[next];
+            table->index[next] = 0;
+            pos = next;
+        }
+    }
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void clients_table_init(clients_table_t *table, client_info_t *entries, uint32_t capacity, uint8_t *index, uint32_t index_size)
+{
+    memset(entries, 0, capacity * sizeof(client_info_t));
+    memset(index, 0, index_size);
+    table->entries = entries;
+    table->index = index;
+    table->capacity = capacity;
+    table->index_mask = index_size - 1;
+    table->count = 0;
+}
+
+client_info_t *clients_table_find(clients_table_t *table, const uint8_t *mac)
+{
+    int pos = index_find(table, mac);
+    return (pos < 0) ? NULL : &table->entries[table->index[pos] - 1];
+}
+
+int clients_table_slot(const clients_table_t *table, const uint8_t *mac)
+{
+    int pos = index_find(table, mac);
+    return (pos < 0) ? -1 : table->index[pos] - 1;
+}
+
+client_info_t *clients_table_add(clients_table_t *table, const uint8_t *mac, uint8_t aid, uint32_t now_s)
+{
+    client_info_t *entry = clients_table_find(table, mac);
+    for (uint32_t slot = 0; entry == NULL && slot < table->capacity; slot++)
+    {
+        if (table->entries[slot].aid == 0)
+        {
+            entry = &table->entries[slot];
+            uint32_t pos = mac_hash(table, mac);
+            while (table->index[pos] != 0)
+            {
+                pos = (pos + 1) & table->index_mask;
+            }
+            table->index[pos] = slot + 1;
+            table->count++;
+        }
+    }
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    // Una reasociación sin desconexión previa empieza de cero
+    memset(entry, 0, sizeof(*entry));
+    memcpy(entry->mac, mac, sizeof(entry->mac));
+    entry->aid = aid ? aid : 0xff;
+    entry->connected_s = now_s;
+    return entry;
+}
+
+bool clients_table_remove(clients_table_t *table, const uint8_t *mac)
+{
+    int pos = index_find(table, mac);
+    if (pos < 0)
+    {
+        return false;
+    }
+    table->entries[table->index[pos] - 1].aid = 0;
+    index_remove(table, pos);
+    table->count--;
+    return true;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tabla de clientes indexada por MAC.
+// Ranuras fijas que cada cliente conserva mientras está conectado y un índice de direccionamiento abierto
+// sobre la MAC (sondeo lineal, borrado por desplazamiento hacia atrás) que guarda la ranura + 1 de cada
+// cliente. La memoria la pone quien la usa. No depende de ESP-IDF para poder compilarse en el host
+// (tools/clients_load.c); la sincronización queda a cargo de quien la use.
+
+// Definiciones de la tabla
+#define CLIENTS_TABLE_MAX_CAPACITY 254 // El índice guarda la ranura + 1 en un byte
+
+// Datos de un cliente
+typedef struct
+{
+    uint8_t mac[6];
+    uint8_t aid;           // Identificador de asociación, 0 en ranuras libres
+    int8_t rssi;           // Última lectura, se refresca en clients_get
+    uint32_t ip;           // 0 hasta que el DHCP le asigna una o envía tráfico
+    uint32_t connected_s;  // Segundos desde el arranque al conectarse
+    uint32_t up_packets;   // Paquetes reenviados hacia la red de subida
+    uint32_t down_packets; // Paquetes reenviados hacia el cliente
+    uint64_t up_bytes;
+    uint64_t down_bytes;
+} client_info_t;
+
+typedef struct
+{
+    client_info_t *entries; // capacity ranuras
+    uint8_t *index;         // Ranura + 1 de cada cliente, 0 vacío
+    uint32_t capacity;
+    uint32_t index_mask;    // Ranuras del índice - 1 (potencia de 2, al menos el doble de capacity)
+    uint32_t count;         // Clientes en la tabla
+} clients_table_t;
+
+void clients_table_init(clients_table_t *table, client_info_t *entries, uint32_t capacity, uint8_t *index, uint32_t index_size); // Vacía la tabla sobre la memoria dada
+client_info_t *clients_table_find(clients_table_t *table, const uint8_t *mac);                  // Ficha del cliente, NULL si no está
+int clients_table_slot(const clients_table_t *table, const uint8_t *mac);                        // Ranura del cliente, -1 si no está
+client_info_t *clients_table_add(clients_table_t *table, const uint8_t *mac, uint8_t aid, uint32_t now_s); // Ficha a cero del cliente, NULL si la tabla está llena
+bool clients_table_remove(clients_table_t *table, const uint8_t *mac);                          // Libera la ranura del cliente
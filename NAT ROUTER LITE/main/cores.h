@@ -0,0 +1,18 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+// Reparto del trabajo entre los dos núcleos.
+// Núcleo 0, ruta de los paquetes: tarea del WiFi (23), bucle de eventos por defecto (20, lo fija ESP-IDF),
+// control de tráfico (19) y tarea TCP/IP (18). El WiFi y TCP/IP se fijan en sdkconfig.
+// Núcleo 1, plano de control: tarea de esp_timer (22, fijada en sdkconfig; reconexión, estado en vivo), reenviador
+// DNS (6), servidor HTTP (5), prueba de velocidad (4), registro de eventos (1) y guardado de la configuración (1).
+// Así ninguna tarea de la interfaz web puede adelantarse a la ruta de los paquetes; /tasks lo comprueba.
+
+#if CONFIG_FREERTOS_UNICORE
+#define CORE_PACKET 0
+#define CORE_CONTROL 0
+#else
+#define CORE_PACKET 0  // Ruta de los paquetes
+#define CORE_CONTROL 1 // Plano de control e interfaz web
+#endif
@@ -0,0 +1,616 @@
+#include "dns_core.h"
+#include <string.h>
+
+// Formato DNS (RFC 1035)
+#define DNS_HEADER_LEN 12
+#define DNS_CLASSIC_UDP 512     // Tamaño máximo de respuesta para clientes sin EDNS
+#define DNS_FLAG_QR 0x8000
+#define DNS_FLAG_TC 0x0200
+#define DNS_OPCODE_MASK 0x7800
+#define DNS_RCODE_MASK 0x000F
+#define DNS_RCODE_NOERROR 0
+#define DNS_RCODE_FORMERR 1
+#define DNS_RCODE_SERVFAIL 2
+#define DNS_RCODE_NXDOMAIN 3
+#define DNS_RCODE_NOTIMP 4
+#define DNS_TYPE_OPT 41
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint16_t read16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline uint32_t read32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static inline void write16(uint8_t *p, uint16_t value)
+{
+    p[0] = value >> 8;
+    p[1] = value & 0xFF;
+}
+
+static inline void write32(uint8_t *p, uint32_t value)
+{
+    p[0] = value >> 24;
+    p[1] = (value >> 16) & 0xFF;
+    p[2] = (value >> 8) & 0xFF;
+    p[3] = value & 0xFF;
+}
+
+// FNV-1a de la clave
+static uint32_t key_hash(const uint8_t *key, int len)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++)
+    {
+        hash = (hash ^ key[i]) * 16777619u;
+    }
+    return hash;
+}
+
+// Copia la pregunta en minúsculas (nombre sin compresión, tipo y clase) y devuelve su longitud, o -1 si es inválida
+static int parse_question(const uint8_t *msg, int len, uint8_t *key)
+{
+    int off = DNS_HEADER_LEN;
+    int key_len = 0;
+
+    while (true)
+    {
+        if (off >= len)
+        {
+            return -1;
+        }
+        uint8_t label = msg[off];
+        if (label & 0xC0)
+        {
+            return -1; // Las preguntas de los clientes no usan compresión
+        }
+        if (off + 1 + label > len || key_len + 1 + label > DNS_MAX_KEY - 4)
+        {
+            return -1;
+        }
+        key[key_len++] = label;
+        off++;
+        for (int i = 0; i < label; i++)
+        {
+            uint8_t c = msg[off + i];
+            key[key_len++] = (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+        }
+        off += label;
+        if (label == 0)
+        {
+            break;
+        }
+    }
+
+    if (off + 4 > len)
+    {
+        return -1;
+    }
+    memcpy(&key[key_len], &msg[off], 4);
+    return key_len + 4;
+}
+
+// Salta un nombre (con o sin compresión) y devuelve el desplazamiento siguiente, o -1 si es inválido
+static int skip_name(const uint8_t *msg, int len, int off)
+{
+    while (off < len)
+    {
+        uint8_t label = msg[off];
+        if ((label & 0xC0) == 0xC0)
+        {
+            return off + 2 <= len ? off + 2 : -1;
+        }
+        if (label & 0xC0)
+        {
+            return -1;
+        }
+        off += 1 + label;
+        if (label == 0)
+        {
+            return off <= len ? off : -1;
+        }
+    }
+    return -1;
+}
+
+// Recorre los registros de la respuesta; obtiene el TTL mínimo y, si elapsed > 0, lo descuenta de cada registro
+static bool walk_records(uint8_t *msg, int len, uint32_t elapsed, uint32_t *min_ttl)
+{
+    int off = DNS_HEADER_LEN;
+    uint16_t qdcount = read16(&msg[4]);
+    int rrcount = read16(&msg[6]) + read16(&msg[8]) + read16(&msg[10]);
+
+    for (int i = 0; i < qdcount; i++)
+    {
+        off = skip_name(msg, len, off);
+        if (off < 0 || off + 4 > len)
+        {
+            return false;
+        }
+        off += 4;
+    }
+
+    uint32_t lowest = UINT32_MAX;
+    for (int i = 0; i < rrcount; i++)
+    {
+        off = skip_name(msg, len, off);
+        if (off < 0 || off + 10 > len)
+        {
+            return false;
+        }
+        uint16_t type = read16(&msg[off]);
+        uint32_t ttl = read32(&msg[off + 4]);
+        uint16_t rdlen = read16(&msg[off + 8]);
+
+        if (type != DNS_TYPE_OPT) // El campo TTL del registro OPT contiene indicadores EDNS
+        {
+            if (ttl < lowest)
+            {
+                lowest = ttl;
+            }
+            if (elapsed > 0)
+            {
+                write32(&msg[off + 4], ttl > elapsed ? ttl - elapsed : 0);
+            }
+        }
+
+        off += 10 + rdlen;
+        if (off > len)
+        {
+            return false;
+        }
+    }
+
+    if (min_ttl != NULL)
+    {
+        *min_ttl = lowest;
+    }
+    return true;
+}
+
+// Tamaño de respuesta aceptado por el cliente según su registro OPT
+static uint16_t query_max_udp(const uint8_t *msg, int len, int question_end)
+{
+    int off = question_end;
+    int rrcount = read16(&msg[6]) + read16(&msg[8]) + read16(&msg[10]);
+
+    for (int i = 0; i < rrcount; i++)
+    {
+        off = skip_name(msg, len, off);
+        if (off < 0 || off + 10 > len)
+        {
+            break;
+        }
+        if (read16(&msg[off]) == DNS_TYPE_OPT)
+        {
+            uint16_t size = read16(&msg[off + 2]);
+            return size < DNS_CLASSIC_UDP ? DNS_CLASSIC_UDP : size;
+        }
+        off += 10 + read16(&msg[off + 8]);
+    }
+    return DNS_CLASSIC_UDP;
+}
+
+// Envía la respuesta al cliente con su identificador; si no cabe, envía solo la cabecera y la pregunta con TC
+static void send_to_client(dns_core_t *core, uint8_t *msg, int len, int question_end, const dns_peer_t *to, uint16_t id, uint16_t max_udp)
+{
+    write16(&msg[0], id);
+    if (len <= max_udp)
+    {
+        core->io.send_client(core->io.ctx, msg, len, to);
+        return;
+    }
+
+    uint8_t truncated[DNS_HEADER_LEN + DNS_MAX_KEY];
+    memcpy(truncated, msg, question_end);
+    write16(&truncated[2], read16(&msg[2]) | DNS_FLAG_TC);
+    memset(&truncated[6], 0, 6);
+    core->io.send_client(core->io.ctx, truncated, question_end, to);
+}
+
+// Responde al cliente con un código de respuesta y la misma pregunta, sin registros
+static void send_rcode(dns_core_t *core, uint8_t *msg, int len, const dns_peer_t *to, uint16_t rcode)
+{
+    int question_end = skip_name(msg, len, DNS_HEADER_LEN);
+    if (read16(&msg[4]) == 0 || question_end < 0 || question_end + 4 > len)
+    {
+        question_end = DNS_HEADER_LEN;
+        write16(&msg[4], 0);
+    }
+    else
+    {
+        question_end += 4;
+        write16(&msg[4], 1);
+    }
+
+    uint16_t flags = read16(&msg[2]);
+    write16(&msg[2], DNS_FLAG_QR | (flags & (DNS_OPCODE_MASK | 0x0100)) | 0x0080 | rcode); // Conserva opcode y RD, activa RA
+    memset(&msg[6], 0, 6);
+    core->io.send_client(core->io.ctx, msg, question_end, to);
+}
+
+// Devuelve a la pregunta de la respuesta las mayúsculas y minúsculas del cliente: los resolutores que las
+// aleatorizan (0x20) descartan las respuestas que no repiten su pregunta exacta
+static inline void restore_question(uint8_t *msg, const uint8_t *question, int question_end)
+{
+    memcpy(&msg[DNS_HEADER_LEN], question, question_end - DNS_HEADER_LEN);
+}
+
+// Responde al cliente con un código de error y la misma pregunta
+static void send_error(dns_core_t *core, uint8_t *msg, int len, const dns_peer_t *to, uint16_t rcode)
+{
+    send_rcode(core, msg, len, to, rcode);
+    core->stats.errors++;
+}
+
+// MARK: CACHÉ ------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void lru_unlink(dns_core_t *core, int16_t index)
+{
+    dns_cache_entry_t *entry = &core->cache[index];
+    if (entry->prev >= 0)
+    {
+        core->cache[entry->prev].next = entry->next;
+    }
+    else
+    {
+        core->lru_head = entry->next;
+    }
+    if (entry->next >= 0)
+    {
+        core->cache[entry->next].prev = entry->prev;
+    }
+    else
+    {
+        core->lru_tail = entry->prev;
+    }
+    entry->prev = entry->next = -1;
+}
+
+static void lru_push_front(dns_core_t *core, int16_t index)
+{
+    dns_cache_entry_t *entry = &core->cache[index];
+    entry->prev = -1;
+    entry->next = core->lru_head;
+    if (core->lru_head >= 0)
+    {
+        core->cache[core->lru_head].prev = index;
+    }
+    core->lru_head = index;
+    if (core->lru_tail < 0)
+    {
+        core->lru_tail = index;
+    }
+}
+
+static void cache_evict(dns_core_t *core, int16_t index)
+{
+    dns_cache_entry_t *entry = &core->cache[index];
+    lru_unlink(core, index);
+    core->stats.bytes -= entry->key_len + entry->resp_len;
+    core->stats.entries--;
+    core->io.free(entry->data);
+    entry->data = NULL;
+}
+
+static int16_t cache_find(dns_core_t *core, const uint8_t *key, int key_len, uint32_t hash, uint32_t now_s)
+{
+    for (int16_t i = core->lru_head; i >= 0; i = core->cache[i].next)
+    {
+        dns_cache_entry_t *entry = &core->cache[i];
+        if (entry->hash != hash || entry->key_len != key_len || memcmp(entry->data, key, key_len) != 0)
+        {
+            continue;
+        }
+        if ((int32_t)(entry->expires - now_s) <= 0)
+        {
+            cache_evict(core, i);
+            return -1;
+        }
+        return i;
+    }
+    return -1;
+}
+
+static void cache_store(dns_core_t *core, const uint8_t *key, int key_len, uint32_t hash, const uint8_t *resp, int resp_len, uint32_t ttl, uint32_t now_s)
+{
+    uint32_t size = key_len + resp_len;
+    if (size > DNS_CACHE_BUDGET / 4) // Una sola respuesta no puede ocupar más de un cuarto de la caché
+    {
+        return;
+    }
+
+    int16_t existing = cache_find(core, key, key_len, hash, now_s);
+    if (existing >= 0)
+    {
+        cache_evict(core, existing);
+    }
+
+    // Libera las entradas menos usadas hasta que quepa la nueva
+    int16_t slot = -1;
+    for (int16_t i = 0; i < DNS_CACHE_MAX_ENTRIES && slot < 0; i++)
+    {
+        if (core->cache[i].data == NULL)
+        {
+            slot = i;
+        }
+    }
+    while (core->lru_tail >= 0 && (slot < 0 || core->stats.bytes + size > DNS_CACHE_BUDGET))
+    {
+        int16_t victim = core->lru_tail;
+        cache_evict(core, victim);
+        if (slot < 0)
+        {
+            slot = victim;
+        }
+    }
+    if (slot < 0)
+    {
+        return;
+    }
+
+    uint8_t *data = core->io.alloc(size);
+    if (data == NULL)
+    {
+        return;
+    }
+    memcpy(data, key, key_len);
+    memcpy(data + key_len, resp, resp_len);
+
+    dns_cache_entry_t *entry = &core->cache[slot];
+    entry->data = data;
+    entry->hash = hash;
+    entry->key_len = key_len;
+    entry->resp_len = resp_len;
+    entry->inserted = now_s;
+    entry->expires = now_s + (ttl < DNS_CACHE_MAX_TTL ? ttl : DNS_CACHE_MAX_TTL);
+    lru_push_front(core, slot);
+    core->stats.bytes += size;
+    core->stats.entries++;
+}
+
+// MARK: CONSULTAS ----------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static dns_pending_t *pending_find(dns_core_t *core, const uint8_t *key, int key_len, uint32_t hash)
+{
+    for (int i = 0; i < DNS_MAX_PENDING; i++)
+    {
+        dns_pending_t *p = &core->pending[i];
+        if (p->data != NULL && p->hash == hash && p->key_len == key_len && memcmp(p->data, key, key_len) == 0)
+        {
+            return p;
+        }
+    }
+    return NULL;
+}
+
+static void pending_release(dns_core_t *core, dns_pending_t *p)
+{
+    for (int i = 0; i < p->waiter_count; i++)
+    {
+        core->io.free(p->waiters[i].question);
+    }
+    core->io.free(p->data);
+    p->data = NULL;
+    p->waiter_count = 0;
+}
+
+static void send_upstream(dns_core_t *core, dns_pending_t *p, uint32_t now_ms)
+{
+    core->io.send_upstream(core->io.ctx, p->data + p->key_len, p->query_len);
+    p->sent_ms = now_ms;
+}
+
+// Responde SERVFAIL a todos los clientes de una consulta abandonada, cada uno con su identificador y su pregunta
+static void fail_waiters(dns_core_t *core, dns_pending_t *p)
+{
+    uint8_t *msg = core->scratch;
+    int question_end = DNS_HEADER_LEN + p->key_len;
+    for (int i = 0; i < p->waiter_count; i++)
+    {
+        dns_waiter_t *w = &p->waiters[i];
+        memcpy(msg, p->data + p->key_len, question_end); // Cabecera y pregunta de la consulta enviada
+        if (w->question)
+        {
+            restore_question(msg, w->question, question_end);
+        }
+        write16(&msg[0], w->id);
+        send_rcode(core, msg, question_end, &w->peer, DNS_RCODE_SERVFAIL);
+    }
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void dns_core_init(dns_core_t *core, const dns_core_io_t *io)
+{
+    memset(core, 0, sizeof(*core));
+    core->io = *io;
+    core->lru_head = core->lru_tail = -1;
+    for (int i = 0; i < DNS_CACHE_MAX_ENTRIES; i++)
+    {
+        core->cache[i].prev = core->cache[i].next = -1;
+    }
+}
+
+void dns_core_query(dns_core_t *core, uint8_t *msg, int len, const dns_peer_t *from, uint32_t now_ms)
+{
+    core->stats.queries++;
+
+    if (len < DNS_HEADER_LEN || (read16(&msg[2]) & DNS_FLAG_QR))
+    {
+        core->stats.errors++;
+        return; // Se ignoran las respuestas y los paquetes truncados
+    }
+    if (read16(&msg[2]) & DNS_OPCODE_MASK)
+    {
+        send_error(core, msg, len, from, DNS_RCODE_NOTIMP);
+        return;
+    }
+
+    uint8_t key[DNS_MAX_KEY];
+    int key_len = read16(&msg[4]) == 1 ? parse_question(msg, len, key) : -1;
+    if (key_len < 0)
+    {
+        send_error(core, msg, len, from, DNS_RCODE_FORMERR);
+        return;
+    }
+
+    // Nombre en la lista de bloqueo: NXDOMAIN sin consultar al servidor de subida (la clave termina en tipo y clase)
+    if (core->io.blocked != NULL && core->io.blocked(key, key_len - 4))
+    {
+        send_rcode(core, msg, len, from, DNS_RCODE_NXDOMAIN);
+        core->stats.blocked++;
+        return;
+    }
+
+    uint16_t id = read16(&msg[0]);
+    int question_end = DNS_HEADER_LEN + key_len;
+    uint16_t max_udp = query_max_udp(msg, len, question_end);
+    uint32_t hash = key_hash(key, key_len);
+    uint32_t now_s = now_ms / 1000;
+
+    // Respuesta en caché: se copia, se descuentan los TTL y se envía con el identificador y la pregunta del cliente
+    int16_t index = cache_find(core, key, key_len, hash, now_s);
+    if (index >= 0)
+    {
+        dns_cache_entry_t *entry = &core->cache[index];
+        memcpy(core->scratch, entry->data + entry->key_len, entry->resp_len);
+        walk_records(core->scratch, entry->resp_len, now_s - entry->inserted, NULL);
+        restore_question(core->scratch, &msg[DNS_HEADER_LEN], question_end);
+        send_to_client(core, core->scratch, entry->resp_len, question_end, from, id, max_udp);
+        lru_unlink(core, index);
+        lru_push_front(core, index);
+        core->stats.hits++;
+        return;
+    }
+
+    // Consulta idéntica ya pendiente: el cliente espera la misma respuesta
+    dns_pending_t *p = pending_find(core, key, key_len, hash);
+    if (p != NULL)
+    {
+        if (p->waiter_count >= DNS_MAX_WAITERS)
+        {
+            core->stats.dropped++;
+            return;
+        }
+
+        // La pregunta se guarda solo si difiere en mayúsculas de la enviada; sin memoria, el cliente repetirá la consulta
+        dns_waiter_t *w = &p->waiters[p->waiter_count];
+        *w = (dns_waiter_t){.peer = *from, .id = id, .max_udp = max_udp};
+        if (memcmp(p->data + p->key_len + DNS_HEADER_LEN, &msg[DNS_HEADER_LEN], key_len) != 0)
+        {
+            w->question = core->io.alloc(key_len);
+            if (w->question == NULL)
+            {
+                core->stats.dropped++;
+                return;
+            }
+            memcpy(w->question, &msg[DNS_HEADER_LEN], key_len);
+        }
+        p->waiter_count++;
+        core->stats.coalesced++;
+        return;
+    }
+
+    if (!core->upstream)
+    {
+        send_error(core, msg, len, from, DNS_RCODE_SERVFAIL);
+        return;
+    }
+
+    for (int i = 0; i < DNS_MAX_PENDING && p == NULL; i++)
+    {
+        if (core->pending[i].data == NULL)
+        {
+            p = &core->pending[i];
+        }
+    }
+    if (p == NULL || (p->data = core->io.alloc(key_len + len)) == NULL)
+    {
+        send_error(core, msg, len, from, DNS_RCODE_SERVFAIL);
+        return;
+    }
+
+    // Se envía con un identificador aleatorio propio para no depender de los identificadores de los clientes
+    p->upstream_id = core->io.random_id();
+    write16(&msg[0], p->upstream_id);
+    memcpy(p->data, key, key_len);
+    memcpy(p->data + key_len, msg, len);
+    p->hash = hash;
+    p->key_len = key_len;
+    p->query_len = len;
+    p->waiters[0] = (dns_waiter_t){.peer = *from, .id = id, .max_udp = max_udp}; // Su pregunta es la enviada
+    p->waiter_count = 1;
+    p->first_ms = now_ms;
+    send_upstream(core, p, now_ms);
+    core->stats.misses++;
+}
+
+void dns_core_response(dns_core_t *core, uint8_t *msg, int len, uint32_t now_ms)
+{
+    if (len < DNS_HEADER_LEN || !(read16(&msg[2]) & DNS_FLAG_QR))
+    {
+        return;
+    }
+
+    uint8_t key[DNS_MAX_KEY];
+    int key_len = read16(&msg[4]) == 1 ? parse_question(msg, len, key) : -1;
+    if (key_len < 0)
+    {
+        return;
+    }
+
+    // La respuesta debe coincidir en identificador y pregunta con una consulta pendiente
+    uint32_t hash = key_hash(key, key_len);
+    dns_pending_t *p = pending_find(core, key, key_len, hash);
+    if (p == NULL || p->upstream_id != read16(&msg[0]))
+    {
+        return;
+    }
+
+    uint16_t flags = read16(&msg[2]);
+    uint16_t rcode = flags & DNS_RCODE_MASK;
+    uint32_t ttl = 0;
+    if (!(flags & DNS_FLAG_TC) && (rcode == DNS_RCODE_NOERROR || rcode == DNS_RCODE_NXDOMAIN) &&
+        walk_records(msg, len, 0, &ttl) && ttl != UINT32_MAX && ttl > 0)
+    {
+        cache_store(core, key, key_len, hash, msg, len, ttl, now_ms / 1000);
+    }
+
+    int question_end = DNS_HEADER_LEN + key_len;
+    for (int i = 0; i < p->waiter_count; i++)
+    {
+        dns_waiter_t *w = &p->waiters[i];
+        restore_question(msg, w->question ? w->question : p->data + p->key_len + DNS_HEADER_LEN, question_end);
+        send_to_client(core, msg, len, question_end, &w->peer, w->id, w->max_udp);
+    }
+    pending_release(core, p);
+}
+
+// Reenvía una vez las consultas sin respuesta y abandona las que superan el tiempo máximo
+void dns_core_tick(dns_core_t *core, uint32_t now_ms)
+{
+    for (int i = 0; i < DNS_MAX_PENDING; i++)
+    {
+        dns_pending_t *p = &core->pending[i];
+        if (p->data == NULL)
+        {
+            continue;
+        }
+        if (now_ms - p->first_ms >= DNS_UPSTREAM_TIMEOUT_MS)
+        {
+            core->stats.upstream_timeouts++;
+            fail_waiters(core, p);
+            pending_release(core, p);
+        }
+        else if (now_ms - p->sent_ms >= DNS_UPSTREAM_RETRY_MS && core->upstream)
+        {
+            send_upstream(core, p, now_ms);
+        }
+    }
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Núcleo del reenviador DNS: análisis de los mensajes, caché LRU y agrupación de consultas idénticas.
+// Recibe los mensajes ya leídos de los sockets y entrega las respuestas a través de las funciones de
+// dns_core_io_t, con el tiempo como argumento; así no depende de ESP-IDF ni de lwIP y tools/dns_replay.c
+// lo ejecuta en el host con trazas de consultas. Los sockets y la tarea están en dns_forwarder.c.
+
+// Definiciones del núcleo
+#define DNS_CACHE_MAX_ENTRIES 64      // Respuestas guardadas como máximo
+#define DNS_CACHE_BUDGET 16384        // Memoria máxima de la caché en bytes (claves y respuestas)
+#define DNS_CACHE_MAX_TTL 3600        // TTL máximo que se respeta en segundos
+#define DNS_MAX_PENDING 16            // Consultas pendientes en el servidor de subida
+#define DNS_MAX_WAITERS 8             // Clientes agrupados en una misma consulta pendiente
+#define DNS_UPSTREAM_RETRY_MS 1500    // Reenvío de una consulta sin respuesta
+#define DNS_UPSTREAM_TIMEOUT_MS 4000  // Abandono de una consulta sin respuesta
+#define DNS_MAX_PACKET 1232           // Tamaño máximo de UDP recomendado con EDNS
+#define DNS_MAX_KEY 260               // Nombre en formato de red (255) más tipo y clase
+
+// Dirección de un cliente (orden de red)
+typedef struct
+{
+    uint32_t ip;
+    uint16_t port;
+} dns_peer_t;
+
+typedef struct
+{
+    uint32_t queries;           // Consultas recibidas de los clientes
+    uint32_t hits;              // Respondidas desde la caché
+    uint32_t misses;            // Enviadas al servidor de subida
+    uint32_t coalesced;         // Agrupadas con una consulta ya pendiente
+    uint32_t blocked;           // Respondidas con NXDOMAIN por la lista de bloqueo
+    uint32_t upstream_timeouts; // Consultas abandonadas sin respuesta
+    uint32_t errors;            // Consultas rechazadas o sin servidor de subida
+    uint32_t dropped;           // Consultas sin respuesta por tener su agrupación llena (el cliente repite)
+    uint32_t entries;           // Respuestas en la caché
+    uint32_t bytes;             // Memoria usada por la caché
+} dns_core_stats_t;
+
+// Entrada y salida del núcleo
+typedef struct
+{
+    void (*send_client)(void *ctx, const uint8_t *msg, int len, const dns_peer_t *to);
+    void (*send_upstream)(void *ctx, const uint8_t *msg, int len);
+    bool (*blocked)(const uint8_t *name, int len); // Nombre en formato de red y en minúsculas; NULL sin lista de bloqueo
+    uint16_t (*random_id)(void);                   // Identificadores de las consultas al servidor de subida
+    void *(*alloc)(size_t size);                   // Claves, respuestas y consultas guardadas
+    void (*free)(void *ptr);
+    void *ctx;
+} dns_core_io_t;
+
+// Respuesta guardada: la clave (pregunta normalizada) y la respuesta comparten un único bloque
+typedef struct
+{
+    uint8_t *data;     // Clave seguida de la respuesta (NULL si la entrada está libre)
+    uint32_t hash;     // Hash de la clave
+    uint32_t inserted; // Segundo en que se guardó
+    uint32_t expires;  // Segundo en que caduca
+    uint16_t key_len;
+    uint16_t resp_len;
+    int16_t prev; // Lista LRU (la cabeza es la usada más recientemente)
+    int16_t next;
+} dns_cache_entry_t;
+
+// Cliente esperando una respuesta del servidor de subida
+typedef struct
+{
+    dns_peer_t peer;
+    uint8_t *question; // Pregunta tal y como la escribió el cliente si difiere de la enviada, o NULL
+    uint16_t id;       // Identificador de la consulta del cliente
+    uint16_t max_udp;  // Tamaño máximo de respuesta que acepta
+} dns_waiter_t;
+
+// Consulta enviada al servidor de subida
+typedef struct
+{
+    uint8_t *data; // Clave seguida de la consulta enviada (NULL si la entrada está libre)
+    uint32_t hash;
+    uint32_t sent_ms;
+    uint32_t first_ms;
+    uint16_t key_len;
+    uint16_t query_len;
+    uint16_t upstream_id;
+    uint8_t waiter_count;
+    dns_waiter_t waiters[DNS_MAX_WAITERS];
+} dns_pending_t;
+
+typedef struct
+{
+    dns_core_io_t io;
+    bool upstream;      // Hay servidor de subida; sin él las consultas no resueltas reciben SERVFAIL
+    dns_cache_entry_t cache[DNS_CACHE_MAX_ENTRIES];
+    int16_t lru_head;
+    int16_t lru_tail;
+    dns_pending_t pending[DNS_MAX_PENDING];
+    dns_core_stats_t stats;
+    uint8_t scratch[DNS_MAX_PACKET]; // Respuestas construidas desde la caché o para los errores
+} dns_core_t;
+
+void dns_core_init(dns_core_t *core, const dns_core_io_t *io);                                  // Vacía la caché y las consultas pendientes
+void dns_core_query(dns_core_t *core, uint8_t *msg, int len, const dns_peer_t *from, uint32_t now_ms); // Consulta de un cliente (msg se modifica)
+void dns_core_response(dns_core_t *core, uint8_t *msg, int len, uint32_t now_ms);               // Respuesta del servidor de subida (msg se modifica)
+void dns_core_tick(dns_core_t *core, uint32_t now_ms);                                          // Reenvía o abandona las consultas sin respuesta
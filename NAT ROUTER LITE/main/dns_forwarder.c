@@ -0,0 +1,183 @@
+#include "dns_forwarder.h"
+#include "blocklist.h"
+#include "pool.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_random.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/inet.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <sys/param.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Tags para logging
+static const char *TAG_DNS = "DNS";
+
+// Variables globales
+static dns_core_t core; // Solo lo usa la tarea del reenviador
+static uint32_t upstream_ip = 0;
+static int client_sock = -1;
+static int upstream_sock = -1;
+static uint8_t packet[DNS_MAX_PACKET];
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static void send_client(void *ctx, const uint8_t *msg, int len, const dns_peer_t *to)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = to->port,
+        .sin_addr.s_addr = to->ip,
+    };
+    sendto(client_sock, msg, len, 0, (const struct sockaddr *)&addr, sizeof(addr));
+}
+
+static void send_upstream(void *ctx, const uint8_t *msg, int len)
+{
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(DNS_PORT),
+        .sin_addr.s_addr = upstream_ip,
+    };
+    sendto(upstream_sock, msg, len, 0, (const struct sockaddr *)&addr, sizeof(addr));
+}
+
+static uint16_t random_id(void)
+{
+    return esp_random() & 0xFFFF;
+}
+
+static int open_socket(uint32_t addr, uint16_t port)
+{
+    int sock = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+    if (sock < 0)
+    {
+        return -1;
+    }
+
+    struct sockaddr_in bind_addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = addr,
+    };
+    if (bind(sock, (struct sockaddr *)&bind_addr, sizeof(bind_addr)) < 0)
+    {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+static void dns_forwarder_task(void *arg)
+{
+    while (true)
+    {
+        core.upstream = upstream_ip != 0; // dns_forwarder_set_upstream se llama desde los eventos de red
+
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        FD_SET(client_sock, &readfds);
+        FD_SET(upstream_sock, &readfds);
+        struct timeval timeout = {.tv_sec = 0, .tv_usec = 500000};
+
+        int ready = select(MAX(client_sock, upstream_sock) + 1, &readfds, NULL, NULL, &timeout);
+        if (ready > 0)
+        {
+            struct sockaddr_in from;
+            socklen_t from_len = sizeof(from);
+
+            if (FD_ISSET(upstream_sock, &readfds))
+            {
+                int len = recvfrom(upstream_sock, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len);
+                // Solo se aceptan respuestas del servidor de subida actual
+                if (len > 0 && from.sin_addr.s_addr == upstream_ip)
+                {
+                    dns_core_response(&core, packet, len, now_ms());
+                }
+            }
+            if (FD_ISSET(client_sock, &readfds))
+            {
+                from_len = sizeof(from);
+                int len = recvfrom(client_sock, packet, sizeof(packet), 0, (struct sockaddr *)&from, &from_len);
+                if (len > 0)
+                {
+                    dns_peer_t peer = {.ip = from.sin_addr.s_addr, .port = from.sin_port};
+                    dns_core_query(&core, packet, len, &peer, now_ms());
+                }
+            }
+        }
+        dns_core_tick(&core, now_ms());
+    }
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t dns_forwarder_start(uint32_t listen_ip)
+{
+    if (client_sock >= 0)
+    {
+        return ESP_OK;
+    }
+
+    dns_core_io_t io = {
+        .send_client = send_client,
+        .send_upstream = send_upstream,
+        .blocked = blocklist_check,
+        .random_id = random_id,
+        .alloc = pool_alloc,
+        .free = pool_free,
+    };
+    dns_core_init(&core, &io);
+
+    client_sock = open_socket(listen_ip, DNS_PORT);
+    upstream_sock = open_socket(INADDR_ANY, 0);
+    if (client_sock < 0 || upstream_sock < 0)
+    {
+        ESP_LOGE(TAG_DNS, "Error al abrir los sockets del reenviador DNS. Error %d", errno);
+        if (client_sock >= 0)
+        {
+            close(client_sock);
+            client_sock = -1;
+        }
+        if (upstream_sock >= 0)
+        {
+            close(upstream_sock);
+            upstream_sock = -1;
+        }
+        return ESP_FAIL;
+    }
+
+    if (xTaskCreatePinnedToCore(dns_forwarder_task, "dns_forwarder", DNS_TASK_STACK, NULL, DNS_TASK_PRIORITY, NULL, DNS_TASK_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG_DNS, "Error al crear la tarea del reenviador DNS");
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG_DNS, "Reenviador DNS escuchando en " IPSTR ":%d", IP2STR((esp_ip4_addr_t *)&listen_ip), DNS_PORT);
+    return ESP_OK;
+}
+
+void dns_forwarder_set_upstream(uint32_t ip)
+{
+    if (ip == upstream_ip)
+    {
+        return;
+    }
+    upstream_ip = ip;
+    ESP_LOGI(TAG_DNS, "Servidor DNS de subida: " IPSTR, IP2STR((esp_ip4_addr_t *)&upstream_ip));
+}
+
+void dns_forwarder_get_stats(dns_forwarder_stats_t *out)
+{
+    *out = core.stats;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "cores.h"
+#include "dns_core.h"
+
+// Reenviador DNS con caché en la interfaz del punto de acceso.
+// El DHCP del AP anuncia la IP del propio router como servidor DNS; las consultas se responden desde
+// una caché LRU acotada por memoria que respeta los TTL, y las consultas idénticas que llegan mientras
+// otra está pendiente se agrupan en una sola petición al servidor DNS de subida. Antes de la caché se
+// comprueba la lista de bloqueo (blocklist.h). El análisis, la caché y la agrupación están en dns_core.h; aquí
+// quedan los sockets y la tarea.
+
+// Definiciones del reenviador
+#define DNS_PORT 53
+#define DNS_SOCKETS 2                 // Socket de los clientes y socket de subida (CONFIG_LWIP_MAX_SOCKETS)
+#define DNS_TASK_PRIORITY 6           // Por encima del servidor HTTP
+#define DNS_TASK_CORE CORE_CONTROL
+#define DNS_TASK_STACK 4096
+
+typedef dns_core_stats_t dns_forwarder_stats_t;
+
+esp_err_t dns_forwarder_start(uint32_t listen_ip);            // Crea la tarea que escucha en listen_ip:53 (orden de red)
+void dns_forwarder_set_upstream(uint32_t ip);                 // Cambia el servidor DNS de subida (orden de red)
+void dns_forwarder_get_stats(dns_forwarder_stats_t *stats);   // Copia las estadísticas
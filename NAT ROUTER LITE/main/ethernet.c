@@ -0,0 +1,187 @@
+#include "ethernet.h"
+#include "esp_event.h"
+#include "esp_log.h"
+
+#if ETHERNET_ENABLED
+#include "esp_eth.h"
+#include "esp_eth_netif_glue.h"
+#include "esp_mac.h"
+#if CONFIG_ROUTER_ETH_W5500
+#include "driver/gpio.h"
+#include "driver/spi_master.h"
+#include "esp_eth_mac_w5500.h"
+#include "esp_eth_phy_w5500.h"
+#endif
+
+// Tags para logging
+static const char *TAG_ETH = "ETH";
+
+// Variables globales
+static esp_eth_handle_t eth_handle = NULL;
+static volatile bool link_up = false;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void eth_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
+{
+    switch (event_id)
+    {
+    case ETHERNET_EVENT_CONNECTED:
+    {
+        eth_speed_t speed;
+        eth_duplex_t duplex;
+        esp_eth_ioctl(eth_handle, ETH_CMD_G_SPEED, &speed);
+        esp_eth_ioctl(eth_handle, ETH_CMD_G_DUPLEX_MODE, &duplex);
+        ESP_LOGI(TAG_ETH, "Enlace Ethernet activo: %s Mbps, %s dúplex", speed == ETH_SPEED_100M ? "100" : "10", duplex == ETH_DUPLEX_FULL ? "full" : "half");
+        link_up = true;
+        break;
+    }
+    case ETHERNET_EVENT_DISCONNECTED:
+        ESP_LOGW(TAG_ETH, "Enlace Ethernet caído");
+        link_up = false;
+        break;
+    case ETHERNET_EVENT_START:
+        ESP_LOGI(TAG_ETH, "Driver Ethernet iniciado");
+        break;
+    case ETHERNET_EVENT_STOP:
+        ESP_LOGI(TAG_ETH, "Driver Ethernet detenido");
+        link_up = false;
+        break;
+    default:
+        break;
+    }
+}
+
+// Crea el MAC y el PHY del driver elegido en la configuración
+static esp_err_t create_driver(esp_eth_mac_t **mac, esp_eth_phy_t **phy)
+{
+    eth_mac_config_t mac_config = ETH_MAC_DEFAULT_CONFIG();
+    eth_phy_config_t phy_config = ETH_PHY_DEFAULT_CONFIG();
+
+#if CONFIG_ROUTER_ETH_OPENETH
+    // QEMU no negocia: el enlace está activo desde el principio
+    phy_config.autonego_timeout_ms = 100;
+    *mac = esp_eth_mac_new_openeth(&mac_config);
+    *phy = esp_eth_phy_new_generic(&phy_config);
+#elif CONFIG_ROUTER_ETH_RMII
+    eth_esp32_emac_config_t emac_config = ETH_ESP32_EMAC_DEFAULT_CONFIG();
+    emac_config.smi_gpio.mdc_num = CONFIG_ROUTER_ETH_MDC_GPIO;
+    emac_config.smi_gpio.mdio_num = CONFIG_ROUTER_ETH_MDIO_GPIO;
+    phy_config.phy_addr = CONFIG_ROUTER_ETH_PHY_ADDR;
+    phy_config.reset_gpio_num = CONFIG_ROUTER_ETH_PHY_RST_GPIO;
+    *mac = esp_eth_mac_new_esp32(&emac_config, &mac_config);
+    *phy = esp_eth_phy_new_generic(&phy_config);
+#elif CONFIG_ROUTER_ETH_W5500
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) // Ya instalado por otro driver
+    {
+        return err;
+    }
+
+    spi_bus_config_t bus_config = {
+        .miso_io_num = CONFIG_ROUTER_ETH_SPI_MISO_GPIO,
+        .mosi_io_num = CONFIG_ROUTER_ETH_SPI_MOSI_GPIO,
+        .sclk_io_num = CONFIG_ROUTER_ETH_SPI_SCLK_GPIO,
+        .quadwp_io_num = -1,
+        .quadhd_io_num = -1,
+    };
+    err = spi_bus_initialize(CONFIG_ROUTER_ETH_SPI_HOST, &bus_config, SPI_DMA_CH_AUTO);
+    if (err != ESP_OK)
+    {
+        return err;
+    }
+
+    spi_device_interface_config_t device_config = {
+        .mode = 0,
+        .clock_speed_hz = CONFIG_ROUTER_ETH_SPI_CLOCK_MHZ * 1000 * 1000,
+        .queue_size = 20,
+        .spics_io_num = CONFIG_ROUTER_ETH_SPI_CS_GPIO,
+    };
+    eth_w5500_config_t w5500_config = ETH_W5500_DEFAULT_CONFIG(CONFIG_ROUTER_ETH_SPI_HOST, &device_config);
+    w5500_config.int_gpio_num = CONFIG_ROUTER_ETH_SPI_INT_GPIO;
+    if (w5500_config.int_gpio_num < 0)
+    {
+        w5500_config.poll_period_ms = 10; // Sin línea de interrupción se sondea el chip
+    }
+    phy_config.reset_gpio_num = -1;
+    *mac = esp_eth_mac_new_w5500(&w5500_config, &mac_config);
+    *phy = esp_eth_phy_new_w5500(&phy_config);
+#endif
+
+    return (*mac != NULL && *phy != NULL) ? ESP_OK : ESP_FAIL;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t ethernet_start(esp_netif_t **netif)
+{
+    esp_eth_mac_t *mac = NULL;
+    esp_eth_phy_t *phy = NULL;
+    esp_err_t err = create_driver(&mac, &phy);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_ETH, "Error al crear el driver Ethernet. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    esp_eth_config_t config = ETH_DEFAULT_CONFIG(mac, phy);
+    err = esp_eth_driver_install(&config, &eth_handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_ETH, "Error al instalar el driver Ethernet. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+#if CONFIG_ROUTER_ETH_W5500
+    // El W5500 no trae dirección MAC de fábrica: se usa la reservada para Ethernet en el eFuse
+    uint8_t mac_addr[6];
+    esp_read_mac(mac_addr, ESP_MAC_ETH);
+    esp_eth_ioctl(eth_handle, ETH_CMD_S_MAC_ADDR, mac_addr);
+#endif
+
+    // Interfaz con cliente DHCP, como la STA
+    esp_netif_config_t netif_config = ESP_NETIF_DEFAULT_ETH();
+    *netif = esp_netif_new(&netif_config);
+    if (*netif == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    err = esp_netif_attach(*netif, esp_eth_new_netif_glue(eth_handle));
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_ETH, "Error al conectar el driver Ethernet a la interfaz. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(ETH_EVENT, ESP_EVENT_ANY_ID, &eth_event_handler, NULL, NULL));
+
+    err = esp_eth_start(eth_handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_ETH, "Error al iniciar el driver Ethernet. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    ESP_LOGI(TAG_ETH, "WAN por Ethernet iniciada (%s)", ETHERNET_PREFERRED ? "principal" : "respaldo");
+    return ESP_OK;
+}
+
+bool ethernet_link_up(void)
+{
+    return link_up;
+}
+
+#else
+
+esp_err_t ethernet_start(esp_netif_t **netif)
+{
+    *netif = NULL;
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+bool ethernet_link_up(void)
+{
+    return false;
+}
+
+#endif // ETHERNET_ENABLED
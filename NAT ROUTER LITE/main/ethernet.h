@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdbool.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+#include "sdkconfig.h"
+
+// WAN opcional por Ethernet.
+// La STA comparte la radio (y el tiempo de aire) con el punto de acceso, así que con las dos activas los clientes
+// tienen más o menos la mitad del caudal de la radio. Con una WAN por cable la radio solo atiende al AP. El driver
+// se elige al compilar (menuconfig "NAT Router"): el EMAC interno con un PHY RMII, un W5500 por SPI o el MAC
+// OpenCores que emula QEMU. La interfaz se crea como una más de esp_netif con DHCP cliente; main.c decide cuál de
+// las WAN con IP es la interfaz por defecto, la que usan el NAPT, el reenviador DNS y las redirecciones de puertos.
+
+// Definiciones de la WAN por Ethernet
+#if CONFIG_ROUTER_ETH_OPENETH || CONFIG_ROUTER_ETH_RMII || CONFIG_ROUTER_ETH_W5500
+#define ETHERNET_ENABLED 1
+#else
+#define ETHERNET_ENABLED 0
+#endif
+
+#if ETHERNET_ENABLED && !CONFIG_ROUTER_ETH_ROLE_BACKUP
+#define ETHERNET_PREFERRED 1 // Con IP en las dos WAN se usa Ethernet
+#else
+#define ETHERNET_PREFERRED 0
+#endif
+
+#if ETHERNET_ENABLED && CONFIG_ROUTER_ETH_ROLE_ONLY
+#define ETHERNET_ONLY 1 // Sin STA: la radio solo hace de punto de acceso
+#else
+#define ETHERNET_ONLY 0
+#endif
+
+esp_err_t ethernet_start(esp_netif_t **netif); // Crea la interfaz y arranca el driver (ESP_ERR_NOT_SUPPORTED sin Ethernet)
+bool ethernet_link_up(void);                   // Hay enlace en el cable
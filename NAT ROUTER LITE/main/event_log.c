@@ -0,0 +1,307 @@
+#include "event_log.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+// Definiciones internas
+#define EVENT_LOG_MAX_MACS 64 // MAC distintas contadas por tipo de evento y ventana
+#define EVENT_LOG_LINE_LEN 128
+
+// Estructuras
+typedef struct
+{
+    uint32_t time_ms;
+    uint8_t event;
+    uint8_t mac[6];
+    int32_t arg[2];
+} log_record_t;
+
+typedef struct
+{
+    uint32_t seq; // Igual a la posición: libre para el productor; posición + 1: listo para el consumidor
+    log_record_t record;
+} log_slot_t;
+
+// Descripción de cada evento
+typedef struct
+{
+    const char *tag;
+    esp_log_level_t level;
+    const char *format;  // Recibe la MAC (si has_mac) y después los dos argumentos
+    const char *summary; // Nombre en plural para el resumen de la ventana
+    bool has_mac;
+    bool ip_arg; // El primer argumento es una IPv4 y se formatea con %s
+} log_event_desc_t;
+
+// Agregación de una ventana
+typedef struct
+{
+    uint32_t count;
+    uint32_t lines; // Líneas individuales ya impresas
+    uint32_t mac_hashes[EVENT_LOG_MAX_MACS];
+    uint16_t macs;
+} log_window_t;
+
+// Tags para logging
+static const char *TAG_LOG = "EVENT_LOG";
+
+static const log_event_desc_t event_desc[LOG_EV_COUNT] = {
+    [LOG_EV_AP_PROBE_REQ] = {"WIFI_AP", ESP_LOG_INFO, "Solicitud de sondeo recibida. MAC: " MACSTR ", RSSI: %ld", "solicitudes de sondeo", true, false},
+    [LOG_EV_AP_STA_CONNECTED] = {"WIFI_AP", ESP_LOG_INFO, "Cliente conectado al ESP. MAC: " MACSTR ", AID: %ld", "conexiones de clientes", true, false},
+    [LOG_EV_AP_STA_DISCONNECTED] = {"WIFI_AP", ESP_LOG_INFO, "Cliente desconectado del ESP. MAC: " MACSTR ", AID: %ld, Razon: %ld", "desconexiones de clientes", true, false},
+    [LOG_EV_AP_CLIENT_IP] = {"WIFI_AP", ESP_LOG_INFO, "Dirección IP asignada al cliente. MAC: " MACSTR ", IP: %s", "direcciones IP asignadas", true, true},
+    [LOG_EV_HTTP_CONNECTED] = {"WEB_SERVER", ESP_LOG_INFO, "Cliente conectado al servidor web. Socket: %ld", "conexiones al servidor web", false, false},
+    [LOG_EV_HTTP_HEADER] = {"WEB_SERVER", ESP_LOG_DEBUG, "Cabecera recibida. Socket: %ld", "cabeceras recibidas", false, false},
+    [LOG_EV_HTTP_HEADERS_SENT] = {"WEB_SERVER", ESP_LOG_DEBUG, "Cabeceras enviadas. Socket: %ld", "respuestas enviadas", false, false},
+    [LOG_EV_HTTP_DATA] = {"WEB_SERVER", ESP_LOG_DEBUG, "Datos recibidos. Socket: %ld, Bytes: %ld", "bloques de datos recibidos", false, false},
+    [LOG_EV_HTTP_SENT] = {"WEB_SERVER", ESP_LOG_DEBUG, "Datos enviados. Socket: %ld, Bytes: %ld", "bloques de datos enviados", false, false},
+    [LOG_EV_HTTP_DISCONNECTED] = {"WEB_SERVER", ESP_LOG_INFO, "Cliente desconectado del servidor web. Socket: %ld", "desconexiones del servidor web", false, false},
+};
+
+// Variables globales
+static log_slot_t ring[EVENT_LOG_RING_SIZE];
+static uint32_t ring_head = 0; // Siguiente posición a escribir (productores)
+static uint32_t ring_tail = 0; // Siguiente posición a leer (solo la tarea de formateo)
+static uint32_t ring_dropped = 0;
+static log_record_t history[EVENT_LOG_HISTORY_SIZE];
+static uint32_t history_count = 0;
+static SemaphoreHandle_t history_mutex = NULL;
+static log_window_t windows[LOG_EV_COUNT];
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static int format_record(const log_record_t *record, char *buf, size_t buf_size)
+{
+    const log_event_desc_t *desc = &event_desc[record->event];
+    char ip[16];
+
+    if (desc->ip_arg)
+    {
+        esp_ip4_addr_t addr = {.addr = (uint32_t)record->arg[0]};
+        esp_ip4addr_ntoa(&addr, ip, sizeof(ip));
+        return snprintf(buf, buf_size, desc->format, MAC2STR(record->mac), ip, record->arg[1]);
+    }
+    if (desc->has_mac)
+    {
+        return snprintf(buf, buf_size, desc->format, MAC2STR(record->mac), record->arg[0], record->arg[1]);
+    }
+    return snprintf(buf, buf_size, desc->format, record->arg[0], record->arg[1]);
+}
+
+// Cuenta una MAC distinta en la ventana (hasta EVENT_LOG_MAX_MACS)
+static void window_add_mac(log_window_t *window, const uint8_t *mac)
+{
+    uint32_t hash = 2166136261u; // FNV-1a
+    for (int i = 0; i < 6; i++)
+    {
+        hash = (hash ^ mac[i]) * 16777619u;
+    }
+
+    for (uint16_t i = 0; i < window->macs; i++)
+    {
+        if (window->mac_hashes[i] == hash)
+        {
+            return;
+        }
+    }
+    if (window->macs < EVENT_LOG_MAX_MACS)
+    {
+        window->mac_hashes[window->macs++] = hash;
+    }
+}
+
+// Procesa un registro: lo guarda en el historial y lo imprime o lo agrega a la ventana
+static void process_record(const log_record_t *record)
+{
+    const log_event_desc_t *desc = &event_desc[record->event];
+    log_window_t *window = &windows[record->event];
+
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    history[history_count % EVENT_LOG_HISTORY_SIZE] = *record;
+    history_count++;
+    xSemaphoreGive(history_mutex);
+
+    window->count++;
+    if (desc->has_mac)
+    {
+        window_add_mac(window, record->mac);
+    }
+
+    if (window->lines < EVENT_LOG_LINES_PER_WINDOW && esp_log_level_get(desc->tag) >= desc->level)
+    {
+        char line[EVENT_LOG_LINE_LEN];
+        format_record(record, line, sizeof(line));
+        ESP_LOG_LEVEL(desc->level, desc->tag, "%s", line);
+        window->lines++;
+    }
+}
+
+// Imprime el resumen de los eventos que superaron el límite de líneas y reinicia la ventana
+static void flush_window(void)
+{
+    for (int event = 0; event < LOG_EV_COUNT; event++)
+    {
+        const log_event_desc_t *desc = &event_desc[event];
+        log_window_t *window = &windows[event];
+
+        if (window->count > window->lines)
+        {
+            if (desc->has_mac)
+            {
+                ESP_LOGI(desc->tag, "%lu %s de %u%s MAC en los últimos %d s", window->count, desc->summary, window->macs,
+                         window->macs >= EVENT_LOG_MAX_MACS ? "+" : "", EVENT_LOG_WINDOW_S);
+            }
+            else
+            {
+                ESP_LOGI(desc->tag, "%lu %s en los últimos %d s", window->count, desc->summary, EVENT_LOG_WINDOW_S);
+            }
+        }
+        memset(window, 0, sizeof(*window));
+    }
+
+    uint32_t dropped = __atomic_exchange_n(&ring_dropped, 0, __ATOMIC_RELAXED);
+    if (dropped > 0)
+    {
+        ESP_LOGW(TAG_LOG, "%lu eventos descartados por anillo lleno", dropped);
+    }
+}
+
+static void event_log_task(void *arg)
+{
+    uint32_t window_start = (uint32_t)(esp_timer_get_time() / 1000);
+
+    while (true)
+    {
+        vTaskDelay(pdMS_TO_TICKS(EVENT_LOG_FLUSH_MS));
+
+        // Vacía el anillo (único consumidor)
+        while (true)
+        {
+            log_slot_t *slot = &ring[ring_tail & (EVENT_LOG_RING_SIZE - 1)];
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != ring_tail + 1)
+            {
+                break;
+            }
+
+            log_record_t record = slot->record;
+            __atomic_store_n(&slot->seq, ring_tail + EVENT_LOG_RING_SIZE, __ATOMIC_RELEASE);
+            ring_tail++;
+            process_record(&record);
+        }
+
+        uint32_t now = (uint32_t)(esp_timer_get_time() / 1000);
+        if (now - window_start >= EVENT_LOG_WINDOW_S * 1000)
+        {
+            flush_window();
+            window_start = now;
+        }
+    }
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t event_log_start(void)
+{
+    for (uint32_t i = 0; i < EVENT_LOG_RING_SIZE; i++)
+    {
+        ring[i].seq = i;
+    }
+
+    history_mutex = xSemaphoreCreateMutex();
+    if (history_mutex == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(event_log_task, "event_log", EVENT_LOG_TASK_STACK, NULL, EVENT_LOG_TASK_PRIORITY, NULL, EVENT_LOG_TASK_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG_LOG, "Error al crear la tarea de registro de eventos");
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+void event_log_record(log_event_t event, const uint8_t *mac, int32_t arg0, int32_t arg1)
+{
+    uint32_t pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    log_slot_t *slot;
+
+    // Reserva una posición libre (cola acotada de Vyukov, varios productores)
+    while (true)
+    {
+        slot = &ring[pos & (EVENT_LOG_RING_SIZE - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            __atomic_fetch_add(&ring_dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->record.time_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    slot->record.event = (uint8_t)event;
+    if (mac)
+    {
+        memcpy(slot->record.mac, mac, sizeof(slot->record.mac));
+    }
+    slot->record.arg[0] = arg0;
+    slot->record.arg[1] = arg1;
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+esp_err_t event_log_handler(httpd_req_t *req)
+{
+    char line[EVENT_LOG_LINE_LEN + 32];
+
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_type(req, "text/plain; charset=utf-8");
+
+    // El historial se copia con el mutex y se envía sin él: un cliente lento no debe frenar a process_record
+    log_record_t *records = malloc(sizeof(history));
+    if (records == NULL)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sin memoria para el historial");
+    }
+    xSemaphoreTake(history_mutex, portMAX_DELAY);
+    uint32_t count = history_count;
+    memcpy(records, history, sizeof(history));
+    xSemaphoreGive(history_mutex);
+
+    // Los registros se formatean aquí, no cuando ocurren
+    uint32_t first = count > EVENT_LOG_HISTORY_SIZE ? count - EVENT_LOG_HISTORY_SIZE : 0;
+    for (uint32_t i = first; i < count; i++)
+    {
+        const log_record_t *record = &records[i % EVENT_LOG_HISTORY_SIZE];
+        int len = snprintf(line, sizeof(line), "[%lu.%03lu] %s: ", record->time_ms / 1000, record->time_ms % 1000, event_desc[record->event].tag);
+        len += format_record(record, line + len, sizeof(line) - len - 1);
+        len = MIN(len, (int)sizeof(line) - 2);
+        line[len++] = '\n';
+        if (httpd_resp_send_chunk(req, line, len) != ESP_OK)
+        {
+            break;
+        }
+    }
+    free(records);
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "cores.h"
+
+// Registro diferido de eventos frecuentes.
+// Los manejadores de eventos solo copian un registro binario (evento, MAC y dos argumentos) a un anillo
+// sin bloqueos; una tarea de baja prioridad los formatea más tarde, limita las líneas por tipo de evento
+// y resume el resto ("412 solicitudes de sondeo de 37 MAC en los últimos 10 s"). Los últimos registros
+// también se pueden consultar en /log.
+
+// Definiciones del registro
+#define EVENT_LOG_RING_SIZE 256      // Registros pendientes de formatear (potencia de 2, 24 bytes cada uno)
+#define EVENT_LOG_HISTORY_SIZE 64    // Registros recientes disponibles en /log
+#define EVENT_LOG_FLUSH_MS 250       // Intervalo de vaciado del anillo
+#define EVENT_LOG_WINDOW_S 10        // Ventana de agregación
+#define EVENT_LOG_LINES_PER_WINDOW 5 // Líneas individuales por tipo de evento y ventana
+#define EVENT_LOG_TASK_PRIORITY 1
+#define EVENT_LOG_TASK_STACK 3072
+#define EVENT_LOG_TASK_CORE CORE_CONTROL
+
+// Eventos registrados
+typedef enum
+{
+    LOG_EV_AP_PROBE_REQ = 0,    // MAC, RSSI
+    LOG_EV_AP_STA_CONNECTED,    // MAC, AID
+    LOG_EV_AP_STA_DISCONNECTED, // MAC, AID, razón
+    LOG_EV_AP_CLIENT_IP,        // MAC, IP
+    LOG_EV_HTTP_CONNECTED,      // Socket
+    LOG_EV_HTTP_HEADER,         // Socket
+    LOG_EV_HTTP_HEADERS_SENT,   // Socket
+    LOG_EV_HTTP_DATA,           // Socket, bytes
+    LOG_EV_HTTP_SENT,           // Socket, bytes
+    LOG_EV_HTTP_DISCONNECTED,   // Socket
+    LOG_EV_COUNT,
+} log_event_t;
+
+esp_err_t event_log_start(void);                                                          // Crea la tarea de formateo
+void event_log_record(log_event_t event, const uint8_t *mac, int32_t arg0, int32_t arg1); // Registra un evento sin bloquear
+esp_err_t event_log_handler(httpd_req_t *req);                                            // Manejador de /log
@@ -0,0 +1,214 @@
+#include "form.h"
+#include <string.h>
+
+#ifdef ESP_PLATFORM
+#define FORM_RECV_CHUNK 64 // Bytes leídos del socket por llamada
+#endif
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+// Añade un carácter ya decodificado al nombre o al valor en curso
+static void emit(form_parser_t *parser, char c)
+{
+    if (!parser->in_value)
+    {
+        if (parser->key_len < FORM_KEY_MAX)
+        {
+            parser->key[parser->key_len++] = c;
+        }
+        else
+        {
+            parser->key_overflow = true;
+        }
+        return;
+    }
+
+    form_field_t *field = parser->current;
+    if (field == NULL)
+    {
+        return;
+    }
+    if (field->len + 1 < field->size)
+    {
+        field->value[field->len++] = c;
+        field->value[field->len] = '\0';
+    }
+    else
+    {
+        field->truncated = true;
+    }
+}
+
+// Vuelca una secuencia %X incompleta o no válida tal cual
+static void flush_percent(form_parser_t *parser)
+{
+    if (parser->pct_digits == 0)
+    {
+        return;
+    }
+    emit(parser, '%');
+    for (int i = 0; i < parser->pct_digits - 1; i++)
+    {
+        emit(parser, parser->pct_text[i]);
+    }
+    parser->pct_digits = 0;
+}
+
+// Termina el nombre: busca el campo conocido cuyo valor se leerá a continuación
+static void end_key(form_parser_t *parser)
+{
+    parser->current = NULL;
+    if (!parser->key_overflow)
+    {
+        for (int i = 0; i < parser->field_count; i++)
+        {
+            form_field_t *field = &parser->fields[i];
+            if (!field->found && strlen(field->name) == parser->key_len && memcmp(field->name, parser->key, parser->key_len) == 0)
+            {
+                field->found = true;
+                parser->current = field;
+                break;
+            }
+        }
+    }
+    parser->in_value = true;
+}
+
+// Termina el par nombre=valor
+static void end_pair(form_parser_t *parser)
+{
+    if (!parser->in_value && parser->key_len > 0)
+    {
+        end_key(parser); // Campo sin "=": valor vacío
+    }
+    parser->current = NULL;
+    parser->in_value = false;
+    parser->key_len = 0;
+    parser->key_overflow = false;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void form_parser_init(form_parser_t *parser, form_field_t *fields, int field_count)
+{
+    memset(parser, 0, sizeof(*parser));
+    parser->fields = fields;
+    parser->field_count = field_count;
+
+    for (int i = 0; i < field_count; i++)
+    {
+        fields[i].len = 0;
+        fields[i].found = false;
+        fields[i].truncated = false;
+        if (fields[i].size > 0)
+        {
+            fields[i].value[0] = '\0';
+        }
+    }
+}
+
+void form_parser_feed(form_parser_t *parser, const char *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++)
+    {
+        char c = data[i];
+
+        // Secuencia %XX en curso, posiblemente empezada en el trozo anterior
+        if (parser->pct_digits > 0)
+        {
+            int value = hex_value(c);
+            if (value >= 0)
+            {
+                parser->pct_text[parser->pct_digits - 1] = c;
+                if (++parser->pct_digits == 3)
+                {
+                    emit(parser, (char)(hex_value(parser->pct_text[0]) << 4 | value));
+                    parser->pct_digits = 0;
+                }
+                continue;
+            }
+            flush_percent(parser);
+        }
+
+        switch (c)
+        {
+        case '%':
+            parser->pct_digits = 1;
+            break;
+        case '+':
+            emit(parser, ' ');
+            break;
+        case '=':
+            if (!parser->in_value)
+            {
+                end_key(parser);
+            }
+            else
+            {
+                emit(parser, c);
+            }
+            break;
+        case '&':
+            end_pair(parser);
+            break;
+        default:
+            emit(parser, c);
+            break;
+        }
+    }
+}
+
+void form_parser_finish(form_parser_t *parser)
+{
+    flush_percent(parser);
+    end_pair(parser);
+}
+
+#ifdef ESP_PLATFORM
+esp_err_t form_recv(httpd_req_t *req, form_field_t *fields, int field_count)
+{
+    form_parser_t parser;
+    form_parser_init(&parser, fields, field_count);
+
+    char chunk[FORM_RECV_CHUNK];
+    size_t remaining = req->content_len;
+    while (remaining > 0)
+    {
+        int ret = httpd_req_recv(req, chunk, remaining < sizeof(chunk) ? remaining : sizeof(chunk));
+        if (ret <= 0)
+        {
+            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
+            {
+                httpd_resp_send_408(req);
+            }
+            else
+            {
+                httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Formulario incompleto");
+            }
+            return ESP_FAIL;
+        }
+        form_parser_feed(&parser, chunk, ret);
+        remaining -= ret;
+    }
+
+    form_parser_finish(&parser);
+    return ESP_OK;
+}
+#endif
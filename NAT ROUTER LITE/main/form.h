@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Analizador incremental de formularios application/x-www-form-urlencoded.
+// Recibe el cuerpo en trozos de cualquier tamaño (una secuencia %XX o un nombre pueden quedar partidos entre
+// dos trozos), decodifica sobre la marcha y copia directamente en los buffers del llamador los valores de los
+// campos conocidos, en una sola pasada y sin reservar memoria. La parte del analizador no depende de ESP-IDF.
+
+// Definiciones del analizador
+#define FORM_KEY_MAX 16 // Longitud máxima de un nombre de campo conocido
+
+// Campo esperado en el formulario
+typedef struct
+{
+    const char *name; // Nombre del campo
+    char *value;      // Buffer de destino (siempre queda terminado en nulo)
+    size_t size;      // Tamaño del buffer, incluido el nulo
+    size_t len;       // Longitud del valor decodificado
+    bool found;       // El campo aparece en el formulario
+    bool truncated;   // El valor no cabía en el buffer
+} form_field_t;
+
+typedef struct
+{
+    form_field_t *fields;
+    int field_count;
+    form_field_t *current; // Campo cuyo valor se está leyendo (NULL si se descarta)
+    char key[FORM_KEY_MAX + 1];
+    uint8_t key_len;
+    bool in_value;
+    bool key_overflow;
+    uint8_t pct_digits; // Dígitos hexadecimales leídos de una secuencia %XX
+    char pct_text[2];
+} form_parser_t;
+
+void form_parser_init(form_parser_t *parser, form_field_t *fields, int field_count); // Prepara el analizador y vacía los campos
+void form_parser_feed(form_parser_t *parser, const char *data, size_t len);         // Procesa un trozo del cuerpo
+void form_parser_finish(form_parser_t *parser);                                      // Cierra el último campo
+
+#ifdef ESP_PLATFORM
+#include "esp_http_server.h"
+
+// Lee el cuerpo de la petición en trozos y lo pasa por el analizador; responde 408 o 400 si falla la lectura
+esp_err_t form_recv(httpd_req_t *req, form_field_t *fields, int field_count);
+#endif
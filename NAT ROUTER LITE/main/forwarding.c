@@ -0,0 +1,706 @@
+#include "forwarding.h"
+#include "capture.h"
+#include "clients.h"
+#include "ipv6_relay.h"
+#include "metrics.h"
+#include "napt_table.h"
+#include "pmtu.h"
+#include "portmap.h"
+#include "shaper.h"
+#include "esp_cpu.h"
+#include "esp_log.h"
+#include "esp_netif_net_stack.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/opt.h"
+#include "lwip/def.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "lwip/prot/ethernet.h"
+#include "lwip/prot/ip4.h"
+#include "lwip/prot/tcp.h"
+#include "lwip/prot/udp.h"
+#include <string.h>
+
+#if IP_NAPT
+
+// Definiciones de la ruta de reenvío
+#define FORWARDING_PENDING_SIZE 64  // Emparejamientos pendientes entre la entrada AP y la salida WAN (potencia de 2)
+#define FORWARDING_MAX_UPLINKS 2    // Interfaces WAN con ganchos (STA y Ethernet)
+#define FORWARDING_EXPIRE_BUDGET 4  // Ranuras de la tabla revisadas por paquete
+#define FORWARDING_REFRESH_MS 1000  // Cada cuánto un paquete de un flujo rápido pasa por lwIP para refrescar su entrada NAPT
+
+// Tags para logging
+static const char *TAG_NAPT = "NAPT";
+
+// Estructuras
+typedef struct
+{
+    struct eth_hdr *eth;
+    struct ip_hdr *ip;
+    uint8_t *l4;        // Cabecera TCP o UDP
+    napt_key_t key;     // 5-tupla tal y como aparece en el paquete
+    uint16_t ip_id;     // Identificador IP (lwIP no lo modifica al traducir)
+    uint8_t tcp_flags;  // Banderas TCP, 0 en UDP
+} fwd_packet_t;
+
+typedef struct
+{
+    struct netif *netif;
+    netif_input_fn input_orig;
+    netif_linkoutput_fn linkoutput_orig;
+} uplink_hooks_t;
+
+typedef struct
+{
+    napt_key_t key; // Flujo original visto en el AP (destino y protocolo no cambian al traducir)
+    uint16_t ip_id;
+    bool valid;
+} pending_match_t;
+
+// Variables globales
+static napt_table_t flow_table;
+static pending_match_t pending[FORWARDING_PENDING_SIZE];
+static portMUX_TYPE table_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct netif *ap_netif = NULL;
+static netif_input_fn ap_input_orig = NULL;
+static uplink_hooks_t uplinks[FORWARDING_MAX_UPLINKS]; // Una entrada por interfaz WAN, fija una vez instalada
+static uplink_hooks_t *volatile uplink = NULL;         // WAN por defecto, a la que va la ruta rápida
+static netif_linkoutput_fn ap_linkoutput_orig = NULL;
+static uint32_t flows_learned = 0;
+static uint32_t flows_remapped = 0;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+// Punteros originales de una interfaz WAN (sus ganchos solo se instalan en interfaces de uplinks)
+static inline uplink_hooks_t *find_uplink(struct netif *netif)
+{
+    for (int i = 0; i < FORWARDING_MAX_UPLINKS; i++)
+    {
+        if (uplinks[i].netif == netif)
+        {
+            return &uplinks[i];
+        }
+    }
+    return NULL;
+}
+
+static inline uint32_t pending_index(uint8_t proto, uint32_t dst_ip, uint16_t dst_port, uint16_t ip_id)
+{
+    uint32_t h = (dst_ip ^ ((uint32_t)dst_port << 16) ^ ip_id ^ proto) * 0x9e3779b1u;
+    return (h >> 16) & (FORWARDING_PENDING_SIZE - 1);
+}
+
+// Extrae la 5-tupla de una trama Ethernet con IPv4 y TCP/UDP no fragmentado
+static bool parse_ipv4(struct pbuf *p, fwd_packet_t *pkt)
+{
+    if (p->len < SIZEOF_ETH_HDR + IP_HLEN + UDP_HLEN)
+    {
+        return false;
+    }
+
+    pkt->eth = (struct eth_hdr *)p->payload;
+    if (pkt->eth->type != PP_HTONS(ETHTYPE_IP))
+    {
+        return false;
+    }
+
+    pkt->ip = (struct ip_hdr *)((uint8_t *)p->payload + SIZEOF_ETH_HDR);
+    uint16_t ip_hlen = IPH_HL_BYTES(pkt->ip);
+    if (IPH_V(pkt->ip) != 4 || ip_hlen < IP_HLEN || (lwip_ntohs(IPH_OFFSET(pkt->ip)) & (IP_OFFMASK | IP_MF)) != 0)
+    {
+        return false;
+    }
+
+    uint8_t proto = IPH_PROTO(pkt->ip);
+    uint16_t l4_hlen = (proto == IP_PROTO_TCP) ? TCP_HLEN : UDP_HLEN;
+    if ((proto != IP_PROTO_TCP && proto != IP_PROTO_UDP) || p->len < SIZEOF_ETH_HDR + ip_hlen + l4_hlen)
+    {
+        return false;
+    }
+
+    pkt->l4 = (uint8_t *)pkt->ip + ip_hlen;
+    pkt->key.src_ip = pkt->ip->src.addr;
+    pkt->key.dst_ip = pkt->ip->dest.addr;
+    pkt->key.proto = proto;
+    pkt->ip_id = IPH_ID(pkt->ip);
+
+    if (proto == IP_PROTO_TCP)
+    {
+        struct tcp_hdr *tcp = (struct tcp_hdr *)pkt->l4;
+        pkt->key.src_port = tcp->src;
+        pkt->key.dst_port = tcp->dest;
+        pkt->tcp_flags = TCPH_FLAGS(tcp);
+    }
+    else
+    {
+        struct udp_hdr *udp = (struct udp_hdr *)pkt->l4;
+        pkt->key.src_port = udp->src;
+        pkt->key.dst_port = udp->dest;
+        pkt->tcp_flags = 0;
+    }
+
+    return true;
+}
+
+// Indica si el destino sale de la subred del AP (tráfico que lwIP reenviará por la WAN)
+static inline bool is_forwarded(uint32_t dst_ip)
+{
+    uint32_t ap_ip = ip4_addr_get_u32(netif_ip4_addr(ap_netif));
+    uint32_t ap_mask = ip4_addr_get_u32(netif_ip4_netmask(ap_netif));
+    ip4_addr_t dst = {.addr = dst_ip};
+    return (dst_ip & ap_mask) != (ap_ip & ap_mask) && !ip4_addr_ismulticast(&dst) && dst_ip != IPADDR_BROADCAST;
+}
+
+// Registra un paquete saliente de un cliente del AP
+static void track_outbound(const fwd_packet_t *pkt)
+{
+    uint32_t now = now_ms();
+    bool created;
+
+    portENTER_CRITICAL(&table_lock);
+    napt_flow_t *flow = napt_table_insert(&flow_table, &pkt->key, now, &created);
+    if (flow)
+    {
+        flow->last_seen = now;
+        flow->refreshed = now;
+        if (pkt->tcp_flags & (TCP_FIN | TCP_RST))
+        {
+            flow->flags |= NAPT_FLOW_FLAG_CLOSING;
+        }
+
+        // Cada paquete de la ruta lenta se empareja con su equivalente en la salida WAN: aprende la traducción de un
+        // flujo nuevo y, en los que ya la tienen (refresco periódico, FIN/RST), detecta si lwIP les ha dado otra
+        pending_match_t *match = &pending[pending_index(pkt->key.proto, pkt->key.dst_ip, pkt->key.dst_port, pkt->ip_id)];
+        match->key = pkt->key;
+        match->ip_id = pkt->ip_id;
+        match->valid = true;
+    }
+    napt_table_expire(&flow_table, now, FORWARDING_EXPIRE_BUDGET);
+    portEXIT_CRITICAL(&table_lock);
+}
+
+// Aprende la traducción de un paquete ya reescrito por lwIP que sale por la WAN
+static void learn_mapping(const fwd_packet_t *pkt)
+{
+    pending_match_t *match = &pending[pending_index(pkt->key.proto, pkt->key.dst_ip, pkt->key.dst_port, pkt->ip_id)];
+
+    portENTER_CRITICAL(&table_lock);
+    if (match->valid && match->ip_id == pkt->ip_id && match->key.proto == pkt->key.proto && match->key.dst_ip == pkt->key.dst_ip && match->key.dst_port == pkt->key.dst_port)
+    {
+        match->valid = false;
+        napt_flow_t *flow = napt_table_find(&flow_table, &match->key, now_ms());
+        if (flow)
+        {
+            // Si lwIP ha vuelto a traducir la 5-tupla (su entrada NAPT expiró o se reinició), la ruta rápida
+            // seguiría usando el puerto viejo: se sustituye por el que lleva el paquete
+            if (flow->state == NAPT_FLOW_PENDING || flow->nat_ip != pkt->key.src_ip || flow->nat_port != pkt->key.src_port)
+            {
+                if (flow->state == NAPT_FLOW_PENDING)
+                {
+                    flows_learned++;
+                }
+                else
+                {
+                    flows_remapped++;
+                }
+                napt_table_map(&flow_table, flow, pkt->key.src_ip, pkt->key.src_port);
+            }
+            memcpy(flow->eth_dst, pkt->eth->dest.addr, sizeof(flow->eth_dst));
+            memcpy(flow->eth_src, pkt->eth->src.addr, sizeof(flow->eth_src));
+        }
+    }
+    portEXIT_CRITICAL(&table_lock);
+}
+
+// Ajuste incremental de la suma de verificación al cambiar una palabra de 16 bits (RFC 1624)
+static inline uint16_t csum_adjust16(uint16_t sum, uint16_t old_word, uint16_t new_word)
+{
+    uint32_t acc = (uint16_t)~sum + (uint32_t)(uint16_t)~old_word + new_word;
+    acc = (acc & 0xffff) + (acc >> 16);
+    acc = (acc & 0xffff) + (acc >> 16);
+    return (uint16_t)~acc;
+}
+
+static inline uint16_t csum_adjust32(uint16_t sum, uint32_t old_word, uint32_t new_word)
+{
+    sum = csum_adjust16(sum, (uint16_t)(old_word >> 16), (uint16_t)(new_word >> 16));
+    return csum_adjust16(sum, (uint16_t)old_word, (uint16_t)new_word);
+}
+
+// Reduce la opción MSS de un SYN para que los segmentos de la conexión quepan en la ruta hacia remote_ip
+static void clamp_mss(struct pbuf *p, const fwd_packet_t *pkt, uint32_t remote_ip)
+{
+    if (pkt->key.proto != IP_PROTO_TCP || !(pkt->tcp_flags & TCP_SYN))
+    {
+        return;
+    }
+
+    struct tcp_hdr *tcp = (struct tcp_hdr *)pkt->l4;
+    uint8_t *opt = pkt->l4 + TCP_HLEN;
+    uint8_t *end = pkt->l4 + TCPH_HDRLEN_BYTES(tcp);
+    if (end > (uint8_t *)p->payload + p->len) // Opciones repartidas entre varios buffers
+    {
+        return;
+    }
+
+    while (opt < end && *opt != 0) // 0: fin de la lista de opciones
+    {
+        if (*opt == 1) // Relleno
+        {
+            opt++;
+            continue;
+        }
+        if (opt + 2 > end || opt[1] < 2 || opt + opt[1] > end)
+        {
+            return;
+        }
+        if (opt[0] == 2 && opt[1] == 4) // MSS
+        {
+            uint16_t mss = pmtu_mss(remote_ip);
+            uint16_t old_word, new_word;
+            memcpy(&old_word, opt + 2, sizeof(old_word));
+            if (lwip_ntohs(old_word) <= mss)
+            {
+                return;
+            }
+            new_word = lwip_htons(mss);
+            memcpy(opt + 2, &new_word, sizeof(new_word));
+
+            // En posición impar los bytes pertenecen a palabras distintas de la suma de verificación
+            if ((opt + 2 - pkt->l4) & 1)
+            {
+                old_word = __builtin_bswap16(old_word);
+                new_word = __builtin_bswap16(new_word);
+            }
+            tcp->chksum = csum_adjust16(tcp->chksum, old_word, new_word);
+            metrics_add(METRIC_MSS_CLAMPED, 1);
+            return;
+        }
+        opt += opt[1];
+    }
+}
+
+// Cabecera IPv4 de una trama Ethernet, NULL si no es IPv4
+static inline struct ip_hdr *ipv4_header(struct pbuf *p)
+{
+    struct eth_hdr *eth = (struct eth_hdr *)p->payload;
+    if (p->len < SIZEOF_ETH_HDR + IP_HLEN || eth->type != PP_HTONS(ETHTYPE_IP))
+    {
+        return NULL;
+    }
+    return (struct ip_hdr *)((uint8_t *)p->payload + SIZEOF_ETH_HDR);
+}
+
+// Cuenta los fragmentos recibidos por la WAN y aprende la MTU de los ICMP "fragmentation needed"
+static void inspect_inbound(struct pbuf *p)
+{
+    struct ip_hdr *ip = ipv4_header(p);
+    if (ip == NULL)
+    {
+        return;
+    }
+
+    uint16_t offset = lwip_ntohs(IPH_OFFSET(ip));
+    if (offset & (IP_OFFMASK | IP_MF))
+    {
+        metrics_add(METRIC_FRAGMENTS_IN, 1);
+        if (!(offset & IP_MF))
+        {
+            metrics_add(METRIC_LAST_FRAGMENTS, 1);
+        }
+        return;
+    }
+
+    // Tipo 3 (destino inalcanzable), código 4; la MTU del siguiente salto va en los bytes 6 y 7, seguida de la
+    // cabecera IP del paquete que no cupo y de sus primeros 8 bytes (los puertos)
+    uint16_t ip_hlen = IPH_HL_BYTES(ip);
+    uint8_t *icmp = (uint8_t *)ip + ip_hlen;
+    if (IPH_PROTO(ip) != IP_PROTO_ICMP || p->len < SIZEOF_ETH_HDR + ip_hlen + 8 || icmp[0] != 3 || icmp[1] != 4)
+    {
+        return;
+    }
+    metrics_add(METRIC_PMTU_ICMP, 1);
+
+    // Solo cuenta si cita un segmento de una conexión TCP traducida viva: un ICMP falso o de otra conexión no
+    // debe bajar el MSS de los demás clientes
+    const struct ip_hdr *inner = (const struct ip_hdr *)(icmp + 8);
+    uint16_t inner_offset = SIZEOF_ETH_HDR + ip_hlen + 8;
+    bool valid = false;
+    if (p->len >= inner_offset + IP_HLEN && IPH_V(inner) == 4 && IPH_PROTO(inner) == IP_PROTO_TCP && IPH_HL_BYTES(inner) >= IP_HLEN &&
+        p->len >= inner_offset + IPH_HL_BYTES(inner) + 4)
+    {
+        const uint8_t *ports = (const uint8_t *)inner + IPH_HL_BYTES(inner);
+        napt_key_t key = {.src_ip = inner->src.addr, .dst_ip = inner->dest.addr, .proto = IP_PROTO_TCP};
+        memcpy(&key.src_port, ports, sizeof(key.src_port));
+        memcpy(&key.dst_port, ports + 2, sizeof(key.dst_port));
+
+        portENTER_CRITICAL(&table_lock);
+        valid = napt_table_find_translated(&flow_table, &key, now_ms()) != NULL;
+        portEXIT_CRITICAL(&table_lock);
+    }
+
+    if (!valid)
+    {
+        metrics_add(METRIC_PMTU_ICMP_IGNORED, 1);
+        return;
+    }
+    pmtu_learn(inner->dest.addr, ((uint16_t)icmp[6] << 8) | icmp[7]);
+}
+
+// Reenvía por la WAN un paquete de un flujo con traducción conocida, reescribiéndolo en el mismo buffer
+static bool fast_forward(struct pbuf *p, fwd_packet_t *pkt)
+{
+    // Apertura y cierre de conexiones, y paquetes que lwIP descartaría, siempre van por la ruta lenta
+    uplink_hooks_t *wan = uplink;
+    if ((pkt->tcp_flags & (TCP_SYN | TCP_FIN | TCP_RST)) || IPH_TTL(pkt->ip) <= 1 || wan == NULL || !netif_is_link_up(wan->netif))
+    {
+        return false;
+    }
+
+    uint32_t start = esp_cpu_get_cycle_count();
+    uint32_t now = now_ms();
+    uint32_t nat_ip;
+    uint16_t nat_port;
+    bool hit = false;
+
+    portENTER_CRITICAL(&table_lock);
+    napt_flow_t *flow = napt_table_find(&flow_table, &pkt->key, now);
+    if (flow && flow->state == NAPT_FLOW_MAPPED && !(flow->flags & NAPT_FLOW_FLAG_CLOSING) && (uint32_t)(now - flow->refreshed) < FORWARDING_REFRESH_MS)
+    {
+        flow->last_seen = now;
+        nat_ip = flow->nat_ip;
+        nat_port = flow->nat_port;
+        memcpy(pkt->eth->dest.addr, flow->eth_dst, sizeof(flow->eth_dst));
+        memcpy(pkt->eth->src.addr, flow->eth_src, sizeof(flow->eth_src));
+        hit = true;
+    }
+    portEXIT_CRITICAL(&table_lock);
+
+    if (!hit)
+    {
+        return false;
+    }
+
+    // Cabecera IP: dirección de origen y TTL
+    uint16_t ttl_proto_old, ttl_proto_new;
+    memcpy(&ttl_proto_old, &pkt->ip->_ttl, sizeof(ttl_proto_old));
+    IPH_TTL_SET(pkt->ip, IPH_TTL(pkt->ip) - 1);
+    memcpy(&ttl_proto_new, &pkt->ip->_ttl, sizeof(ttl_proto_new));
+
+    uint16_t ip_sum = csum_adjust16(IPH_CHKSUM(pkt->ip), ttl_proto_old, ttl_proto_new);
+    IPH_CHKSUM_SET(pkt->ip, csum_adjust32(ip_sum, pkt->key.src_ip, nat_ip));
+    pkt->ip->src.addr = nat_ip;
+
+    // Cabecera TCP/UDP: puerto de origen y pseudo-cabecera
+    if (pkt->key.proto == IP_PROTO_TCP)
+    {
+        struct tcp_hdr *tcp = (struct tcp_hdr *)pkt->l4;
+        uint16_t sum = csum_adjust32(tcp->chksum, pkt->key.src_ip, nat_ip);
+        tcp->chksum = csum_adjust16(sum, pkt->key.src_port, nat_port);
+        tcp->src = nat_port;
+    }
+    else
+    {
+        struct udp_hdr *udp = (struct udp_hdr *)pkt->l4;
+        if (udp->chksum != 0) // 0 indica que no se usa suma de verificación
+        {
+            uint16_t sum = csum_adjust32(udp->chksum, pkt->key.src_ip, nat_ip);
+            sum = csum_adjust16(sum, pkt->key.src_port, nat_port);
+            udp->chksum = (sum == 0) ? 0xffff : sum;
+        }
+        udp->src = nat_port;
+    }
+
+    uint16_t len = p->tot_len;
+    capture_tap(CAPTURE_STA_OUT, p);
+    err_t err = wan->linkoutput_orig(wan->netif, p);
+    pbuf_free(p);
+
+    if (err == ERR_OK)
+    {
+        metrics_add(METRIC_UP_FAST_PACKETS, 1);
+        metrics_add(METRIC_UP_FAST_BYTES, len);
+    }
+    else
+    {
+        metrics_add(METRIC_DROP_STA_TX, 1);
+    }
+    metrics_add(METRIC_FAST_CYCLES, esp_cpu_get_cycle_count() - start);
+    return true;
+}
+
+// Salidas del paso de IPv6: directas a los drivers, sin los ganchos de salida
+static err_t ipv6_ap_output(struct pbuf *p)
+{
+    capture_tap(CAPTURE_AP_OUT, p);
+    return ap_linkoutput_orig(ap_netif, p);
+}
+
+static err_t ipv6_wan_output(struct pbuf *p)
+{
+    uplink_hooks_t *wan = uplink;
+    if (wan == NULL)
+    {
+        return ERR_IF;
+    }
+    capture_tap(CAPTURE_STA_OUT, p);
+    return wan->linkoutput_orig(wan->netif, p);
+}
+
+// MARK: GANCHOS -----------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Entrada de la interfaz AP (tarea del driver WiFi, antes de pasar a la tarea TCP/IP)
+static err_t ap_input_hook(struct pbuf *p, struct netif *inp)
+{
+    capture_tap(CAPTURE_AP_IN, p);
+
+    // IPv6 global se reenvía sin traducción
+    if (IPV6_RELAY_ENABLED && ipv6_relay_ap_input(p))
+    {
+        return ERR_OK;
+    }
+
+    fwd_packet_t pkt;
+    if (parse_ipv4(p, &pkt) && is_forwarded(pkt.key.dst_ip))
+    {
+        clients_count_up(pkt.eth->src.addr, pkt.key.src_ip, p->tot_len);
+        clamp_mss(p, &pkt, pkt.key.dst_ip);
+
+        // Con control de tráfico el paquete espera su turno en la cola del cliente
+        if (shaper_enqueue(p, pkt.eth->src.addr))
+        {
+            return ERR_OK;
+        }
+
+        if (fast_forward(p, &pkt))
+        {
+            return ERR_OK;
+        }
+
+        track_outbound(&pkt);
+        metrics_add(METRIC_UP_SLOW_PACKETS, 1);
+        metrics_add(METRIC_UP_SLOW_BYTES, p->tot_len);
+    }
+
+    // Si la cola de la tarea TCP/IP está llena el paquete se pierde (el llamador libera el buffer)
+    err_t err = ap_input_orig(p, inp);
+    if (err != ERR_OK)
+    {
+        metrics_add(METRIC_DROP_AP_INPUT, 1);
+    }
+    return err;
+}
+
+// Envío de un paquete de subida que sale de la cola del control de tráfico (tarea del control de tráfico)
+static void shaper_send(struct pbuf *p)
+{
+    fwd_packet_t pkt;
+    parse_ipv4(p, &pkt); // Ya se validó al encolarlo
+    if (fast_forward(p, &pkt))
+    {
+        return;
+    }
+
+    track_outbound(&pkt);
+    metrics_add(METRIC_UP_SLOW_PACKETS, 1);
+    metrics_add(METRIC_UP_SLOW_BYTES, p->tot_len);
+
+    if (ap_input_orig(p, ap_netif) != ERR_OK)
+    {
+        metrics_add(METRIC_DROP_AP_INPUT, 1);
+        pbuf_free(p);
+    }
+}
+
+// Entrada de una interfaz WAN (tarea del driver WiFi o Ethernet): cuenta los paquetes de las reglas de redirección
+// de puertos y ajusta el MSS de los SYN que llegan de la red de subida
+static err_t uplink_input_hook(struct pbuf *p, struct netif *inp)
+{
+    capture_tap(CAPTURE_STA_IN, p);
+
+    if (IPV6_RELAY_ENABLED && ipv6_relay_wan_input(p, inp))
+    {
+        return ERR_OK;
+    }
+
+    fwd_packet_t pkt;
+    if (parse_ipv4(p, &pkt))
+    {
+        if (pkt.key.dst_ip == ip4_addr_get_u32(netif_ip4_addr(inp)))
+        {
+            portmap_hit(pkt.key.proto, lwip_ntohs(pkt.key.dst_port));
+            clamp_mss(p, &pkt, pkt.key.src_ip);
+        }
+    }
+    else
+    {
+        inspect_inbound(p);
+    }
+    return find_uplink(inp)->input_orig(p, inp);
+}
+
+// Salida de una interfaz WAN (tarea TCP/IP, después de la traducción NAPT de lwIP)
+static err_t uplink_linkoutput_hook(struct netif *netif, struct pbuf *p)
+{
+    fwd_packet_t pkt;
+    if (parse_ipv4(p, &pkt))
+    {
+        if (pkt.key.src_ip == ip4_addr_get_u32(netif_ip4_addr(netif)))
+        {
+            learn_mapping(&pkt);
+        }
+    }
+    else
+    {
+        // Fragmentos generados por lwIP al reenviar datagramas mayores que la MTU de la WAN
+        struct ip_hdr *ip = ipv4_header(p);
+        if (ip != NULL && (lwip_ntohs(IPH_OFFSET(ip)) & (IP_OFFMASK | IP_MF)))
+        {
+            metrics_add(METRIC_FRAGMENTS_OUT, 1);
+        }
+    }
+
+    capture_tap(CAPTURE_STA_OUT, p);
+    err_t err = find_uplink(netif)->linkoutput_orig(netif, p);
+    if (err != ERR_OK)
+    {
+        metrics_add(METRIC_DROP_STA_TX, 1);
+    }
+    return err;
+}
+
+// Salida de la interfaz AP (tarea TCP/IP): cuenta el tráfico reenviado hacia los clientes
+static err_t ap_linkoutput_hook(struct netif *netif, struct pbuf *p)
+{
+    uint16_t len = p->tot_len;
+    bool forwarded = false;
+    struct eth_hdr *eth = (struct eth_hdr *)p->payload;
+    if (p->len >= SIZEOF_ETH_HDR + IP_HLEN && eth->type == PP_HTONS(ETHTYPE_IP))
+    {
+        // Los paquetes generados por el propio router llevan la IP del AP como origen
+        struct ip_hdr *ip = (struct ip_hdr *)((uint8_t *)p->payload + SIZEOF_ETH_HDR);
+        forwarded = ip->src.addr != ip4_addr_get_u32(netif_ip4_addr(netif));
+    }
+
+    // Límite de bajada del cliente: el paquete se descarta como si se hubiera enviado
+    if (forwarded && !shaper_admit_down(eth->dest.addr, len))
+    {
+        return ERR_OK;
+    }
+
+    capture_tap(CAPTURE_AP_OUT, p);
+    err_t err = ap_linkoutput_orig(netif, p);
+    if (err != ERR_OK)
+    {
+        metrics_add(METRIC_DROP_AP_TX, 1);
+    }
+    else if (forwarded)
+    {
+        metrics_add(METRIC_DOWN_PACKETS, 1);
+        metrics_add(METRIC_DOWN_BYTES, len);
+        clients_count_down(eth->dest.addr, len);
+    }
+    return err;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t forwarding_start(esp_netif_t *esp_netif_ap, esp_netif_t *esp_netif_wan)
+{
+    if (flow_table.slots == NULL && !napt_table_init(&flow_table, NAPT_TABLE_SIZE_DEFAULT))
+    {
+        ESP_LOGE(TAG_NAPT, "Sin memoria para la tabla de conexiones NAPT");
+        return ESP_ERR_NO_MEM;
+    }
+
+    // Las traducciones anteriores dejan de ser válidas con una nueva IP o con otra WAN
+    forwarding_reset();
+
+    if (ap_netif == NULL)
+    {
+        ap_netif = esp_netif_get_netif_impl(esp_netif_ap);
+        if (ap_netif == NULL)
+        {
+            return ESP_ERR_INVALID_STATE;
+        }
+
+        // Los punteros de entrada y salida se fijan una sola vez al crear las interfaces
+        ap_input_orig = ap_netif->input;
+        ap_netif->input = ap_input_hook;
+        ap_linkoutput_orig = ap_netif->linkoutput;
+        ap_netif->linkoutput = ap_linkoutput_hook;
+        ipv6_relay_start(ap_netif, ipv6_ap_output, ipv6_wan_output);
+
+        esp_err_t err = shaper_start(shaper_send);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG_NAPT, "Error al iniciar el control de tráfico. Error %s", esp_err_to_name(err));
+        }
+
+        ESP_LOGI(TAG_NAPT, "Tabla de conexiones NAPT lista. Capacidad: %lu flujos", flow_table.limit);
+    }
+
+    struct netif *wan_netif = esp_netif_get_netif_impl(esp_netif_wan);
+    if (wan_netif == NULL)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    // Cada WAN recibe sus ganchos la primera vez que se usa y los conserva aunque deje de ser la activa
+    uplink_hooks_t *hooks = find_uplink(wan_netif);
+    if (hooks == NULL)
+    {
+        hooks = find_uplink(NULL);
+        if (hooks == NULL)
+        {
+            return ESP_ERR_NO_MEM;
+        }
+        hooks->input_orig = wan_netif->input;
+        hooks->linkoutput_orig = wan_netif->linkoutput;
+        hooks->netif = wan_netif;
+        wan_netif->input = uplink_input_hook;
+        wan_netif->linkoutput = uplink_linkoutput_hook;
+    }
+    uplink = hooks;
+    ipv6_relay_set_wan(wan_netif);
+
+    // La MTU de la interfaz puede cambiar con cada concesión DHCP
+    pmtu_set_link_mtu(wan_netif->mtu);
+
+    return ESP_OK;
+}
+
+void forwarding_reset(void)
+{
+    if (flow_table.slots == NULL)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&table_lock);
+    napt_table_clear(&flow_table);
+    memset(pending, 0, sizeof(pending));
+    flows_learned = 0;
+    flows_remapped = 0;
+    portEXIT_CRITICAL(&table_lock);
+}
+
+void forwarding_get_stats(forwarding_stats_t *stats)
+{
+    portENTER_CRITICAL(&table_lock);
+    stats->flows = flow_table.count;
+    stats->learned = flows_learned;
+    stats->remapped = flows_remapped;
+    stats->capacity = flow_table.limit;
+    stats->expired = flow_table.expired;
+    stats->rejected = flow_table.rejected;
+    portEXIT_CRITICAL(&table_lock);
+}
+
+#endif // IP_NAPT
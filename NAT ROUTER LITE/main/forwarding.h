@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_netif.h"
+
+// Ruta de reenvío entre el punto de acceso y la WAN (cliente STA o Ethernet).
+// Intercepta la entrada de la interfaz AP y la salida de la interfaz WAN de lwIP para llevar
+// la tabla de conexiones NAPT (napt_table) sin pasar por la tabla interna de lwIP.
+// Los paquetes de flujos con traducción conocida se reescriben en el mismo buffer y se entregan
+// directamente al driver de la WAN activa (ruta rápida); el resto sigue por lwIP (ruta lenta).
+// El IPv6 global no se traduce: lo reenvía ipv6_relay desde los mismos ganchos.
+// Los contadores de tráfico se publican en metrics.
+
+typedef struct
+{
+    uint32_t flows;    // Flujos en la tabla
+    uint32_t learned;  // Traducciones aprendidas desde el último reinicio
+    uint32_t remapped; // Traducciones sustituidas porque lwIP cambió el puerto de un flujo
+    uint32_t capacity; // Máximo de flujos admitidos
+    uint32_t expired;  // Flujos expirados desde el inicio
+    uint32_t rejected; // Flujos no registrados por tabla llena
+} forwarding_stats_t;
+
+esp_err_t forwarding_start(esp_netif_t *esp_netif_ap, esp_netif_t *esp_netif_wan); // Instala los ganchos, fija la WAN activa y vacía la tabla
+void forwarding_reset(void);                                                       // Descarta las traducciones aprendidas
+void forwarding_get_stats(forwarding_stats_t *stats);                              // Copia las estadísticas de la tabla
@@ -0,0 +1,482 @@
+#include "ipv6_relay.h"
+#include "clients.h"
+#include "metrics.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/prot/ethernet.h"
+#include <string.h>
+
+// Definiciones de IPv6 y NDP
+#define IP6_HLEN 40
+#define IP6_NEXTH_ICMP6 58
+#define ICMP6_RS 133
+#define ICMP6_RA 134
+#define ICMP6_NS 135
+#define ICMP6_NA 136
+#define ND_OPT_SOURCE_LLADDR 1
+#define ND_OPT_TARGET_LLADDR 2
+#define ND_OPT_PREFIX_INFO 3
+#define ND_PREFIX_FLAG_ON_LINK 0x80
+#define ND_NA_FLAG_SOLICITED 0x40
+#define RA_HLEN 16 // Cabecera del RA hasta las opciones
+#define NA_LEN 32  // NA con la opción de dirección de enlace del destino
+
+// Tags para logging
+static const char *TAG_IPV6 = "IPV6";
+
+// Estructuras
+typedef struct
+{
+    uint8_t addr[16];
+    uint8_t mac[6];
+    bool valid;
+    uint32_t last_seen; // ms
+} neighbor_t;
+
+// Variables globales
+static portMUX_TYPE relay_lock = portMUX_INITIALIZER_UNLOCKED;
+static struct netif *ap_netif = NULL;
+static struct netif *wan_netif = NULL;
+static ipv6_relay_output_fn ap_output = NULL;
+static ipv6_relay_output_fn wan_output = NULL;
+static neighbor_t neighbors[IPV6_RELAY_NEIGHBORS];
+static uint8_t ra[IPV6_RELAY_RA_MAX]; // Último RA de la red de subida, tal como llegó
+static uint16_t ra_len = 0;
+static uint8_t router_mac[6];         // Router de subida, destino del tráfico de los clientes
+static bool router_known = false;
+
+static const uint8_t all_nodes[16] = {0xff, 0x02, [15] = 0x01};
+static const uint8_t all_nodes_mac[6] = {0x33, 0x33, 0x00, 0x00, 0x00, 0x01};
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static inline bool is_global(const uint8_t *addr)
+{
+    return (addr[0] & 0xe0) == 0x20; // 2000::/3
+}
+
+static inline bool is_unspecified(const uint8_t *addr)
+{
+    static const uint8_t zero[16] = {0};
+    return memcmp(addr, zero, sizeof(zero)) == 0;
+}
+
+// Dirección de enlace local EUI-64, la misma que crea lwIP para la interfaz
+static void link_local(const uint8_t *mac, uint8_t *addr)
+{
+    memset(addr, 0, 16);
+    addr[0] = 0xfe;
+    addr[1] = 0x80;
+    addr[8] = mac[0] ^ 0x02;
+    addr[9] = mac[1];
+    addr[10] = mac[2];
+    addr[11] = 0xff;
+    addr[12] = 0xfe;
+    addr[13] = mac[3];
+    addr[14] = mac[4];
+    addr[15] = mac[5];
+}
+
+// Cabecera IPv6 de una trama; NULL si no es IPv6 o la cabecera no está en el primer buffer
+static uint8_t *ipv6_header(struct pbuf *p)
+{
+    struct eth_hdr *eth = (struct eth_hdr *)p->payload;
+    if (p->len < SIZEOF_ETH_HDR + IP6_HLEN || eth->type != PP_HTONS(ETHTYPE_IPV6))
+    {
+        return NULL;
+    }
+    uint8_t *ip6 = (uint8_t *)p->payload + SIZEOF_ETH_HDR;
+    return (ip6[0] >> 4) == 6 ? ip6 : NULL;
+}
+
+// Mensaje ICMPv6 sin cabeceras de extensión (así van siempre los de NDP); NULL si no lo es
+static uint8_t *icmp6_header(struct pbuf *p, uint8_t *ip6, uint16_t min_len)
+{
+    if (ip6[6] != IP6_NEXTH_ICMP6 || p->len < SIZEOF_ETH_HDR + IP6_HLEN + min_len)
+    {
+        return NULL;
+    }
+    return ip6 + IP6_HLEN;
+}
+
+// Suma de verificación ICMPv6 con la pseudo-cabecera (el campo de la suma debe estar a 0)
+static uint16_t icmp6_checksum(const uint8_t *ip6, const uint8_t *icmp, uint16_t len)
+{
+    uint32_t sum = len + IP6_NEXTH_ICMP6;
+    for (int i = 8; i < IP6_HLEN; i += 2)
+    {
+        sum += ((uint32_t)ip6[i] << 8) | ip6[i + 1];
+    }
+    for (int i = 0; i + 1 < len; i += 2)
+    {
+        sum += ((uint32_t)icmp[i] << 8) | icmp[i + 1];
+    }
+    if (len & 1)
+    {
+        sum += (uint32_t)icmp[len - 1] << 8;
+    }
+    while (sum >> 16)
+    {
+        sum = (sum & 0xffff) + (sum >> 16);
+    }
+    return ~sum & 0xffff;
+}
+
+// Rellena las cabeceras Ethernet e IPv6 de un mensaje ICMPv6 y su suma de verificación
+static void build_icmp6(uint8_t *frame, const uint8_t *dst_mac, const uint8_t *src_mac, const uint8_t *dst, const uint8_t *src, uint16_t icmp_len)
+{
+    struct eth_hdr *eth = (struct eth_hdr *)frame;
+    memcpy(eth->dest.addr, dst_mac, 6);
+    memcpy(eth->src.addr, src_mac, 6);
+    eth->type = PP_HTONS(ETHTYPE_IPV6);
+
+    uint8_t *ip6 = frame + SIZEOF_ETH_HDR;
+    memset(ip6, 0, 8);
+    ip6[0] = 0x60;
+    ip6[4] = icmp_len >> 8;
+    ip6[5] = icmp_len & 0xff;
+    ip6[6] = IP6_NEXTH_ICMP6;
+    ip6[7] = 255; // NDP exige 255: demuestra que el mensaje no ha cruzado un router
+    memcpy(ip6 + 8, src, 16);
+    memcpy(ip6 + 24, dst, 16);
+
+    uint8_t *icmp = ip6 + IP6_HLEN;
+    icmp[2] = icmp[3] = 0;
+    uint16_t sum = icmp6_checksum(ip6, icmp, icmp_len);
+    icmp[2] = sum >> 8;
+    icmp[3] = sum & 0xff;
+}
+
+// Copia la trama en un buffer nuevo y la entrega al driver
+static bool send_frame(ipv6_relay_output_fn output, const uint8_t *frame, uint16_t len)
+{
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    if (p == NULL)
+    {
+        return false;
+    }
+    memcpy(p->payload, frame, len);
+    err_t err = output(p);
+    pbuf_free(p);
+    return err == ERR_OK;
+}
+
+// Recuerda en qué cliente está una dirección; si no hay hueco sustituye a la más antigua
+static void neighbor_learn(const uint8_t *addr, const uint8_t *mac, uint32_t now)
+{
+    portENTER_CRITICAL(&relay_lock);
+    neighbor_t *slot = NULL;
+    for (int i = 0; i < IPV6_RELAY_NEIGHBORS; i++)
+    {
+        neighbor_t *n = &neighbors[i];
+        if (n->valid && memcmp(n->addr, addr, 16) == 0)
+        {
+            slot = n;
+            break;
+        }
+        if (slot == NULL || (slot->valid && (!n->valid || (uint32_t)(now - n->last_seen) > (uint32_t)(now - slot->last_seen))))
+        {
+            slot = n;
+        }
+    }
+    memcpy(slot->addr, addr, 16);
+    memcpy(slot->mac, mac, 6);
+    slot->valid = true;
+    slot->last_seen = now;
+    portEXIT_CRITICAL(&relay_lock);
+}
+
+// Busca el cliente de una dirección; las que llevan mucho sin tráfico se olvidan
+static bool neighbor_find(const uint8_t *addr, uint8_t *mac, uint32_t now)
+{
+    bool found = false;
+    portENTER_CRITICAL(&relay_lock);
+    for (int i = 0; i < IPV6_RELAY_NEIGHBORS; i++)
+    {
+        neighbor_t *n = &neighbors[i];
+        if (n->valid && memcmp(n->addr, addr, 16) == 0)
+        {
+            if ((uint32_t)(now - n->last_seen) >= IPV6_RELAY_NEIGHBOR_AGE_MS)
+            {
+                n->valid = false;
+                break;
+            }
+            memcpy(mac, n->mac, 6);
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&relay_lock);
+    return found;
+}
+
+// Envía en el AP el último RA de la red de subida como propio. Con withdraw anuncia que el router ya no es
+// router por defecto y que el prefijo no debe usarse para conexiones nuevas (tras cambiar de WAN)
+static void send_ra(bool withdraw)
+{
+    uint8_t frame[SIZEOF_ETH_HDR + IP6_HLEN + IPV6_RELAY_RA_MAX];
+    uint8_t *icmp = frame + SIZEOF_ETH_HDR + IP6_HLEN;
+
+    portENTER_CRITICAL(&relay_lock);
+    uint16_t len = ra_len;
+    memcpy(icmp, ra, len);
+    portEXIT_CRITICAL(&relay_lock);
+    if (len == 0 || ap_netif == NULL)
+    {
+        return;
+    }
+
+    if (withdraw)
+    {
+        icmp[6] = icmp[7] = 0; // Tiempo de vida como router por defecto
+    }
+
+    // Opciones: la dirección de enlace pasa a ser la del AP y los prefijos dejan de ser locales al enlace, para
+    // que los clientes envíen todo al router (que es quien sabe en qué lado está cada dirección)
+    for (uint16_t offset = RA_HLEN; offset + 2 <= len && icmp[offset + 1] != 0; offset += icmp[offset + 1] * 8)
+    {
+        uint8_t *option = icmp + offset;
+        if (offset + option[1] * 8 > len)
+        {
+            break;
+        }
+        if (option[0] == ND_OPT_SOURCE_LLADDR && option[1] == 1)
+        {
+            memcpy(option + 2, ap_netif->hwaddr, 6);
+        }
+        else if (option[0] == ND_OPT_PREFIX_INFO && option[1] == 4)
+        {
+            option[3] &= ~ND_PREFIX_FLAG_ON_LINK;
+            if (withdraw)
+            {
+                memset(option + 8, 0, 4); // Tiempo preferido
+            }
+        }
+    }
+
+    uint8_t src[16];
+    link_local(ap_netif->hwaddr, src);
+    build_icmp6(frame, all_nodes_mac, ap_netif->hwaddr, all_nodes, src, len);
+    if (send_frame(ap_output, frame, SIZEOF_ETH_HDR + IP6_HLEN + len))
+    {
+        metrics_add(METRIC_IPV6_RA_RELAYED, 1);
+    }
+}
+
+// Responde en la WAN a una solicitud de vecino de la dirección de un cliente con la MAC de la WAN
+static void send_proxy_na(struct pbuf *p, const uint8_t *ip6, const uint8_t *target)
+{
+    struct netif *wan = wan_netif;
+    if (wan == NULL)
+    {
+        return;
+    }
+
+    uint8_t frame[SIZEOF_ETH_HDR + IP6_HLEN + NA_LEN];
+    uint8_t *icmp = frame + SIZEOF_ETH_HDR + IP6_HLEN;
+    const uint8_t *requester = ip6 + 8;
+    bool dad = is_unspecified(requester); // La detección de duplicados se responde a todos los nodos
+
+    memset(icmp, 0, NA_LEN);
+    icmp[0] = ICMP6_NA;
+    icmp[4] = dad ? 0 : ND_NA_FLAG_SOLICITED; // Sin Override: la respuesta de un proxy no pisa la del propio nodo
+    memcpy(icmp + 8, target, 16);
+    icmp[24] = ND_OPT_TARGET_LLADDR;
+    icmp[25] = 1;
+    memcpy(icmp + 26, wan->hwaddr, 6);
+
+    uint8_t src[16];
+    link_local(wan->hwaddr, src);
+    const struct eth_hdr *eth = (const struct eth_hdr *)p->payload;
+    build_icmp6(frame, dad ? all_nodes_mac : eth->src.addr, wan->hwaddr, dad ? all_nodes : requester, src, NA_LEN);
+    if (send_frame(wan_output, frame, sizeof(frame)))
+    {
+        metrics_add(METRIC_IPV6_NDP_PROXIED, 1);
+    }
+}
+
+// Reenvía una trama IPv6 cambiando la cabecera Ethernet y el límite de saltos; libera la trama
+static void relay(struct pbuf *p, uint8_t *ip6, ipv6_relay_output_fn output, const uint8_t *dst_mac, const uint8_t *src_mac)
+{
+    struct eth_hdr *eth = (struct eth_hdr *)p->payload;
+    memcpy(eth->dest.addr, dst_mac, 6);
+    memcpy(eth->src.addr, src_mac, 6);
+    ip6[7]--; // IPv6 no tiene suma de verificación de cabecera
+    if (output(p) != ERR_OK)
+    {
+        metrics_add(METRIC_IPV6_DROPPED, 1);
+    }
+    pbuf_free(p);
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void ipv6_relay_start(struct netif *ap, ipv6_relay_output_fn ap_out, ipv6_relay_output_fn wan_out)
+{
+    ap_netif = ap;
+    ap_output = ap_out;
+    wan_output = wan_out;
+}
+
+void ipv6_relay_set_wan(struct netif *wan)
+{
+    if (wan == wan_netif)
+    {
+        return;
+    }
+
+    // El prefijo de la WAN anterior deja de valer: se retira antes de olvidar el RA
+    if (wan_netif != NULL)
+    {
+        send_ra(true);
+        ESP_LOGI(TAG_IPV6, "Nueva WAN: prefijo anterior retirado");
+    }
+
+    portENTER_CRITICAL(&relay_lock);
+    wan_netif = wan;
+    ra_len = 0;
+    router_known = false;
+    memset(neighbors, 0, sizeof(neighbors));
+    portEXIT_CRITICAL(&relay_lock);
+}
+
+bool ipv6_relay_ap_input(struct pbuf *p)
+{
+    uint8_t *ip6 = ipv6_header(p);
+    if (ip6 == NULL)
+    {
+        return false;
+    }
+
+    struct eth_hdr *eth = (struct eth_hdr *)p->payload;
+    const uint8_t *src = ip6 + 8;
+    const uint8_t *dst = ip6 + 24;
+    uint32_t now = now_ms();
+
+    if (is_global(src))
+    {
+        neighbor_learn(src, eth->src.addr, now);
+    }
+
+    uint8_t *icmp = icmp6_header(p, ip6, 24);
+    if (icmp != NULL && icmp[0] == ICMP6_NS && is_unspecified(src))
+    {
+        // Detección de duplicados de una dirección nueva: se aprende antes de que el cliente la use
+        if (is_global(icmp + 8))
+        {
+            neighbor_learn(icmp + 8, eth->src.addr, now);
+        }
+        return false;
+    }
+    if (icmp != NULL && icmp[0] == ICMP6_RS && ra_len != 0)
+    {
+        send_ra(false);
+        pbuf_free(p);
+        return true;
+    }
+
+    if (!is_global(dst) || p->len != p->tot_len)
+    {
+        return false; // Enlace local y multidifusión son para lwIP
+    }
+    if (ip6[7] <= 1)
+    {
+        metrics_add(METRIC_IPV6_DROPPED, 1);
+        pbuf_free(p);
+        return true;
+    }
+
+    uint8_t client_mac[6], next_mac[6];
+    memcpy(client_mac, eth->src.addr, sizeof(client_mac));
+    uint16_t len = p->tot_len;
+
+    // Entre clientes del AP el paquete vuelve al AP; el resto va al router de subida
+    struct netif *wan = wan_netif;
+    if (neighbor_find(dst, next_mac, now))
+    {
+        relay(p, ip6, ap_output, next_mac, ap_netif->hwaddr);
+    }
+    else if (router_known && wan != NULL)
+    {
+        portENTER_CRITICAL(&relay_lock);
+        memcpy(next_mac, router_mac, sizeof(next_mac));
+        portEXIT_CRITICAL(&relay_lock);
+        relay(p, ip6, wan_output, next_mac, wan->hwaddr);
+    }
+    else
+    {
+        return false; // Aún sin RA de la red de subida
+    }
+
+    clients_count_up(client_mac, 0, len);
+    metrics_add(METRIC_IPV6_UP_PACKETS, 1);
+    metrics_add(METRIC_IPV6_UP_BYTES, len);
+    return true;
+}
+
+bool ipv6_relay_wan_input(struct pbuf *p, struct netif *inp)
+{
+    // La WAN de respaldo tiene su propio prefijo: solo se pasa el de la activa
+    uint8_t *ip6 = ipv6_header(p);
+    if (ip6 == NULL || ap_netif == NULL || inp != wan_netif)
+    {
+        return false;
+    }
+
+    struct eth_hdr *eth = (struct eth_hdr *)p->payload;
+    const uint8_t *dst = ip6 + 24;
+    uint32_t now = now_ms();
+    uint8_t mac[6];
+
+    uint8_t *icmp = icmp6_header(p, ip6, 24);
+    if (icmp != NULL && icmp[0] == ICMP6_RA && ip6[7] == 255)
+    {
+        // RA del router de subida: se guarda, se retransmite en el AP y lwIP también lo procesa
+        uint16_t len = ((uint16_t)ip6[4] << 8) | ip6[5];
+        if (len >= RA_HLEN && len <= IPV6_RELAY_RA_MAX && SIZEOF_ETH_HDR + IP6_HLEN + len <= p->len)
+        {
+            portENTER_CRITICAL(&relay_lock);
+            memcpy(ra, icmp, len);
+            ra_len = len;
+            memcpy(router_mac, eth->src.addr, sizeof(router_mac));
+            router_known = true;
+            portEXIT_CRITICAL(&relay_lock);
+            send_ra(false);
+        }
+        return false;
+    }
+    if (icmp != NULL && icmp[0] == ICMP6_NS && ip6[7] == 255)
+    {
+        if (is_global(icmp + 8) && neighbor_find(icmp + 8, mac, now))
+        {
+            send_proxy_na(p, ip6, icmp + 8);
+            pbuf_free(p);
+            return true;
+        }
+        return false;
+    }
+
+    if (!is_global(dst) || p->len != p->tot_len || !neighbor_find(dst, mac, now))
+    {
+        return false;
+    }
+    if (ip6[7] <= 1)
+    {
+        metrics_add(METRIC_IPV6_DROPPED, 1);
+        pbuf_free(p);
+        return true;
+    }
+
+    uint16_t len = p->tot_len;
+    relay(p, ip6, ap_output, mac, ap_netif->hwaddr);
+    clients_count_down(mac, len);
+    metrics_add(METRIC_IPV6_DOWN_PACKETS, 1);
+    metrics_add(METRIC_IPV6_DOWN_BYTES, len);
+    return true;
+}
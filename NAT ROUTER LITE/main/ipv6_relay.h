@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lwip/err.h"
+#include "lwip/netif.h"
+#include "lwip/pbuf.h"
+#include "sdkconfig.h"
+
+// Paso de IPv6 sin traducción entre la WAN y el punto de acceso (proxy NDP, al estilo del RFC 4389).
+// Los clientes del AP usan el prefijo /64 de la red de subida: el RA del router de subida se retransmite en el AP
+// con la MAC y la dirección de enlace local del router y el prefijo marcado como no local al enlace, así todo el
+// tráfico de los clientes pasa por el router, que configura sus direcciones por SLAAC. En la WAN el router
+// responde a las solicitudes de vecino (NS) de las direcciones de los clientes con su propia MAC. Los paquetes
+// IPv6 se reenvían en la ruta de reenvío cambiando solo la cabecera Ethernet y el límite de saltos, sin pasar por
+// lwIP ni por la tabla NAPT; /metrics cuenta el tráfico IPv6 y la parte del tráfico reenviado que evita el NAPT.
+
+// Definiciones del paso de IPv6
+#if CONFIG_ROUTER_IPV6_RELAY
+#define IPV6_RELAY_ENABLED 1
+#else
+#define IPV6_RELAY_ENABLED 0
+#endif
+
+#define IPV6_RELAY_NEIGHBORS 32            // Direcciones IPv6 de clientes del AP recordadas (varias por cliente)
+#define IPV6_RELAY_NEIGHBOR_AGE_MS 600000  // Vida de una dirección sin tráfico del cliente
+#define IPV6_RELAY_RA_MAX 256              // Tamaño máximo del RA de la red de subida (mensaje ICMPv6)
+
+typedef err_t (*ipv6_relay_output_fn)(struct pbuf *p); // Entrega una trama completa al driver (no libera p)
+
+void ipv6_relay_start(struct netif *ap, ipv6_relay_output_fn ap_output, ipv6_relay_output_fn wan_output); // Interfaz AP y salidas
+void ipv6_relay_set_wan(struct netif *wan); // WAN activa; al cambiar retira el prefijo anterior y olvida los vecinos
+bool ipv6_relay_ap_input(struct pbuf *p);   // Trama de un cliente del AP; true si se ha reenviado o respondido (liberada)
+bool ipv6_relay_wan_input(struct pbuf *p, struct netif *inp); // Trama de una WAN; true si se ha reenviado o respondido (liberada)
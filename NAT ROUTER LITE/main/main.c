@@ -1,17 +1,44 @@
 #include "driver/gpio.h"
 #include "esp_check.h"
+#include "esp_eth.h"
 #include "esp_event.h"
 #include "esp_http_server.h"
 #include "esp_log.h"
 #include "esp_mac.h"
 #include "esp_netif.h"
 #include "esp_netif_net_stack.h"
+#include "esp_random.h"
 #include "esp_system.h"
 #include "esp_timer.h"
 #include "esp_tls.h"
 #include "esp_tls_crypto.h"
 #include "esp_wifi.h"
+#include "admin.h"
+#include "capture.h"
+#include "clients.h"
+#include "blocklist.h"
+#include "cores.h"
+#include "dns_forwarder.h"
+#include "ethernet.h"
+#include "event_log.h"
+#include "ipv6_relay.h"
+#include "form.h"
+#include "metrics.h"
+#include "ota.h"
+#include "pmtu.h"
+#include "pool.h"
+#include "portmap.h"
+#include "selftest.h"
+#include "settings.h"
+#include "shaper.h"
+#include "sockets.h"
+#include "status.h"
+#include "task_stats.h"
+#include "uplink_policy.h"
+#include "sta_policy.h"
+#include "web_assets.h"
 #include "freertos/FreeRTOS.h"
+#include "freertos/event_groups.h"
 #include "freertos/queue.h"
 #include "freertos/task.h"
 #include "lwip/err.h"
@@ -19,24 +46,28 @@
 #include "lwip/netdb.h"
 #include "lwip/sockets.h"
 #include "lwip/sys.h"
-#include "nvs.h"
 #include "nvs_flash.h"
 #include <sys/param.h>
 #include <stdbool.h>
 #if IP_NAPT
 #include "lwip/lwip_napt.h"
+#include "forwarding.h"
 #endif
 
 // Definiciones de pines
 #define BUILD_LED GPIO_NUM_2 // LED conectado al pin GPIO 2
+#define LED_BLINK_MS 500     // Parpadeo del LED mientras no hay conexión
 
-// Definiciones de NVS
-#define WIFI_NAMESPACE "wifi"
+// Bits del estado del router
+#define ROUTER_STA_BIT BIT0    // STA conectada a la red de subida
+#define ROUTER_STA_IP_BIT BIT1 // STA con IP
+#define ROUTER_ETH_IP_BIT BIT2 // WAN por Ethernet con IP
+#define ROUTER_WAN_BITS (ROUTER_STA_BIT | ROUTER_ETH_IP_BIT) // Con alguna WAN el LED deja de parpadear
 
 // Definiciones WiFi AP
 #define WIFI_AP_SSID "ESP32-NAT"
 #define WIFI_AP_PASS "12345678"
-#define WIFI_AP_MAX_STA_CONN 3
+#define WIFI_AP_MAX_STA_CONN CLIENTS_MAX // Capacidad de la tabla de clientes (CONFIG_ROUTER_MAX_CLIENTS)
 #define WIFI_AP_CHANNEL 0
 #define WIFI_AP_IP "192.168.2.1" // También se usa como gateway (Netmask: 255.255.255.0)
 
@@ -44,7 +75,20 @@
 #define WIFI_STA_SSID_DEFAULT "SSID"
 #define WIFI_STA_PASS_DEFAULT "PASS"
 #define WIFI_STA_MAX_RETRY 2
-#define WIFI_STA_RECONNECT_TIMEOUT 3
+#define WIFI_STA_SCAN_MAX_RECORDS 8   // Resultados leídos del escaneo de detección de autenticación
+#define WIFI_STA_UPLINK_SCAN_INTERVAL_S 60  // Escaneo en segundo plano de las redes de subida (con conexión)
+#define WIFI_STA_UPLINK_SCAN_DWELL_MS 60    // Tiempo en cada canal, corto para no dejar al AP sin servicio
+#define WIFI_STA_UPLINK_SCAN_HOME_MS 30     // Vuelta al canal propio entre canales escaneados
+#define WIFI_STA_UPLINK_SCAN_MAX_RECORDS 16 // Resultados leídos del escaneo de redes de subida
+
+_Static_assert(UPLINK_POLICY_MAX_NETWORKS == SETTINGS_MAX_NETWORKS, "uplink_policy debe admitir todas las redes de la configuración");
+
+// Presupuesto de sockets de lwIP (sockets.h): sesiones del servidor web y sus sockets internos, reenviador DNS y prueba de velocidad
+_Static_assert(HTTP_MAX_SOCKETS + HTTP_INTERNAL_SOCKETS + DNS_SOCKETS + SELFTEST_SOCKETS <= CONFIG_LWIP_MAX_SOCKETS,
+               "CONFIG_LWIP_MAX_SOCKETS no alcanza para el servidor web, el DNS y la prueba de velocidad");
+
+// Definiciones de estadísticas
+#define FORWARDING_STATS_INTERVAL 60 // Segundos entre informes de la ruta de reenvío
 
 // Tags para logging
 static const char *TAG_GPIO = "GPIO";
@@ -55,6 +99,7 @@ static const char *TAG_NVS = "NVS";
 static const char *TAG_WIFI = "WIFI";
 static const char *TAG_AP = "WIFI_AP";
 static const char *TAG_STA = "WIFI_STA";
+static const char *TAG_WAN = "WAN";
 static const char *TAG_HTTP = "WEB_SERVER";
 
 // Estructuras
@@ -67,12 +112,21 @@ typedef struct
 
 // Variables globales
 static esp_timer_handle_t reconnect_timer = NULL;
+static esp_timer_handle_t stats_timer = NULL;
 static esp_netif_t *esp_netif_ap = NULL;
-static esp_netif_t *esp_netif_sta = NULL;
-static char *ssid = NULL;
-static char *password = NULL;
-static int auth_mode_index = 6;
-static bool esp_connected = false;
+static esp_netif_t *esp_netif_sta = NULL;  // NULL si la WAN es solo Ethernet
+static esp_netif_t *esp_netif_eth = NULL;  // NULL sin Ethernet
+static esp_netif_t *wan_netif = NULL;      // WAN por defecto: la del NAPT, el reenviador DNS y las redirecciones
+static bool authmode_scan_pending = false; // Escaneo de detección de autenticación en curso
+static bool uplink_scan_pending = false;   // Escaneo de redes de subida en curso
+static esp_timer_handle_t uplink_scan_timer = NULL;
+static uplink_policy_t uplink_policy;      // Elección de la red de subida
+static portMUX_TYPE uplink_lock = portMUX_INITIALIZER_UNLOCKED;
+static char sta_ssid[33] = "";             // Red del intento de conexión actual
+static EventGroupHandle_t router_events = NULL; // Estado del router (ROUTER_*_BIT)
+static esp_timer_handle_t led_timer = NULL;
+static digital_pin build_led = {BUILD_LED, GPIO_MODE_OUTPUT, 1};
+static sta_policy_t sta_policy; // Estado de la reconexión de la STA
 static httpd_handle_t server_handle = NULL;
 
 // Declaración de funciones principales
@@ -82,44 +136,93 @@ static void nvs_start(void);
 static void wifi_start(void);                                                                                    // Inicializa el WiFi
 esp_netif_t *wifi_ap_start(void);                                                                                // Inicializa el punto de acceso WiFi
 esp_netif_t *wifi_sta_start(void);                                                                               // Inicializa el cliente WiFi
-static void get_wifi_credentials(char **ssid, char **password);                                                  // Guarda las credenciales de WiFi en el almacenamiento no volátil
 static void configure_http_server(void);                                                                         // Configura el servidor HTTP
 static void toggle_pin(digital_pin *pin);                                                                        // Cambia el estado de un pin GPIO
+static void led_update(void);                                                                                    // Ajusta el LED al estado de la conexión
 
 // Declaración de funciones de eventos en el WiFi
 static void sta_disconnected_event_handler(wifi_event_sta_disconnected_t *event);   // Manejador de eventos de desconexión del cliente WiFi
-static void change_sta_authmode_threshold(void);                                    // Manejador de eventos de no encontrar AP en el umbral de autenticación
-static void update_wifi_credentials(void);                                          // Manejador de eventos comunes de desconexión del cliente WiFi
+static void start_authmode_scan(void);                                              // Escanea el SSID configurado para detectar su autenticación
+static void authmode_scan_done(void);                                               // Aplica la autenticación detectada en el escaneo
+static void apply_authmode(wifi_config_t *wifi_config, wifi_auth_mode_t authmode);  // Ajusta el umbral y PMF a la autenticación del AP
+static void sta_connect(void);                                                      // Conecta la STA, directamente al último AP si se conoce
 static void wifi_reconnect(void);                                                   // Reintenta la conexión WiFi
-static void ap_set_dns_addr(esp_netif_t *esp_netif_ap, esp_netif_t *esp_netif_sta); // Establece la dirección DNS en el punto de acceso
+static void start_uplink_scan(void);                                                // Escanea las redes de subida configuradas
+static void uplink_scan_done(void);                                                 // Puntúa las redes vistas y vuelve a la preferida si ha reaparecido
+static void wan_update(esp_netif_t *renewed);                                       // Elige la WAN por defecto entre las que tienen IP
+static void wan_lost(esp_netif_t *netif);                                           // Una WAN ha perdido la IP
+static void ap_set_dns_addr(esp_netif_t *esp_netif_ap, esp_netif_t *esp_netif_wan); // Establece la dirección DNS en el punto de acceso
 
 // Declaración de manejadores del web server
-static esp_err_t main_handler(httpd_req_t *req);    // Manejador de la página principal
-static esp_err_t favicon_handler(httpd_req_t *req); // Manejador del favicon
-static esp_err_t post_handler(httpd_req_t *req);    // Manejador de la petición POST
+static esp_err_t post_handler(httpd_req_t *req);         // Manejador de la petición POST
+static esp_err_t uplinks_get_handler(httpd_req_t *req);  // GET /uplinks: redes de subida y su puntuación
+static esp_err_t uplinks_post_handler(httpd_req_t *req); // POST /uplinks: añade, quita o prefiere una red
 
-// Declaración de funciones del web server
-static void url_decode(char *dst, const char *src);            // Decodifica una URL
-static void save_wifi_credentials(char *ssid, char *password); // Obtiene las credenciales de WiFi del almacenamiento no volátil
 
-// Paginas web
-extern const uint8_t main_html_start[] asm("_binary_main_html_start");
-extern const uint8_t main_html_end[] asm("_binary_main_html_end");
+// MARK: CALLBACKS ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+static void settings_changed_cb(const settings_t *settings, uint32_t changed, void *arg)
+{
+    if ((changed & SETTINGS_STA_NETWORKS) && esp_netif_sta != NULL)
+    {
+        // El historial de la lista anterior no vale; la red en uso conserva su puesto si sigue en la lista
+        int current = settings_find_network(settings->networks, settings->network_count, sta_ssid);
+        portENTER_CRITICAL(&uplink_lock);
+        uplink_policy_reset(&uplink_policy, settings->network_count, current);
+        portEXIT_CRITICAL(&uplink_lock);
 
-// Imagenes e iconos
-extern const uint8_t router_ico_start[] asm("_binary_router_ico_start");
-extern const uint8_t router_ico_end[] asm("_binary_router_ico_end");
+        // Solo se reconecta si la red en uso ya no es la preferida o ha cambiado su contraseña
+        wifi_config_t wifi_config;
+        ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
+        bool connected = xEventGroupGetBits(router_events) & ROUTER_STA_BIT;
+        if (!connected || current != 0 || strncmp((char *)wifi_config.sta.password, settings->networks[0].password, sizeof(wifi_config.sta.password)) != 0)
+        {
+            ESP_LOGI(TAG_STA, "Nuevas redes de subida. Reiniciando conexión STA...");
+            sta_policy_reset(&sta_policy);
+            esp_wifi_disconnect();
+
+            // Esperando un reintento no hay nada que desconectar: se adelanta con la espera ya reiniciada en lugar
+            // de agotar la espera larga que dejaron los fallos con las credenciales anteriores
+            if (esp_timer_is_active(reconnect_timer))
+            {
+                wifi_reconnect();
+            }
+        }
+    }
+}
 
-// MARK: CALLBACKS ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 static void reconnect_cb(void *arg)
 {
-    esp_err_t err = esp_wifi_connect();
-    if (err != ESP_OK)
+    sta_connect();
+}
+
+static void uplink_scan_cb(void *arg)
+{
+    start_uplink_scan();
+}
+
+static void led_cb(void *arg)
+{
+    // Solo corre sin conexión; si se acaba de conectar, led_update ya lo está parando
+    if (!(xEventGroupGetBits(router_events) & ROUTER_WAN_BITS))
     {
-        ESP_LOGE(TAG_TIMER, "Error al conectar al WiFi. Error %s", esp_err_to_name(err));
+        toggle_pin(&build_led);
     }
 }
 
+#if IP_NAPT
+static void stats_cb(void *arg)
+{
+    forwarding_stats_t stats;
+    forwarding_get_stats(&stats);
+    uint64_t m[METRIC_COUNT];
+    metrics_snapshot(m);
+
+    uint32_t cycles_per_packet = m[METRIC_UP_FAST_PACKETS] ? (uint32_t)(m[METRIC_FAST_CYCLES] / m[METRIC_UP_FAST_PACKETS]) : 0;
+    ESP_LOGI(TAG_TIMER, "Reenvío AP->STA. Ruta rápida: %llu paquetes, %llu bytes, %lu ciclos/paquete. Ruta lenta: %llu paquetes, %llu bytes. Flujos: %lu/%lu",
+             m[METRIC_UP_FAST_PACKETS], m[METRIC_UP_FAST_BYTES], cycles_per_packet, m[METRIC_UP_SLOW_PACKETS], m[METRIC_UP_SLOW_BYTES], stats.flows, stats.capacity);
+}
+#endif
+
 // MARK: EVENTOS -----------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t event_id, void *event_data)
 {
@@ -135,23 +238,33 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
         }
         case WIFI_EVENT_AP_START:
             ESP_LOGI(TAG_AP, "Punto de acceso WiFi iniciado");
+            if (IPV6_RELAY_ENABLED)
+            {
+                // Origen de los RA retransmitidos y router por defecto IPv6 de los clientes
+                ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_create_ip6_linklocal(esp_netif_ap));
+            }
             break;
         case WIFI_EVENT_AP_PROBEREQRECVED:
         {
             wifi_event_ap_probe_req_rx_t *event = (wifi_event_ap_probe_req_rx_t *)event_data;
-            ESP_LOGI(TAG_AP, "Solicitud de sondeo recibida. MAC: " MACSTR ", RSSI: %d", MAC2STR(event->mac), event->rssi);
+            event_log_record(LOG_EV_AP_PROBE_REQ, event->mac, event->rssi, 0);
             break;
         }
         case WIFI_EVENT_AP_STACONNECTED:
         {
             wifi_event_ap_staconnected_t *event = (wifi_event_ap_staconnected_t *)event_data;
-            ESP_LOGI(TAG_AP, "Cliente conectado al ESP. MAC: " MACSTR ", AID: %d", MAC2STR(event->mac), event->aid);
+            event_log_record(LOG_EV_AP_STA_CONNECTED, event->mac, event->aid, 0);
+            clients_connected(event->mac, event->aid);
+            status_event(STATUS_EV_CLIENT_JOINED, event->mac, event->aid);
             break;
         }
         case WIFI_EVENT_AP_STADISCONNECTED:
         {
             wifi_event_ap_stadisconnected_t *event = (wifi_event_ap_stadisconnected_t *)event_data;
-            ESP_LOGI(TAG_AP, "Cliente desconectado del ESP. MAC: " MACSTR ", AID: %d, Razon: %d", MAC2STR(event->mac), event->aid, event->reason);
+            event_log_record(LOG_EV_AP_STA_DISCONNECTED, event->mac, event->aid, event->reason);
+            shaper_station_remove(event->mac);
+            clients_disconnected(event->mac);
+            status_event(STATUS_EV_CLIENT_LEFT, event->mac, event->reason);
             break;
         }
         case WIFI_EVENT_AP_STOP:
@@ -159,24 +272,40 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
             break;
         case WIFI_EVENT_STA_START:
             ESP_LOGI(TAG_STA, "Cliente WiFi iniciado, conectando a la red...");
-            esp_err_t err = esp_wifi_connect();
-            if (err != ESP_OK)
-            {
-                ESP_LOGE(TAG_STA, "Error al conectar al WiFi. Error %s", esp_err_to_name(err));
-            }
+            sta_policy_link_lost(&sta_policy, esp_timer_get_time());
+            sta_connect();
             break;
         case WIFI_EVENT_STA_CONNECTED:
         {
             wifi_event_sta_connected_t *event = (wifi_event_sta_connected_t *)event_data;
             ESP_LOGI(TAG_STA, "Conectado a la red. MAC: " MACSTR ", AID: %d", MAC2STR(event->bssid), event->aid);
-            esp_connected = 1;
+            xEventGroupSetBits(router_events, ROUTER_STA_BIT);
+            led_update();
+            status_event(STATUS_EV_STA_CONNECTED, NULL, 0);
+            if (IPV6_RELAY_ENABLED)
+            {
+                ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_create_ip6_linklocal(esp_netif_sta));
+            }
             break;
         }
         case WIFI_EVENT_STA_DISCONNECTED:
         {
             wifi_event_sta_disconnected_t *event = (wifi_event_sta_disconnected_t *)event_data;
             ESP_LOGW(TAG_STA, "Desconectado de la red o fallo en conexión. MAC: " MACSTR ", Razon: %d", MAC2STR(event->bssid), event->reason);
-            esp_connected = 0;
+            xEventGroupClearBits(router_events, ROUTER_STA_BIT | ROUTER_STA_IP_BIT);
+            led_update();
+            sta_policy_link_lost(&sta_policy, esp_timer_get_time());
+            status_event(STATUS_EV_STA_DISCONNECTED, NULL, event->reason);
+            wan_update(NULL); // Si la STA era la WAN y hay Ethernet con IP, pasa a Ethernet sin esperar a perder la IP
+
+            // La red perdida (o el intento fallido) se penaliza para que el siguiente intento vaya a la mejor alternativa
+            portENTER_CRITICAL(&uplink_lock);
+            uplink_policy_link_lost(&uplink_policy);
+            portEXIT_CRITICAL(&uplink_lock);
+            if (uplink_scan_pending)
+            {
+                esp_wifi_scan_stop();
+            }
 
             sta_disconnected_event_handler(event);
             break;
@@ -184,6 +313,16 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
         case WIFI_EVENT_STA_BEACON_TIMEOUT:
             ESP_LOGW(TAG_STA, "Tiempo de espera de beacon agotado");
             break;
+        case WIFI_EVENT_SCAN_DONE:
+            if (authmode_scan_pending)
+            {
+                authmode_scan_done();
+            }
+            else if (uplink_scan_pending)
+            {
+                uplink_scan_done();
+            }
+            break;
         case WIFI_EVENT_STA_STOP:
             ESP_LOGI(TAG_STA, "Cliente WiFi detenido");
             break;
@@ -192,6 +331,19 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
             break;
         }
     }
+#if ETHERNET_ENABLED
+    else if (event_base == ETH_EVENT && event_id == ETHERNET_EVENT_DISCONNECTED)
+    {
+        // Sin cable la IP no vale aunque DHCP aún no la haya dado por perdida
+        xEventGroupClearBits(router_events, ROUTER_ETH_IP_BIT);
+        led_update();
+        wan_update(NULL);
+    }
+    else if (event_base == ETH_EVENT && event_id == ETHERNET_EVENT_CONNECTED && IPV6_RELAY_ENABLED)
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_create_ip6_linklocal(esp_netif_eth));
+    }
+#endif
     else if (event_base == IP_EVENT)
     {
         switch (event_id)
@@ -200,38 +352,79 @@ static void wifi_event_handler(void *arg, esp_event_base_t event_base, int32_t e
         {
             ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
             ESP_LOGI(TAG_STA, "Dirección IP asignada. IP: " IPSTR ", Máscara: " IPSTR ", Gateway: " IPSTR, IP2STR(&event->ip_info.ip), IP2STR(&event->ip_info.netmask), IP2STR(&event->ip_info.gw));
+            status_event(STATUS_EV_STA_GOT_IP, NULL, (int32_t)event->ip_info.ip.addr);
 
-            esp_err_t err = esp_netif_set_default_netif(esp_netif_sta);
-            if (err != ESP_OK)
+            bool targeted = sta_policy.targeted;
+            uint32_t outage_ms, attempt_ms;
+            sta_policy_got_ip(&sta_policy, esp_timer_get_time(), &outage_ms, &attempt_ms);
+            if (outage_ms != 0)
+            {
+                metrics_set_time_to_ip(outage_ms);
+            }
+            if (attempt_ms != 0)
             {
-                ESP_LOGE(TAG_WIFI, "Error al establecer la interfaz de red por defecto. Error %s", esp_err_to_name(err));
+                metrics_set_attempt_to_ip(attempt_ms, targeted);
             }
 
-#if IP_NAPT
-            err = esp_netif_napt_enable(esp_netif_ap);
-            if (err != ESP_OK)
+            // Tiempo sin servicio de un cambio de red: desde la pérdida de la anterior hasta tener IP en la nueva
+            portENTER_CRITICAL(&uplink_lock);
+            uplink_switch_t uplink_switch = uplink_policy_got_ip(&uplink_policy);
+            portEXIT_CRITICAL(&uplink_lock);
+            if (uplink_switch != UPLINK_SWITCH_NONE)
             {
-                ESP_LOGE(TAG_WIFI, "Error al habilitar el NAT en la interfaz de red del punto de acceso. Error %s", esp_err_to_name(err));
+                ESP_LOGI(TAG_STA, "%s a %s: %lu ms sin servicio", uplink_switch == UPLINK_SWITCH_FAILBACK ? "Vuelta a la red preferida" : "Cambio de red", sta_ssid, outage_ms);
+                metrics_set_uplink_switch(outage_ms, uplink_switch == UPLINK_SWITCH_FAILBACK);
+            }
+
+            // Recuerda el AP para que la próxima conexión no tenga que escanear
+            wifi_ap_record_t ap_info;
+            if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK)
+            {
+                settings_set_sta_last_ap(sta_ssid, ap_info.bssid, ap_info.primary);
+                settings_set_sta_authmode(sta_ssid, ap_info.authmode);
             }
-#else
-            ESP_LOGW(TAG_WIFI, "El soporte NAPT no está habilitado en la configuración de lwIP");
-#endif
 
-            ap_set_dns_addr(esp_netif_ap, esp_netif_sta);
+            xEventGroupSetBits(router_events, ROUTER_STA_IP_BIT);
+            wan_update(esp_netif_sta);
             break;
         }
         case IP_EVENT_STA_LOST_IP:
             ESP_LOGW(TAG_STA, "Dirección IP perdida");
+            status_event(STATUS_EV_STA_LOST_IP, NULL, 0);
+            xEventGroupClearBits(router_events, ROUTER_STA_IP_BIT);
+            wan_lost(esp_netif_sta);
             break;
+#if ETHERNET_ENABLED
+        case IP_EVENT_ETH_GOT_IP:
+        {
+            ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
+            ESP_LOGI(TAG_WAN, "Ethernet con IP. IP: " IPSTR ", Máscara: " IPSTR ", Gateway: " IPSTR, IP2STR(&event->ip_info.ip), IP2STR(&event->ip_info.netmask), IP2STR(&event->ip_info.gw));
+            xEventGroupSetBits(router_events, ROUTER_ETH_IP_BIT);
+            led_update();
+            wan_update(esp_netif_eth);
+            break;
+        }
+        case IP_EVENT_ETH_LOST_IP:
+            ESP_LOGW(TAG_WAN, "Ethernet sin IP");
+            xEventGroupClearBits(router_events, ROUTER_ETH_IP_BIT);
+            led_update();
+            wan_lost(esp_netif_eth);
+            break;
+#endif
         case IP_EVENT_ASSIGNED_IP_TO_CLIENT:
         {
             ip_event_assigned_ip_to_client_t *event = (ip_event_assigned_ip_to_client_t *)event_data;
-            ESP_LOGI(TAG_AP, "Dirección IP asignada al cliente. IP: " IPSTR ", MAC: " MACSTR, IP2STR(&event->ip), MAC2STR(event->mac));
+            event_log_record(LOG_EV_AP_CLIENT_IP, event->mac, (int32_t)event->ip.addr, 0);
+            clients_set_ip(event->mac, event->ip.addr);
             break;
         }
         case IP_EVENT_GOT_IP6:
-            ESP_LOGI(TAG_STA, "Dirección IPv6 asignada (ignorada para NAT IPv4)");
+        {
+            // Solo de enlace local: los clientes usan el prefijo de la red de subida a través de ipv6_relay
+            ip_event_got_ip6_t *event = (ip_event_got_ip6_t *)event_data;
+            ESP_LOGI(TAG_WIFI, "Dirección IPv6 asignada en %s", esp_netif_get_desc(event->esp_netif));
             break;
+        }
         case IP_EVENT_NETIF_UP:
             ESP_LOGI(TAG_WIFI, "Interfaz de red levantada (Netif Up)");
             break;
@@ -250,14 +443,16 @@ static void sta_disconnected_event_handler(wifi_event_sta_disconnected_t *event)
     switch (event->reason)
     {
     case WIFI_REASON_NO_AP_FOUND_IN_AUTHMODE_THRESHOLD:
-        change_sta_authmode_threshold();
+    case WIFI_REASON_NO_AP_FOUND_W_COMPATIBLE_SECURITY:
+        ESP_LOGW(TAG_STA, "El AP no cumple el umbral de autenticación, escaneando para detectarla...");
+        start_authmode_scan();
         break;
     case WIFI_REASON_NO_AP_FOUND:
     case WIFI_REASON_4WAY_HANDSHAKE_TIMEOUT:
     case WIFI_REASON_CONNECTION_FAIL:
     case WIFI_REASON_STA_LEAVING:
-        ESP_LOGI(TAG_STA, "Desconexión local o red no encontrada, actualizando credenciales y reconectando...");
-        update_wifi_credentials();
+        ESP_LOGI(TAG_STA, "Desconexión local o red no encontrada, reconectando...");
+        wifi_reconnect();
         break;
     case WIFI_REASON_AUTH_EXPIRE:
         ESP_LOGW(TAG_STA, "La autenticación ha expirado");
@@ -286,60 +481,325 @@ static void sta_disconnected_event_handler(wifi_event_sta_disconnected_t *event)
     }
 }
 
-static void change_sta_authmode_threshold(void)
+static void start_authmode_scan(void)
 {
-    if (auth_mode_index < WIFI_AUTH_MAX)
+    wifi_config_t wifi_config;
+    ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
+
+    uint8_t ssid[sizeof(wifi_config.sta.ssid) + 1] = {0}; // El SSID de la configuración puede no terminar en nulo
+    memcpy(ssid, wifi_config.sta.ssid, sizeof(wifi_config.sta.ssid));
+
+    // Un único escaneo activo filtrado por el SSID configurado en todos los canales
+    wifi_scan_config_t scan_config = {
+        .ssid = ssid,
+        .channel = 0,
+        .show_hidden = true,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+    };
+
+    esp_err_t err = esp_wifi_scan_start(&scan_config, false);
+    if (err != ESP_OK)
     {
-        wifi_config_t wifi_config;
-        ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
+        ESP_LOGE(TAG_STA, "Error al iniciar el escaneo. Error %s", esp_err_to_name(err));
+        wifi_reconnect();
+        return;
+    }
+    authmode_scan_pending = true;
+}
 
-        wifi_config.sta.threshold.authmode = (wifi_auth_mode_t)auth_mode_index++;
-        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+static void authmode_scan_done(void)
+{
+    static wifi_ap_record_t records[WIFI_STA_SCAN_MAX_RECORDS]; // Fuera de la pila de la tarea de eventos
+    uint16_t count = WIFI_STA_SCAN_MAX_RECORDS;
+
+    authmode_scan_pending = false;
+    esp_err_t err = esp_wifi_scan_get_ap_records(&count, records);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_STA, "Error al leer los resultados del escaneo. Error %s", esp_err_to_name(err));
+        count = 0;
+    }
 
-        ESP_ERROR_CHECK(esp_wifi_disconnect());
-        ESP_ERROR_CHECK(esp_wifi_connect());
+    // Los resultados vienen ordenados por RSSI; el primero es el AP al que se conectará
+    if (count == 0)
+    {
+        ESP_LOGW(TAG_STA, "No se encontró el SSID configurado en el escaneo");
     }
     else
     {
-        ESP_LOGW(TAG_STA, "Todos los modos de autenticación han sido probados.");
-        auth_mode_index = 0; // Reiniciar el índice para futuros intentos
+        ESP_LOGI(TAG_STA, "Autenticación detectada: %d (BSSID " MACSTR ", canal %d, RSSI %d)", records[0].authmode, MAC2STR(records[0].bssid), records[0].primary, records[0].rssi);
+        settings_set_sta_authmode(sta_ssid, records[0].authmode);
+    }
+
+    wifi_reconnect();
+}
+
+static void apply_authmode(wifi_config_t *wifi_config, wifi_auth_mode_t authmode)
+{
+    // En los modos mixtos el umbral es el modo más débil que anuncia el AP
+    switch (authmode)
+    {
+    case WIFI_AUTH_WPA_WPA2_PSK:
+        wifi_config->sta.threshold.authmode = WIFI_AUTH_WPA_PSK;
+        break;
+    case WIFI_AUTH_WPA2_WPA3_PSK:
+        wifi_config->sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+        break;
+    default:
+        wifi_config->sta.threshold.authmode = authmode;
+        break;
+    }
+
+    // PMF se anuncia siempre y solo se exige en WPA3 (SAE), que no funciona sin él; en WPA2/WPA3 exigirlo dejaría
+    // fuera a los AP que lo ofrecen como opcional. El registro del escaneo no dice si el AP admite H2E (hash-to-element)
+    // o solo el bucle de SAE: con SAE se aceptan los dos métodos
+    bool sae = authmode == WIFI_AUTH_WPA3_PSK || authmode == WIFI_AUTH_WPA2_WPA3_PSK;
+    wifi_config->sta.pmf_cfg.capable = true;
+    wifi_config->sta.pmf_cfg.required = authmode == WIFI_AUTH_WPA3_PSK;
+    if (sae)
+    {
+        wifi_config->sta.sae_pwe_h2e = WPA3_SAE_PWE_BOTH;
     }
 }
 
-static void update_wifi_credentials(void)
+static void sta_connect(void)
 {
     wifi_config_t wifi_config;
     ESP_ERROR_CHECK(esp_wifi_get_config(WIFI_IF_STA, &wifi_config));
 
-    get_wifi_credentials(&ssid, &password);
-    if (ssid && password)
+    // Mejor red según el último escaneo, la preferencia y los fallos; su AP del escaneo o, si no, el último conocido
+    portENTER_CRITICAL(&uplink_lock);
+    int index = uplink_policy_select(&uplink_policy);
+    uplink_candidate_t candidate = index >= 0 ? uplink_policy.candidates[index] : (uplink_candidate_t){0};
+    portEXIT_CRITICAL(&uplink_lock);
+
+    // Solo la red elegida: la configuración completa no cabe holgada en la pila de la tarea de eventos
+    settings_network_t network;
+    const uint8_t *bssid = NULL;
+    uint8_t channel = 0;
+    uint8_t authmode = SETTINGS_AUTHMODE_UNKNOWN;
+    if (index >= 0 && settings_get_network(index, &network))
+    {
+        strncpy((char *)wifi_config.sta.ssid, network.ssid, sizeof(wifi_config.sta.ssid));
+        strncpy((char *)wifi_config.sta.password, network.password, sizeof(wifi_config.sta.password));
+        strcpy(sta_ssid, network.ssid);
+        bssid = candidate.channel != 0 ? candidate.bssid : network.bssid;
+        channel = candidate.channel != 0 ? candidate.channel : network.channel;
+        authmode = network.authmode;
+        ESP_LOGI(TAG_STA, "Conectando a %s (red %d de %d, RSSI %d)", network.ssid, index + 1, settings_network_count(), candidate.rssi);
+    }
+    else
+    {
+        memset(wifi_config.sta.ssid, 0, sizeof(wifi_config.sta.ssid));
+        memset(wifi_config.sta.password, 0, sizeof(wifi_config.sta.password));
+        strncpy((char *)wifi_config.sta.ssid, WIFI_STA_SSID_DEFAULT, sizeof(wifi_config.sta.ssid) - 1);
+        strncpy((char *)wifi_config.sta.password, WIFI_STA_PASS_DEFAULT, sizeof(wifi_config.sta.password) - 1);
+        sta_ssid[0] = '\0';
+    }
+
+    if (sta_policy_begin_attempt(&sta_policy, esp_timer_get_time(), channel != 0))
     {
-        strcpy((char *)wifi_config.sta.ssid, ssid);
-        strcpy((char *)wifi_config.sta.password, password);
-        ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+        wifi_config.sta.bssid_set = true;
+        memcpy(wifi_config.sta.bssid, bssid, sizeof(wifi_config.sta.bssid));
+        wifi_config.sta.channel = channel;
+        wifi_config.sta.scan_method = WIFI_FAST_SCAN;
     }
+    else
+    {
+        wifi_config.sta.bssid_set = false;
+        wifi_config.sta.channel = 0;
+        wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    }
+    if (authmode != SETTINGS_AUTHMODE_UNKNOWN)
+    {
+        apply_authmode(&wifi_config, (wifi_auth_mode_t)authmode);
+    }
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
 
-    wifi_reconnect();
+    esp_err_t err = esp_wifi_connect();
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_STA, "Error al conectar al WiFi. Error %s", esp_err_to_name(err));
+    }
 }
 
 static void wifi_reconnect(void)
 {
-    ESP_LOGI(TAG_WIFI, "Reconectando al WiFi...");
+    metrics_add(METRIC_RECONNECTS, 1);
+
+    uint32_t delay_ms = sta_policy_next_delay(&sta_policy, esp_random());
+    ESP_LOGI(TAG_WIFI, "Reconectando al WiFi en %lu ms (intento %lu)...", delay_ms, sta_policy.failures);
+    status_event(STATUS_EV_STA_RECONNECT, NULL, delay_ms);
 
     // Detener el timer si ya está corriendo
     esp_timer_stop(reconnect_timer);
 
-    esp_err_t err = esp_timer_start_once(reconnect_timer, WIFI_STA_RECONNECT_TIMEOUT * 1000000);
+    esp_err_t err = esp_timer_start_once(reconnect_timer, delay_ms * 1000ULL);
     if (err != ESP_OK)
     {
         ESP_LOGE(TAG_TIMER, "Error al iniciar el timer. Error %s", esp_err_to_name(err));
     }
 }
 
-static void ap_set_dns_addr(esp_netif_t *esp_netif_ap, esp_netif_t *esp_netif_sta)
+static void start_uplink_scan(void)
 {
+    // Solo con conexión y con alternativas; sin conexión ya escanean los intentos de conexión
+    if (!(xEventGroupGetBits(router_events) & ROUTER_STA_BIT) || settings_network_count() < 2 || authmode_scan_pending || uplink_scan_pending)
+    {
+        return;
+    }
+
+    // Escaneo activo de todos los SSID con poco tiempo por canal y vueltas al canal propio, para que los
+    // clientes del AP (que comparte radio y canal con la STA) apenas lo noten
+    wifi_scan_config_t scan_config = {
+        .ssid = NULL,
+        .channel = 0,
+        .show_hidden = false,
+        .scan_type = WIFI_SCAN_TYPE_ACTIVE,
+        .scan_time.active = {.min = 0, .max = WIFI_STA_UPLINK_SCAN_DWELL_MS},
+        .home_chan_dwell_time = WIFI_STA_UPLINK_SCAN_HOME_MS,
+    };
+
+    esp_err_t err = esp_wifi_scan_start(&scan_config, false);
+    if (err != ESP_OK)
+    {
+        ESP_LOGW(TAG_STA, "Error al iniciar el escaneo de redes de subida. Error %s", esp_err_to_name(err));
+        return;
+    }
+    uplink_scan_pending = true;
+}
+
+static void uplink_scan_done(void)
+{
+    static wifi_ap_record_t records[WIFI_STA_UPLINK_SCAN_MAX_RECORDS]; // Fuera de la pila de la tarea de eventos
+    uint16_t count = WIFI_STA_UPLINK_SCAN_MAX_RECORDS;
+
+    uplink_scan_pending = false;
+    esp_err_t err = esp_wifi_scan_get_ap_records(&count, records);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_STA, "Error al leer los resultados del escaneo. Error %s", esp_err_to_name(err));
+        return;
+    }
+
+    // Red de la lista de cada resultado, antes de tomar uplink_lock
+    static int8_t networks[WIFI_STA_UPLINK_SCAN_MAX_RECORDS];
+    for (int i = 0; i < count; i++)
+    {
+        networks[i] = settings_network_index((const char *)records[i].ssid);
+    }
+    bool connected = xEventGroupGetBits(router_events) & ROUTER_STA_BIT;
+
+    portENTER_CRITICAL(&uplink_lock);
+    uplink_policy_scan_begin(&uplink_policy);
+    for (int i = 0; i < count; i++)
+    {
+        if (networks[i] >= 0)
+        {
+            uplink_policy_scan_seen(&uplink_policy, networks[i], records[i].rssi, records[i].bssid, records[i].primary);
+        }
+    }
+    int target = uplink_policy_scan_end(&uplink_policy, connected);
+    if (target >= 0)
+    {
+        uplink_policy_failback(&uplink_policy, target);
+    }
+    portEXIT_CRITICAL(&uplink_lock);
+
+    if (target >= 0)
+    {
+        settings_network_t network = {0};
+        settings_get_network(target, &network);
+
+        // El siguiente intento, tras la desconexión, va directo a la red preferida
+        ESP_LOGI(TAG_STA, "La red preferida %s ha vuelto, cambiando de red...", network.ssid);
+        sta_policy_reset(&sta_policy);
+        esp_wifi_disconnect();
+    }
+}
+
+static void wan_update(esp_netif_t *renewed)
+{
+    EventBits_t bits = xEventGroupGetBits(router_events);
+    bool eth_ready = bits & ROUTER_ETH_IP_BIT;
+    bool sta_ready = bits & ROUTER_STA_IP_BIT;
+
+    esp_netif_t *wan = NULL;
+    if (eth_ready && (ETHERNET_PREFERRED || !sta_ready))
+    {
+        wan = esp_netif_eth;
+    }
+    else if (sta_ready)
+    {
+        wan = esp_netif_sta;
+    }
+
+    // Sin alternativa se mantiene la WAN actual hasta que pierda la IP (una reconexión rápida conserva los flujos);
+    // la misma WAN se vuelve a configurar si ha renovado la IP, que puede haber cambiado
+    if (wan == NULL || (wan == wan_netif && wan != renewed))
+    {
+        return;
+    }
+
+    esp_netif_ip_info_t ip_info;
+    ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_get_ip_info(wan, &ip_info));
+    if (wan != wan_netif)
+    {
+        ESP_LOGI(TAG_WAN, "WAN por defecto: %s (" IPSTR ")", wan == esp_netif_eth ? "Ethernet" : "STA", IP2STR(&ip_info.ip));
+    }
+    wan_netif = wan;
+
+    esp_err_t err = esp_netif_set_default_netif(wan);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_WAN, "Error al establecer la interfaz de red por defecto. Error %s", esp_err_to_name(err));
+    }
+
+#if IP_NAPT
+    err = esp_netif_napt_enable(esp_netif_ap);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_WAN, "Error al habilitar el NAT en la interfaz de red del punto de acceso. Error %s", esp_err_to_name(err));
+    }
+
+    err = forwarding_start(esp_netif_ap, wan);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_WAN, "Error al iniciar la tabla de conexiones NAPT. Error %s", esp_err_to_name(err));
+    }
+#else
+    ESP_LOGW(TAG_WAN, "El soporte NAPT no está habilitado en la configuración de lwIP");
+#endif
+
+    ap_set_dns_addr(esp_netif_ap, wan);
+    portmap_apply(ip_info.ip.addr); // Las redirecciones siguen a la IP de la WAN
+}
+
+static void wan_lost(esp_netif_t *netif)
+{
+    if (netif == wan_netif)
+    {
+        wan_netif = NULL;
+        portmap_apply(0);
+#if IP_NAPT
+        forwarding_reset();
+#endif
+    }
+    wan_update(NULL);
+}
+
+static void ap_set_dns_addr(esp_netif_t *esp_netif_ap, esp_netif_t *esp_netif_wan)
+{
+    // El reenviador consulta al DNS de la WAN y los clientes del AP usan el propio router
     esp_netif_dns_info_t dns;
-    esp_netif_get_dns_info(esp_netif_sta, ESP_NETIF_DNS_MAIN, &dns);
+    esp_netif_get_dns_info(esp_netif_wan, ESP_NETIF_DNS_MAIN, &dns);
+    dns_forwarder_set_upstream(dns.ip.u_addr.ip4.addr);
+
+    esp_netif_ip_info_t ap_ip;
+    ESP_ERROR_CHECK(esp_netif_get_ip_info(esp_netif_ap, &ap_ip));
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    dns.ip.u_addr.ip4 = ap_ip.ip;
+
     uint8_t dhcps_offer_option = 0x02;
     ESP_ERROR_CHECK_WITHOUT_ABORT(esp_netif_dhcps_stop(esp_netif_ap));
     ESP_ERROR_CHECK(esp_netif_dhcps_option(esp_netif_ap, ESP_NETIF_OP_SET, ESP_NETIF_DOMAIN_NAME_SERVER, &dhcps_offer_option, sizeof(dhcps_offer_option)));
@@ -362,22 +822,28 @@ static void http_event_handler(void *arg, esp_event_base_t event_base, int32_t e
             ESP_LOGI(TAG_HTTP, "Servidor web iniciado");
             break;
         case HTTP_SERVER_EVENT_ON_CONNECTED:
-            ESP_LOGI(TAG_HTTP, "Cliente conectado al servidor web");
+            event_log_record(LOG_EV_HTTP_CONNECTED, NULL, *(int *)event_data, 0);
             break;
         case HTTP_SERVER_EVENT_ON_HEADER:
-            ESP_LOGI(TAG_HTTP, "Cabecera recibida");
+            event_log_record(LOG_EV_HTTP_HEADER, NULL, *(int *)event_data, 0);
             break;
         case HTTP_SERVER_EVENT_HEADERS_SENT:
-            ESP_LOGI(TAG_HTTP, "Cabeceras enviadas");
+            event_log_record(LOG_EV_HTTP_HEADERS_SENT, NULL, *(int *)event_data, 0);
             break;
         case HTTP_SERVER_EVENT_ON_DATA:
-            ESP_LOGI(TAG_HTTP, "Datos recibidos");
+        {
+            esp_http_server_event_data *event = (esp_http_server_event_data *)event_data;
+            event_log_record(LOG_EV_HTTP_DATA, NULL, event->fd, event->data_len);
             break;
+        }
         case HTTP_SERVER_EVENT_SENT_DATA:
-            ESP_LOGI(TAG_HTTP, "Datos enviados");
+        {
+            esp_http_server_event_data *event = (esp_http_server_event_data *)event_data;
+            event_log_record(LOG_EV_HTTP_SENT, NULL, event->fd, event->data_len);
             break;
+        }
         case HTTP_SERVER_EVENT_DISCONNECTED:
-            ESP_LOGI(TAG_HTTP, "Cliente desconectado del servidor web");
+            event_log_record(LOG_EV_HTTP_DISCONNECTED, NULL, *(int *)event_data, 0);
             break;
         case HTTP_SERVER_EVENT_STOP:
             ESP_LOGW(TAG_HTTP, "Servidor web detenido");
@@ -392,39 +858,50 @@ static void http_event_handler(void *arg, esp_event_base_t event_base, int32_t e
 // MARK: MAIN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
 void app_main(void)
 {
-    // Configura los pines GPIO
-    digital_pin build_led = {BUILD_LED, GPIO_MODE_OUTPUT, 1};
+    // Las pools de bloques fijos tienen que estar listas antes de la primera reserva
+    pool_init();
+
+    // Configura los pines GPIO y el LED, que parpadea hasta conectar con la red de subida
+    router_events = xEventGroupCreate();
     configure_digital_pin(&build_led);
+    configure_timer("led_timer", &led_timer, led_cb);
+    led_update();
+
+    // Inicia las métricas y el registro diferido de eventos
+    ESP_ERROR_CHECK_WITHOUT_ABORT(metrics_init());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(event_log_start());
 
     // Inicia el timer
     configure_timer("reconnect_timer", &reconnect_timer, reconnect_cb);
+    configure_timer("uplink_scan_timer", &uplink_scan_timer, uplink_scan_cb);
+#if IP_NAPT
+    configure_timer("stats_timer", &stats_timer, stats_cb);
+    esp_timer_start_periodic(stats_timer, FORWARDING_STATS_INTERVAL * 1000000ULL);
+#endif
 
     // Inicia el almacenamiento no volátil
     nvs_start();
+    ESP_ERROR_CHECK_WITHOUT_ABORT(settings_init());
 
     // Inicia el WiFi
     wifi_start();
-
-    // Inicia el servidor HTTP
+    ESP_ERROR_CHECK(settings_subscribe(settings_changed_cb, NULL));
+    esp_timer_start_periodic(uplink_scan_timer, WIFI_STA_UPLINK_SCAN_INTERVAL_S * 1000000ULL);
+    ESP_ERROR_CHECK_WITHOUT_ABORT(portmap_start(esp_netif_ap));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(pmtu_start());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(selftest_start(esp_netif_ap, esp_netif_sta, esp_netif_eth));
+
+    // Inicia el reenviador DNS en la IP del punto de acceso, con la lista de bloqueo guardada
+    ESP_ERROR_CHECK_WITHOUT_ABORT(blocklist_start());
+    ESP_ERROR_CHECK_WITHOUT_ABORT(dns_forwarder_start(inet_addr(WIFI_AP_IP)));
+
+    // Inicia el servidor HTTP; las rutas de administración solo se aceptan desde el punto de acceso
+    admin_start(esp_netif_ap);
     configure_http_server();
+    ESP_ERROR_CHECK_WITHOUT_ABORT(status_start(server_handle, esp_netif_sta));
+    ESP_ERROR_CHECK_WITHOUT_ABORT(ota_start(esp_netif_ap));
 
-    // Bucle principal
-    while (true)
-    {
-        if (esp_connected)
-        {
-            if (build_led.state == 1)
-            {
-                toggle_pin(&build_led);
-            }
-            vTaskDelay(500 / portTICK_PERIOD_MS);
-        }
-        else
-        {
-            toggle_pin(&build_led);
-            vTaskDelay(500 / portTICK_PERIOD_MS);
-        }
-    }
+    // No hay bucle principal: el LED lo mueve led_timer y app_main puede terminar
 }
 
 // MARK: FUNCIONES -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
@@ -484,25 +961,37 @@ static void wifi_start(void)
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
 
-    // Registra el manejador de eventos de WiFi
+    // Registra el manejador de eventos de WiFi (y de la WAN por Ethernet, que se trata igual que la STA)
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
     ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
+#if ETHERNET_ENABLED
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(ETH_EVENT, ESP_EVENT_ANY_ID, &wifi_event_handler, NULL, NULL));
+#endif
 
     // Inicializa el controlador WiFi
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
-    // Configura el modo WiFi en modo AP-STA
-    ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_APSTA));
+    // Configura el modo WiFi en modo AP-STA, o solo AP si la WAN es únicamente Ethernet
+    ESP_ERROR_CHECK(esp_wifi_set_mode(ETHERNET_ONLY ? WIFI_MODE_AP : WIFI_MODE_APSTA));
 
     // Inicia el punto de acceso WiFi
     esp_netif_ap = wifi_ap_start();
 
     // Inicia el cliente STA
-    esp_netif_sta = wifi_sta_start();
+    if (!ETHERNET_ONLY)
+    {
+        esp_netif_sta = wifi_sta_start();
+    }
 
     // Inicia el controlador WiFi
     ESP_ERROR_CHECK(esp_wifi_start());
+
+    // Inicia la WAN por Ethernet, si está configurada
+    if (ETHERNET_ENABLED)
+    {
+        ESP_ERROR_CHECK_WITHOUT_ABORT(ethernet_start(&esp_netif_eth));
+    }
 }
 
 esp_netif_t *wifi_ap_start(void)
@@ -575,20 +1064,22 @@ esp_netif_t *wifi_sta_start(void)
             },
     };
 
-    // Obtiene las credenciales de WiFi del almacenamiento no volátil
-    get_wifi_credentials(&ssid, &password);
+    // Obtiene las credenciales de WiFi de la configuración
+    settings_t settings;
+    settings_get(&settings);
 
-    // Si no se encuentran credenciales, se usan las predeterminadas
-    if (ssid == NULL || password == NULL)
+    // Si no se encuentran credenciales, se usan las predeterminadas; con varias redes, sta_connect elige en cada intento
+    if (settings.network_count == 0)
     {
         strncpy((char *)wifi_config.sta.ssid, WIFI_STA_SSID_DEFAULT, sizeof(wifi_config.sta.ssid) - 1);
         strncpy((char *)wifi_config.sta.password, WIFI_STA_PASS_DEFAULT, sizeof(wifi_config.sta.password) - 1);
     }
     else
     {
-        strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
-        strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+        strncpy((char *)wifi_config.sta.ssid, settings.networks[0].ssid, sizeof(wifi_config.sta.ssid));
+        strncpy((char *)wifi_config.sta.password, settings.networks[0].password, sizeof(wifi_config.sta.password));
     }
+    uplink_policy_reset(&uplink_policy, settings.network_count, -1);
 
     ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
 
@@ -597,81 +1088,25 @@ esp_netif_t *wifi_sta_start(void)
     return esp_netif_sta;
 }
 
-static void get_wifi_credentials(char **ssid, char **password)
+static void led_update(void)
 {
-    nvs_handle_t nvs_handle_wifi;
-    esp_err_t err = nvs_open(WIFI_NAMESPACE, NVS_READWRITE, &nvs_handle_wifi);
-    if (err != ESP_OK)
+    if (xEventGroupGetBits(router_events) & ROUTER_WAN_BITS)
     {
-        ESP_LOGE(TAG_NVS, "Error al abrir el almacenamiento no volátil. Error %s", esp_err_to_name(err));
-        if (err == ESP_ERR_NVS_NOT_FOUND)
+        // Conectado: LED apagado y sin timer
+        esp_timer_stop(led_timer);
+        if (build_led.state == 1)
         {
-            ESP_LOGW(TAG_NVS, "Creando espacio de almacenamiento no volátil...");
-            err = nvs_flash_init_partition(WIFI_NAMESPACE);
-            if (err != ESP_OK)
-            {
-                ESP_LOGE(TAG_NVS, "Error al inicializar el espacio de almacenamiento no volátil. Error %s", esp_err_to_name(err));
-            }
-            else
-            {
-                ESP_LOGI(TAG_NVS, "Espacio de almacenamiento no volátil creado correctamente");
-                err = nvs_open(WIFI_NAMESPACE, NVS_READWRITE, &nvs_handle_wifi);
-                if (err != ESP_OK)
-                {
-                    ESP_LOGE(TAG_NVS, "Error al abrir el almacenamiento no volátil después de la creación. Error %s", esp_err_to_name(err));
-                }
-            }
+            toggle_pin(&build_led);
         }
     }
-
-    size_t ssid_len = 0;
-    err = nvs_get_str(nvs_handle_wifi, "ssid", NULL, &ssid_len);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND) // Si no se encuentra la clave, no se muestra el error
+    else if (!esp_timer_is_active(led_timer))
     {
-        ESP_LOGE(TAG_NVS, "Error al obtener la longitud del SSID del almacenamiento no volátil. Error %s", esp_err_to_name(err));
-    }
-
-    size_t password_len = 0;
-    err = nvs_get_str(nvs_handle_wifi, "password", NULL, &password_len);
-    if (err != ESP_OK && err != ESP_ERR_NVS_NOT_FOUND)
-    {
-        ESP_LOGE(TAG_NVS, "Error al obtener la longitud de la contraseña del almacenamiento no volátil. Error %s", esp_err_to_name(err));
-    }
-
-    if (ssid_len > 0 && password_len > 0)
-    {
-        if (*ssid)
-        {
-            free(*ssid);
-            *ssid = NULL;
-        }
-        if (*password)
-        {
-            free(*password);
-            *password = NULL;
-        }
-
-        *ssid = malloc(ssid_len);
-        *password = malloc(password_len);
-
-        err = nvs_get_str(nvs_handle_wifi, "ssid", *ssid, &ssid_len);
-        if (err != ESP_OK)
-        {
-            ESP_LOGE(TAG_NVS, "Error al obtener el SSID del almacenamiento no volátil. Error %s", esp_err_to_name(err));
-        }
-
-        err = nvs_get_str(nvs_handle_wifi, "password", *password, &password_len);
+        esp_err_t err = esp_timer_start_periodic(led_timer, LED_BLINK_MS * 1000ULL);
         if (err != ESP_OK)
         {
-            ESP_LOGE(TAG_NVS, "Error al obtener la contraseña del almacenamiento no volátil. Error %s", esp_err_to_name(err));
+            ESP_LOGE(TAG_TIMER, "Error al iniciar el timer del LED. Error %s", esp_err_to_name(err));
         }
     }
-    else
-    {
-        ESP_LOGW(TAG_NVS, "No se encontraron credenciales de WiFi en el almacenamiento no volátil");
-    }
-
-    nvs_close(nvs_handle_wifi);
 }
 
 static void toggle_pin(digital_pin *pin)
@@ -696,7 +1131,10 @@ static void toggle_pin(digital_pin *pin)
 static void configure_http_server(void)
 {
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
-    config.max_uri_handlers = 8;
+    config.max_uri_handlers = 30;
+    config.max_open_sockets = HTTP_MAX_SOCKETS; // Ver el presupuesto de sockets en sockets.h
+    config.core_id = CORE_CONTROL;  // Fuera del núcleo de la ruta de los paquetes
+    config.lru_purge_enable = true; // Las pestañas con estado en vivo mantienen su socket abierto y se reconectan si se cierra
 
     ESP_LOGI(TAG_HTTP, "Iniciando servidor web en puerto: %d", config.server_port);
 
@@ -706,31 +1144,215 @@ static void configure_http_server(void)
     // Inicia el servidor HTTP con las URL y manejadores de eventos
     if (httpd_start(&server_handle, &config) == ESP_OK)
     {
-        // Pagina principal
-        httpd_uri_t uri_main = {
+        // Pagina principal, favicon y demás recursos embebidos
+        web_assets_register(server_handle);
+
+        httpd_uri_t uri_post = {
             .uri = "/",
+            .method = HTTP_POST,
+            .handler = post_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_post);
+
+        // Redes de subida
+        httpd_uri_t uri_uplinks_get = {
+            .uri = "/uplinks",
             .method = HTTP_GET,
-            .handler = main_handler,
+            .handler = uplinks_get_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_uplinks_get);
+
+        httpd_uri_t uri_uplinks_post = {
+            .uri = "/uplinks",
+            .method = HTTP_POST,
+            .handler = uplinks_post_handler,
             .user_ctx = NULL,
         };
-        httpd_register_uri_handler(server_handle, &uri_main);
+        httpd_register_uri_handler(server_handle, &uri_uplinks_post);
 
-        // Favicon
-        httpd_uri_t uri_favicon = {
-            .uri = "/favicon.ico",
+        // Métricas en formato Prometheus
+        httpd_uri_t uri_metrics = {
+            .uri = "/metrics",
             .method = HTTP_GET,
-            .handler = favicon_handler,
+            .handler = metrics_handler,
             .user_ctx = NULL,
         };
-        httpd_register_uri_handler(server_handle, &uri_favicon);
+        httpd_register_uri_handler(server_handle, &uri_metrics);
 
-        httpd_uri_t uri_post = {
-            .uri = "/",
+        // Últimos eventos registrados
+        httpd_uri_t uri_log = {
+            .uri = "/log",
+            .method = HTTP_GET,
+            .handler = event_log_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_log);
+
+        // Límites de tráfico por cliente
+        httpd_uri_t uri_shaper_get = {
+            .uri = "/shaper",
+            .method = HTTP_GET,
+            .handler = shaper_get_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_shaper_get);
+
+        httpd_uri_t uri_shaper_post = {
+            .uri = "/shaper",
             .method = HTTP_POST,
-            .handler = post_handler,
+            .handler = shaper_post_handler,
             .user_ctx = NULL,
         };
-        httpd_register_uri_handler(server_handle, &uri_post);
+        httpd_register_uri_handler(server_handle, &uri_shaper_post);
+
+        // Redirección de puertos
+        httpd_uri_t uri_portmap_get = {
+            .uri = "/portmap",
+            .method = HTTP_GET,
+            .handler = portmap_get_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_portmap_get);
+
+        httpd_uri_t uri_portmap_post = {
+            .uri = "/portmap",
+            .method = HTTP_POST,
+            .handler = portmap_post_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_portmap_post);
+
+        // MTU de subida y ajuste del MSS
+        httpd_uri_t uri_mtu_get = {
+            .uri = "/mtu",
+            .method = HTTP_GET,
+            .handler = pmtu_get_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_mtu_get);
+
+        httpd_uri_t uri_mtu_post = {
+            .uri = "/mtu",
+            .method = HTTP_POST,
+            .handler = pmtu_post_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_mtu_post);
+
+        // Captura de paquetes
+        httpd_uri_t uri_capture_get = {
+            .uri = "/capture",
+            .method = HTTP_GET,
+            .handler = capture_get_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_capture_get);
+
+        httpd_uri_t uri_capture_post = {
+            .uri = "/capture",
+            .method = HTTP_POST,
+            .handler = capture_post_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_capture_post);
+
+        httpd_uri_t uri_capture_pcap = {
+            .uri = "/capture.pcap",
+            .method = HTTP_GET,
+            .handler = capture_pcap_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_capture_pcap);
+
+        // Clientes del punto de acceso
+        httpd_uri_t uri_clients = {
+            .uri = "/clients",
+            .method = HTTP_GET,
+            .handler = clients_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_clients);
+
+        // Memoria: heap y pools de bloques fijos
+        httpd_uri_t uri_heap = {
+            .uri = "/heap",
+            .method = HTTP_GET,
+            .handler = pool_heap_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_heap);
+
+        // Actualización del firmware
+        httpd_uri_t uri_ota_get = {
+            .uri = "/ota",
+            .method = HTTP_GET,
+            .handler = ota_get_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_ota_get);
+
+        httpd_uri_t uri_ota_post = {
+            .uri = "/ota",
+            .method = HTTP_POST,
+            .handler = ota_post_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_ota_post);
+
+        // Lista de bloqueo DNS
+        httpd_uri_t uri_blocklist_get = {
+            .uri = "/blocklist",
+            .method = HTTP_GET,
+            .handler = blocklist_get_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_blocklist_get);
+
+        httpd_uri_t uri_blocklist_post = {
+            .uri = "/blocklist",
+            .method = HTTP_POST,
+            .handler = blocklist_post_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_blocklist_post);
+
+        // Prueba de velocidad
+        httpd_uri_t uri_selftest_get = {
+            .uri = "/selftest",
+            .method = HTTP_GET,
+            .handler = selftest_get_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_selftest_get);
+
+        httpd_uri_t uri_selftest_post = {
+            .uri = "/selftest",
+            .method = HTTP_POST,
+            .handler = selftest_post_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_selftest_post);
+
+        // Tiempo de CPU de cada tarea
+        httpd_uri_t uri_tasks = {
+            .uri = "/tasks",
+            .method = HTTP_GET,
+            .handler = task_stats_handler,
+            .user_ctx = NULL,
+        };
+        httpd_register_uri_handler(server_handle, &uri_tasks);
+
+        // Estado en vivo
+        httpd_uri_t uri_ws = {
+            .uri = "/ws",
+            .method = HTTP_GET,
+            .handler = status_ws_handler,
+            .user_ctx = NULL,
+            .is_websocket = true,
+        };
+        httpd_register_uri_handler(server_handle, &uri_ws);
     }
     else
     {
@@ -738,130 +1360,157 @@ static void configure_http_server(void)
     }
 }
 
-static esp_err_t main_handler(httpd_req_t *req)
+static esp_err_t post_handler(httpd_req_t *req)
 {
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");         // No almacenar en caché
-    httpd_resp_set_hdr(req, "X-Content-Type-Options", "nosniff"); // No permitir la interpretación de MIME
-    httpd_resp_set_type(req, "text/html; charset=utf-8");         // Tipo de contenido
-    httpd_resp_send(req, (const char *)main_html_start, main_html_end - main_html_start);
-    return ESP_OK;
-}
+    // Los valores se decodifican directamente en estos buffers mientras se recibe el cuerpo
+    char ssid[33];
+    char password[65];
+    form_field_t fields[] = {
+        {.name = "ssid", .value = ssid, .size = sizeof(ssid)},
+        {.name = "password", .value = password, .size = sizeof(password)},
+    };
 
-static esp_err_t favicon_handler(httpd_req_t *req)
-{
-    httpd_resp_set_hdr(req, "Cache-Control", "max-age=31536000, immutable"); // Almacenar en caché por un año, no modificar
-    httpd_resp_set_hdr(req, "X-Content-Type-Options", "nosniff");
-    httpd_resp_set_type(req, "image/x-icon");
-    httpd_resp_send(req, (const char *)router_ico_start, router_ico_end - router_ico_start);
+    if (form_recv(req, fields, sizeof(fields) / sizeof(fields[0])) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    if (!fields[0].found || fields[0].len == 0 || fields[0].truncated || fields[1].truncated)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "SSID o contraseña no válidos");
+    }
+
+    ESP_LOGI(TAG_HTTP, "Credenciales recibidas. SSID: %s", ssid);
+
+    // La red pasa a ser la preferida; el cambio se aplica en settings_changed_cb y se guarda en segundo plano
+    esp_err_t err = settings_set_sta_credentials(ssid, password);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_HTTP, "Error al actualizar las credenciales. Error %s", esp_err_to_name(err));
+    }
+
+    // Redirige a la página principal, que el navegador revalida con su ETag sin volver a descargarla
+    httpd_resp_set_status(req, "303 See Other");
+    httpd_resp_set_hdr(req, "Location", "/");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_send(req, NULL, 0);
     return ESP_OK;
 }
 
-static esp_err_t post_handler(httpd_req_t *req)
+static esp_err_t uplinks_get_handler(httpd_req_t *req)
 {
-    char buf[256];
-    int ret, remaining = req->content_len;
+    uint8_t count = settings_network_count();
+    uplink_policy_t policy;
+    portENTER_CRITICAL(&uplink_lock);
+    policy = uplink_policy;
+    portEXIT_CRITICAL(&uplink_lock);
+    bool connected = xEventGroupGetBits(router_events) & ROUTER_STA_BIT;
+
+    char line[160];
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    esp_netif_t *wan = wan_netif;
+    snprintf(line, sizeof(line), "wan %s\nethernet %s\nethernet_role %s\n", wan == NULL ? "none" : (wan == esp_netif_eth ? "eth" : "sta"),
+             !ETHERNET_ENABLED ? "disabled" : (ethernet_link_up() ? "up" : "down"), !ETHERNET_ENABLED ? "-" : (ETHERNET_ONLY ? "only" : (ETHERNET_PREFERRED ? "primary" : "backup")));
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    snprintf(line, sizeof(line), "networks %u\nmax_networks %d\nscan_interval_s %d\n", count, SETTINGS_MAX_NETWORKS, WIFI_STA_UPLINK_SCAN_INTERVAL_S);
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
 
-    while (remaining > 0)
+    // Las contraseñas no se muestran
+    settings_network_t network;
+    for (int i = 0; i < count && i < policy.count && settings_get_network(i, &network); i++)
     {
-        if ((ret = httpd_req_recv(req, buf, MIN(remaining, sizeof(buf) - 1))) <= 0)
-        {
-            if (ret == HTTPD_SOCK_ERR_TIMEOUT)
-            {
-                httpd_resp_send_408(req);
-            }
-            return ESP_FAIL;
-        }
-        remaining -= ret;
-        buf[ret] = '\0'; // Asegurarse de que el buffer esté terminado con un carácter nulo
+        const uplink_candidate_t *candidate = &policy.candidates[i];
+        const char *state = i != policy.current ? "-" : (connected ? "connected" : "connecting");
+        snprintf(line, sizeof(line), "network %d ssid %s state %s rssi %d channel %u failures %u connects %lu score %d\n", i, network.ssid, state,
+                 candidate->channel ? candidate->rssi : 0, candidate->channel, candidate->failures, candidate->connects, uplink_policy_score(&policy, i));
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
     }
 
-    char decoded_buf[256];
-    url_decode(decoded_buf, buf);
-
-    printf("Datos recibidos: %s\n", decoded_buf);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
 
-    // Parsear los datos recibidos para extraer ssid y password
-    char ssid[32] = {0};
-    char password[64] = {0};
+// Campos: action (add, remove o prefer), ssid y password (al añadir). add pone la red al final de la lista
+// (o cambia su contraseña si ya estaba); prefer la pone al principio; POST / también la añade como preferida.
+// Solo desde el punto de acceso y con la contraseña de administración (admin.h)
+static esp_err_t uplinks_post_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, NULL))
+    {
+        return ESP_FAIL;
+    }
 
-    // ESP-IDF buscará las claves directamente en el string decodificado
-    httpd_query_key_value(decoded_buf, "ssid", ssid, sizeof(ssid));
-    httpd_query_key_value(decoded_buf, "password", password, sizeof(password));
+    char action[7];
+    char ssid[33];
+    char password[65];
+    form_field_t fields[] = {
+        {.name = "action", .value = action, .size = sizeof(action)},
+        {.name = "ssid", .value = ssid, .size = sizeof(ssid)},
+        {.name = "password", .value = password, .size = sizeof(password)},
+    };
 
-    // Guardar las credenciales de WiFi en la memoria no volátil
-    save_wifi_credentials(ssid, password);
+    if (form_recv(req, fields, sizeof(fields) / sizeof(fields[0])) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    if (fields[0].truncated || !fields[1].found || fields[1].len == 0 || fields[1].truncated || fields[2].truncated)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "SSID o contraseña no válidos");
+    }
 
-    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
-    httpd_resp_set_hdr(req, "X-Content-Type-Options", "nosniff");
-    httpd_resp_set_type(req, "text/html; charset=utf-8");
-    httpd_resp_send(req, (const char *)main_html_start, main_html_end - main_html_start);
-    ESP_LOGI(TAG_HTTP, "Nuevas credenciales guardadas. Reiniciando conexión STA...");
-    esp_wifi_disconnect();
-    return ESP_OK;
-}
+    settings_network_t networks[SETTINGS_MAX_NETWORKS];
+    uint8_t count = settings_get_networks(networks);
+    int index = settings_find_network(networks, count, ssid);
+    esp_err_t err;
 
-// Función para decodificar URL
-static void url_decode(char *dst, const char *src)
-{
-    char a, b;
-    while (*src)
+    if (strcmp(action, "add") == 0)
     {
-        if ((*src == '%') && ((a = src[1]) && (b = src[2])) && (isxdigit(a) && isxdigit(b)))
+        if (index < 0 && count == SETTINGS_MAX_NETWORKS)
         {
-            if (a >= 'a')
-                a -= 'a' - 'A';
-            if (a >= 'A')
-                a -= ('A' - 10);
-            else
-                a -= '0';
-            if (b >= 'a')
-                b -= 'a' - 'A';
-            if (b >= 'A')
-                b -= ('A' - 10);
-            else
-                b -= '0';
-            *dst++ = 16 * a + b;
-            src += 3;
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "La lista de redes está llena");
         }
-        else if (*src == '+')
+        if (index < 0)
         {
-            *dst++ = ' ';
-            src++;
+            index = count++;
+            memset(&networks[index], 0, sizeof(networks[index]));
+            strcpy(networks[index].ssid, ssid);
+            networks[index].authmode = SETTINGS_AUTHMODE_UNKNOWN;
         }
-        else
+        else if (strcmp(networks[index].password, password) != 0)
         {
-            *dst++ = *src++;
+            memset(networks[index].bssid, 0, sizeof(networks[index].bssid)); // Lo aprendido era con la contraseña anterior
+            networks[index].channel = 0;
+            networks[index].authmode = SETTINGS_AUTHMODE_UNKNOWN;
         }
+        memset(networks[index].password, 0, sizeof(networks[index].password));
+        strcpy(networks[index].password, password);
+        err = settings_set_sta_networks(networks, count);
     }
-    *dst = '\0';
-}
-
-static void save_wifi_credentials(char *ssid, char *password)
-{
-    nvs_handle_t nvs_handle_wifi;
-    esp_err_t err = nvs_open(WIFI_NAMESPACE, NVS_READWRITE, &nvs_handle_wifi);
-    if (err != ESP_OK)
-    {
-        ESP_LOGE(TAG_NVS, "Error al abrir el almacenamiento no volátil. Error %s", esp_err_to_name(err));
-    }
-
-    err = nvs_set_str(nvs_handle_wifi, "ssid", ssid);
-    if (err != ESP_OK)
+    else if (strcmp(action, "remove") == 0 || strcmp(action, "prefer") == 0)
     {
-        ESP_LOGE(TAG_NVS, "Error al guardar el SSID en el almacenamiento no volátil. Error %s", esp_err_to_name(err));
+        if (index < 0)
+        {
+            return httpd_resp_send_err(req, HTTPD_404_NOT_FOUND, "La red no está en la lista");
+        }
+        if (action[0] == 'p')
+        {
+            err = settings_set_sta_credentials(ssid, networks[index].password);
+        }
+        else
+        {
+            memmove(&networks[index], &networks[index + 1], (count - index - 1) * sizeof(networks[0]));
+            err = settings_set_sta_networks(networks, count - 1);
+        }
     }
-
-    err = nvs_set_str(nvs_handle_wifi, "password", password);
-    if (err != ESP_OK)
+    else
     {
-        ESP_LOGE(TAG_NVS, "Error al guardar la contraseña en el almacenamiento no volátil. Error %s", esp_err_to_name(err));
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Acción no válida");
     }
 
-    err = nvs_commit(nvs_handle_wifi);
     if (err != ESP_OK)
     {
-        ESP_LOGE(TAG_NVS, "Error al confirmar los cambios en el almacenamiento no volátil. Error %s", esp_err_to_name(err));
+        ESP_LOGE(TAG_HTTP, "Error al cambiar las redes de subida. Error %s", esp_err_to_name(err));
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Error al guardar las redes");
     }
-
-    nvs_close(nvs_handle_wifi);
-}
\ No newline at end of file
+    return uplinks_get_handler(req);
+}
@@ -0,0 +1,388 @@
+#include "metrics.h"
+#include "blocklist.h"
+#include "capture.h"
+#include "clients.h"
+#include "dns_forwarder.h"
+#include "ota.h"
+#include "pmtu.h"
+#include "pool.h"
+#include "portmap.h"
+#include "shaper.h"
+#include "task_stats.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "lwip/opt.h"
+#include "lwip/prot/ip4.h"
+#include <stdarg.h>
+#include <sys/param.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#if IP_NAPT
+#include "forwarding.h"
+#endif
+
+// Tags para logging
+static const char *TAG_METRICS = "METRICS";
+
+// Variables globales
+metrics_shard_t metrics_shards[portNUM_PROCESSORS];
+static uint32_t folded[portNUM_PROCESSORS][METRIC_COUNT]; // Último valor acumulado de cada copia
+static uint64_t totals[METRIC_COUNT];
+static portMUX_TYPE fold_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t fold_timer = NULL;
+static uint32_t time_to_ip_last_ms = 0;
+static uint32_t attempt_to_ip_last_ms = 0;
+static uint32_t uplink_switch_last_ms = 0;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Acumula las diferencias de 32 bits de cada núcleo en los totales (la resta sin signo absorbe el desbordamiento)
+static void fold(void)
+{
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        for (int id = 0; id < METRIC_COUNT; id++)
+        {
+            uint32_t value = __atomic_load_n(&metrics_shards[core].values[id], __ATOMIC_RELAXED);
+            totals[id] += (uint32_t)(value - folded[core][id]);
+            folded[core][id] = value;
+        }
+    }
+}
+
+static void fold_cb(void *arg)
+{
+    portENTER_CRITICAL(&fold_lock);
+    fold();
+    portEXIT_CRITICAL(&fold_lock);
+}
+
+// Envía una línea de texto como fragmento de la respuesta
+static esp_err_t send_line(httpd_req_t *req, const char *fmt, ...)
+{
+    char line[160];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    if (len < 0)
+    {
+        return ESP_FAIL;
+    }
+    return httpd_resp_send_chunk(req, line, MIN(len, (int)sizeof(line) - 1));
+}
+
+static esp_err_t send_header(httpd_req_t *req, const char *name, const char *type, const char *help)
+{
+    return send_line(req, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t metrics_init(void)
+{
+    esp_timer_create_args_t config = {
+        .callback = fold_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "metrics_timer",
+    };
+
+    esp_err_t err = esp_timer_create(&config, &fold_timer);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_METRICS, "Error al crear el timer de métricas. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    return esp_timer_start_periodic(fold_timer, METRICS_FOLD_INTERVAL_MS * 1000ULL);
+}
+
+void metrics_snapshot(uint64_t out[METRIC_COUNT])
+{
+    portENTER_CRITICAL(&fold_lock);
+    fold();
+    memcpy(out, totals, sizeof(totals));
+    portEXIT_CRITICAL(&fold_lock);
+}
+
+void metrics_set_time_to_ip(uint32_t ms)
+{
+    time_to_ip_last_ms = ms;
+    metrics_add(METRIC_TIME_TO_IP_MS_SUM, ms);
+    metrics_add(METRIC_TIME_TO_IP_COUNT, 1);
+}
+
+void metrics_set_attempt_to_ip(uint32_t ms, bool targeted)
+{
+    attempt_to_ip_last_ms = ms;
+    metrics_add(targeted ? METRIC_ATTEMPT_TARGETED_MS_SUM : METRIC_ATTEMPT_FULL_MS_SUM, ms);
+    metrics_add(targeted ? METRIC_ATTEMPT_TARGETED_COUNT : METRIC_ATTEMPT_FULL_COUNT, 1);
+}
+
+void metrics_set_uplink_switch(uint32_t ms, bool failback)
+{
+    uplink_switch_last_ms = ms;
+    metrics_add(failback ? METRIC_UPLINK_FAILBACK_MS_SUM : METRIC_UPLINK_FAILOVER_MS_SUM, ms);
+    metrics_add(failback ? METRIC_UPLINK_FAILBACKS : METRIC_UPLINK_FAILOVERS, 1);
+}
+
+esp_err_t metrics_handler(httpd_req_t *req)
+{
+    uint64_t m[METRIC_COUNT];
+    metrics_snapshot(m);
+
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    // Tráfico reenviado
+    send_header(req, "router_forwarded_packets_total", "counter", "Paquetes reenviados por sentido y ruta");
+    send_line(req, "router_forwarded_packets_total{direction=\"up\",path=\"fast\"} %llu\n", m[METRIC_UP_FAST_PACKETS]);
+    send_line(req, "router_forwarded_packets_total{direction=\"up\",path=\"slow\"} %llu\n", m[METRIC_UP_SLOW_PACKETS]);
+    send_line(req, "router_forwarded_packets_total{direction=\"down\",path=\"slow\"} %llu\n", m[METRIC_DOWN_PACKETS]);
+    send_line(req, "router_forwarded_packets_total{direction=\"up\",path=\"ipv6\"} %llu\n", m[METRIC_IPV6_UP_PACKETS]);
+    send_line(req, "router_forwarded_packets_total{direction=\"down\",path=\"ipv6\"} %llu\n", m[METRIC_IPV6_DOWN_PACKETS]);
+    send_header(req, "router_forwarded_bytes_total", "counter", "Bytes reenviados por sentido y ruta");
+    send_line(req, "router_forwarded_bytes_total{direction=\"up\",path=\"fast\"} %llu\n", m[METRIC_UP_FAST_BYTES]);
+    send_line(req, "router_forwarded_bytes_total{direction=\"up\",path=\"slow\"} %llu\n", m[METRIC_UP_SLOW_BYTES]);
+    send_line(req, "router_forwarded_bytes_total{direction=\"down\",path=\"slow\"} %llu\n", m[METRIC_DOWN_BYTES]);
+    send_line(req, "router_forwarded_bytes_total{direction=\"up\",path=\"ipv6\"} %llu\n", m[METRIC_IPV6_UP_BYTES]);
+    send_line(req, "router_forwarded_bytes_total{direction=\"down\",path=\"ipv6\"} %llu\n", m[METRIC_IPV6_DOWN_BYTES]);
+
+    // Parte del tráfico reenviado que no pasa por el NAPT (IPv6 sin traducción)
+    uint64_t ipv6_bytes = m[METRIC_IPV6_UP_BYTES] + m[METRIC_IPV6_DOWN_BYTES];
+    uint64_t forwarded_bytes = ipv6_bytes + m[METRIC_UP_FAST_BYTES] + m[METRIC_UP_SLOW_BYTES] + m[METRIC_DOWN_BYTES];
+    uint32_t bypass_permille = forwarded_bytes ? (uint32_t)(ipv6_bytes * 1000 / forwarded_bytes) : 0;
+    send_header(req, "router_napt_bypass_ratio", "gauge", "Fracción de los bytes reenviados desde el arranque que evitan el NAPT");
+    send_line(req, "router_napt_bypass_ratio %lu.%03lu\n", bypass_permille / 1000, bypass_permille % 1000);
+    send_header(req, "router_ipv6_ndp_proxied_total", "counter", "NA enviados en la WAN en nombre de los clientes del AP");
+    send_line(req, "router_ipv6_ndp_proxied_total %llu\n", m[METRIC_IPV6_NDP_PROXIED]);
+    send_header(req, "router_ipv6_ra_relayed_total", "counter", "RA de la red de subida retransmitidos en el AP");
+    send_line(req, "router_ipv6_ra_relayed_total %llu\n", m[METRIC_IPV6_RA_RELAYED]);
+    send_header(req, "router_fast_path_cycles_total", "counter", "Ciclos de CPU consumidos por la ruta rápida");
+    send_line(req, "router_fast_path_cycles_total %llu\n", m[METRIC_FAST_CYCLES]);
+
+    // Descartes
+    send_header(req, "router_drops_total", "counter", "Paquetes descartados por motivo");
+    send_line(req, "router_drops_total{reason=\"tcpip_queue\"} %llu\n", m[METRIC_DROP_AP_INPUT]);
+    send_line(req, "router_drops_total{reason=\"sta_tx\"} %llu\n", m[METRIC_DROP_STA_TX]);
+    send_line(req, "router_drops_total{reason=\"ap_tx\"} %llu\n", m[METRIC_DROP_AP_TX]);
+    send_line(req, "router_drops_total{reason=\"ipv6\"} %llu\n", m[METRIC_IPV6_DROPPED]);
+
+    // MTU de subida
+    pmtu_state_t pmtu;
+    pmtu_get_state(&pmtu);
+    send_header(req, "router_path_mtu_bytes", "gauge", "MTU aplicada a la ruta de subida (destinos sin MTU aprendida)");
+    send_line(req, "router_path_mtu_bytes %u\n", pmtu.effective);
+    send_header(req, "router_mss_clamped_total", "counter", "SYN con la opción MSS reducida a la MTU de subida");
+    send_line(req, "router_mss_clamped_total %llu\n", m[METRIC_MSS_CLAMPED]);
+    send_header(req, "router_fragments_total", "counter", "Fragmentos IPv4 en la STA por sentido");
+    send_line(req, "router_fragments_total{direction=\"in\"} %llu\n", m[METRIC_FRAGMENTS_IN]);
+    send_line(req, "router_fragments_total{direction=\"out\"} %llu\n", m[METRIC_FRAGMENTS_OUT]);
+    send_header(req, "router_last_fragments_total", "counter", "Últimos fragmentos IPv4 recibidos por la STA (fragmentos con MF a 0)");
+    send_line(req, "router_last_fragments_total %llu\n", m[METRIC_LAST_FRAGMENTS]);
+    send_header(req, "router_pmtu_icmp_total", "counter", "ICMP fragmentation needed recibidos en la STA");
+    send_line(req, "router_pmtu_icmp_total %llu\n", m[METRIC_PMTU_ICMP]);
+    send_header(req, "router_pmtu_icmp_ignored_total", "counter", "ICMP fragmentation needed que no citan una conexión TCP traducida viva");
+    send_line(req, "router_pmtu_icmp_ignored_total %llu\n", m[METRIC_PMTU_ICMP_IGNORED]);
+    send_header(req, "router_pmtu_destinations", "gauge", "Destinos con una MTU menor aprendida por ICMP");
+    send_line(req, "router_pmtu_destinations %lu\n", pmtu.destinations);
+
+#if IP_NAPT
+    // Tabla NAPT
+    forwarding_stats_t fwd;
+    forwarding_get_stats(&fwd);
+    send_header(req, "router_napt_flows", "gauge", "Flujos en la tabla de conexiones NAPT");
+    send_line(req, "router_napt_flows %lu\n", fwd.flows);
+    send_header(req, "router_napt_capacity", "gauge", "Capacidad de la tabla de conexiones NAPT");
+    send_line(req, "router_napt_capacity %lu\n", fwd.capacity);
+    send_header(req, "router_napt_remapped_total", "counter", "Traducciones sustituidas porque lwIP cambió el puerto de un flujo");
+    send_line(req, "router_napt_remapped_total %lu\n", fwd.remapped);
+    send_header(req, "router_napt_expired_total", "counter", "Flujos expirados");
+    send_line(req, "router_napt_expired_total %lu\n", fwd.expired);
+    send_header(req, "router_napt_rejected_total", "counter", "Flujos no registrados por tabla llena");
+    send_line(req, "router_napt_rejected_total %lu\n", fwd.rejected);
+#endif
+
+    // Reenviador DNS
+    dns_forwarder_stats_t dns;
+    dns_forwarder_get_stats(&dns);
+    send_header(req, "router_dns_queries_total", "counter", "Consultas DNS recibidas de los clientes por resultado");
+    send_line(req, "router_dns_queries_total{result=\"hit\"} %lu\n", dns.hits);
+    send_line(req, "router_dns_queries_total{result=\"miss\"} %lu\n", dns.misses);
+    send_line(req, "router_dns_queries_total{result=\"coalesced\"} %lu\n", dns.coalesced);
+    send_line(req, "router_dns_queries_total{result=\"blocked\"} %lu\n", dns.blocked);
+    send_line(req, "router_dns_queries_total{result=\"error\"} %lu\n", dns.errors);
+    send_line(req, "router_dns_queries_total{result=\"dropped\"} %lu\n", dns.dropped);
+    send_header(req, "router_dns_upstream_timeouts_total", "counter", "Consultas abandonadas sin respuesta del servidor de subida");
+    send_line(req, "router_dns_upstream_timeouts_total %lu\n", dns.upstream_timeouts);
+    send_header(req, "router_dns_cache_entries", "gauge", "Respuestas en la caché DNS");
+    send_line(req, "router_dns_cache_entries %lu\n", dns.entries);
+    send_header(req, "router_dns_cache_bytes", "gauge", "Memoria usada por la caché DNS");
+    send_line(req, "router_dns_cache_bytes %lu\n", dns.bytes);
+    send_header(req, "router_dns_cache_hit_ratio", "gauge", "Proporción de consultas respondidas desde la caché");
+    send_line(req, "router_dns_cache_hit_ratio %.3f\n", dns.queries ? (double)dns.hits / dns.queries : 0.0);
+
+    // Lista de bloqueo DNS
+    blocklist_stats_t blocklist;
+    blocklist_get_stats(&blocklist);
+    send_header(req, "router_dns_blocklist_entries", "gauge", "Dominios en la lista de bloqueo activa");
+    send_line(req, "router_dns_blocklist_entries %lu\n", blocklist.entries);
+    send_header(req, "router_dns_blocklist_lookups_total", "counter", "Consultas comprobadas en la lista de bloqueo");
+    send_line(req, "router_dns_blocklist_lookups_total %lu\n", blocklist.lookups);
+    send_header(req, "router_dns_blocklist_lookup_cycles_total", "counter", "Ciclos de CPU consumidos por las búsquedas en la lista de bloqueo");
+    send_line(req, "router_dns_blocklist_lookup_cycles_total %llu\n", blocklist.cycles);
+
+    // Conexión de la STA
+    send_header(req, "router_reconnects_total", "counter", "Reintentos de conexión al WiFi de subida");
+    send_line(req, "router_reconnects_total %llu\n", m[METRIC_RECONNECTS]);
+    send_header(req, "router_time_to_ip_seconds", "summary", "Tiempo desde la pérdida de conexión hasta obtener IP");
+    send_line(req, "router_time_to_ip_seconds_sum %llu.%03llu\n", m[METRIC_TIME_TO_IP_MS_SUM] / 1000, m[METRIC_TIME_TO_IP_MS_SUM] % 1000);
+    send_line(req, "router_time_to_ip_seconds_count %llu\n", m[METRIC_TIME_TO_IP_COUNT]);
+    send_header(req, "router_time_to_ip_last_seconds", "gauge", "Tiempo sin IP de la última pérdida de conexión");
+    send_line(req, "router_time_to_ip_last_seconds %lu.%03lu\n", time_to_ip_last_ms / 1000, time_to_ip_last_ms % 1000);
+    send_header(req, "router_attempt_to_ip_seconds", "summary", "Tiempo hasta obtener IP del intento de conexión que lo consiguió");
+    send_line(req, "router_attempt_to_ip_seconds_sum{scan=\"targeted\"} %llu.%03llu\n", m[METRIC_ATTEMPT_TARGETED_MS_SUM] / 1000, m[METRIC_ATTEMPT_TARGETED_MS_SUM] % 1000);
+    send_line(req, "router_attempt_to_ip_seconds_count{scan=\"targeted\"} %llu\n", m[METRIC_ATTEMPT_TARGETED_COUNT]);
+    send_line(req, "router_attempt_to_ip_seconds_sum{scan=\"full\"} %llu.%03llu\n", m[METRIC_ATTEMPT_FULL_MS_SUM] / 1000, m[METRIC_ATTEMPT_FULL_MS_SUM] % 1000);
+    send_line(req, "router_attempt_to_ip_seconds_count{scan=\"full\"} %llu\n", m[METRIC_ATTEMPT_FULL_COUNT]);
+    send_header(req, "router_attempt_to_ip_last_seconds", "gauge", "Tiempo hasta obtener IP del último intento de conexión");
+    send_line(req, "router_attempt_to_ip_last_seconds %lu.%03lu\n", attempt_to_ip_last_ms / 1000, attempt_to_ip_last_ms % 1000);
+    send_header(req, "router_uplink_switch_downtime_seconds", "summary", "Tiempo sin servicio de los cambios de red de subida");
+    send_line(req, "router_uplink_switch_downtime_seconds_sum{kind=\"failover\"} %llu.%03llu\n", m[METRIC_UPLINK_FAILOVER_MS_SUM] / 1000, m[METRIC_UPLINK_FAILOVER_MS_SUM] % 1000);
+    send_line(req, "router_uplink_switch_downtime_seconds_count{kind=\"failover\"} %llu\n", m[METRIC_UPLINK_FAILOVERS]);
+    send_line(req, "router_uplink_switch_downtime_seconds_sum{kind=\"failback\"} %llu.%03llu\n", m[METRIC_UPLINK_FAILBACK_MS_SUM] / 1000, m[METRIC_UPLINK_FAILBACK_MS_SUM] % 1000);
+    send_line(req, "router_uplink_switch_downtime_seconds_count{kind=\"failback\"} %llu\n", m[METRIC_UPLINK_FAILBACKS]);
+    send_header(req, "router_uplink_switch_downtime_last_seconds", "gauge", "Tiempo sin servicio del último cambio de red de subida");
+    send_line(req, "router_uplink_switch_downtime_last_seconds %lu.%03lu\n", uplink_switch_last_ms / 1000, uplink_switch_last_ms % 1000);
+
+    // Memoria
+    send_header(req, "router_heap_free_bytes", "gauge", "Memoria libre");
+    send_line(req, "router_heap_free_bytes %lu\n", esp_get_free_heap_size());
+    send_header(req, "router_heap_min_free_bytes", "gauge", "Mínimo histórico de memoria libre");
+    send_line(req, "router_heap_min_free_bytes %lu\n", esp_get_minimum_free_heap_size());
+    pool_heap_info_t heap;
+    pool_get_heap_info(&heap);
+    send_header(req, "router_heap_largest_free_block_bytes", "gauge", "Mayor bloque libre de la memoria interna");
+    send_line(req, "router_heap_largest_free_block_bytes %lu\n", heap.largest_free_block);
+    send_header(req, "router_heap_fragmentation_ratio", "gauge", "Fragmentación de la memoria interna (1 - bloque libre mayor / memoria libre)");
+    send_line(req, "router_heap_fragmentation_ratio %.3f\n", heap.fragmentation);
+
+    // Pools de bloques fijos
+    pool_stats_t pools[POOL_CLASSES];
+    pool_get_stats(pools);
+    send_header(req, "router_pool_blocks", "gauge", "Bloques de cada pool");
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        send_line(req, "router_pool_blocks{size=\"%lu\"} %lu\n", pools[i].block_size, pools[i].blocks);
+    }
+    send_header(req, "router_pool_in_use", "gauge", "Bloques en uso de cada pool");
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        send_line(req, "router_pool_in_use{size=\"%lu\"} %lu\n", pools[i].block_size, pools[i].in_use);
+    }
+    send_header(req, "router_pool_high_water", "gauge", "Máximo de bloques en uso a la vez de cada pool");
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        send_line(req, "router_pool_high_water{size=\"%lu\"} %lu\n", pools[i].block_size, pools[i].high_water);
+    }
+    send_header(req, "router_pool_fallbacks_total", "counter", "Reservas de cada pool servidas por una pool mayor o por el heap");
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        send_line(req, "router_pool_fallbacks_total{size=\"%lu\"} %lu\n", pools[i].block_size, pools[i].fallbacks);
+    }
+
+    // Actualización del firmware
+    ota_progress_t ota;
+    ota_get_progress(&ota);
+    send_header(req, "router_ota_written_bytes", "gauge", "Bytes de la imagen escritos en la flash en la última actualización");
+    send_line(req, "router_ota_written_bytes %lu\n", ota.written);
+    send_header(req, "router_ota_ms_per_mb", "gauge", "Tiempo por MB de la última actualización completada");
+    send_line(req, "router_ota_ms_per_mb %lu\n", ota.state == OTA_STATE_DONE ? ota.ms_per_mb : 0);
+
+    // Tiempo de CPU por tarea
+    task_stats_t *tasks = pool_alloc(TASK_STATS_MAX_TASKS * sizeof(task_stats_t));
+    if (tasks != NULL)
+    {
+        uint64_t uptime_us;
+        int task_count = task_stats_get(tasks, TASK_STATS_MAX_TASKS, &uptime_us);
+        send_header(req, "router_task_cpu_seconds_total", "counter", "Tiempo de CPU de cada tarea");
+        for (int i = 0; i < task_count; i++)
+        {
+            send_line(req, "router_task_cpu_seconds_total{task=\"%s\",core=\"%d\"} %llu.%06llu\n", tasks[i].name, tasks[i].core, tasks[i].runtime_us / 1000000, tasks[i].runtime_us % 1000000);
+        }
+        pool_free(tasks);
+    }
+
+    // Clientes del AP
+    static client_info_t clients[CLIENTS_MAX]; // Fuera de la pila de la tarea del servidor HTTP
+    int client_count = clients_get(clients, CLIENTS_MAX);
+    send_header(req, "router_clients", "gauge", "Clientes conectados al punto de acceso");
+    send_line(req, "router_clients %d\n", client_count);
+    send_header(req, "router_clients_max", "gauge", "Capacidad de la tabla de clientes");
+    send_line(req, "router_clients_max %d\n", CLIENTS_MAX);
+    send_header(req, "router_station_rssi_dbm", "gauge", "RSSI de cada cliente del punto de acceso");
+    for (int i = 0; i < client_count; i++)
+    {
+        send_line(req, "router_station_rssi_dbm{mac=\"" MACSTR "\"} %d\n", MAC2STR(clients[i].mac), clients[i].rssi);
+    }
+    send_header(req, "router_client_forwarded_bytes_total", "counter", "Bytes reenviados de cada cliente por sentido");
+    for (int i = 0; i < client_count; i++)
+    {
+        send_line(req, "router_client_forwarded_bytes_total{mac=\"" MACSTR "\",direction=\"up\"} %llu\n", MAC2STR(clients[i].mac), clients[i].up_bytes);
+        send_line(req, "router_client_forwarded_bytes_total{mac=\"" MACSTR "\",direction=\"down\"} %llu\n", MAC2STR(clients[i].mac), clients[i].down_bytes);
+    }
+
+    // Control de tráfico por cliente
+    shaper_station_stats_t stations[SHAPER_MAX_STATIONS];
+    int station_count = shaper_get_stats(stations, SHAPER_MAX_STATIONS);
+    send_header(req, "router_station_queue_depth", "gauge", "Paquetes de subida en la cola de cada cliente");
+    for (int i = 0; i < station_count; i++)
+    {
+        send_line(req, "router_station_queue_depth{mac=\"" MACSTR "\"} %u\n", MAC2STR(stations[i].mac), stations[i].queue_depth);
+    }
+    send_header(req, "router_station_queue_max", "gauge", "Máximo de paquetes en la cola de cada cliente");
+    for (int i = 0; i < station_count; i++)
+    {
+        send_line(req, "router_station_queue_max{mac=\"" MACSTR "\"} %u\n", MAC2STR(stations[i].mac), stations[i].queue_max);
+    }
+    send_header(req, "router_station_bytes_total", "counter", "Bytes de cada cliente con control de tráfico por sentido");
+    for (int i = 0; i < station_count; i++)
+    {
+        send_line(req, "router_station_bytes_total{mac=\"" MACSTR "\",direction=\"up\"} %lu\n", MAC2STR(stations[i].mac), stations[i].up_bytes);
+        send_line(req, "router_station_bytes_total{mac=\"" MACSTR "\",direction=\"down\"} %lu\n", MAC2STR(stations[i].mac), stations[i].down_bytes);
+    }
+    send_header(req, "router_station_drops_total", "counter", "Paquetes descartados de cada cliente por motivo");
+    for (int i = 0; i < station_count; i++)
+    {
+        send_line(req, "router_station_drops_total{mac=\"" MACSTR "\",reason=\"queue\"} %lu\n", MAC2STR(stations[i].mac), stations[i].drops_queue);
+        send_line(req, "router_station_drops_total{mac=\"" MACSTR "\",reason=\"rate\"} %lu\n", MAC2STR(stations[i].mac), stations[i].drops_rate);
+    }
+
+    // Captura de paquetes
+    capture_stats_t capture;
+    capture_get_stats(&capture);
+    send_header(req, "router_capture_frames_total", "counter", "Tramas inspeccionadas por la captura por resultado");
+    send_line(req, "router_capture_frames_total{result=\"stored\"} %lu\n", capture.captured);
+    send_line(req, "router_capture_frames_total{result=\"filtered\"} %lu\n", capture.filtered);
+    send_header(req, "router_capture_overwritten_total", "counter", "Tramas sobrescritas en el anillo de captura");
+    send_line(req, "router_capture_overwritten_total %lu\n", capture.overwritten);
+    send_header(req, "router_capture_cycles_total", "counter", "Ciclos de CPU consumidos por la captura en la ruta de los paquetes");
+    send_line(req, "router_capture_cycles_total %llu\n", capture.cycles);
+
+    // Redirección de puertos
+    portmap_rule_stats_t rules[SETTINGS_PORTMAP_MAX_RULES];
+    int rule_count = portmap_get_stats(rules, SETTINGS_PORTMAP_MAX_RULES);
+    send_header(req, "router_portmap_hits_total", "counter", "Paquetes recibidos en la STA para cada regla de redirección de puertos");
+    for (int i = 0; i < rule_count; i++)
+    {
+        send_line(req, "router_portmap_hits_total{proto=\"%s\",port=\"%u\"} %lu\n", rules[i].rule.proto == IP_PROTO_TCP ? "tcp" : "udp", rules[i].rule.ext_port, rules[i].hits);
+    }
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "freertos/FreeRTOS.h"
+
+// Contadores del router exportados en formato Prometheus por /metrics.
+// Cada núcleo escribe en su propia copia con una suma atómica de 32 bits (sin bloqueos ni contención);
+// un timer acumula periódicamente las diferencias en totales de 64 bits antes de que den la vuelta.
+
+// Definiciones de métricas
+#define METRICS_FOLD_INTERVAL_MS 5000 // Intervalo de acumulación de los contadores de 32 bits
+
+// Contadores
+typedef enum
+{
+    METRIC_UP_FAST_PACKETS = 0, // AP -> STA por la ruta rápida
+    METRIC_UP_FAST_BYTES,
+    METRIC_UP_SLOW_PACKETS,     // AP -> STA por lwIP
+    METRIC_UP_SLOW_BYTES,
+    METRIC_DOWN_PACKETS,        // Hacia los clientes del AP
+    METRIC_DOWN_BYTES,
+    METRIC_FAST_CYCLES,         // Ciclos de CPU de la ruta rápida
+    METRIC_DROP_AP_INPUT,       // Paquetes rechazados por la cola de la tarea TCP/IP
+    METRIC_DROP_STA_TX,         // Fallos del driver al transmitir por la STA
+    METRIC_DROP_AP_TX,          // Fallos del driver al transmitir por el AP
+    METRIC_RECONNECTS,          // Reintentos de conexión de la STA
+    METRIC_TIME_TO_IP_MS_SUM,   // Suma de tiempos hasta obtener IP
+    METRIC_TIME_TO_IP_COUNT,
+    METRIC_ATTEMPT_TARGETED_MS_SUM, // Suma de tiempos hasta obtener IP de los intentos al último AP
+    METRIC_ATTEMPT_TARGETED_COUNT,
+    METRIC_ATTEMPT_FULL_MS_SUM,     // Suma de tiempos hasta obtener IP de los intentos con escaneo completo
+    METRIC_ATTEMPT_FULL_COUNT,
+    METRIC_UPLINK_FAILOVER_MS_SUM,  // Suma de tiempos sin servicio al cambiar de red tras perder la conexión
+    METRIC_UPLINK_FAILOVERS,
+    METRIC_UPLINK_FAILBACK_MS_SUM,  // Suma de tiempos sin servicio al volver a la red preferida
+    METRIC_UPLINK_FAILBACKS,
+    METRIC_MSS_CLAMPED,         // SYN con la opción MSS reducida a la MTU de subida
+    METRIC_FRAGMENTS_IN,        // Fragmentos IPv4 recibidos por la STA
+    METRIC_FRAGMENTS_OUT,       // Fragmentos IPv4 enviados por la STA
+    METRIC_LAST_FRAGMENTS,      // Últimos fragmentos recibidos por la STA (no garantiza que lwIP complete el datagrama)
+    METRIC_PMTU_ICMP,           // ICMP "fragmentation needed" recibidos por la STA
+    METRIC_PMTU_ICMP_IGNORED,   // Los que no citan una conexión TCP traducida viva
+    METRIC_IPV6_UP_PACKETS,     // Paquetes IPv6 reenviados sin NAPT hacia la WAN (o entre clientes del AP)
+    METRIC_IPV6_UP_BYTES,
+    METRIC_IPV6_DOWN_PACKETS,   // Paquetes IPv6 reenviados sin NAPT hacia los clientes
+    METRIC_IPV6_DOWN_BYTES,
+    METRIC_IPV6_DROPPED,        // Paquetes IPv6 con el límite de saltos agotado o que el driver no aceptó
+    METRIC_IPV6_NDP_PROXIED,    // NA enviados en la WAN por direcciones de clientes
+    METRIC_IPV6_RA_RELAYED,     // RA retransmitidos en el AP
+    METRIC_COUNT,
+} metric_id_t;
+
+// Copia de los contadores de un núcleo
+typedef struct
+{
+    uint32_t values[METRIC_COUNT];
+} metrics_shard_t;
+
+extern metrics_shard_t metrics_shards[portNUM_PROCESSORS];
+
+// Suma value al contador id sin bloqueos (seguro desde cualquier tarea)
+static inline void metrics_add(metric_id_t id, uint32_t value)
+{
+    __atomic_fetch_add(&metrics_shards[xPortGetCoreID()].values[id], value, __ATOMIC_RELAXED);
+}
+
+esp_err_t metrics_init(void);                         // Inicia el timer de acumulación
+void metrics_snapshot(uint64_t totals[METRIC_COUNT]); // Obtiene los totales de 64 bits
+void metrics_set_time_to_ip(uint32_t ms);             // Registra el tiempo desde la pérdida de conexión hasta obtener IP
+void metrics_set_attempt_to_ip(uint32_t ms, bool targeted); // Registra el tiempo hasta obtener IP del intento que lo consiguió
+void metrics_set_uplink_switch(uint32_t ms, bool failback);  // Registra el tiempo sin servicio de un cambio de red de subida
+esp_err_t metrics_handler(httpd_req_t *req);          // Manejador de /metrics
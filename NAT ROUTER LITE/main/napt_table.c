@@ -0,0 +1,311 @@
+#include "napt_table.h"
+#include <stdlib.h>
+#include <string.h>
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline bool key_equal(const napt_key_t *a, const napt_key_t *b)
+{
+    return a->src_ip == b->src_ip && a->dst_ip == b->dst_ip && a->src_port == b->src_port && a->dst_port == b->dst_port && a->proto == b->proto;
+}
+
+static inline uint32_t flow_timeout(const napt_flow_t *flow)
+{
+    if (flow->key.proto == 6) // TCP
+    {
+        return (flow->flags & NAPT_FLOW_FLAG_CLOSING) ? NAPT_TABLE_TCP_FIN_TIMEOUT_MS : NAPT_TABLE_TCP_TIMEOUT_MS;
+    }
+    return NAPT_TABLE_UDP_TIMEOUT_MS;
+}
+
+static inline bool flow_expired(const napt_flow_t *flow, uint32_t now)
+{
+    return (uint32_t)(now - flow->last_seen) > flow_timeout(flow);
+}
+
+// Hash del origen traducido de un flujo, clave del índice inverso
+static inline uint32_t reverse_hash(uint32_t nat_ip, uint16_t nat_port, uint8_t proto)
+{
+    uint32_t h = (nat_ip ^ ((uint32_t)nat_port << 16) ^ proto) * 0x9e3779b1u;
+    return h ^ (h >> 16);
+}
+
+static inline uint32_t reverse_home(const napt_table_t *table, uint32_t index)
+{
+    const napt_flow_t *flow = &table->slots[index];
+    return reverse_hash(flow->nat_ip, flow->nat_port, flow->key.proto) & table->mask;
+}
+
+// Posición en el índice inverso de la ranura index (que debe estar indexada)
+static uint32_t reverse_position(const napt_table_t *table, uint32_t index)
+{
+    uint32_t pos = reverse_home(table, index);
+    while (table->reverse[pos] != index + 1)
+    {
+        pos = (pos + 1) & table->mask;
+    }
+    return pos;
+}
+
+// Nunca se llena: hay tantas posiciones como ranuras y como mucho una por flujo
+static void reverse_add(napt_table_t *table, uint32_t index)
+{
+    uint32_t pos = reverse_home(table, index);
+    while (table->reverse[pos] != 0)
+    {
+        pos = (pos + 1) & table->mask;
+    }
+    table->reverse[pos] = index + 1;
+}
+
+// Quita la ranura index del índice inverso desplazando hacia atrás las siguientes de la misma cadena de sondeo
+static void reverse_remove(napt_table_t *table, uint32_t index)
+{
+    uint16_t *reverse = table->reverse;
+    uint32_t mask = table->mask;
+    uint32_t pos = reverse_position(table, index);
+    reverse[pos] = 0;
+    for (uint32_t next = (pos + 1) & mask; reverse[next] != 0; next = (next + 1) & mask)
+    {
+        uint32_t home = reverse_home(table, reverse[next] - 1);
+        if (((next - home) & mask) >= ((next - pos) & mask))
+        {
+            reverse[pos] = reverse[next];
+            reverse[next] = 0;
+            pos = next;
+        }
+    }
+}
+
+// Libera la ranura index desplazando hacia atrás las entradas del mismo grupo de sondeo
+static void remove_slot(napt_table_t *table, uint32_t index)
+{
+    napt_flow_t *slots = table->slots;
+    uint32_t mask = table->mask;
+    uint32_t hole = index;
+    uint32_t next = index;
+
+    if (slots[index].state == NAPT_FLOW_MAPPED)
+    {
+        reverse_remove(table, index);
+    }
+
+    while (true)
+    {
+        next = (next + 1) & mask;
+        if (slots[next].state == NAPT_FLOW_FREE)
+        {
+            break;
+        }
+
+        // Distancia de cada posición a la ranura ideal de la entrada
+        uint32_t home = slots[next].hash & mask;
+        if (((next - home) & mask) >= ((next - hole) & mask))
+        {
+            // Una entrada con traducción que cambia de ranura se actualiza también en el índice inverso
+            if (slots[next].state == NAPT_FLOW_MAPPED)
+            {
+                table->reverse[reverse_position(table, next)] = hole + 1;
+            }
+            slots[hole] = slots[next];
+            hole = next;
+        }
+    }
+
+    slots[hole].state = NAPT_FLOW_FREE;
+    table->count--;
+}
+
+// Devuelve la ranura de la clave o la primera libre de su grupo de sondeo
+static uint32_t probe(const napt_table_t *table, const napt_key_t *key, uint32_t hash, bool *found)
+{
+    uint32_t index = hash & table->mask;
+    while (table->slots[index].state != NAPT_FLOW_FREE)
+    {
+        if (table->slots[index].hash == hash && key_equal(&table->slots[index].key, key))
+        {
+            *found = true;
+            return index;
+        }
+        index = (index + 1) & table->mask;
+    }
+    *found = false;
+    return index;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+bool napt_table_init(napt_table_t *table, uint32_t size)
+{
+    uint32_t slots = 16;
+    while (slots < size)
+    {
+        slots <<= 1;
+    }
+
+    memset(table, 0, sizeof(*table));
+    if (slots > NAPT_TABLE_SIZE_MAX)
+    {
+        return false;
+    }
+    table->slots = calloc(slots, sizeof(napt_flow_t));
+    table->reverse = calloc(slots, sizeof(uint16_t));
+    if (table->slots == NULL || table->reverse == NULL)
+    {
+        napt_table_deinit(table);
+        return false;
+    }
+
+    table->mask = slots - 1;
+    table->limit = (uint32_t)(((uint64_t)slots * NAPT_TABLE_LOAD_PERCENT) / 100);
+    return true;
+}
+
+void napt_table_deinit(napt_table_t *table)
+{
+    free(table->slots);
+    free(table->reverse);
+    memset(table, 0, sizeof(*table));
+}
+
+void napt_table_clear(napt_table_t *table)
+{
+    memset(table->slots, 0, (table->mask + 1) * sizeof(napt_flow_t));
+    memset(table->reverse, 0, (table->mask + 1) * sizeof(uint16_t));
+    table->count = 0;
+    table->cursor = 0;
+}
+
+uint32_t napt_table_hash(const napt_key_t *key)
+{
+    // Mezcla tipo murmur3 (fmix32) sobre los campos de la tupla
+    uint32_t h = key->src_ip * 0x9e3779b1u;
+    h ^= key->dst_ip + 0x7f4a7c15u + (h << 6) + (h >> 2);
+    h ^= (((uint32_t)key->src_port << 16) | key->dst_port) + 0x85ebca6bu + (h << 6) + (h >> 2);
+    h ^= key->proto;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+napt_flow_t *napt_table_find(napt_table_t *table, const napt_key_t *key, uint32_t now)
+{
+    bool found;
+    uint32_t index = probe(table, key, napt_table_hash(key), &found);
+    if (!found)
+    {
+        return NULL;
+    }
+
+    if (flow_expired(&table->slots[index], now))
+    {
+        remove_slot(table, index);
+        table->expired++;
+        return NULL;
+    }
+
+    return &table->slots[index];
+}
+
+napt_flow_t *napt_table_insert(napt_table_t *table, const napt_key_t *key, uint32_t now, bool *created)
+{
+    uint32_t hash = napt_table_hash(key);
+    bool found;
+    uint32_t index = probe(table, key, hash, &found);
+
+    if (found && !flow_expired(&table->slots[index], now))
+    {
+        *created = false;
+        return &table->slots[index];
+    }
+
+    if (found)
+    {
+        // Reutiliza la ranura de un flujo vencido con la misma tupla
+        if (table->slots[index].state == NAPT_FLOW_MAPPED)
+        {
+            reverse_remove(table, index);
+        }
+        table->expired++;
+        table->count--;
+    }
+    else if (table->count >= table->limit)
+    {
+        table->rejected++;
+        *created = false;
+        return NULL;
+    }
+
+    napt_flow_t *flow = &table->slots[index];
+    memset(flow, 0, sizeof(*flow));
+    flow->key = *key;
+    flow->hash = hash;
+    flow->last_seen = now;
+    flow->state = NAPT_FLOW_PENDING;
+    table->count++;
+
+    *created = true;
+    return flow;
+}
+
+void napt_table_map(napt_table_t *table, napt_flow_t *flow, uint32_t nat_ip, uint16_t nat_port)
+{
+    uint32_t index = flow - table->slots;
+    if (flow->state == NAPT_FLOW_MAPPED)
+    {
+        reverse_remove(table, index);
+    }
+    flow->nat_ip = nat_ip;
+    flow->nat_port = nat_port;
+    flow->state = NAPT_FLOW_MAPPED;
+    reverse_add(table, index);
+}
+
+// Sigue la cadena del origen traducido en el índice inverso; varios flujos pueden compartirlo (otro destino)
+const napt_flow_t *napt_table_find_translated(const napt_table_t *table, const napt_key_t *translated, uint32_t now)
+{
+    uint32_t pos = reverse_hash(translated->src_ip, translated->src_port, translated->proto) & table->mask;
+    for (; table->reverse[pos] != 0; pos = (pos + 1) & table->mask)
+    {
+        const napt_flow_t *flow = &table->slots[table->reverse[pos] - 1];
+        if (flow->nat_port == translated->src_port && flow->nat_ip == translated->src_ip && flow->key.dst_ip == translated->dst_ip &&
+            flow->key.dst_port == translated->dst_port && flow->key.proto == translated->proto && !flow_expired(flow, now))
+        {
+            return flow;
+        }
+    }
+    return NULL;
+}
+
+bool napt_table_remove(napt_table_t *table, const napt_key_t *key)
+{
+    bool found;
+    uint32_t index = probe(table, key, napt_table_hash(key), &found);
+    if (found)
+    {
+        remove_slot(table, index);
+    }
+    return found;
+}
+
+uint32_t napt_table_expire(napt_table_t *table, uint32_t now, uint32_t budget)
+{
+    uint32_t removed = 0;
+    while (budget-- > 0 && table->count > 0)
+    {
+        napt_flow_t *flow = &table->slots[table->cursor];
+        if (flow->state != NAPT_FLOW_FREE && flow_expired(flow, now))
+        {
+            // El desplazamiento puede traer otra entrada a esta ranura, se revisa de nuevo en la siguiente vuelta
+            remove_slot(table, table->cursor);
+            table->expired++;
+            removed++;
+            continue;
+        }
+        table->cursor = (table->cursor + 1) & table->mask;
+    }
+    return removed;
+}
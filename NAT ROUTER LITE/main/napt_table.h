@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Tabla de conexiones NAPT indexada por hash de la 5-tupla.
+// Direccionamiento abierto con sondeo lineal y borrado por desplazamiento hacia atrás (sin lápidas),
+// de modo que insertar, buscar y expirar cuestan O(1) en promedio. Un índice inverso con la misma
+// estructura localiza los flujos con traducción por su origen traducido (nat_ip, nat_port, proto), para
+// validar los ICMP de error que citan un paquete ya traducido sin recorrer la tabla. No depende de ESP-IDF
+// ni de lwIP para poder compilarse en el host; la sincronización queda a cargo de quien la use.
+
+// Definiciones de la tabla
+#define NAPT_TABLE_SIZE_DEFAULT 512         // Número de ranuras (potencia de 2, 48 bytes cada una más 2 del índice inverso)
+#define NAPT_TABLE_SIZE_MAX 32768           // El índice inverso guarda la ranura + 1 en 16 bits
+#define NAPT_TABLE_LOAD_PERCENT 75          // Ocupación máxima antes de rechazar inserciones
+#define NAPT_TABLE_TCP_TIMEOUT_MS 300000    // Conexión TCP establecida sin tráfico (5 min)
+#define NAPT_TABLE_TCP_FIN_TIMEOUT_MS 10000 // Conexión TCP cerrada (FIN/RST visto)
+#define NAPT_TABLE_UDP_TIMEOUT_MS 30000     // Flujo UDP sin tráfico
+
+// Estados de una ranura
+typedef enum
+{
+    NAPT_FLOW_FREE = 0, // Ranura libre
+    NAPT_FLOW_PENDING,  // Flujo visto en el AP, traducción todavía desconocida
+    NAPT_FLOW_MAPPED,   // Traducción aprendida de la salida por la STA
+} napt_flow_state_t;
+
+// Banderas de un flujo
+#define NAPT_FLOW_FLAG_CLOSING 0x01 // Se ha visto FIN o RST
+
+// 5-tupla de un flujo saliente (direcciones y puertos en orden de red)
+typedef struct
+{
+    uint32_t src_ip;
+    uint32_t dst_ip;
+    uint16_t src_port;
+    uint16_t dst_port;
+    uint8_t proto;
+} napt_key_t;
+
+// Entrada de la tabla
+typedef struct
+{
+    napt_key_t key;
+    uint32_t hash;      // Hash de la clave (evita recalcularlo al desplazar entradas)
+    uint32_t last_seen; // Última actividad en ms
+    uint32_t refreshed; // Último paquete que pasó por lwIP en ms (mantiene viva su entrada NAPT)
+    uint32_t nat_ip;    // Dirección de origen tras la traducción (orden de red)
+    uint16_t nat_port;  // Puerto de origen tras la traducción (orden de red)
+    uint8_t state;      // napt_flow_state_t
+    uint8_t flags;      // NAPT_FLOW_FLAG_*
+    uint8_t eth_dst[6]; // Cabecera Ethernet usada por la STA para este flujo
+    uint8_t eth_src[6];
+} napt_flow_t;
+
+typedef struct
+{
+    napt_flow_t *slots;
+    uint16_t *reverse; // Ranura + 1 de cada flujo MAPPED por su origen traducido, 0 vacío (mismo tamaño que slots)
+    uint32_t mask;     // Número de ranuras - 1
+    uint32_t count;    // Entradas ocupadas
+    uint32_t limit;    // Máximo de entradas según NAPT_TABLE_LOAD_PERCENT
+    uint32_t cursor;   // Posición del barrido incremental de expiración
+    uint32_t expired;  // Entradas expiradas desde el inicio
+    uint32_t rejected; // Inserciones rechazadas por tabla llena
+} napt_table_t;
+
+bool napt_table_init(napt_table_t *table, uint32_t size);                                // Reserva la tabla (size se redondea a potencia de 2, hasta NAPT_TABLE_SIZE_MAX)
+void napt_table_deinit(napt_table_t *table);                                            // Libera la tabla
+void napt_table_clear(napt_table_t *table);                                             // Vacía la tabla sin liberarla
+uint32_t napt_table_hash(const napt_key_t *key);                                        // Calcula el hash de una 5-tupla
+napt_flow_t *napt_table_find(napt_table_t *table, const napt_key_t *key, uint32_t now); // Busca un flujo vigente
+napt_flow_t *napt_table_insert(napt_table_t *table, const napt_key_t *key, uint32_t now, bool *created); // Busca o crea un flujo
+void napt_table_map(napt_table_t *table, napt_flow_t *flow, uint32_t nat_ip, uint16_t nat_port); // Guarda la traducción de un flujo (MAPPED) y la indexa
+const napt_flow_t *napt_table_find_translated(const napt_table_t *table, const napt_key_t *translated, uint32_t now); // Busca un flujo por su 5-tupla ya traducida
+bool napt_table_remove(napt_table_t *table, const napt_key_t *key);                     // Elimina un flujo
+uint32_t napt_table_expire(napt_table_t *table, uint32_t now, uint32_t budget);         // Revisa hasta budget ranuras y expira las vencidas
@@ -0,0 +1,488 @@
+#include "ota.h"
+#include "admin.h"
+#include "settings.h"
+#include "esp_app_desc.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "freertos/task.h"
+#include "psa/crypto.h"
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/param.h>
+
+// Tags para logging
+static const char *TAG_OTA = "OTA";
+
+static const char *state_names[] = {
+    [OTA_STATE_IDLE] = "idle",
+    [OTA_STATE_RECEIVING] = "receiving",
+    [OTA_STATE_VERIFYING] = "verifying",
+    [OTA_STATE_DONE] = "done",
+    [OTA_STATE_FAILED] = "failed",
+};
+
+// Estructuras
+typedef struct
+{
+    uint8_t index; // Buffer lleno
+    uint16_t len;  // Bytes del buffer, 0 para terminar
+} ota_chunk_t;
+
+// Variables globales
+static portMUX_TYPE ota_lock = portMUX_INITIALIZER_UNLOCKED;
+static ota_progress_t progress;
+static bool busy = false;
+static int64_t start_us = 0; // Inicio de la actualización en curso
+static esp_netif_t *ap = NULL;
+static esp_timer_handle_t validate_timer = NULL;
+static esp_timer_handle_t reboot_timer = NULL;
+
+// Solo durante una actualización
+static uint8_t *buffers[2];
+static QueueHandle_t free_queue = NULL; // Índices de los buffers libres
+static QueueHandle_t full_queue = NULL; // Buffers pendientes de escribir
+static esp_ota_handle_t ota_handle;
+static TaskHandle_t receiver_task = NULL;
+static esp_err_t write_err = ESP_OK;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Escribe en la flash los buffers que entrega el servidor HTTP y los devuelve vacíos
+static void writer_task(void *arg)
+{
+    ota_chunk_t chunk;
+    while (xQueueReceive(full_queue, &chunk, portMAX_DELAY) == pdTRUE && chunk.len > 0)
+    {
+        if (write_err == ESP_OK)
+        {
+            write_err = esp_ota_write(ota_handle, buffers[chunk.index], chunk.len);
+            if (write_err == ESP_OK)
+            {
+                portENTER_CRITICAL(&ota_lock);
+                progress.written += chunk.len;
+                portEXIT_CRITICAL(&ota_lock);
+            }
+        }
+        xQueueSend(free_queue, &chunk.index, portMAX_DELAY);
+    }
+
+    xTaskNotifyGive(receiver_task);
+    vTaskDelete(NULL);
+}
+
+// Reserva los buffers, las colas y la tarea de escritura
+static esp_err_t pipeline_create(void)
+{
+    buffers[0] = malloc(OTA_BUFFER_SIZE);
+    buffers[1] = malloc(OTA_BUFFER_SIZE);
+    free_queue = xQueueCreate(2, sizeof(uint8_t));
+    full_queue = xQueueCreate(2, sizeof(ota_chunk_t));
+    if (buffers[0] == NULL || buffers[1] == NULL || free_queue == NULL || full_queue == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        xQueueSend(free_queue, &i, 0);
+    }
+
+    write_err = ESP_OK;
+    receiver_task = xTaskGetCurrentTaskHandle();
+    if (xTaskCreatePinnedToCore(writer_task, "ota_writer", OTA_WRITER_STACK, NULL, OTA_WRITER_PRIORITY, NULL, OTA_WRITER_CORE) != pdPASS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    return ESP_OK;
+}
+
+// Espera a que la tarea de escritura termine (si se creó) y libera los recursos
+static void pipeline_destroy(bool writer_running)
+{
+    if (writer_running)
+    {
+        ota_chunk_t end = {.index = 0, .len = 0};
+        xQueueSend(full_queue, &end, portMAX_DELAY);
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+
+    if (free_queue != NULL)
+    {
+        vQueueDelete(free_queue);
+        free_queue = NULL;
+    }
+    if (full_queue != NULL)
+    {
+        vQueueDelete(full_queue);
+        full_queue = NULL;
+    }
+    free(buffers[0]);
+    free(buffers[1]);
+    buffers[0] = buffers[1] = NULL;
+}
+
+static void fail(const char *error)
+{
+    ESP_LOGE(TAG_OTA, "Actualización fallida: %s", error);
+    portENTER_CRITICAL(&ota_lock);
+    progress.state = OTA_STATE_FAILED;
+    snprintf(progress.error, sizeof(progress.error), "%s", error);
+    busy = false;
+    portEXIT_CRITICAL(&ota_lock);
+}
+
+static void set_state(ota_state_t state)
+{
+    portENTER_CRITICAL(&ota_lock);
+    progress.state = state;
+    portEXIT_CRITICAL(&ota_lock);
+}
+
+static void reboot_cb(void *arg)
+{
+    esp_restart();
+}
+
+// La imagen nueva sigue en marcha: si el AP está levantado se confirma, si no se vuelve a la anterior
+static void validate_cb(void *arg)
+{
+    if (esp_netif_is_netif_up(ap))
+    {
+        esp_err_t err = esp_ota_mark_app_valid_cancel_rollback();
+        if (err == ESP_OK)
+        {
+            ESP_LOGI(TAG_OTA, "Imagen nueva confirmada");
+        }
+        else
+        {
+            ESP_LOGE(TAG_OTA, "Error al confirmar la imagen nueva. Error %s", esp_err_to_name(err));
+        }
+        return;
+    }
+
+    ESP_LOGE(TAG_OTA, "El punto de acceso no está levantado, volviendo a la imagen anterior");
+    esp_ota_mark_app_invalid_rollback_and_reboot();
+}
+
+static const char *image_state_name(esp_ota_img_states_t state)
+{
+    switch (state)
+    {
+    case ESP_OTA_IMG_NEW:
+        return "new";
+    case ESP_OTA_IMG_PENDING_VERIFY:
+        return "pending_verify";
+    case ESP_OTA_IMG_VALID:
+        return "valid";
+    case ESP_OTA_IMG_INVALID:
+        return "invalid";
+    case ESP_OTA_IMG_ABORTED:
+        return "aborted";
+    default:
+        return "undefined";
+    }
+}
+
+// Convierte el resumen esperado de la cabecera a binario; false si no son 64 dígitos hexadecimales
+static bool parse_sha256(const char *text, uint8_t out[32])
+{
+    if (strlen(text) != 64)
+    {
+        return false;
+    }
+    for (int i = 0; i < 32; i++)
+    {
+        char byte[3] = {text[2 * i], text[2 * i + 1], '\0'};
+        if (!isxdigit((unsigned char)byte[0]) || !isxdigit((unsigned char)byte[1]))
+        {
+            return false;
+        }
+        out[i] = strtoul(byte, NULL, 16);
+    }
+    return true;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t ota_start(esp_netif_t *ap_netif)
+{
+    ap = ap_netif;
+
+    esp_timer_create_args_t reboot_config = {
+        .callback = reboot_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ota_reboot",
+    };
+    esp_err_t err = esp_timer_create(&reboot_config, &reboot_timer);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA, "Error al crear el timer de reinicio. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    esp_ota_img_states_t state;
+    if (esp_ota_get_state_partition(running, &state) != ESP_OK)
+    {
+        state = ESP_OTA_IMG_UNDEFINED;
+    }
+    ESP_LOGI(TAG_OTA, "Imagen en marcha: %s en %s (%s)", esp_app_get_description()->version, running->label, image_state_name(state));
+
+    if (state != ESP_OTA_IMG_PENDING_VERIFY)
+    {
+        return ESP_OK;
+    }
+
+    // Primer arranque tras una actualización
+    esp_timer_create_args_t validate_config = {
+        .callback = validate_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "ota_validate",
+    };
+    err = esp_timer_create(&validate_config, &validate_timer);
+    if (err == ESP_OK)
+    {
+        err = esp_timer_start_once(validate_timer, OTA_VALIDATE_DELAY_MS * 1000ULL);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA, "Error al programar la confirmación de la imagen. Error %s", esp_err_to_name(err));
+    }
+    return err;
+}
+
+void ota_get_progress(ota_progress_t *out)
+{
+    portENTER_CRITICAL(&ota_lock);
+    *out = progress;
+    portEXIT_CRITICAL(&ota_lock);
+}
+
+esp_err_t ota_get_handler(httpd_req_t *req)
+{
+    ota_progress_t p;
+    ota_get_progress(&p);
+    if (p.state == OTA_STATE_RECEIVING || p.state == OTA_STATE_VERIFYING)
+    {
+        p.elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+        p.ms_per_mb = p.received ? (uint64_t)p.elapsed_ms * 1048576 / p.received : 0;
+    }
+
+    const esp_partition_t *running = esp_ota_get_running_partition();
+    const esp_partition_t *boot = esp_ota_get_boot_partition();
+    esp_ota_img_states_t image_state;
+    if (esp_ota_get_state_partition(running, &image_state) != ESP_OK)
+    {
+        image_state = ESP_OTA_IMG_UNDEFINED;
+    }
+
+    char text[512];
+    snprintf(text, sizeof(text),
+             "version %s\nrunning %s\nboot %s\nimage_state %s\n"
+             "state %s\nreceived %lu\nwritten %lu\ntotal %lu\nprogress %lu%%\nelapsed_ms %lu\nms_per_mb %lu\nsha256 %s\nerror %s\n",
+             esp_app_get_description()->version, running->label, boot ? boot->label : "-", image_state_name(image_state), state_names[p.state], p.received, p.written,
+             p.total, p.total ? (uint32_t)((uint64_t)p.written * 100 / p.total) : 0, p.elapsed_ms, p.ms_per_mb, p.sha256[0] ? p.sha256 : "-", p.error[0] ? p.error : "-");
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_send(req, text, HTTPD_RESP_USE_STRLEN);
+}
+
+// Cuerpo: la imagen en binario (application/octet-stream); cabecera opcional X-Image-SHA256 en hexadecimal.
+// Solo desde el punto de acceso y con la contraseña de administración (admin.h)
+esp_err_t ota_post_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, "application/octet-stream"))
+    {
+        return ESP_FAIL; // Se cierra la conexión sin recibir la imagen
+    }
+
+    const esp_partition_t *partition = esp_ota_get_next_update_partition(NULL);
+    if (partition == NULL)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "No hay partición OTA");
+    }
+    if (req->content_len == 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_411_LENGTH_REQUIRED, "Falta la imagen");
+    }
+    if (req->content_len > partition->size)
+    {
+        return httpd_resp_send_err(req, HTTPD_413_CONTENT_TOO_LARGE, "La imagen no cabe en la partición");
+    }
+
+    uint8_t expected[32];
+    bool check_sha = false;
+    char sha_text[65];
+    if (httpd_req_get_hdr_value_len(req, "X-Image-SHA256") > 0)
+    {
+        if (httpd_req_get_hdr_value_str(req, "X-Image-SHA256", sha_text, sizeof(sha_text)) != ESP_OK || !parse_sha256(sha_text, expected))
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "X-Image-SHA256 no válido");
+        }
+        check_sha = true;
+    }
+
+    // Una sola actualización a la vez
+    portENTER_CRITICAL(&ota_lock);
+    bool was_busy = busy;
+    if (!was_busy)
+    {
+        busy = true;
+        memset(&progress, 0, sizeof(progress));
+        progress.state = OTA_STATE_RECEIVING;
+        progress.total = req->content_len;
+        start_us = esp_timer_get_time();
+    }
+    portEXIT_CRITICAL(&ota_lock);
+    if (was_busy)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, "Ya hay una actualización en curso", HTTPD_RESP_USE_STRLEN);
+    }
+
+    ESP_LOGI(TAG_OTA, "Recibiendo imagen de %u bytes en %s", req->content_len, partition->label);
+
+    // Borrado sector a sector al escribir: sin una pausa larga de la flash al empezar
+    esp_err_t err = esp_ota_begin(partition, OTA_WITH_SEQUENTIAL_WRITES, &ota_handle);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA, "Error al preparar la partición. Error %s", esp_err_to_name(err));
+        fail("Error al preparar la partición");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Error al preparar la partición");
+    }
+
+    psa_hash_operation_t hash = PSA_HASH_OPERATION_INIT;
+    bool writer_running = false;
+    if (psa_crypto_init() != PSA_SUCCESS || psa_hash_setup(&hash, PSA_ALG_SHA_256) != PSA_SUCCESS)
+    {
+        err = ESP_FAIL;
+    }
+    else
+    {
+        err = pipeline_create();
+        writer_running = err == ESP_OK;
+    }
+    if (err != ESP_OK)
+    {
+        pipeline_destroy(writer_running);
+        psa_hash_abort(&hash);
+        esp_ota_abort(ota_handle);
+        fail("Sin memoria para la actualización");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sin memoria para la actualización");
+    }
+
+    // Mientras la tarea de escritura graba un buffer, aquí se llena el otro
+    size_t remaining = req->content_len;
+    bool recv_failed = false;
+    int timeouts = 0;
+    while (remaining > 0 && !recv_failed && write_err == ESP_OK)
+    {
+        uint8_t index;
+        xQueueReceive(free_queue, &index, portMAX_DELAY);
+
+        size_t len = 0;
+        size_t want = MIN(remaining, OTA_BUFFER_SIZE);
+        while (len < want)
+        {
+            int received = httpd_req_recv(req, (char *)buffers[index] + len, want - len);
+            if (received == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < OTA_RECV_RETRIES)
+            {
+                continue;
+            }
+            if (received <= 0)
+            {
+                recv_failed = true;
+                break;
+            }
+            len += received;
+        }
+        if (recv_failed)
+        {
+            xQueueSend(free_queue, &index, 0);
+            break;
+        }
+
+        psa_hash_update(&hash, buffers[index], len);
+        remaining -= len;
+        portENTER_CRITICAL(&ota_lock);
+        progress.received += len;
+        portEXIT_CRITICAL(&ota_lock);
+
+        ota_chunk_t chunk = {.index = index, .len = len};
+        xQueueSend(full_queue, &chunk, portMAX_DELAY);
+    }
+
+    pipeline_destroy(true);
+
+    uint8_t digest[32];
+    size_t digest_len = 0;
+    psa_hash_finish(&hash, digest, sizeof(digest), &digest_len);
+
+    if (recv_failed || write_err != ESP_OK)
+    {
+        esp_ota_abort(ota_handle);
+        if (recv_failed)
+        {
+            fail("Error al recibir la imagen");
+            return ESP_FAIL; // Se cierra la conexión
+        }
+        ESP_LOGE(TAG_OTA, "Error al escribir la imagen. Error %s", esp_err_to_name(write_err));
+        fail("Error al escribir la imagen");
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Error al escribir la imagen");
+    }
+
+    set_state(OTA_STATE_VERIFYING);
+    char digest_text[65];
+    for (int i = 0; i < 32; i++)
+    {
+        snprintf(digest_text + 2 * i, 3, "%02x", digest[i]);
+    }
+    portENTER_CRITICAL(&ota_lock);
+    memcpy(progress.sha256, digest_text, sizeof(progress.sha256));
+    portEXIT_CRITICAL(&ota_lock);
+
+    if (check_sha && memcmp(digest, expected, sizeof(expected)) != 0)
+    {
+        esp_ota_abort(ota_handle);
+        fail("El SHA-256 no coincide");
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "El SHA-256 no coincide");
+    }
+
+    // esp_ota_end comprueba la cabecera y el resumen que lleva la propia imagen
+    err = esp_ota_end(ota_handle);
+    if (err == ESP_OK)
+    {
+        err = esp_ota_set_boot_partition(partition);
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_OTA, "Imagen rechazada. Error %s", esp_err_to_name(err));
+        fail(err == ESP_ERR_OTA_VALIDATE_FAILED ? "Imagen no válida" : "Error al activar la imagen");
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, err == ESP_ERR_OTA_VALIDATE_FAILED ? "Imagen no válida" : "Error al activar la imagen");
+    }
+
+    uint32_t elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+    uint32_t ms_per_mb = (uint64_t)elapsed_ms * 1048576 / req->content_len;
+    portENTER_CRITICAL(&ota_lock);
+    progress.state = OTA_STATE_DONE;
+    progress.elapsed_ms = elapsed_ms;
+    progress.ms_per_mb = ms_per_mb;
+    portEXIT_CRITICAL(&ota_lock);
+    ESP_LOGI(TAG_OTA, "Imagen activada en %s: %u bytes en %lu ms (%lu ms/MB), SHA-256 %s", partition->label, req->content_len, elapsed_ms, ms_per_mb, digest_text);
+
+    // La configuración pendiente se guarda antes de reiniciar con la imagen nueva
+    settings_flush();
+    esp_timer_start_once(reboot_timer, OTA_REBOOT_DELAY_MS * 1000ULL);
+    return ota_get_handler(req);
+}
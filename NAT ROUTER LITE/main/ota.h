@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_netif.h"
+#include "cores.h"
+
+// Actualización del firmware por la web (OTA).
+// POST /ota recibe la imagen en binario y la escribe en la partición OTA inactiva sin pasar por un archivo:
+// dos buffers se alternan entre la tarea del servidor HTTP, que recibe del socket y calcula el SHA-256, y una
+// tarea de escritura que borra y graba la flash sector a sector, así la recepción y la escritura se solapan.
+// Si la cabecera X-Image-SHA256 viene con la petición, la imagen solo se activa si el resumen coincide.
+// La ruta es de administración: solo desde el punto de acceso, con X-Admin-Token y application/octet-stream.
+// La imagen nueva arranca pendiente de verificar: si el router no sigue en marcha con el AP levantado tras
+// OTA_VALIDATE_DELAY_MS, o se reinicia antes, el gestor de arranque vuelve a la imagen anterior.
+// GET /ota muestra el progreso y el tiempo por MB de la última actualización.
+
+// Definiciones de la actualización
+#define OTA_BUFFER_SIZE 4096            // Tamaño de cada uno de los dos buffers (un sector de flash)
+#define OTA_WRITER_PRIORITY 3           // Por debajo del servidor HTTP: escribe mientras este espera al socket
+#define OTA_WRITER_CORE CORE_CONTROL
+#define OTA_WRITER_STACK 4096
+#define OTA_RECV_RETRIES 5              // Esperas del socket (recv_wait_timeout) antes de abandonar
+#define OTA_REBOOT_DELAY_MS 1000        // Margen para enviar la respuesta antes de reiniciar
+#define OTA_VALIDATE_DELAY_MS 60000     // Tiempo en marcha para confirmar una imagen nueva
+
+// Fase de la actualización
+typedef enum
+{
+    OTA_STATE_IDLE = 0,
+    OTA_STATE_RECEIVING,
+    OTA_STATE_VERIFYING,
+    OTA_STATE_DONE,    // Imagen activada, reiniciando
+    OTA_STATE_FAILED,
+} ota_state_t;
+
+// Progreso de la última actualización
+typedef struct
+{
+    ota_state_t state;
+    uint32_t received;   // Bytes recibidos
+    uint32_t written;    // Bytes escritos en la flash
+    uint32_t total;      // Tamaño de la imagen
+    uint32_t elapsed_ms;
+    uint32_t ms_per_mb;  // Tiempo de actualización por MB
+    char sha256[65];     // Resumen de la imagen recibida (hexadecimal)
+    char error[48];      // Motivo del fallo
+} ota_progress_t;
+
+esp_err_t ota_start(esp_netif_t *ap_netif);          // Confirma o revierte una imagen recién actualizada
+void ota_get_progress(ota_progress_t *progress);    // Copia el progreso
+esp_err_t ota_get_handler(httpd_req_t *req);        // GET /ota: imagen en marcha y progreso
+esp_err_t ota_post_handler(httpd_req_t *req);       // POST /ota: recibe y activa una imagen
@@ -0,0 +1,235 @@
+#include "pmtu.h"
+#include "admin.h"
+#include "form.h"
+#include "settings.h"
+#include "esp_log.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+// Estructuras
+typedef struct
+{
+    uint32_t ip;         // Destino en orden de red
+    uint16_t mtu;        // 0: entrada libre
+    uint32_t learned_ms;
+} pmtu_dest_t;
+
+// Tags para logging
+static const char *TAG_PMTU = "PMTU";
+
+// Variables globales
+static portMUX_TYPE pmtu_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint16_t configured_mtu = 0;
+static uint16_t link_mtu = SETTINGS_MTU_MAX;
+static pmtu_dest_t dests[PMTU_MAX_DESTINATIONS];
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint32_t now_ms(void)
+{
+    return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+static inline bool dest_valid(const pmtu_dest_t *dest, uint32_t now)
+{
+    return dest->mtu != 0 && (uint32_t)(now - dest->learned_ms) < PMTU_LEARNED_AGE_MS;
+}
+
+// MTU hacia un destino con pmtu_lock tomado: la configurada manda sobre la aprendida
+static uint16_t dest_mtu(uint32_t ip, uint32_t now)
+{
+    if (configured_mtu != 0)
+    {
+        return configured_mtu;
+    }
+    for (int i = 0; i < PMTU_MAX_DESTINATIONS; i++)
+    {
+        if (dests[i].ip == ip && dest_valid(&dests[i], now))
+        {
+            return MIN(dests[i].mtu, link_mtu);
+        }
+    }
+    return link_mtu;
+}
+
+// Rellena el estado con pmtu_lock tomado
+static void compute(pmtu_state_t *state, uint32_t now)
+{
+    state->configured = configured_mtu;
+    state->link = link_mtu;
+    state->effective = configured_mtu != 0 ? configured_mtu : link_mtu;
+    state->mss = state->effective - PMTU_IPV4_TCP_HLEN;
+    state->learned = 0;
+    state->destinations = 0;
+    for (int i = 0; i < PMTU_MAX_DESTINATIONS; i++)
+    {
+        if (dest_valid(&dests[i], now))
+        {
+            state->learned = state->learned == 0 ? dests[i].mtu : MIN(state->learned, dests[i].mtu);
+            state->destinations++;
+        }
+    }
+}
+
+static void settings_cb(const settings_t *settings, uint32_t changed, void *arg)
+{
+    if (changed & SETTINGS_UPLINK_MTU)
+    {
+        portENTER_CRITICAL(&pmtu_lock);
+        configured_mtu = settings->uplink_mtu;
+        portEXIT_CRITICAL(&pmtu_lock);
+    }
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t pmtu_start(void)
+{
+    settings_t settings;
+    settings_get(&settings);
+    settings_cb(&settings, SETTINGS_UPLINK_MTU, NULL);
+    return settings_subscribe(settings_cb, NULL);
+}
+
+void pmtu_set_link_mtu(uint16_t mtu)
+{
+    if (mtu < SETTINGS_MTU_MIN || mtu > SETTINGS_MTU_MAX)
+    {
+        mtu = SETTINGS_MTU_MAX;
+    }
+
+    portENTER_CRITICAL(&pmtu_lock);
+    link_mtu = mtu;
+    memset(dests, 0, sizeof(dests)); // Las rutas aprendidas pertenecen a la conexión anterior
+    portEXIT_CRITICAL(&pmtu_lock);
+}
+
+void pmtu_learn(uint32_t dst_ip, uint16_t mtu)
+{
+    // Los routers antiguos envían 0 (RFC 1191, sección 5); no se baja del mínimo de IPv4 ante un ICMP falso
+    if (mtu == 0)
+    {
+        return;
+    }
+    if (mtu < SETTINGS_MTU_MIN)
+    {
+        mtu = SETTINGS_MTU_MIN;
+    }
+
+    uint32_t now = now_ms();
+    portENTER_CRITICAL(&pmtu_lock);
+    if (mtu < link_mtu)
+    {
+        // Entrada del destino; si no tiene, una libre o caducada y, si no queda ninguna, la más antigua
+        pmtu_dest_t *dest = NULL;
+        pmtu_dest_t *spare = &dests[0];
+        for (int i = 0; i < PMTU_MAX_DESTINATIONS; i++)
+        {
+            if (dests[i].mtu != 0 && dests[i].ip == dst_ip)
+            {
+                dest = &dests[i];
+                break;
+            }
+            if (dest_valid(spare, now) && (!dest_valid(&dests[i], now) || (int32_t)(dests[i].learned_ms - spare->learned_ms) < 0))
+            {
+                spare = &dests[i];
+            }
+        }
+
+        // Mientras no caduque solo se baja (RFC 1191)
+        if (dest == NULL || !dest_valid(dest, now) || mtu <= dest->mtu)
+        {
+            dest = dest ? dest : spare;
+            dest->ip = dst_ip;
+            dest->mtu = mtu;
+            dest->learned_ms = now;
+        }
+    }
+    portEXIT_CRITICAL(&pmtu_lock);
+}
+
+uint16_t pmtu_mss(uint32_t remote_ip)
+{
+    portENTER_CRITICAL(&pmtu_lock);
+    uint16_t mtu = dest_mtu(remote_ip, now_ms());
+    portEXIT_CRITICAL(&pmtu_lock);
+    return mtu - PMTU_IPV4_TCP_HLEN;
+}
+
+void pmtu_get_state(pmtu_state_t *state)
+{
+    portENTER_CRITICAL(&pmtu_lock);
+    compute(state, now_ms());
+    portEXIT_CRITICAL(&pmtu_lock);
+}
+
+esp_err_t pmtu_get_handler(httpd_req_t *req)
+{
+    pmtu_state_t state;
+    pmtu_dest_t copy[PMTU_MAX_DESTINATIONS];
+    uint32_t now = now_ms();
+    portENTER_CRITICAL(&pmtu_lock);
+    compute(&state, now);
+    memcpy(copy, dests, sizeof(copy));
+    portEXIT_CRITICAL(&pmtu_lock);
+
+    char text[192];
+    snprintf(text, sizeof(text), "configured_mtu %u\nlink_mtu %u\neffective_mtu %u\nmss %u\nlearned_mtu %u\nlearned_destinations %lu\n", state.configured, state.link,
+             state.effective, state.mss, state.learned, state.destinations);
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_send_chunk(req, text, HTTPD_RESP_USE_STRLEN);
+
+    // Una línea por destino: IP, MTU aprendida y antigüedad en segundos
+    for (int i = 0; i < PMTU_MAX_DESTINATIONS; i++)
+    {
+        if (dest_valid(&copy[i], now))
+        {
+            snprintf(text, sizeof(text), "learned " IPSTR " %u %lu\n", IP2STR((esp_ip4_addr_t *)&copy[i].ip), copy[i].mtu, (now - copy[i].learned_ms) / 1000);
+            httpd_resp_send_chunk(req, text, HTTPD_RESP_USE_STRLEN);
+        }
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Campo: mtu (SETTINGS_MTU_MIN a SETTINGS_MTU_MAX, o 0 para volver al modo automático).
+// Solo desde el punto de acceso y con la contraseña de administración (admin.h)
+esp_err_t pmtu_post_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, NULL))
+    {
+        return ESP_FAIL;
+    }
+
+    char mtu_text[6];
+    form_field_t fields[] = {
+        {.name = "mtu", .value = mtu_text, .size = sizeof(mtu_text)},
+    };
+
+    if (form_recv(req, fields, sizeof(fields) / sizeof(fields[0])) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+
+    char *end;
+    unsigned long mtu = strtoul(mtu_text, &end, 10);
+    if (!fields[0].found || fields[0].truncated || end == mtu_text || *end != '\0' || (mtu != 0 && (mtu < SETTINGS_MTU_MIN || mtu > SETTINGS_MTU_MAX)))
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "MTU no válida");
+    }
+
+    esp_err_t err = settings_set_uplink_mtu((uint16_t)mtu);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_PMTU, "Error al cambiar la MTU. Error %s", esp_err_to_name(err));
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Error al guardar la MTU");
+    }
+    return pmtu_get_handler(req);
+}
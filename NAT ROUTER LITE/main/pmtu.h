@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// MTU de la ruta de subida y ajuste del MSS de TCP.
+// La ruta de reenvío reduce la opción MSS de los SYN que cruzan el router (en ambos sentidos) para que los
+// segmentos quepan en la ruta de subida sin fragmentar ni perderse en enlaces que descartan el ICMP. La MTU
+// se configura en /mtu o, en automático, es la de la interfaz WAN salvo para los destinos con una MTU menor
+// aprendida de los ICMP "fragmentation needed" recibidos en la WAN, que caduca como indica el RFC 1191. La ruta
+// de reenvío solo aprende de los ICMP que citan una conexión TCP traducida viva, y la MTU aprendida se aplica
+// únicamente a ese destino.
+
+// Definiciones de la MTU
+#define PMTU_LEARNED_AGE_MS 600000 // Vida de una MTU aprendida por ICMP
+#define PMTU_MAX_DESTINATIONS 16   // Destinos con MTU aprendida; al llenarse se reemplaza el más antiguo
+#define PMTU_IPV4_TCP_HLEN 40      // Cabeceras IPv4 y TCP sin opciones
+
+// Estado de la MTU
+typedef struct
+{
+    uint16_t configured;   // Fijada en la configuración (0 = automática)
+    uint16_t link;         // MTU de la interfaz WAN
+    uint16_t effective;    // MTU aplicada a los destinos sin MTU aprendida
+    uint16_t mss;          // MSS máximo de los SYN hacia esos destinos
+    uint16_t learned;      // Menor MTU aprendida vigente (0 si no hay)
+    uint32_t destinations; // Destinos con MTU aprendida vigente
+} pmtu_state_t;
+
+esp_err_t pmtu_start(void);                     // Carga la MTU configurada y se suscribe a sus cambios
+void pmtu_set_link_mtu(uint16_t mtu);           // MTU de la interfaz WAN, al obtener IP
+void pmtu_learn(uint32_t dst_ip, uint16_t mtu); // MTU hacia dst_ip (orden de red) indicada por un ICMP "fragmentation needed"
+uint16_t pmtu_mss(uint32_t remote_ip);          // MSS máximo para los SYN reenviados desde o hacia remote_ip
+void pmtu_get_state(pmtu_state_t *state);     // Copia el estado actual
+esp_err_t pmtu_get_handler(httpd_req_t *req);  // GET /mtu: MTU y MSS aplicados
+esp_err_t pmtu_post_handler(httpd_req_t *req); // POST /mtu: fija la MTU (mtu=0 automática)
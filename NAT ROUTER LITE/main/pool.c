@@ -0,0 +1,106 @@
+#include "pool.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Tags para logging
+static const char *TAG_POOL = "POOL";
+
+// Variables globales
+static uint8_t small_memory[POOL_SMALL_SIZE * POOL_SMALL_COUNT] __attribute__((aligned(4)));
+static uint8_t medium_memory[POOL_MEDIUM_SIZE * POOL_MEDIUM_COUNT] __attribute__((aligned(4)));
+static uint8_t large_memory[POOL_LARGE_SIZE * POOL_LARGE_COUNT] __attribute__((aligned(4)));
+static pool_t pools[POOL_CLASSES] = {
+    {.memory = small_memory, .block_size = POOL_SMALL_SIZE, .blocks = POOL_SMALL_COUNT},
+    {.memory = medium_memory, .block_size = POOL_MEDIUM_SIZE, .blocks = POOL_MEDIUM_COUNT},
+    {.memory = large_memory, .block_size = POOL_LARGE_SIZE, .blocks = POOL_LARGE_COUNT},
+};
+static portMUX_TYPE pool_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void pool_init(void)
+{
+    portENTER_CRITICAL(&pool_lock);
+    pool_core_init(pools, POOL_CLASSES);
+    portEXIT_CRITICAL(&pool_lock);
+
+    ESP_LOGI(TAG_POOL, "Pools de bloques listas: %u bytes", (unsigned)(sizeof(small_memory) + sizeof(medium_memory) + sizeof(large_memory)));
+}
+
+void *pool_alloc(size_t size)
+{
+    portENTER_CRITICAL(&pool_lock);
+    void *ptr = pool_core_alloc(pools, POOL_CLASSES, size);
+    portEXIT_CRITICAL(&pool_lock);
+
+    // Mayor que cualquier bloque o con las pools llenas
+    return ptr != NULL ? ptr : malloc(size);
+}
+
+void pool_free(void *ptr)
+{
+    if (ptr == NULL)
+    {
+        return;
+    }
+
+    portENTER_CRITICAL(&pool_lock);
+    bool pooled = pool_core_free(pools, POOL_CLASSES, ptr);
+    portEXIT_CRITICAL(&pool_lock);
+    if (!pooled)
+    {
+        free(ptr);
+    }
+}
+
+void pool_get_stats(pool_stats_t stats[POOL_CLASSES])
+{
+    portENTER_CRITICAL(&pool_lock);
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        stats[i] = pools[i].stats;
+    }
+    portEXIT_CRITICAL(&pool_lock);
+}
+
+void pool_get_heap_info(pool_heap_info_t *info)
+{
+    multi_heap_info_t heap;
+    heap_caps_get_info(&heap, MALLOC_CAP_8BIT | MALLOC_CAP_INTERNAL);
+
+    info->free_bytes = heap.total_free_bytes;
+    info->min_free_bytes = heap.minimum_free_bytes;
+    info->largest_free_block = heap.largest_free_block;
+    info->free_blocks = heap.free_blocks;
+    info->fragmentation = heap.total_free_bytes ? 1.0f - (float)heap.largest_free_block / heap.total_free_bytes : 0.0f;
+}
+
+esp_err_t pool_heap_handler(httpd_req_t *req)
+{
+    pool_heap_info_t heap;
+    pool_stats_t stats[POOL_CLASSES];
+    pool_get_heap_info(&heap);
+    pool_get_stats(stats);
+
+    char line[160];
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    snprintf(line, sizeof(line), "heap_free %lu\nheap_min_free %lu\nlargest_free_block %lu\nfree_blocks %lu\nfragmentation %.3f\n", heap.free_bytes, heap.min_free_bytes,
+             heap.largest_free_block, heap.free_blocks, heap.fragmentation);
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        const pool_stats_t *pool = &stats[i];
+        snprintf(line, sizeof(line), "pool %lu blocks %lu in_use %lu high_water %lu allocs %lu fallbacks %lu\n", pool->block_size, pool->blocks, pool->in_use, pool->high_water,
+                 pool->allocs, pool->fallbacks);
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "pool_core.h"
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Bloques de tamaño fijo para las reservas pequeñas y frecuentes.
+// Las respuestas de la caché DNS, las consultas pendientes y los buffers de las estadísticas de tareas se
+// reservan y liberan continuamente; en el heap general acaban partiéndolo en huecos pequeños. Estas pools
+// están en memoria estática (reservada al enlazar) y cada una tiene una lista de bloques libres, así que
+// reservar y liberar cuesta O(1) y no mueve el heap. Si la clase adecuada está llena se usa la siguiente y,
+// como último recurso, el heap (contado como fallback). /heap muestra el uso de cada pool y la fragmentación.
+
+// Estado del heap general (memoria interna de 8 bits)
+typedef struct
+{
+    uint32_t free_bytes;
+    uint32_t min_free_bytes;
+    uint32_t largest_free_block;
+    uint32_t free_blocks;
+    float fragmentation; // 1 - bloque libre mayor / memoria libre
+} pool_heap_info_t;
+
+void pool_init(void);                              // Enlaza los bloques libres de cada pool (al arrancar)
+void *pool_alloc(size_t size);                     // Bloque de al menos size bytes, NULL si no hay memoria
+void pool_free(void *ptr);                         // Devuelve un bloque de pool_alloc (admite NULL)
+void pool_get_stats(pool_stats_t stats[POOL_CLASSES]); // Copia los contadores de las pools
+void pool_get_heap_info(pool_heap_info_t *info);   // Estado del heap general
+esp_err_t pool_heap_handler(httpd_req_t *req);     // GET /heap: heap y pools
@@ -0,0 +1,90 @@
+#include "pool_core.h"
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Pool a la que pertenece un puntero, NULL si no es de ninguna
+static pool_t *pool_of(pool_t *pools, int count, const void *ptr)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const uint8_t *start = pools[i].memory;
+        if ((const uint8_t *)ptr >= start && (const uint8_t *)ptr < start + pools[i].block_size * pools[i].blocks)
+        {
+            return &pools[i];
+        }
+    }
+    return NULL;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void pool_core_init(pool_t *pools, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        pool_t *pool = &pools[i];
+        pool->free_list = NULL;
+        for (int n = pool->blocks - 1; n >= 0; n--)
+        {
+            pool_block_t *block = (pool_block_t *)(pool->memory + n * pool->block_size);
+            block->next = pool->free_list;
+            pool->free_list = block;
+        }
+        pool->stats = (pool_stats_t){.block_size = pool->block_size, .blocks = pool->blocks};
+    }
+}
+
+void *pool_core_alloc(pool_t *pools, int count, size_t size)
+{
+    pool_t *wanted = NULL; // Menor clase en la que cabe
+    pool_t *served = NULL; // Clase que tiene un bloque libre
+
+    for (int i = 0; i < count && served == NULL; i++)
+    {
+        if (size > pools[i].block_size)
+        {
+            continue;
+        }
+        if (wanted == NULL)
+        {
+            wanted = &pools[i];
+        }
+        if (pools[i].free_list != NULL)
+        {
+            served = &pools[i];
+        }
+    }
+
+    void *ptr = NULL;
+    if (served != NULL)
+    {
+        ptr = served->free_list;
+        served->free_list = served->free_list->next;
+        served->stats.allocs++;
+        served->stats.in_use++;
+        if (served->stats.in_use > served->stats.high_water)
+        {
+            served->stats.high_water = served->stats.in_use;
+        }
+    }
+    if (wanted != NULL && served != wanted)
+    {
+        wanted->stats.fallbacks++;
+    }
+    return ptr;
+}
+
+bool pool_core_free(pool_t *pools, int count, void *ptr)
+{
+    pool_t *pool = pool_of(pools, count, ptr);
+    if (pool == NULL)
+    {
+        return false;
+    }
+
+    pool_block_t *block = (pool_block_t *)ptr;
+    block->next = pool->free_list;
+    pool->free_list = block;
+    pool->stats.in_use--;
+    return true;
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Núcleo de las pools de bloques: listas de bloques libres y elección de clase.
+// Cada pool reparte bloques de una memoria que pone quien la usa; una reserva va a la menor clase en la que
+// cabe y, si está llena, a la siguiente. No depende de ESP-IDF para poder compilarse en el host
+// (tools/pool_soak.c); el bloqueo y el recurso al heap quedan en pool.c.
+
+// Definiciones de las pools (tamaño de bloque múltiplo de 4)
+#define POOL_SMALL_SIZE 256   // Respuestas DNS típicas y consultas pendientes
+#define POOL_SMALL_COUNT 32
+#define POOL_MEDIUM_SIZE 640  // Respuestas DNS con varios registros
+#define POOL_MEDIUM_COUNT 12
+#define POOL_LARGE_SIZE 1536  // Respuestas DNS grandes (EDNS) y buffers de las estadísticas de tareas
+#define POOL_LARGE_COUNT 4
+#define POOL_CLASSES 3
+
+// Contadores de una pool
+typedef struct
+{
+    uint32_t block_size;
+    uint32_t blocks;
+    uint32_t in_use;
+    uint32_t high_water; // Máximo de bloques en uso a la vez
+    uint32_t allocs;     // Reservas servidas por la pool
+    uint32_t fallbacks;  // Reservas de esta clase servidas por una clase mayor o por el heap
+} pool_stats_t;
+
+// Estructuras
+typedef struct pool_block
+{
+    struct pool_block *next; // Solo mientras el bloque está libre
+} pool_block_t;
+
+typedef struct
+{
+    uint8_t *memory;
+    uint32_t block_size;
+    uint32_t blocks;
+    pool_block_t *free_list;
+    pool_stats_t stats;
+} pool_t;
+
+void pool_core_init(pool_t *pools, int count);                    // Enlaza los bloques libres de cada pool (de menor a mayor bloque)
+void *pool_core_alloc(pool_t *pools, int count, size_t size);     // Bloque de al menos size bytes, NULL si no cabe en ninguna pool libre
+bool pool_core_free(pool_t *pools, int count, void *ptr);         // Devuelve un bloque a su pool, false si no es de ninguna
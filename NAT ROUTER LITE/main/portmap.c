@@ -0,0 +1,334 @@
+#include "portmap.h"
+#include "admin.h"
+#include "form.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "lwip/opt.h"
+#include "lwip/lwip_napt.h"
+#include "lwip/prot/ip4.h"
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Tags para logging
+static const char *TAG_PORTMAP = "PORTMAP";
+
+// Variables globales
+static esp_netif_t *ap = NULL;
+static portMUX_TYPE portmap_lock = portMUX_INITIALIZER_UNLOCKED;
+static settings_portmap_rule_t rules[SETTINGS_PORTMAP_MAX_RULES]; // Copia de la configuración, ordenada por clave
+static uint32_t hits[SETTINGS_PORTMAP_MAX_RULES];
+static int rule_count = 0;
+static uint32_t mapped_ip = 0; // IP de la STA para la que deben estar instaladas (0 sin IP)
+
+// Solo se usan en la tarea TCP/IP
+static settings_portmap_rule_t installed[SETTINGS_PORTMAP_MAX_RULES];
+static int installed_count = 0;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static inline uint32_t rule_key(uint8_t proto, uint16_t port)
+{
+    return ((uint32_t)proto << 16) | port;
+}
+
+// Primera posición cuya clave no es menor que key
+static int lower_bound(const settings_portmap_rule_t *list, int count, uint32_t key)
+{
+    int low = 0, high = count;
+    while (low < high)
+    {
+        int mid = (low + high) / 2;
+        if (rule_key(list[mid].proto, list[mid].ext_port) < key)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+static inline const char *proto_name(uint8_t proto)
+{
+    return proto == IP_PROTO_TCP ? "tcp" : "udp";
+}
+
+// Copia las reglas de la configuración conservando los contadores de las que no cambian de clave
+static void load_rules(const settings_portmap_t *portmap)
+{
+    uint32_t new_hits[SETTINGS_PORTMAP_MAX_RULES];
+
+    portENTER_CRITICAL(&portmap_lock);
+    for (int i = 0; i < portmap->rule_count; i++)
+    {
+        uint32_t key = rule_key(portmap->rules[i].proto, portmap->rules[i].ext_port);
+        int index = lower_bound(rules, rule_count, key);
+        new_hits[i] = (index < rule_count && rule_key(rules[index].proto, rules[index].ext_port) == key) ? hits[index] : 0;
+    }
+    memcpy(rules, portmap->rules, portmap->rule_count * sizeof(rules[0]));
+    memcpy(hits, new_hits, portmap->rule_count * sizeof(hits[0]));
+    rule_count = portmap->rule_count;
+    portEXIT_CRITICAL(&portmap_lock);
+}
+
+// Sustituye las reglas instaladas en lwIP por las actuales (tarea TCP/IP)
+static esp_err_t install_cb(void *ctx)
+{
+#if IP_NAPT && IP_NAPT_PORTMAP
+    for (int i = 0; i < installed_count; i++)
+    {
+        ip_portmap_remove(installed[i].proto, installed[i].ext_port);
+    }
+    installed_count = 0;
+
+    settings_portmap_rule_t current[SETTINGS_PORTMAP_MAX_RULES];
+    portENTER_CRITICAL(&portmap_lock);
+    uint32_t ip = mapped_ip;
+    int count = rule_count;
+    memcpy(current, rules, count * sizeof(current[0]));
+    portEXIT_CRITICAL(&portmap_lock);
+
+    if (ip == 0)
+    {
+        return ESP_OK;
+    }
+
+    for (int i = 0; i < count; i++)
+    {
+        if (ip_portmap_add(current[i].proto, ip, current[i].ext_port, current[i].int_ip, current[i].int_port))
+        {
+            installed[installed_count++] = current[i];
+        }
+        else
+        {
+            ESP_LOGE(TAG_PORTMAP, "Error al instalar la regla %s %u", proto_name(current[i].proto), current[i].ext_port);
+        }
+    }
+    ESP_LOGI(TAG_PORTMAP, "Reglas de redirección instaladas: %d", installed_count);
+#else
+    ESP_LOGW(TAG_PORTMAP, "La redirección de puertos no está habilitada en la configuración de lwIP");
+#endif
+    return ESP_OK;
+}
+
+static void sync_rules(void)
+{
+    esp_err_t err = esp_netif_tcpip_exec(install_cb, NULL);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_PORTMAP, "Error al instalar las reglas de redirección. Error %s", esp_err_to_name(err));
+    }
+}
+
+static void settings_cb(const settings_t *settings, uint32_t changed, void *arg)
+{
+    if (changed & SETTINGS_PORTMAP)
+    {
+        load_rules(&settings->portmap);
+        sync_rules();
+    }
+}
+
+// Lee un puerto entre 1 y 65535
+static bool parse_port(const char *text, uint16_t *port)
+{
+    char *end;
+    unsigned long value = strtoul(text, &end, 10);
+    if (*text == '\0' || *end != '\0' || value == 0 || value > 65535)
+    {
+        return false;
+    }
+    *port = value;
+    return true;
+}
+
+// Añade, cambia o quita (remove) la regla en una copia de las reglas y la guarda. Aparte del manejador para que la
+// copia deje la pila antes de responder con portmap_get_handler; ESP_ERR_NO_MEM si no caben más reglas
+static __attribute__((noinline)) esp_err_t update_rules(const settings_portmap_rule_t *rule, bool remove)
+{
+    settings_portmap_t portmap;
+    settings_get_portmap(&portmap);
+
+    int index = lower_bound(portmap.rules, portmap.rule_count, rule_key(rule->proto, rule->ext_port));
+    bool exists = index < portmap.rule_count && portmap.rules[index].proto == rule->proto && portmap.rules[index].ext_port == rule->ext_port;
+
+    if (remove)
+    {
+        if (!exists)
+        {
+            return ESP_OK;
+        }
+        memmove(&portmap.rules[index], &portmap.rules[index + 1], (portmap.rule_count - index - 1) * sizeof(portmap.rules[0]));
+        portmap.rule_count--;
+    }
+    else
+    {
+        if (!exists)
+        {
+            if (portmap.rule_count == SETTINGS_PORTMAP_MAX_RULES)
+            {
+                return ESP_ERR_NO_MEM;
+            }
+            memmove(&portmap.rules[index + 1], &portmap.rules[index], (portmap.rule_count - index) * sizeof(portmap.rules[0]));
+            portmap.rule_count++;
+        }
+        portmap.rules[index] = *rule;
+    }
+    return settings_set_portmap(&portmap);
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t portmap_start(esp_netif_t *ap_netif)
+{
+    ap = ap_netif;
+
+    settings_portmap_t portmap;
+    settings_get_portmap(&portmap);
+    load_rules(&portmap);
+    return settings_subscribe(settings_cb, NULL);
+}
+
+void portmap_apply(uint32_t sta_ip)
+{
+    portENTER_CRITICAL(&portmap_lock);
+    mapped_ip = sta_ip;
+    portEXIT_CRITICAL(&portmap_lock);
+
+    sync_rules();
+}
+
+void portmap_hit(uint8_t proto, uint16_t port)
+{
+    if (__atomic_load_n(&rule_count, __ATOMIC_RELAXED) == 0)
+    {
+        return;
+    }
+
+    uint32_t key = rule_key(proto, port);
+    portENTER_CRITICAL(&portmap_lock);
+    int index = lower_bound(rules, rule_count, key);
+    if (index < rule_count && rule_key(rules[index].proto, rules[index].ext_port) == key)
+    {
+        hits[index]++;
+    }
+    portEXIT_CRITICAL(&portmap_lock);
+}
+
+int portmap_get_stats(portmap_rule_stats_t *stats, int max)
+{
+    int count = 0;
+    portENTER_CRITICAL(&portmap_lock);
+    for (; count < rule_count && count < max; count++)
+    {
+        stats[count].rule = rules[count];
+        stats[count].hits = hits[count];
+    }
+    portEXIT_CRITICAL(&portmap_lock);
+    return count;
+}
+
+esp_err_t portmap_get_handler(httpd_req_t *req)
+{
+    portmap_rule_stats_t stats[SETTINGS_PORTMAP_MAX_RULES];
+    int count = portmap_get_stats(stats, SETTINGS_PORTMAP_MAX_RULES);
+    uint32_t ip = __atomic_load_n(&mapped_ip, __ATOMIC_RELAXED);
+
+    char line[96];
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    snprintf(line, sizeof(line), "external_ip " IPSTR "\n", IP2STR((esp_ip4_addr_t *)&ip));
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    for (int i = 0; i < count; i++)
+    {
+        const settings_portmap_rule_t *rule = &stats[i].rule;
+        snprintf(line, sizeof(line), "rule %s %u " IPSTR " %u hits %lu\n", proto_name(rule->proto), rule->ext_port, IP2STR((esp_ip4_addr_t *)&rule->int_ip), rule->int_port, stats[i].hits);
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Campos: proto (tcp/udp), port, ip y to_port (por defecto igual a port); con remove=1 se quita la regla de proto y port.
+// Solo desde el punto de acceso y con la contraseña de administración (admin.h)
+esp_err_t portmap_post_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, NULL))
+    {
+        return ESP_FAIL;
+    }
+
+    char proto_text[4], port_text[6], ip_text[16], to_port_text[6], remove[2];
+    form_field_t fields[] = {
+        {.name = "proto", .value = proto_text, .size = sizeof(proto_text)},
+        {.name = "port", .value = port_text, .size = sizeof(port_text)},
+        {.name = "ip", .value = ip_text, .size = sizeof(ip_text)},
+        {.name = "to_port", .value = to_port_text, .size = sizeof(to_port_text)},
+        {.name = "remove", .value = remove, .size = sizeof(remove)},
+    };
+    const int field_count = sizeof(fields) / sizeof(fields[0]);
+
+    if (form_recv(req, fields, field_count) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < field_count; i++)
+    {
+        if (fields[i].truncated)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Valor demasiado largo");
+        }
+    }
+
+    settings_portmap_rule_t rule = {0};
+    if (strcasecmp(proto_text, "tcp") == 0)
+    {
+        rule.proto = IP_PROTO_TCP;
+    }
+    else if (strcasecmp(proto_text, "udp") == 0)
+    {
+        rule.proto = IP_PROTO_UDP;
+    }
+    else
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Protocolo no válido");
+    }
+    if (!parse_port(port_text, &rule.ext_port))
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Puerto no válido");
+    }
+
+    bool removing = fields[4].found && remove[0] == '1';
+    if (!removing)
+    {
+        // El destino tiene que ser un cliente de la red del AP
+        esp_netif_ip_info_t ap_ip;
+        rule.int_ip = esp_ip4addr_aton(ip_text);
+        if (esp_netif_get_ip_info(ap, &ap_ip) != ESP_OK || rule.int_ip == ap_ip.ip.addr ||
+            (rule.int_ip & ap_ip.netmask.addr) != (ap_ip.ip.addr & ap_ip.netmask.addr))
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "IP no válida");
+        }
+        rule.int_port = rule.ext_port;
+        if (fields[3].found && !parse_port(to_port_text, &rule.int_port))
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Puerto de destino no válido");
+        }
+    }
+
+    esp_err_t err = update_rules(&rule, removing);
+    if (err == ESP_ERR_NO_MEM)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No caben más reglas");
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Error al guardar las reglas");
+    }
+    return portmap_get_handler(req);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_netif.h"
+#include "settings.h"
+
+// Redirección de puertos desde la red de subida hacia los clientes del AP.
+// Las reglas se guardan en la configuración (settings.h) ordenadas por protocolo y puerto, y se instalan en la
+// tabla de redirección de la NAPT de lwIP (ip_portmap_add) cada vez que la STA obtiene IP o cambian las reglas.
+// La ruta de reenvío cuenta los paquetes entrantes de cada regla con una búsqueda binaria (O(log n)).
+
+// Contadores de una regla
+typedef struct
+{
+    settings_portmap_rule_t rule;
+    uint32_t hits; // Paquetes recibidos en la STA para la regla
+} portmap_rule_stats_t;
+
+esp_err_t portmap_start(esp_netif_t *ap_netif);                 // Carga las reglas y se suscribe a sus cambios
+void portmap_apply(uint32_t sta_ip);                            // Instala las reglas para la IP de la STA (0 las retira)
+void portmap_hit(uint8_t proto, uint16_t port);                 // Cuenta un paquete entrante al puerto port (orden de host)
+int portmap_get_stats(portmap_rule_stats_t *stats, int max);    // Copia las reglas con sus contadores y devuelve cuántas
+esp_err_t portmap_get_handler(httpd_req_t *req);                // GET /portmap: reglas actuales
+esp_err_t portmap_post_handler(httpd_req_t *req);               // POST /portmap: añade, cambia o quita una regla
@@ -0,0 +1,718 @@
+#include "selftest.h"
+#include "admin.h"
+#include "form.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "lwip/inet.h"
+#include "lwip/sockets.h"
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Cabecera de los datagramas UDP (la de iperf 2, en orden de red)
+#define SELFTEST_UDP_HEADER 12
+
+// Tags para logging
+static const char *TAG_SELFTEST = "SELFTEST";
+
+static const char *state_names[] = {
+    [SELFTEST_STATE_IDLE] = "idle",
+    [SELFTEST_STATE_WAITING] = "waiting",
+    [SELFTEST_STATE_RUNNING] = "running",
+    [SELFTEST_STATE_DONE] = "done",
+    [SELFTEST_STATE_FAILED] = "failed",
+};
+
+static const char *iface_names[] = {
+    [SELFTEST_IFACE_AP] = "ap",
+    [SELFTEST_IFACE_STA] = "sta",
+    [SELFTEST_IFACE_ETH] = "eth",
+};
+
+// Variables globales
+static portMUX_TYPE selftest_lock = portMUX_INITIALIZER_UNLOCKED;
+static selftest_result_t result;
+static bool busy = false;
+static volatile bool stop_requested = false;
+static esp_netif_t *ap = NULL;
+static esp_netif_t *sta = NULL;
+static esp_netif_t *eth = NULL;
+
+// Solo durante una prueba (tarea de la prueba)
+static selftest_config_t config;
+static uint32_t local_ip = 0;
+static uint8_t *buffer = NULL;
+static int64_t start_us = 0;
+static uint64_t idle_start[portNUM_PROCESSORS];
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Tiempo de CPU de la tarea inactiva de cada núcleo
+static void sample_idle(uint64_t idle[portNUM_PROCESSORS])
+{
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        idle[core] = ulTaskGetRunTimeCounter(xTaskGetIdleTaskHandleForCore(core));
+    }
+}
+
+static void set_state(selftest_state_t state)
+{
+    portENTER_CRITICAL(&selftest_lock);
+    result.state = state;
+    portEXIT_CRITICAL(&selftest_lock);
+}
+
+// Empieza a medir con el primer dato o la conexión
+static void begin_measure(uint32_t peer_ip)
+{
+    start_us = esp_timer_get_time();
+    sample_idle(idle_start);
+
+    portENTER_CRITICAL(&selftest_lock);
+    result.state = SELFTEST_STATE_RUNNING;
+    result.config.peer_ip = peer_ip;
+    portEXIT_CRITICAL(&selftest_lock);
+}
+
+// Publica los contadores para GET /selftest
+static void publish(uint64_t bytes, uint32_t packets, uint32_t lost, uint32_t out_of_order, uint32_t jitter_us)
+{
+    portENTER_CRITICAL(&selftest_lock);
+    result.bytes = bytes;
+    result.packets = packets;
+    result.lost = lost;
+    result.out_of_order = out_of_order;
+    result.jitter_us = jitter_us;
+    portEXIT_CRITICAL(&selftest_lock);
+}
+
+// Cierra la medida: tiempo, tasa y uso de CPU de cada núcleo
+static void end_measure(int64_t end_us)
+{
+    uint64_t idle_end[portNUM_PROCESSORS];
+    sample_idle(idle_end);
+    uint32_t elapsed_ms = start_us ? (end_us - start_us) / 1000 : 0;
+
+    portENTER_CRITICAL(&selftest_lock);
+    result.elapsed_ms = elapsed_ms;
+    result.kbps = elapsed_ms ? result.bytes * 8 / elapsed_ms : 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        float idle = elapsed_ms ? (float)(idle_end[core] - idle_start[core]) / (elapsed_ms * 1000.0f) : 1.0f;
+        result.cpu[core] = idle < 1.0f ? 100.0f * (1.0f - idle) : 0.0f;
+    }
+    portEXIT_CRITICAL(&selftest_lock);
+}
+
+static void set_error(const char *error)
+{
+    ESP_LOGE(TAG_SELFTEST, "Prueba fallida: %s (errno %d)", error, errno);
+    portENTER_CRITICAL(&selftest_lock);
+    snprintf(result.error, sizeof(result.error), "%s", error);
+    portEXIT_CRITICAL(&selftest_lock);
+}
+
+static bool waited_too_long(int64_t since_us)
+{
+    return esp_timer_get_time() - since_us >= SELFTEST_WAIT_MS * 1000LL;
+}
+
+static bool is_timeout(void)
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+// Socket en la IP de la interfaz; el timeout permite comprobar stop_requested mientras espera
+static int open_socket(uint16_t port)
+{
+    bool tcp = config.proto == SELFTEST_TCP;
+    int sock = socket(AF_INET, tcp ? SOCK_STREAM : SOCK_DGRAM, tcp ? IPPROTO_TCP : IPPROTO_UDP);
+    if (sock < 0)
+    {
+        return -1;
+    }
+
+    int enable = 1;
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = SELFTEST_POLL_MS * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = local_ip,
+    };
+    if (bind(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(sock);
+        return -1;
+    }
+    return sock;
+}
+
+// Conexión TCP sin bloquear para poder abandonar con stop_requested o SELFTEST_WAIT_MS
+static bool connect_peer(int sock)
+{
+    struct sockaddr_in peer = {
+        .sin_family = AF_INET,
+        .sin_port = htons(config.port),
+        .sin_addr.s_addr = config.peer_ip,
+    };
+
+    int flags = fcntl(sock, F_GETFL, 0);
+    fcntl(sock, F_SETFL, flags | O_NONBLOCK);
+    int err = connect(sock, (struct sockaddr *)&peer, sizeof(peer));
+    if (err < 0 && errno != EINPROGRESS)
+    {
+        return false;
+    }
+
+    int64_t since_us = esp_timer_get_time();
+    while (err < 0)
+    {
+        if (stop_requested || waited_too_long(since_us))
+        {
+            return false;
+        }
+
+        fd_set writable;
+        FD_ZERO(&writable);
+        FD_SET(sock, &writable);
+        struct timeval timeout = {.tv_sec = 0, .tv_usec = SELFTEST_POLL_MS * 1000};
+        if (select(sock + 1, NULL, &writable, NULL, &timeout) > 0)
+        {
+            int sock_err = 0;
+            socklen_t len = sizeof(sock_err);
+            getsockopt(sock, SOL_SOCKET, SO_ERROR, &sock_err, &len);
+            if (sock_err != 0)
+            {
+                errno = sock_err;
+                return false;
+            }
+            err = 0;
+        }
+    }
+
+    fcntl(sock, F_SETFL, flags);
+    return true;
+}
+
+static bool tcp_sink(int listen_sock)
+{
+    if (listen(listen_sock, 1) < 0)
+    {
+        set_error("Error al escuchar");
+        return false;
+    }
+
+    // accept respeta SO_RCVTIMEO
+    struct sockaddr_in peer;
+    socklen_t peer_len = sizeof(peer);
+    int sock = -1;
+    int64_t since_us = esp_timer_get_time();
+    while (sock < 0)
+    {
+        if (stop_requested || waited_too_long(since_us))
+        {
+            set_error(stop_requested ? "Detenida" : "Nadie se ha conectado");
+            return false;
+        }
+        sock = accept(listen_sock, (struct sockaddr *)&peer, &peer_len);
+    }
+
+    struct timeval timeout = {.tv_sec = 0, .tv_usec = SELFTEST_POLL_MS * 1000};
+    setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    begin_measure(peer.sin_addr.s_addr);
+
+    uint64_t bytes = 0;
+    int64_t last_us = start_us;
+    int64_t end_us = start_us + config.duration_s * 1000000LL;
+    while (!stop_requested)
+    {
+        int len = recv(sock, buffer, SELFTEST_BUFFER_SIZE, 0);
+        int64_t now = esp_timer_get_time();
+        if (len > 0)
+        {
+            bytes += len;
+            last_us = now;
+            publish(bytes, 0, 0, 0, 0);
+        }
+        else if (len == 0 || !is_timeout())
+        {
+            break; // El otro extremo ha terminado
+        }
+        if (now >= end_us || now - last_us >= SELFTEST_IDLE_MS * 1000LL)
+        {
+            break;
+        }
+    }
+
+    close(sock);
+    end_measure(last_us);
+    return true;
+}
+
+static bool tcp_source(int sock)
+{
+    if (!connect_peer(sock))
+    {
+        set_error(stop_requested ? "Detenida" : "No se ha podido conectar");
+        return false;
+    }
+    begin_measure(config.peer_ip);
+
+    memset(buffer, 0, SELFTEST_BUFFER_SIZE);
+    uint64_t bytes = 0;
+    int64_t end_us = start_us + config.duration_s * 1000000LL;
+    bool ok = true;
+    while (!stop_requested && esp_timer_get_time() < end_us)
+    {
+        int len = send(sock, buffer, SELFTEST_BUFFER_SIZE, 0);
+        if (len > 0)
+        {
+            bytes += len;
+            publish(bytes, 0, 0, 0, 0);
+        }
+        else if (!is_timeout())
+        {
+            set_error("El otro extremo ha cerrado");
+            ok = false;
+            break;
+        }
+    }
+
+    end_measure(esp_timer_get_time());
+    return ok;
+}
+
+static bool udp_sink(int sock)
+{
+    uint64_t bytes = 0;
+    uint32_t packets = 0, lost = 0, out_of_order = 0;
+    uint32_t next_seq = 0;
+    int64_t last_us = 0, end_us = 0;
+    int64_t prev_transit = 0;
+    uint32_t jitter = 0; // En 1/16 de microsegundo (RFC 3550, sección 6.4.1)
+    int64_t since_us = esp_timer_get_time();
+
+    while (!stop_requested)
+    {
+        struct sockaddr_in peer;
+        socklen_t peer_len = sizeof(peer);
+        int len = recvfrom(sock, buffer, SELFTEST_BUFFER_SIZE, 0, (struct sockaddr *)&peer, &peer_len);
+        int64_t now = esp_timer_get_time();
+        if (len < 0)
+        {
+            if (!is_timeout())
+            {
+                set_error("Error al recibir");
+                return false;
+            }
+            if (packets == 0 && waited_too_long(since_us))
+            {
+                set_error("No ha llegado ningún datagrama");
+                return false;
+            }
+            if (packets > 0 && now - last_us >= SELFTEST_IDLE_MS * 1000LL)
+            {
+                break;
+            }
+            continue;
+        }
+        if (len < SELFTEST_UDP_HEADER)
+        {
+            continue;
+        }
+
+        if (packets == 0)
+        {
+            begin_measure(peer.sin_addr.s_addr);
+            end_us = start_us + config.duration_s * 1000000LL;
+        }
+
+        uint32_t word[3];
+        memcpy(word, buffer, sizeof(word));
+        int32_t seq = (int32_t)ntohl(word[0]);
+        int64_t sent_us = (int64_t)ntohl(word[1]) * 1000000 + ntohl(word[2]);
+        bool last = seq < 0; // iperf 2 marca el final con la secuencia en negativo
+        uint32_t useq = last ? -seq : seq;
+
+        bytes += len;
+        packets++;
+        last_us = now;
+        if (useq >= next_seq)
+        {
+            lost += useq - next_seq;
+            next_seq = useq + 1;
+        }
+        else
+        {
+            out_of_order++;
+            if (lost > 0)
+            {
+                lost--;
+            }
+        }
+
+        // Solo cuenta la variación del tiempo de tránsito: los relojes de los dos extremos no tienen que coincidir
+        int64_t transit = now - sent_us;
+        if (packets > 1)
+        {
+            int64_t d = transit > prev_transit ? transit - prev_transit : prev_transit - transit;
+            jitter += d - ((jitter + 8) >> 4);
+        }
+        prev_transit = transit;
+        publish(bytes, packets, lost, out_of_order, jitter >> 4);
+
+        if (last || now >= end_us)
+        {
+            break;
+        }
+    }
+
+    end_measure(last_us ? last_us : esp_timer_get_time());
+    return true;
+}
+
+static bool udp_source(int sock)
+{
+    struct sockaddr_in peer = {
+        .sin_family = AF_INET,
+        .sin_port = htons(config.port),
+        .sin_addr.s_addr = config.peer_ip,
+    };
+    if (connect(sock, (struct sockaddr *)&peer, sizeof(peer)) < 0)
+    {
+        set_error("No se ha podido conectar");
+        return false;
+    }
+    begin_measure(config.peer_ip);
+
+    memset(buffer, 0, SELFTEST_UDP_PAYLOAD);
+    uint64_t bytes = 0;
+    uint32_t packets = 0;
+    int64_t end_us = start_us + config.duration_s * 1000000LL;
+    int64_t now;
+    while (!stop_requested && (now = esp_timer_get_time()) < end_us)
+    {
+        // Ritmo: si va por delante de la tasa pedida, cede un tick
+        if (bytes * 8000 >= (uint64_t)config.rate_kbps * (now - start_us))
+        {
+            vTaskDelay(1);
+            continue;
+        }
+
+        uint32_t word[3] = {htonl(packets), htonl(now / 1000000), htonl(now % 1000000)};
+        memcpy(buffer, word, sizeof(word));
+        if (send(sock, buffer, SELFTEST_UDP_PAYLOAD, 0) == SELFTEST_UDP_PAYLOAD)
+        {
+            bytes += SELFTEST_UDP_PAYLOAD;
+            packets++;
+            publish(bytes, packets, 0, 0, 0);
+        }
+        else
+        {
+            vTaskDelay(1); // Sin buffers en lwIP o el WiFi
+        }
+    }
+    end_measure(esp_timer_get_time());
+
+    // Fin de la prueba al estilo de iperf 2, repetido por si se pierde alguno
+    now = esp_timer_get_time();
+    uint32_t word[3] = {htonl(-(int32_t)packets), htonl(now / 1000000), htonl(now % 1000000)};
+    memcpy(buffer, word, sizeof(word));
+    for (int i = 0; i < 3; i++)
+    {
+        send(sock, buffer, SELFTEST_UDP_PAYLOAD, 0);
+    }
+    return true;
+}
+
+static void selftest_task(void *arg)
+{
+    bool sink = config.mode == SELFTEST_SINK;
+    int sock = open_socket(sink ? config.port : 0);
+    bool ok = false;
+    if (sock < 0)
+    {
+        set_error("Error al abrir el socket");
+    }
+    else if (config.proto == SELFTEST_TCP)
+    {
+        ok = sink ? tcp_sink(sock) : tcp_source(sock);
+    }
+    else
+    {
+        ok = sink ? udp_sink(sock) : udp_source(sock);
+    }
+
+    if (sock >= 0)
+    {
+        close(sock);
+    }
+    free(buffer);
+    buffer = NULL;
+
+    selftest_result_t done;
+    portENTER_CRITICAL(&selftest_lock);
+    result.state = ok ? SELFTEST_STATE_DONE : SELFTEST_STATE_FAILED;
+    done = result;
+    busy = false;
+    portEXIT_CRITICAL(&selftest_lock);
+
+    if (ok)
+    {
+        ESP_LOGI(TAG_SELFTEST, "Prueba terminada: %llu bytes en %lu ms, %lu kbit/s, perdidos %lu, jitter %lu us, CPU %.1f%% / %.1f%%", done.bytes, done.elapsed_ms, done.kbps,
+                 done.lost, done.jitter_us, done.cpu[0], done.cpu[portNUM_PROCESSORS - 1]);
+    }
+    vTaskDelete(NULL);
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t selftest_start(esp_netif_t *ap_netif, esp_netif_t *sta_netif, esp_netif_t *eth_netif)
+{
+    ap = ap_netif;
+    sta = sta_netif;
+    eth = eth_netif;
+    return ESP_OK;
+}
+
+esp_err_t selftest_run(const selftest_config_t *new_config)
+{
+    esp_netif_ip_info_t ip_info;
+    esp_netif_t *netifs[] = {[SELFTEST_IFACE_AP] = ap, [SELFTEST_IFACE_STA] = sta, [SELFTEST_IFACE_ETH] = eth};
+    esp_netif_t *netif = netifs[new_config->iface];
+    if (netif == NULL || esp_netif_get_ip_info(netif, &ip_info) != ESP_OK || ip_info.ip.addr == 0)
+    {
+        return ESP_ERR_INVALID_ARG; // La interfaz no tiene IP
+    }
+
+    portENTER_CRITICAL(&selftest_lock);
+    bool was_busy = busy;
+    busy = true;
+    portEXIT_CRITICAL(&selftest_lock);
+    if (was_busy)
+    {
+        return ESP_ERR_INVALID_STATE;
+    }
+
+    buffer = malloc(SELFTEST_BUFFER_SIZE);
+    if (buffer == NULL)
+    {
+        busy = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    config = *new_config;
+    local_ip = ip_info.ip.addr;
+    start_us = 0;
+    stop_requested = false;
+    portENTER_CRITICAL(&selftest_lock);
+    memset(&result, 0, sizeof(result));
+    result.state = SELFTEST_STATE_WAITING;
+    result.config = config;
+    portEXIT_CRITICAL(&selftest_lock);
+
+    if (xTaskCreatePinnedToCore(selftest_task, "selftest", SELFTEST_STACK, NULL, SELFTEST_PRIORITY, NULL, SELFTEST_CORE) != pdPASS)
+    {
+        free(buffer);
+        buffer = NULL;
+        set_state(SELFTEST_STATE_IDLE);
+        busy = false;
+        return ESP_ERR_NO_MEM;
+    }
+
+    ESP_LOGI(TAG_SELFTEST, "Prueba %s %s en %s, puerto %u, %lu s", config.proto == SELFTEST_TCP ? "TCP" : "UDP", config.mode == SELFTEST_SINK ? "recibiendo" : "enviando",
+             config.iface == SELFTEST_IFACE_AP ? "AP" : "STA", config.port, config.duration_s);
+    return ESP_OK;
+}
+
+void selftest_stop(void)
+{
+    stop_requested = true;
+}
+
+void selftest_get_result(selftest_result_t *out)
+{
+    portENTER_CRITICAL(&selftest_lock);
+    *out = result;
+    portEXIT_CRITICAL(&selftest_lock);
+
+    // Durante la prueba, tiempo y tasa hasta ahora
+    if (out->state == SELFTEST_STATE_RUNNING && start_us != 0)
+    {
+        out->elapsed_ms = (esp_timer_get_time() - start_us) / 1000;
+        out->kbps = out->elapsed_ms ? out->bytes * 8 / out->elapsed_ms : 0;
+    }
+}
+
+esp_err_t selftest_get_handler(httpd_req_t *req)
+{
+    selftest_result_t r;
+    selftest_get_result(&r);
+
+    char peer[16] = "-";
+    if (r.config.peer_ip != 0)
+    {
+        esp_ip4_addr_t addr = {.addr = r.config.peer_ip};
+        esp_ip4addr_ntoa(&addr, peer, sizeof(peer));
+    }
+    uint32_t expected = r.packets + r.lost;
+
+    char text[512];
+    int len = snprintf(text, sizeof(text),
+                       "state %s\nproto %s\nmode %s\niface %s\nport %u\npeer %s\nduration_s %lu\nrate_kbps %lu\n"
+                       "elapsed_ms %lu\nbytes %llu\nmbps %lu.%03lu\npackets %lu\nlost %lu\nloss_pct %.2f\nout_of_order %lu\njitter_ms %lu.%03lu\n",
+                       state_names[r.state], r.config.proto == SELFTEST_TCP ? "tcp" : "udp", r.config.mode == SELFTEST_SINK ? "sink" : "source",
+                       iface_names[r.config.iface], r.config.port, peer, r.config.duration_s, r.config.rate_kbps, r.elapsed_ms, r.bytes,
+                       r.kbps / 1000, r.kbps % 1000, r.packets, r.lost, expected ? 100.0 * r.lost / expected : 0.0, r.out_of_order, r.jitter_us / 1000,
+                       r.jitter_us % 1000);
+    for (int core = 0; core < portNUM_PROCESSORS; core++)
+    {
+        len += snprintf(text + len, sizeof(text) - len, "cpu%d %.1f%%\n", core, r.cpu[core]);
+    }
+    snprintf(text + len, sizeof(text) - len, "error %s\n", r.error[0] ? r.error : "-");
+
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    return httpd_resp_send(req, text, HTTPD_RESP_USE_STRLEN);
+}
+
+// Campos: action (start o stop), proto (tcp o udp), mode (sink o source), iface (ap, sta o eth), peer (IP, al enviar),
+// port, duration (s) y rate (kbit/s, al enviar UDP).
+// Solo desde el punto de acceso y con la contraseña de administración (admin.h), aunque se pruebe otra interfaz
+esp_err_t selftest_post_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, NULL))
+    {
+        return ESP_FAIL;
+    }
+
+    char action[6], proto[4], mode[7], iface[4], peer[16], port_text[6], duration_text[4], rate_text[7];
+    form_field_t fields[] = {
+        {.name = "action", .value = action, .size = sizeof(action)},
+        {.name = "proto", .value = proto, .size = sizeof(proto)},
+        {.name = "mode", .value = mode, .size = sizeof(mode)},
+        {.name = "iface", .value = iface, .size = sizeof(iface)},
+        {.name = "peer", .value = peer, .size = sizeof(peer)},
+        {.name = "port", .value = port_text, .size = sizeof(port_text)},
+        {.name = "duration", .value = duration_text, .size = sizeof(duration_text)},
+        {.name = "rate", .value = rate_text, .size = sizeof(rate_text)},
+    };
+    const int field_count = sizeof(fields) / sizeof(fields[0]);
+
+    if (form_recv(req, fields, field_count) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < field_count; i++)
+    {
+        if (fields[i].truncated)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Valor demasiado largo");
+        }
+    }
+
+    if (strcmp(action, "stop") == 0)
+    {
+        selftest_stop();
+        return selftest_get_handler(req);
+    }
+    if (strcmp(action, "start") != 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Acción no válida");
+    }
+
+    selftest_config_t new_config = {
+        .proto = SELFTEST_TCP,
+        .mode = SELFTEST_SINK,
+        .iface = SELFTEST_IFACE_AP,
+        .port = SELFTEST_PORT,
+        .duration_s = SELFTEST_DURATION_S,
+        .rate_kbps = SELFTEST_UDP_RATE_KBPS,
+    };
+    if (strcmp(proto, "udp") == 0)
+    {
+        new_config.proto = SELFTEST_UDP;
+    }
+    else if (proto[0] != '\0' && strcmp(proto, "tcp") != 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Protocolo no válido");
+    }
+    if (strcmp(mode, "source") == 0)
+    {
+        new_config.mode = SELFTEST_SOURCE;
+    }
+    else if (mode[0] != '\0' && strcmp(mode, "sink") != 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Modo no válido");
+    }
+    if (strcmp(iface, "sta") == 0)
+    {
+        new_config.iface = SELFTEST_IFACE_STA;
+    }
+    else if (strcmp(iface, "eth") == 0)
+    {
+        new_config.iface = SELFTEST_IFACE_ETH;
+    }
+    else if (iface[0] != '\0' && strcmp(iface, "ap") != 0)
+    {
+        return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Interfaz no válida");
+    }
+    if (new_config.mode == SELFTEST_SOURCE)
+    {
+        new_config.peer_ip = esp_ip4addr_aton(peer);
+        if (new_config.peer_ip == 0)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "IP remota no válida");
+        }
+    }
+    if (port_text[0] != '\0')
+    {
+        unsigned long port = strtoul(port_text, NULL, 10);
+        if (port == 0 || port > 65535)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Puerto no válido");
+        }
+        new_config.port = port;
+    }
+    if (duration_text[0] != '\0')
+    {
+        new_config.duration_s = strtoul(duration_text, NULL, 10);
+        if (new_config.duration_s == 0 || new_config.duration_s > SELFTEST_MAX_DURATION_S)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Duración no válida");
+        }
+    }
+    if (rate_text[0] != '\0')
+    {
+        new_config.rate_kbps = strtoul(rate_text, NULL, 10);
+        if (new_config.rate_kbps == 0 || new_config.rate_kbps > SELFTEST_MAX_UDP_RATE_KBPS)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Tasa no válida");
+        }
+    }
+
+    esp_err_t err = selftest_run(&new_config);
+    if (err == ESP_ERR_INVALID_STATE)
+    {
+        httpd_resp_set_status(req, "409 Conflict");
+        return httpd_resp_send(req, "Ya hay una prueba en curso", HTTPD_RESP_USE_STRLEN);
+    }
+    if (err == ESP_ERR_INVALID_ARG)
+    {
+        return httpd_resp_send_err(req, HTTPD_503_SERVICE_UNAVAILABLE, "La interfaz no tiene IP");
+    }
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Sin memoria para la prueba");
+    }
+    return selftest_get_handler(req);
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_netif.h"
+#include "cores.h"
+
+// Prueba de velocidad en el propio router (al estilo de iperf).
+// El router genera o recibe tráfico TCP o UDP en la IP del punto de acceso, de la STA o de la WAN por Ethernet,
+// así se puede medir por separado la radio del AP (un cliente conectado al router) y cada enlace de subida (un
+// equipo de la red de subida), comparar la WAN por cable con la WiFi y con el tráfico reenviado por el NAT. Cada prueba mide Mbit/s y el uso de CPU de
+// cada núcleo; al recibir UDP mide además el jitter (RFC 3550) y los datagramas perdidos o desordenados.
+// Los datagramas UDP llevan la cabecera de iperf 2 (secuencia, segundos y microsegundos de envío, en orden
+// de red), así que también sirve un cliente o servidor de iperf 2. POST /selftest inicia o detiene la prueba,
+// GET /selftest muestra el estado y el último resultado; tools/selftest.py la ejecuta desde un equipo.
+
+// Definiciones de la prueba
+#define SELFTEST_PORT 5001               // Puerto por defecto (el de iperf 2)
+#define SELFTEST_DURATION_S 10           // Duración por defecto
+#define SELFTEST_MAX_DURATION_S 60
+#define SELFTEST_UDP_RATE_KBPS 10000     // Tasa por defecto al enviar UDP
+#define SELFTEST_MAX_UDP_RATE_KBPS 100000
+#define SELFTEST_UDP_PAYLOAD 1470        // Datagrama sin fragmentar con MTU 1500 (la de iperf 2)
+#define SELFTEST_BUFFER_SIZE 2920        // Dos segmentos TCP por llamada
+#define SELFTEST_WAIT_MS 15000           // Espera máxima al otro extremo
+#define SELFTEST_IDLE_MS 2000            // Sin datos durante este tiempo, la prueba termina
+#define SELFTEST_POLL_MS 100             // Timeout de los sockets para comprobar si se pide parar
+#define SELFTEST_PRIORITY 4              // Por debajo del servidor HTTP
+#define SELFTEST_CORE CORE_CONTROL
+#define SELFTEST_STACK 4096
+#define SELFTEST_SOCKETS 2               // Escucha y conexión aceptada (CONFIG_LWIP_MAX_SOCKETS)
+
+// Tipo de prueba
+typedef enum
+{
+    SELFTEST_TCP = 0,
+    SELFTEST_UDP,
+} selftest_proto_t;
+
+typedef enum
+{
+    SELFTEST_SINK = 0, // El router recibe (sentido de subida desde el otro extremo)
+    SELFTEST_SOURCE,   // El router envía
+} selftest_mode_t;
+
+typedef enum
+{
+    SELFTEST_IFACE_AP = 0,
+    SELFTEST_IFACE_STA,
+    SELFTEST_IFACE_ETH,
+} selftest_iface_t;
+
+// Fase de la prueba
+typedef enum
+{
+    SELFTEST_STATE_IDLE = 0,
+    SELFTEST_STATE_WAITING, // Esperando al otro extremo
+    SELFTEST_STATE_RUNNING,
+    SELFTEST_STATE_DONE,
+    SELFTEST_STATE_FAILED,
+} selftest_state_t;
+
+// Parámetros de una prueba
+typedef struct
+{
+    selftest_proto_t proto;
+    selftest_mode_t mode;
+    selftest_iface_t iface;
+    uint32_t peer_ip;     // Orden de red, solo al enviar
+    uint16_t port;
+    uint32_t duration_s;
+    uint32_t rate_kbps;   // Solo al enviar UDP
+} selftest_config_t;
+
+// Resultado de la prueba en curso o de la última
+typedef struct
+{
+    selftest_state_t state;
+    selftest_config_t config;
+    uint32_t elapsed_ms;
+    uint64_t bytes;
+    uint32_t kbps;
+    uint32_t packets;      // Datagramas UDP enviados o recibidos
+    uint32_t lost;         // Datagramas que no llegaron (al recibir UDP)
+    uint32_t out_of_order;
+    uint32_t jitter_us;
+    float cpu[portNUM_PROCESSORS]; // Uso de cada núcleo durante la prueba (%)
+    char error[48];
+} selftest_result_t;
+
+esp_err_t selftest_start(esp_netif_t *ap_netif, esp_netif_t *sta_netif, esp_netif_t *eth_netif); // Guarda las interfaces de la prueba (NULL si no hay)
+esp_err_t selftest_run(const selftest_config_t *config);                 // Inicia una prueba en segundo plano
+void selftest_stop(void);                                                // Pide parar la prueba en curso
+void selftest_get_result(selftest_result_t *result);                     // Copia el estado y el resultado
+esp_err_t selftest_get_handler(httpd_req_t *req);                        // GET /selftest
+esp_err_t selftest_post_handler(httpd_req_t *req);                       // POST /selftest: inicia o detiene una prueba
@@ -0,0 +1,628 @@
+#include "settings.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "freertos/task.h"
+#include "nvs.h"
+#include <stdbool.h>
+#include <string.h>
+
+// Registro de una red en el almacenamiento no volátil: longitud y SSID, longitud y contraseña, BSSID, canal y autenticación
+#define NETWORK_RECORD_MAX (1 + 32 + 1 + 64 + 6 + 1 + 1)
+#define SETTINGS_STA_ALL (SETTINGS_STA_NETWORKS | SETTINGS_STA_LAST_AP | SETTINGS_STA_AUTHMODE)
+
+// Tags para logging
+static const char *TAG_SETTINGS = "SETTINGS";
+
+typedef struct
+{
+    settings_cb_t cb;
+    void *arg;
+} settings_subscriber_t;
+
+// Variables globales
+static settings_t current;
+static uint32_t dirty = 0; // Grupos cambiados pendientes de guardar
+static portMUX_TYPE settings_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t commit_mutex = NULL;
+static SemaphoreHandle_t publish_mutex = NULL; // Recursivo: un suscriptor puede cambiar la configuración
+static settings_t published;                   // Copia que reciben los suscriptores (fuera de la pila de quien cambia)
+static esp_timer_handle_t commit_timer = NULL;
+static TaskHandle_t commit_task_handle = NULL;
+static settings_subscriber_t subscribers[SETTINGS_MAX_SUBSCRIBERS];
+static int subscriber_count = 0;
+static bool legacy_sta_keys = false; // Credenciales de una sola red guardadas por versiones anteriores
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Lee una cadena del almacenamiento no volátil en un buffer fijo; la deja vacía si no existe
+static void load_str(nvs_handle_t handle, const char *key, char *out, size_t size)
+{
+    size_t len = size;
+    esp_err_t err = nvs_get_str(handle, key, out, &len);
+    if (err != ESP_OK)
+    {
+        if (err != ESP_ERR_NVS_NOT_FOUND) // Si no se encuentra la clave, no se muestra el error
+        {
+            ESP_LOGE(TAG_SETTINGS, "Error al leer '%s' del almacenamiento no volátil. Error %s", key, esp_err_to_name(err));
+        }
+        out[0] = '\0';
+    }
+}
+
+// Empaqueta la lista de redes sin los bytes sin usar de cada cadena; devuelve la longitud
+static size_t encode_networks(const settings_t *settings, uint8_t *out)
+{
+    size_t len = 0;
+    for (int i = 0; i < settings->network_count; i++)
+    {
+        const settings_network_t *network = &settings->networks[i];
+        uint8_t ssid_len = strlen(network->ssid);
+        uint8_t password_len = strlen(network->password);
+        out[len++] = ssid_len;
+        memcpy(out + len, network->ssid, ssid_len);
+        len += ssid_len;
+        out[len++] = password_len;
+        memcpy(out + len, network->password, password_len);
+        len += password_len;
+        memcpy(out + len, network->bssid, sizeof(network->bssid));
+        len += sizeof(network->bssid);
+        out[len++] = network->channel;
+        out[len++] = network->authmode;
+    }
+    return len;
+}
+
+// Desempaqueta la lista de redes; false si el blob no es válido
+static bool decode_networks(const uint8_t *data, size_t len, settings_t *settings)
+{
+    size_t pos = 0;
+    uint8_t count = 0;
+    while (pos < len)
+    {
+        if (count >= SETTINGS_MAX_NETWORKS)
+        {
+            return false;
+        }
+        settings_network_t *network = &settings->networks[count];
+        memset(network, 0, sizeof(*network));
+
+        uint8_t ssid_len = data[pos++];
+        if (ssid_len == 0 || ssid_len >= sizeof(network->ssid) || pos + ssid_len >= len)
+        {
+            return false;
+        }
+        memcpy(network->ssid, data + pos, ssid_len);
+        pos += ssid_len;
+
+        uint8_t password_len = data[pos++];
+        if (password_len >= sizeof(network->password) || pos + password_len + sizeof(network->bssid) + 2 > len)
+        {
+            return false;
+        }
+        memcpy(network->password, data + pos, password_len);
+        pos += password_len;
+        memcpy(network->bssid, data + pos, sizeof(network->bssid));
+        pos += sizeof(network->bssid);
+        network->channel = data[pos++];
+        network->authmode = data[pos++];
+        count++;
+    }
+    settings->network_count = count;
+    return true;
+}
+
+// Lee las credenciales de una sola red de versiones anteriores como primera red de la lista
+static void load_legacy_network(nvs_handle_t handle, settings_t *settings)
+{
+    settings_network_t *network = &settings->networks[0];
+    memset(network, 0, sizeof(*network));
+    load_str(handle, "ssid", network->ssid, sizeof(network->ssid));
+    if (network->ssid[0] == '\0')
+    {
+        return;
+    }
+    load_str(handle, "password", network->password, sizeof(network->password));
+
+    size_t bssid_len = sizeof(network->bssid);
+    if (nvs_get_blob(handle, "bssid", network->bssid, &bssid_len) != ESP_OK || bssid_len != sizeof(network->bssid) ||
+        nvs_get_u8(handle, "channel", &network->channel) != ESP_OK)
+    {
+        memset(network->bssid, 0, sizeof(network->bssid));
+        network->channel = 0;
+    }
+    if (nvs_get_u8(handle, "authmode", &network->authmode) != ESP_OK)
+    {
+        network->authmode = SETTINGS_AUTHMODE_UNKNOWN;
+    }
+    settings->network_count = 1;
+    legacy_sta_keys = true;
+    dirty |= SETTINGS_STA_ALL; // Se guarda en el formato nuevo con el siguiente commit
+}
+
+// Escribe en el almacenamiento no volátil los grupos cambiados con un único commit
+static esp_err_t commit(void)
+{
+    xSemaphoreTake(commit_mutex, portMAX_DELAY);
+
+    // Estáticos, protegidos por commit_mutex: no ocupan la pila de quien guarda (tarea de guardado u OTA)
+    static settings_t snapshot;
+    static uint8_t blob[SETTINGS_MAX_NETWORKS * NETWORK_RECORD_MAX];
+    portENTER_CRITICAL(&settings_lock);
+    uint32_t changed = dirty;
+    dirty = 0;
+    snapshot = current;
+    portEXIT_CRITICAL(&settings_lock);
+
+    if (changed == 0)
+    {
+        xSemaphoreGive(commit_mutex);
+        return ESP_OK;
+    }
+
+    nvs_handle_t handle;
+    esp_err_t err = nvs_open(SETTINGS_NAMESPACE, NVS_READWRITE, &handle);
+    if (err == ESP_OK)
+    {
+        if (changed & SETTINGS_STA_ALL)
+        {
+            size_t len = encode_networks(&snapshot, blob);
+            if (len > 0)
+            {
+                err = nvs_set_blob(handle, "networks", blob, len);
+            }
+            else
+            {
+                err = nvs_erase_key(handle, "networks");
+                err = (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+            }
+
+            // Las claves de una sola red ya están en la lista
+            if (err == ESP_OK && legacy_sta_keys)
+            {
+                static const char *legacy_keys[] = {"ssid", "password", "bssid", "channel", "authmode"};
+                for (size_t i = 0; i < sizeof(legacy_keys) / sizeof(legacy_keys[0]); i++)
+                {
+                    nvs_erase_key(handle, legacy_keys[i]);
+                }
+                legacy_sta_keys = false;
+            }
+        }
+        if (err == ESP_OK && (changed & SETTINGS_SHAPER))
+        {
+            err = nvs_set_blob(handle, "shaper", &snapshot.shaper, sizeof(snapshot.shaper));
+        }
+        if (err == ESP_OK && (changed & SETTINGS_PORTMAP))
+        {
+            // Solo las reglas en uso, sin el resto del array
+            if (snapshot.portmap.rule_count > 0)
+            {
+                err = nvs_set_blob(handle, "portmap", snapshot.portmap.rules, snapshot.portmap.rule_count * sizeof(snapshot.portmap.rules[0]));
+            }
+            else
+            {
+                err = nvs_erase_key(handle, "portmap");
+                err = (err == ESP_ERR_NVS_NOT_FOUND) ? ESP_OK : err;
+            }
+        }
+        if (err == ESP_OK && (changed & SETTINGS_UPLINK_MTU))
+        {
+            err = nvs_set_u16(handle, "mtu", snapshot.uplink_mtu);
+        }
+        if (err == ESP_OK)
+        {
+            err = nvs_commit(handle);
+        }
+        nvs_close(handle);
+    }
+
+    if (err != ESP_OK)
+    {
+        // Los cambios siguen en RAM y se reintentan con la siguiente escritura
+        ESP_LOGE(TAG_SETTINGS, "Error al guardar la configuración en el almacenamiento no volátil. Error %s", esp_err_to_name(err));
+        portENTER_CRITICAL(&settings_lock);
+        dirty |= changed;
+        portEXIT_CRITICAL(&settings_lock);
+    }
+    else
+    {
+        ESP_LOGI(TAG_SETTINGS, "Configuración guardada (versión %lu)", snapshot.version);
+    }
+
+    xSemaphoreGive(commit_mutex);
+    return err;
+}
+
+// La escritura en la flash puede tardar decenas de ms: se hace en su propia tarea y no en la de esp_timer
+static void commit_cb(void *arg)
+{
+    xTaskNotifyGive(commit_task_handle);
+}
+
+static void commit_task(void *arg)
+{
+    while (true)
+    {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        commit();
+    }
+}
+
+// Avisa a los suscriptores y programa el guardado agrupado
+static void publish(uint32_t changed)
+{
+    xSemaphoreTakeRecursive(publish_mutex, portMAX_DELAY);
+    settings_get(&published);
+    for (int i = 0; i < subscriber_count; i++)
+    {
+        subscribers[i].cb(&published, changed, subscribers[i].arg);
+    }
+    xSemaphoreGiveRecursive(publish_mutex);
+
+    esp_timer_stop(commit_timer);
+    esp_err_t err = esp_timer_start_once(commit_timer, SETTINGS_COMMIT_DELAY_MS * 1000ULL);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_SETTINGS, "Error al programar el guardado de la configuración. Error %s", esp_err_to_name(err));
+    }
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t settings_init(void)
+{
+    commit_mutex = xSemaphoreCreateMutex();
+    publish_mutex = xSemaphoreCreateRecursiveMutex();
+    if (commit_mutex == NULL || publish_mutex == NULL)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+
+    if (xTaskCreatePinnedToCore(commit_task, "settings", SETTINGS_TASK_STACK, NULL, SETTINGS_TASK_PRIORITY, &commit_task_handle, SETTINGS_TASK_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG_SETTINGS, "Error al crear la tarea de guardado de la configuración");
+        return ESP_ERR_NO_MEM;
+    }
+
+    esp_timer_create_args_t config = {
+        .callback = commit_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "settings_timer",
+    };
+    esp_err_t err = esp_timer_create(&config, &commit_timer);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_SETTINGS, "Error al crear el timer de la configuración. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    memset(&current, 0, sizeof(current));
+
+    nvs_handle_t handle;
+    err = nvs_open(SETTINGS_NAMESPACE, NVS_READONLY, &handle);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        ESP_LOGW(TAG_SETTINGS, "No hay configuración guardada, se usan los valores predeterminados");
+        return ESP_OK;
+    }
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_SETTINGS, "Error al abrir el almacenamiento no volátil. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    uint8_t networks[SETTINGS_MAX_NETWORKS * NETWORK_RECORD_MAX];
+    size_t networks_len = sizeof(networks);
+    err = nvs_get_blob(handle, "networks", networks, &networks_len);
+    if (err == ESP_ERR_NVS_NOT_FOUND)
+    {
+        load_legacy_network(handle, &current);
+    }
+    else if (err != ESP_OK || !decode_networks(networks, networks_len, &current))
+    {
+        ESP_LOGE(TAG_SETTINGS, "Lista de redes de subida no válida, se descarta");
+        current.network_count = 0;
+    }
+
+    size_t shaper_len = sizeof(current.shaper);
+    if (nvs_get_blob(handle, "shaper", &current.shaper, &shaper_len) != ESP_OK || shaper_len != sizeof(current.shaper) ||
+        current.shaper.override_count > SETTINGS_SHAPER_MAX_OVERRIDES)
+    {
+        memset(&current.shaper, 0, sizeof(current.shaper));
+    }
+
+    size_t portmap_len = sizeof(current.portmap.rules);
+    if (nvs_get_blob(handle, "portmap", current.portmap.rules, &portmap_len) == ESP_OK && portmap_len % sizeof(current.portmap.rules[0]) == 0)
+    {
+        current.portmap.rule_count = portmap_len / sizeof(current.portmap.rules[0]);
+    }
+    else
+    {
+        memset(&current.portmap, 0, sizeof(current.portmap));
+    }
+
+    if (nvs_get_u16(handle, "mtu", &current.uplink_mtu) != ESP_OK ||
+        (current.uplink_mtu != 0 && (current.uplink_mtu < SETTINGS_MTU_MIN || current.uplink_mtu > SETTINGS_MTU_MAX)))
+    {
+        current.uplink_mtu = 0;
+    }
+    nvs_close(handle);
+
+    if (current.network_count == 0)
+    {
+        ESP_LOGW(TAG_SETTINGS, "No se encontraron credenciales de WiFi en el almacenamiento no volátil");
+    }
+    return ESP_OK;
+}
+
+void settings_get(settings_t *out)
+{
+    portENTER_CRITICAL(&settings_lock);
+    *out = current;
+    portEXIT_CRITICAL(&settings_lock);
+}
+
+uint32_t settings_version(void)
+{
+    return current.version;
+}
+
+int settings_find_network(const settings_network_t *networks, uint8_t count, const char *ssid)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (strcmp(networks[i].ssid, ssid) == 0)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+uint8_t settings_network_count(void)
+{
+    return current.network_count;
+}
+
+int settings_network_index(const char *ssid)
+{
+    portENTER_CRITICAL(&settings_lock);
+    int index = settings_find_network(current.networks, current.network_count, ssid);
+    portEXIT_CRITICAL(&settings_lock);
+    return index;
+}
+
+bool settings_get_network(int index, settings_network_t *out)
+{
+    portENTER_CRITICAL(&settings_lock);
+    bool found = index >= 0 && index < current.network_count;
+    if (found)
+    {
+        *out = current.networks[index];
+    }
+    portEXIT_CRITICAL(&settings_lock);
+    return found;
+}
+
+uint8_t settings_get_networks(settings_network_t networks[SETTINGS_MAX_NETWORKS])
+{
+    portENTER_CRITICAL(&settings_lock);
+    uint8_t count = current.network_count;
+    memcpy(networks, current.networks, count * sizeof(networks[0]));
+    portEXIT_CRITICAL(&settings_lock);
+    return count;
+}
+
+void settings_get_shaper(settings_shaper_t *out)
+{
+    portENTER_CRITICAL(&settings_lock);
+    *out = current.shaper;
+    portEXIT_CRITICAL(&settings_lock);
+}
+
+void settings_get_portmap(settings_portmap_t *out)
+{
+    portENTER_CRITICAL(&settings_lock);
+    *out = current.portmap;
+    portEXIT_CRITICAL(&settings_lock);
+}
+
+esp_err_t settings_set_sta_credentials(const char *ssid, const char *password)
+{
+    if (ssid[0] == '\0' || strlen(ssid) >= sizeof(current.networks[0].ssid) || strlen(password) >= sizeof(current.networks[0].password))
+    {
+        return ESP_ERR_INVALID_SIZE;
+    }
+
+    // La red pasa a ser la preferida; si ya estaba conserva su último AP mientras no cambie la contraseña
+    settings_network_t networks[SETTINGS_MAX_NETWORKS];
+    uint8_t count = settings_get_networks(networks);
+    settings_network_t network = {.channel = 0, .authmode = SETTINGS_AUTHMODE_UNKNOWN};
+    int index = settings_find_network(networks, count, ssid);
+    if (index >= 0)
+    {
+        if (strcmp(networks[index].password, password) == 0)
+        {
+            network = networks[index];
+        }
+        memmove(&networks[index], &networks[index + 1], (count - index - 1) * sizeof(network));
+        count--;
+    }
+    else if (count == SETTINGS_MAX_NETWORKS)
+    {
+        count--; // Se olvida la menos preferida
+    }
+    strcpy(network.ssid, ssid);
+    strcpy(network.password, password);
+
+    memmove(&networks[1], &networks[0], count * sizeof(network));
+    networks[0] = network;
+    return settings_set_sta_networks(networks, count + 1);
+}
+
+esp_err_t settings_set_sta_networks(const settings_network_t *networks, uint8_t count)
+{
+    if (count > SETTINGS_MAX_NETWORKS)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    for (int i = 0; i < count; i++)
+    {
+        if (networks[i].ssid[0] == '\0' || memchr(networks[i].ssid, '\0', sizeof(networks[i].ssid)) == NULL ||
+            memchr(networks[i].password, '\0', sizeof(networks[i].password)) == NULL)
+        {
+            return ESP_ERR_INVALID_SIZE;
+        }
+    }
+
+    portENTER_CRITICAL(&settings_lock);
+    bool changed = current.network_count != count || memcmp(current.networks, networks, count * sizeof(networks[0])) != 0;
+    if (changed)
+    {
+        current.network_count = count;
+        memcpy(current.networks, networks, count * sizeof(networks[0]));
+        current.version++;
+        dirty |= SETTINGS_STA_ALL;
+    }
+    portEXIT_CRITICAL(&settings_lock);
+
+    if (changed)
+    {
+        publish(SETTINGS_STA_ALL);
+    }
+    return ESP_OK;
+}
+
+esp_err_t settings_set_sta_last_ap(const char *ssid, const uint8_t bssid[6], uint8_t channel)
+{
+    portENTER_CRITICAL(&settings_lock);
+    int index = settings_find_network(current.networks, current.network_count, ssid);
+    settings_network_t *network = &current.networks[index < 0 ? 0 : index];
+    bool changed = index >= 0 && (memcmp(network->bssid, bssid, sizeof(network->bssid)) != 0 || network->channel != channel);
+    if (changed)
+    {
+        memcpy(network->bssid, bssid, sizeof(network->bssid));
+        network->channel = channel;
+        current.version++;
+        dirty |= SETTINGS_STA_LAST_AP;
+    }
+    portEXIT_CRITICAL(&settings_lock);
+
+    if (changed)
+    {
+        publish(SETTINGS_STA_LAST_AP);
+    }
+    return index >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t settings_set_sta_authmode(const char *ssid, uint8_t authmode)
+{
+    portENTER_CRITICAL(&settings_lock);
+    int index = settings_find_network(current.networks, current.network_count, ssid);
+    bool changed = index >= 0 && current.networks[index].authmode != authmode;
+    if (changed)
+    {
+        current.networks[index].authmode = authmode;
+        current.version++;
+        dirty |= SETTINGS_STA_AUTHMODE;
+    }
+    portEXIT_CRITICAL(&settings_lock);
+
+    if (changed)
+    {
+        publish(SETTINGS_STA_AUTHMODE);
+    }
+    return index >= 0 ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+esp_err_t settings_set_shaper(const settings_shaper_t *shaper)
+{
+    if (shaper->override_count > SETTINGS_SHAPER_MAX_OVERRIDES)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&settings_lock);
+    bool changed = memcmp(&current.shaper, shaper, sizeof(current.shaper)) != 0;
+    if (changed)
+    {
+        current.shaper = *shaper;
+        current.version++;
+        dirty |= SETTINGS_SHAPER;
+    }
+    portEXIT_CRITICAL(&settings_lock);
+
+    if (changed)
+    {
+        publish(SETTINGS_SHAPER);
+    }
+    return ESP_OK;
+}
+
+esp_err_t settings_set_portmap(const settings_portmap_t *portmap)
+{
+    if (portmap->rule_count > SETTINGS_PORTMAP_MAX_RULES)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&settings_lock);
+    bool changed = current.portmap.rule_count != portmap->rule_count ||
+                   memcmp(current.portmap.rules, portmap->rules, portmap->rule_count * sizeof(portmap->rules[0])) != 0;
+    if (changed)
+    {
+        current.portmap.rule_count = portmap->rule_count;
+        memcpy(current.portmap.rules, portmap->rules, portmap->rule_count * sizeof(portmap->rules[0]));
+        current.version++;
+        dirty |= SETTINGS_PORTMAP;
+    }
+    portEXIT_CRITICAL(&settings_lock);
+
+    if (changed)
+    {
+        publish(SETTINGS_PORTMAP);
+    }
+    return ESP_OK;
+}
+
+esp_err_t settings_set_uplink_mtu(uint16_t mtu)
+{
+    if (mtu != 0 && (mtu < SETTINGS_MTU_MIN || mtu > SETTINGS_MTU_MAX))
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+
+    portENTER_CRITICAL(&settings_lock);
+    bool changed = current.uplink_mtu != mtu;
+    if (changed)
+    {
+        current.uplink_mtu = mtu;
+        current.version++;
+        dirty |= SETTINGS_UPLINK_MTU;
+    }
+    portEXIT_CRITICAL(&settings_lock);
+
+    if (changed)
+    {
+        publish(SETTINGS_UPLINK_MTU);
+    }
+    return ESP_OK;
+}
+
+esp_err_t settings_subscribe(settings_cb_t cb, void *arg)
+{
+    if (subscriber_count >= SETTINGS_MAX_SUBSCRIBERS)
+    {
+        return ESP_ERR_NO_MEM;
+    }
+    subscribers[subscriber_count++] = (settings_subscriber_t){.cb = cb, .arg = arg};
+    return ESP_OK;
+}
+
+esp_err_t settings_flush(void)
+{
+    esp_timer_stop(commit_timer);
+    return commit();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "cores.h"
+
+// Configuración del router en memoria.
+// Todos los ajustes se leen del almacenamiento no volátil una sola vez al arrancar y se mantienen en una copia
+// en RAM con número de versión. Las lecturas copian la configuración sin reservar memoria ni tocar la flash;
+// las escrituras actualizan la copia, avisan a los suscriptores y se agrupan en un único nvs_commit diferido,
+// que hace una tarea de baja prioridad (el timer solo la despierta).
+// settings_t ocupa unos 780 bytes: desde tareas con poca pila (eventos del sistema, servidor HTTP) se lee solo
+// la parte necesaria (settings_get_network/settings_get_networks, settings_get_shaper, settings_get_portmap), y los suscriptores
+// reciben un puntero a una copia estática en lugar de una copia en su pila.
+
+// Definiciones de la configuración
+#define SETTINGS_NAMESPACE "wifi"      // Espacio de nombres del almacenamiento no volátil
+#define SETTINGS_COMMIT_DELAY_MS 1000  // Espera para agrupar varias escrituras en un mismo commit
+#define SETTINGS_MAX_SUBSCRIBERS 8
+#define SETTINGS_TASK_PRIORITY 1       // Guardado en la flash, sin prisa
+#define SETTINGS_TASK_STACK 3072
+#define SETTINGS_TASK_CORE CORE_CONTROL
+#define SETTINGS_SHAPER_MAX_OVERRIDES 8 // Clientes con límites propios
+#define SETTINGS_PORTMAP_MAX_RULES 16   // Reglas de redirección de puertos (IP_PORTMAP_MAX de lwIP admite 32)
+#define SETTINGS_MTU_MIN 576            // MTU mínima configurable (RFC 791)
+#define SETTINGS_MTU_MAX 1500
+#define SETTINGS_MAX_NETWORKS 4         // Redes de subida, en orden de preferencia
+
+// Grupos de ajustes (máscara de cambios)
+#define SETTINGS_STA_NETWORKS (1u << 0)    // Lista de redes de subida (SSID y contraseña)
+#define SETTINGS_STA_LAST_AP (1u << 1)     // Último AP al que se conectó la STA en alguna de las redes
+#define SETTINGS_STA_AUTHMODE (1u << 2)    // Modo de autenticación detectado para alguna de las redes
+#define SETTINGS_SHAPER (1u << 3)          // Límites de tráfico de los clientes del AP
+#define SETTINGS_PORTMAP (1u << 4)         // Redirección de puertos hacia los clientes del AP
+#define SETTINGS_UPLINK_MTU (1u << 5)      // MTU de la red de subida para ajustar el MSS de TCP
+
+#define SETTINGS_AUTHMODE_UNKNOWN 0xFF // authmode sin detectar
+
+// Red de subida con lo aprendido de ella para reconectar rápido
+typedef struct
+{
+    char ssid[33];
+    char password[65];
+    uint8_t bssid[6];  // BSSID del último AP con conexión correcta
+    uint8_t channel;   // Canal del último AP (0 si no se conoce)
+    uint8_t authmode;  // wifi_auth_mode_t anunciado por la red (SETTINGS_AUTHMODE_UNKNOWN si no se conoce)
+} settings_network_t;
+
+// Límites de un cliente concreto del AP (0 = sin límite)
+typedef struct
+{
+    uint8_t mac[6];
+    uint32_t up_kbps;
+    uint32_t down_kbps;
+} settings_station_limit_t;
+
+// Límites de tráfico (0 = sin límite)
+typedef struct
+{
+    uint32_t uplink_kbps;       // Total hacia la red de subida, repartido entre clientes por turnos
+    uint32_t station_up_kbps;   // Subida de cada cliente sin límite propio
+    uint32_t station_down_kbps; // Bajada de cada cliente sin límite propio
+    uint8_t override_count;
+    settings_station_limit_t overrides[SETTINGS_SHAPER_MAX_OVERRIDES];
+} settings_shaper_t;
+
+// Regla de redirección de puertos: proto/ext_port en la IP de la STA -> int_ip/int_port en la red del AP
+typedef struct
+{
+    uint32_t int_ip;    // Dirección del cliente (orden de red)
+    uint16_t ext_port;  // Puerto en la IP de la STA
+    uint16_t int_port;  // Puerto en el cliente
+    uint8_t proto;      // IP_PROTO_TCP o IP_PROTO_UDP
+    uint8_t reserved[3];
+} settings_portmap_rule_t;
+
+// Reglas ordenadas por (proto, ext_port) y sin repetir
+typedef struct
+{
+    uint8_t rule_count;
+    settings_portmap_rule_t rules[SETTINGS_PORTMAP_MAX_RULES];
+} settings_portmap_t;
+
+typedef struct
+{
+    uint32_t version;       // Se incrementa con cada cambio
+    uint8_t network_count;  // 0 si no hay credenciales guardadas
+    settings_network_t networks[SETTINGS_MAX_NETWORKS]; // La primera es la preferida
+    settings_shaper_t shaper;
+    settings_portmap_t portmap;
+    uint16_t uplink_mtu;    // MTU de la ruta de subida (0 = automática)
+} settings_t;
+
+typedef void (*settings_cb_t)(const settings_t *settings, uint32_t changed, void *arg); // Se llama en la tarea que hace el cambio; settings solo vale durante la llamada
+
+esp_err_t settings_init(void);                                              // Carga la configuración del almacenamiento no volátil
+void settings_get(settings_t *out);                                         // Copia la configuración actual
+uint32_t settings_version(void);                                            // Versión de la configuración actual
+esp_err_t settings_set_sta_credentials(const char *ssid, const char *password); // Pone la red al principio de la lista (la añade si no está)
+esp_err_t settings_set_sta_networks(const settings_network_t *networks, uint8_t count); // Cambia la lista de redes de subida
+esp_err_t settings_set_sta_last_ap(const char *ssid, const uint8_t bssid[6], uint8_t channel); // Recuerda el último AP de una red para reconectar rápido
+esp_err_t settings_set_sta_authmode(const char *ssid, uint8_t authmode);    // Recuerda el modo de autenticación de una red
+int settings_find_network(const settings_network_t *networks, uint8_t count, const char *ssid); // Posición de una red en una lista, -1 si no está
+uint8_t settings_network_count(void);                                       // Redes de subida en la lista
+int settings_network_index(const char *ssid);                               // Posición de una red en la lista actual, -1 si no está
+bool settings_get_network(int index, settings_network_t *out);              // Copia una red de la lista; false si no existe
+uint8_t settings_get_networks(settings_network_t networks[SETTINGS_MAX_NETWORKS]); // Copia la lista de redes y devuelve cuántas hay
+void settings_get_shaper(settings_shaper_t *out);                          // Copia los límites de tráfico
+void settings_get_portmap(settings_portmap_t *out);                        // Copia las reglas de redirección de puertos
+esp_err_t settings_set_shaper(const settings_shaper_t *shaper);            // Cambia los límites de tráfico
+esp_err_t settings_set_portmap(const settings_portmap_t *portmap);         // Cambia las reglas de redirección de puertos
+esp_err_t settings_set_uplink_mtu(uint16_t mtu);                            // Cambia la MTU de la red de subida (0 = automática)
+esp_err_t settings_subscribe(settings_cb_t cb, void *arg);                  // Registra un suscriptor a los cambios
+esp_err_t settings_flush(void);                                             // Guarda ya los cambios pendientes
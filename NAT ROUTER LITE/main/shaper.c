@@ -0,0 +1,561 @@
+#include "shaper.h"
+#include "admin.h"
+#include "settings.h"
+#include "form.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+// Tags para logging
+static const char *TAG_SHAPER = "SHAPER";
+
+// Cubo de fichas en millonésimas de byte para no perder las fracciones entre recargas
+typedef struct
+{
+    int64_t tokens;
+    int64_t burst;
+    uint32_t rate; // Bytes por segundo (0 = sin límite)
+    int64_t last_us;
+} bucket_t;
+
+typedef struct
+{
+    bool used;
+    uint8_t mac[6];
+    bucket_t up;
+    bucket_t down;
+    struct pbuf *queue[SHAPER_QUEUE_LEN];
+    uint8_t head;
+    uint8_t count;
+    int32_t deficit;
+    shaper_station_stats_t stats;
+} station_t;
+
+// Variables globales
+static station_t stations[SHAPER_MAX_STATIONS];
+static bucket_t uplink;
+static settings_shaper_t limits;
+static bool enabled = false; // Hay algún límite configurado
+static int total_queued = 0;
+static int rr_next = 0;      // Siguiente cliente en el turno
+static portMUX_TYPE shaper_lock = portMUX_INITIALIZER_UNLOCKED;
+static TaskHandle_t shaper_task_handle = NULL;
+static shaper_send_fn send_packet = NULL;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void bucket_set_rate(bucket_t *bucket, uint32_t kbps, int64_t now_us)
+{
+    bucket->rate = kbps * 125;
+    bucket->burst = MAX((int64_t)bucket->rate * SHAPER_BURST_MS / 1000, 2 * SHAPER_QUANTUM) * 1000000;
+    bucket->tokens = bucket->burst;
+    bucket->last_us = now_us;
+}
+
+static void bucket_refill(bucket_t *bucket, int64_t now_us)
+{
+    if (bucket->rate != 0)
+    {
+        bucket->tokens = MIN(bucket->tokens + (now_us - bucket->last_us) * bucket->rate, bucket->burst);
+        bucket->last_us = now_us;
+    }
+}
+
+static inline bool bucket_has(const bucket_t *bucket, uint16_t len)
+{
+    return bucket->rate == 0 || bucket->tokens >= (int64_t)len * 1000000;
+}
+
+static inline void bucket_take(bucket_t *bucket, uint16_t len)
+{
+    if (bucket->rate != 0)
+    {
+        bucket->tokens -= (int64_t)len * 1000000;
+    }
+}
+
+// Microsegundos hasta que el cubo tenga len bytes
+static int64_t bucket_wait_us(const bucket_t *bucket, uint16_t len)
+{
+    if (bucket_has(bucket, len))
+    {
+        return 0;
+    }
+    return ((int64_t)len * 1000000 - bucket->tokens) / bucket->rate + 1;
+}
+
+// Aplica a un cliente su límite propio o el general
+static void station_apply_limits(station_t *st, int64_t now_us)
+{
+    uint32_t up_kbps = limits.station_up_kbps;
+    uint32_t down_kbps = limits.station_down_kbps;
+    for (int i = 0; i < limits.override_count; i++)
+    {
+        if (memcmp(limits.overrides[i].mac, st->mac, sizeof(st->mac)) == 0)
+        {
+            up_kbps = limits.overrides[i].up_kbps;
+            down_kbps = limits.overrides[i].down_kbps;
+            break;
+        }
+    }
+    bucket_set_rate(&st->up, up_kbps, now_us);
+    bucket_set_rate(&st->down, down_kbps, now_us);
+}
+
+// Busca el estado de un cliente en su ranura de la tabla de clientes y, si create, lo crea
+static station_t *station_get(const uint8_t *mac, bool create)
+{
+    int slot = clients_index(mac);
+    if (slot < 0)
+    {
+        return NULL; // Cliente no registrado (tabla llena)
+    }
+
+    station_t *st = &stations[slot];
+    if (st->used)
+    {
+        // La ranura se libera en shaper_station_remove antes de que la tabla de clientes la reutilice
+        return (memcmp(st->mac, mac, sizeof(st->mac)) == 0) ? st : NULL;
+    }
+    if (!create)
+    {
+        return NULL;
+    }
+
+    memset(st, 0, sizeof(*st));
+    st->used = true;
+    memcpy(st->mac, mac, sizeof(st->mac));
+    memcpy(st->stats.mac, mac, sizeof(st->stats.mac));
+    station_apply_limits(st, esp_timer_get_time());
+    return st;
+}
+
+static struct pbuf *queue_pop(station_t *st)
+{
+    struct pbuf *p = st->queue[st->head];
+    st->head = (st->head + 1) & (SHAPER_QUEUE_LEN - 1);
+    st->count--;
+    st->stats.queue_depth = st->count;
+    total_queued--;
+    return p;
+}
+
+static void settings_changed_cb(const settings_t *settings, uint32_t changed, void *arg)
+{
+    if (!(changed & SETTINGS_SHAPER))
+    {
+        return;
+    }
+
+    int64_t now_us = esp_timer_get_time();
+    portENTER_CRITICAL(&shaper_lock);
+    limits = settings->shaper;
+    enabled = limits.uplink_kbps != 0 || limits.station_up_kbps != 0 || limits.station_down_kbps != 0 || limits.override_count != 0;
+    bucket_set_rate(&uplink, limits.uplink_kbps, now_us);
+    for (int i = 0; i < SHAPER_MAX_STATIONS; i++)
+    {
+        if (stations[i].used)
+        {
+            station_apply_limits(&stations[i], now_us);
+        }
+    }
+    portEXIT_CRITICAL(&shaper_lock);
+
+    // Si se quitan todos los límites la tarea vacía las colas que queden
+    xTaskNotifyGive(shaper_task_handle);
+}
+
+// Envía por turnos lo que permitan los cubos; devuelve los microsegundos hasta el siguiente envío posible (-1 si no hay cola)
+static int64_t drain(void)
+{
+    int64_t wait_us = -1;
+    bool sent;
+
+    do
+    {
+        sent = false;
+        wait_us = -1;
+
+        for (int n = 0; n < SHAPER_MAX_STATIONS; n++)
+        {
+            int index = (rr_next + n) % SHAPER_MAX_STATIONS;
+            station_t *st = &stations[index];
+
+            portENTER_CRITICAL(&shaper_lock);
+            if (!st->used || st->count == 0)
+            {
+                portEXIT_CRITICAL(&shaper_lock);
+                continue;
+            }
+
+            int64_t now_us = esp_timer_get_time();
+            bucket_refill(&st->up, now_us);
+            bucket_refill(&uplink, now_us);
+
+            // El déficit se limita para que un cliente frenado por su cubo no acumule turnos
+            st->deficit = MIN(st->deficit + SHAPER_QUANTUM, 2 * SHAPER_QUANTUM);
+
+            while (st->count > 0)
+            {
+                struct pbuf *p = st->queue[st->head];
+                uint16_t len = p->tot_len;
+                if (len > st->deficit)
+                {
+                    break;
+                }
+                if (enabled && (!bucket_has(&st->up, len) || !bucket_has(&uplink, len)))
+                {
+                    int64_t wait = MAX(bucket_wait_us(&st->up, len), bucket_wait_us(&uplink, len));
+                    wait_us = (wait_us < 0) ? wait : MIN(wait_us, wait);
+                    break;
+                }
+
+                queue_pop(st);
+                st->deficit -= len;
+                bucket_take(&st->up, len);
+                bucket_take(&uplink, len);
+                st->stats.up_packets++;
+                st->stats.up_bytes += len;
+                portEXIT_CRITICAL(&shaper_lock);
+
+                send_packet(p);
+                sent = true;
+
+                portENTER_CRITICAL(&shaper_lock);
+            }
+
+            if (st->count == 0)
+            {
+                st->deficit = 0;
+            }
+            else if (wait_us < 0)
+            {
+                wait_us = 0; // Le falta déficit: sigue en el próximo turno
+            }
+            portEXIT_CRITICAL(&shaper_lock);
+        }
+
+        rr_next = (rr_next + 1) % SHAPER_MAX_STATIONS;
+    } while (sent);
+
+    return wait_us;
+}
+
+static void shaper_task(void *arg)
+{
+    while (true)
+    {
+        int64_t wait_us = drain();
+        TickType_t ticks = portMAX_DELAY;
+        if (wait_us >= 0)
+        {
+            ticks = MAX(pdMS_TO_TICKS((wait_us + 999) / 1000), 1);
+        }
+        ulTaskNotifyTake(pdTRUE, ticks);
+    }
+}
+
+// Lee una MAC con o sin separadores (":" o "-")
+static bool parse_mac(const char *text, uint8_t mac[6])
+{
+    int digits = 0;
+    memset(mac, 0, 6);
+
+    while (*text && digits < 12)
+    {
+        if (*text == ':' || *text == '-')
+        {
+            text++;
+            continue;
+        }
+        if (!isxdigit((unsigned char)*text))
+        {
+            return false;
+        }
+        uint8_t value = isdigit((unsigned char)*text) ? *text - '0' : (tolower((unsigned char)*text) - 'a' + 10);
+        mac[digits / 2] = (mac[digits / 2] << 4) | value;
+        digits++;
+        text++;
+    }
+    return digits == 12 && *text == '\0';
+}
+
+// Copia el valor numérico de un campo si aparece en el formulario; false si no es un número de 32 bits
+static bool field_u32(const form_field_t *field, uint32_t *value)
+{
+    if (!field->found)
+    {
+        return true;
+    }
+    char *end;
+    unsigned long long parsed = strtoull(field->value, &end, 10);
+    if (!isdigit((unsigned char)field->value[0]) || *end != '\0' || parsed > UINT32_MAX)
+    {
+        return false;
+    }
+    *value = parsed;
+    return true;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t shaper_start(shaper_send_fn send)
+{
+    if (shaper_task_handle != NULL)
+    {
+        return ESP_OK;
+    }
+    send_packet = send;
+
+    if (xTaskCreatePinnedToCore(shaper_task, "shaper", SHAPER_TASK_STACK, NULL, SHAPER_TASK_PRIORITY, &shaper_task_handle, SHAPER_TASK_CORE) != pdPASS)
+    {
+        ESP_LOGE(TAG_SHAPER, "Error al crear la tarea de control de tráfico");
+        return ESP_ERR_NO_MEM;
+    }
+
+    settings_t settings;
+    settings_get(&settings);
+    settings_changed_cb(&settings, SETTINGS_SHAPER, NULL);
+    return settings_subscribe(settings_changed_cb, NULL);
+}
+
+bool shaper_enqueue(struct pbuf *p, const uint8_t *mac)
+{
+    if (!enabled && total_queued == 0)
+    {
+        return false;
+    }
+
+    struct pbuf *dropped = NULL;
+    portENTER_CRITICAL(&shaper_lock);
+    station_t *st = station_get(mac, true);
+    if (st == NULL)
+    {
+        portEXIT_CRITICAL(&shaper_lock);
+        return false; // Sin hueco para el cliente: se envía sin control
+    }
+
+    // Con las colas llenas se descarta de la cola más larga, que es la del cliente que más ocupa
+    if (st->count == SHAPER_QUEUE_LEN || total_queued >= SHAPER_QUEUE_TOTAL)
+    {
+        station_t *longest = st;
+        for (int i = 0; i < SHAPER_MAX_STATIONS; i++)
+        {
+            if (stations[i].used && stations[i].count > longest->count)
+            {
+                longest = &stations[i];
+            }
+        }
+
+        if (longest == st && st->count == SHAPER_QUEUE_LEN)
+        {
+            st->stats.drops_queue++;
+            portEXIT_CRITICAL(&shaper_lock);
+            pbuf_free(p);
+            return true;
+        }
+        dropped = queue_pop(longest);
+        longest->stats.drops_queue++;
+    }
+
+    st->queue[(st->head + st->count) & (SHAPER_QUEUE_LEN - 1)] = p;
+    st->count++;
+    total_queued++;
+    st->stats.queue_depth = st->count;
+    st->stats.queue_max = MAX(st->stats.queue_max, st->count);
+    portEXIT_CRITICAL(&shaper_lock);
+
+    // Los buffers del driver se liberan fuera de la sección crítica
+    if (dropped != NULL)
+    {
+        pbuf_free(dropped);
+    }
+    xTaskNotifyGive(shaper_task_handle);
+    return true;
+}
+
+bool shaper_admit_down(const uint8_t *mac, uint16_t len)
+{
+    if (!enabled || (mac[0] & 0x01)) // Sin límites, o difusión
+    {
+        return true;
+    }
+
+    bool admit = true;
+
+    portENTER_CRITICAL(&shaper_lock);
+    station_t *st = station_get(mac, true);
+    if (st != NULL)
+    {
+        bucket_refill(&st->down, esp_timer_get_time());
+        admit = bucket_has(&st->down, len);
+        if (admit)
+        {
+            bucket_take(&st->down, len);
+            st->stats.down_packets++;
+            st->stats.down_bytes += len;
+        }
+        else
+        {
+            st->stats.drops_rate++;
+        }
+    }
+    portEXIT_CRITICAL(&shaper_lock);
+
+    return admit;
+}
+
+void shaper_station_remove(const uint8_t *mac)
+{
+    struct pbuf *queued[SHAPER_QUEUE_LEN];
+    int count = 0;
+
+    portENTER_CRITICAL(&shaper_lock);
+    station_t *st = station_get(mac, false);
+    if (st != NULL)
+    {
+        while (st->count > 0)
+        {
+            queued[count++] = queue_pop(st);
+        }
+        st->used = false;
+    }
+    portEXIT_CRITICAL(&shaper_lock);
+
+    for (int i = 0; i < count; i++)
+    {
+        pbuf_free(queued[i]);
+    }
+}
+
+int shaper_get_stats(shaper_station_stats_t *stats, int max)
+{
+    int count = 0;
+    portENTER_CRITICAL(&shaper_lock);
+    for (int i = 0; i < SHAPER_MAX_STATIONS && count < max; i++)
+    {
+        if (stations[i].used)
+        {
+            stats[count++] = stations[i].stats;
+        }
+    }
+    portEXIT_CRITICAL(&shaper_lock);
+    return count;
+}
+
+esp_err_t shaper_get_handler(httpd_req_t *req)
+{
+    settings_shaper_t limits;
+    settings_get_shaper(&limits);
+    settings_shaper_t *shaper = &limits;
+
+    char line[96];
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    snprintf(line, sizeof(line), "uplink_kbps %lu\nstation_up_kbps %lu\nstation_down_kbps %lu\n", shaper->uplink_kbps, shaper->station_up_kbps, shaper->station_down_kbps);
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    for (int i = 0; i < shaper->override_count; i++)
+    {
+        snprintf(line, sizeof(line), "station " MACSTR " up_kbps %lu down_kbps %lu\n", MAC2STR(shaper->overrides[i].mac), shaper->overrides[i].up_kbps, shaper->overrides[i].down_kbps);
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
+
+// Campos: uplink, up, down (límites generales) o mac, up, down (límite de un cliente; con remove=1 se quita).
+// Solo desde el punto de acceso y con la contraseña de administración (admin.h)
+esp_err_t shaper_post_handler(httpd_req_t *req)
+{
+    if (!admin_authorize(req, NULL))
+    {
+        return ESP_FAIL;
+    }
+
+    char mac_text[18], remove[2], uplink[11], up[11], down[11];
+    form_field_t fields[] = {
+        {.name = "mac", .value = mac_text, .size = sizeof(mac_text)},
+        {.name = "remove", .value = remove, .size = sizeof(remove)},
+        {.name = "uplink", .value = uplink, .size = sizeof(uplink)},
+        {.name = "up", .value = up, .size = sizeof(up)},
+        {.name = "down", .value = down, .size = sizeof(down)},
+    };
+    const int field_count = sizeof(fields) / sizeof(fields[0]);
+
+    if (form_recv(req, fields, field_count) != ESP_OK)
+    {
+        return ESP_FAIL;
+    }
+    for (int i = 0; i < field_count; i++)
+    {
+        if (fields[i].truncated)
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Valor demasiado largo");
+        }
+    }
+
+    settings_shaper_t limits;
+    settings_get_shaper(&limits);
+    settings_shaper_t *shaper = &limits;
+
+    if (fields[0].found)
+    {
+        uint8_t mac[6];
+        if (!parse_mac(mac_text, mac))
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "MAC no válida");
+        }
+
+        int index = 0;
+        while (index < shaper->override_count && memcmp(shaper->overrides[index].mac, mac, sizeof(mac)) != 0)
+        {
+            index++;
+        }
+
+        if (fields[1].found && remove[0] == '1')
+        {
+            if (index < shaper->override_count)
+            {
+                shaper->overrides[index] = shaper->overrides[--shaper->override_count];
+            }
+        }
+        else
+        {
+            if (index == shaper->override_count)
+            {
+                if (index == SETTINGS_SHAPER_MAX_OVERRIDES)
+                {
+                    return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "No caben más límites por cliente");
+                }
+                memset(&shaper->overrides[index], 0, sizeof(shaper->overrides[index]));
+                memcpy(shaper->overrides[index].mac, mac, sizeof(mac));
+                shaper->override_count++;
+            }
+            if (!field_u32(&fields[3], &shaper->overrides[index].up_kbps) || !field_u32(&fields[4], &shaper->overrides[index].down_kbps))
+            {
+                return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Límite no válido");
+            }
+        }
+    }
+    else
+    {
+        if (!field_u32(&fields[2], &shaper->uplink_kbps) || !field_u32(&fields[3], &shaper->station_up_kbps) || !field_u32(&fields[4], &shaper->station_down_kbps))
+        {
+            return httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Límite no válido");
+        }
+    }
+
+    esp_err_t err = settings_set_shaper(shaper);
+    if (err != ESP_OK)
+    {
+        return httpd_resp_send_err(req, HTTPD_500_INTERNAL_SERVER_ERROR, "Error al guardar los límites");
+    }
+    return shaper_get_handler(req);
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "clients.h"
+#include "cores.h"
+#include "lwip/pbuf.h"
+
+// Control de tráfico por cliente del AP.
+// Cada cliente (por MAC) tiene un cubo de fichas para la subida y otro para la bajada. Los paquetes de subida
+// se encolan por cliente y una tarea los envía por turnos con déficit (DRR), limitada además por un cubo común
+// ajustado algo por debajo del enlace de subida: así la cola se forma aquí, donde es justa, y no en el driver,
+// y los flujos pequeños de un cliente no esperan detrás de la descarga de otro. La bajada solo se limita.
+// Los límites se guardan en la configuración (settings.h); sin ningún límite los paquetes no se encolan.
+
+// Definiciones del control de tráfico
+#define SHAPER_MAX_STATIONS CLIENTS_MAX // Clientes con estado propio (misma ranura que en la tabla de clientes)
+#define SHAPER_QUEUE_LEN 16       // Paquetes en cola por cliente (potencia de 2)
+#define SHAPER_QUEUE_TOTAL 24     // Paquetes en cola entre todos los clientes (retienen buffers de recepción del WiFi)
+#define SHAPER_QUANTUM 1514       // Bytes que gana cada cliente por turno
+#define SHAPER_BURST_MS 20        // Ráfaga permitida por encima del límite
+#define SHAPER_TASK_PRIORITY 19   // Justo por encima de la tarea TCP/IP
+#define SHAPER_TASK_CORE CORE_PACKET
+#define SHAPER_TASK_STACK 3072
+
+// Contadores de un cliente
+typedef struct
+{
+    uint8_t mac[6];
+    uint16_t queue_depth;   // Paquetes en cola
+    uint16_t queue_max;     // Máximo de paquetes en cola observado
+    uint32_t up_packets;    // Paquetes enviados hacia la red de subida
+    uint32_t up_bytes;
+    uint32_t down_packets;  // Paquetes entregados al cliente
+    uint32_t down_bytes;
+    uint32_t drops_queue;   // Descartados por cola llena
+    uint32_t drops_rate;    // Descartados por superar el límite de bajada
+} shaper_station_stats_t;
+
+typedef void (*shaper_send_fn)(struct pbuf *p); // Envía un paquete de subida que ha salido de la cola
+
+esp_err_t shaper_start(shaper_send_fn send);                   // Crea la tarea de envío y carga los límites
+bool shaper_enqueue(struct pbuf *p, const uint8_t *mac);       // Encola un paquete de subida; false si no hay control y debe enviarse ya
+bool shaper_admit_down(const uint8_t *mac, uint16_t len);      // Comprueba el límite de bajada; false si el paquete debe descartarse
+void shaper_station_remove(const uint8_t *mac);                // Libera el estado de un cliente desconectado
+int shaper_get_stats(shaper_station_stats_t *stats, int max);  // Copia los contadores de los clientes y devuelve cuántos
+esp_err_t shaper_get_handler(httpd_req_t *req);                // GET /shaper: límites actuales
+esp_err_t shaper_post_handler(httpd_req_t *req);               // POST /shaper: cambia los límites
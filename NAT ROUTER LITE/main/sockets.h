@@ -0,0 +1,9 @@
+#pragma once
+
+// Presupuesto de sockets de lwIP (CONFIG_LWIP_MAX_SOCKETS).
+// Sesiones del servidor web y sus sockets internos; el reenviador DNS (DNS_SOCKETS) y la prueba de velocidad
+// (SELFTEST_SOCKETS) declaran los suyos en su cabecera, y main.c comprueba al compilar que la suma cabe.
+
+// Definiciones del presupuesto
+#define HTTP_MAX_SOCKETS 7      // max_open_sockets del servidor HTTP (pestañas del estado en vivo incluidas)
+#define HTTP_INTERNAL_SOCKETS 3 // Escucha, control y el que reserva esp_http_server para aceptar y cerrar
@@ -0,0 +1,49 @@
+#include "sta_policy.h"
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void sta_policy_reset(sta_policy_t *policy)
+{
+    policy->failures = 0;
+}
+
+void sta_policy_link_lost(sta_policy_t *policy, int64_t now_us)
+{
+    if (policy->outage_start_us == 0)
+    {
+        policy->outage_start_us = now_us;
+    }
+}
+
+bool sta_policy_begin_attempt(sta_policy_t *policy, int64_t now_us, bool cached)
+{
+    // Los primeros intentos van directos al último BSSID en su canal; si fallan se escanean todos los canales
+    policy->targeted = cached && policy->failures < STA_POLICY_TARGETED_ATTEMPTS;
+    policy->attempt_start_us = now_us;
+    return policy->targeted;
+}
+
+uint32_t sta_policy_next_delay(sta_policy_t *policy, uint32_t random)
+{
+    // Espera exponencial (100 ms, 200 ms, 400 ms...) hasta STA_POLICY_BACKOFF_MAX_MS, con un ±25 % aleatorio
+    uint32_t delay_ms = STA_POLICY_BACKOFF_MAX_MS;
+    if (policy->failures < 16)
+    {
+        delay_ms = (uint32_t)STA_POLICY_BACKOFF_MIN_MS << policy->failures;
+        if (delay_ms > STA_POLICY_BACKOFF_MAX_MS)
+        {
+            delay_ms = STA_POLICY_BACKOFF_MAX_MS;
+        }
+    }
+    policy->failures++;
+    return delay_ms * 3 / 4 + random % (delay_ms / 2 + 1);
+}
+
+void sta_policy_got_ip(sta_policy_t *policy, int64_t now_us, uint32_t *outage_ms, uint32_t *attempt_ms)
+{
+    *outage_ms = policy->outage_start_us ? (uint32_t)((now_us - policy->outage_start_us) / 1000) : 0;
+    *attempt_ms = policy->attempt_start_us ? (uint32_t)((now_us - policy->attempt_start_us) / 1000) : 0;
+    policy->outage_start_us = 0;
+    policy->attempt_start_us = 0;
+    policy->failures = 0;
+}
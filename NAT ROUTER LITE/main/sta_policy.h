@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Política de reconexión de la STA.
+// Decide cuándo y cómo reintentar la conexión (espera exponencial, intento directo al último AP o escaneo
+// completo) y mide el tiempo hasta obtener IP. No depende de ESP-IDF: recibe el tiempo y el valor aleatorio
+// del llamador, de modo que la misma lógica puede compilarse y ejecutarse en el host con eventos simulados.
+
+// Definiciones de la política
+#define STA_POLICY_BACKOFF_MIN_MS 100   // Espera antes del primer reintento
+#define STA_POLICY_BACKOFF_MAX_MS 30000 // Espera máxima entre reintentos
+#define STA_POLICY_TARGETED_ATTEMPTS 2  // Intentos al último BSSID y canal antes de escanear todos los canales
+
+typedef struct
+{
+    uint32_t failures;        // Reintentos seguidos sin obtener IP
+    int64_t outage_start_us;  // Momento en que se perdió la conexión (0 si hay IP)
+    int64_t attempt_start_us; // Momento en que empezó el intento actual (0 si no hay intento)
+    bool targeted;            // El intento actual va directo al último AP conocido
+} sta_policy_t;
+
+void sta_policy_reset(sta_policy_t *policy);                                      // Olvida los fallos (por ejemplo, al cambiar de red)
+void sta_policy_link_lost(sta_policy_t *policy, int64_t now_us);                  // Marca el inicio de una pérdida de conexión
+bool sta_policy_begin_attempt(sta_policy_t *policy, int64_t now_us, bool cached); // Empieza un intento; true si debe ir directo al AP guardado
+uint32_t sta_policy_next_delay(sta_policy_t *policy, uint32_t random);            // Cuenta un fallo y devuelve la espera hasta el siguiente intento
+void sta_policy_got_ip(sta_policy_t *policy, int64_t now_us, uint32_t *outage_ms, uint32_t *attempt_ms); // Cierra la pérdida y el intento (0 si no había)
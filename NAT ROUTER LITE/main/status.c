@@ -0,0 +1,422 @@
+#include "status.h"
+#include "clients.h"
+#include "metrics.h"
+#include "sockets.h"
+#include "esp_log.h"
+#include "esp_mac.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#include "freertos/FreeRTOS.h"
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/param.h>
+
+// Grupos del estado (máscara de cambios)
+#define STATUS_GROUP_STA (1u << 0)     // Red de subida
+#define STATUS_GROUP_RATE (1u << 1)    // Tráfico reenviado
+#define STATUS_GROUP_CLIENTS (1u << 2) // Clientes del AP
+#define STATUS_GROUP_ALL (STATUS_GROUP_STA | STATUS_GROUP_RATE | STATUS_GROUP_CLIENTS)
+
+// Estructuras
+typedef struct
+{
+    uint8_t mac[6];
+    uint32_t ip; // 0 si aún no tiene IP
+} status_client_t;
+
+typedef struct
+{
+    uint8_t sta_state; // 0: sin conexión, 1: asociada, 2: con IP
+    char ssid[33];
+    uint32_t ip;
+    int8_t rssi;
+    uint32_t up_kbps; // Tráfico reenviado en kbit/s
+    uint32_t down_kbps;
+    uint8_t client_count;
+    status_client_t clients[CLIENTS_MAX];
+} status_state_t;
+
+typedef struct
+{
+    uint32_t seq; // Número de evento, empezando en 1
+    uint32_t time_s;
+    uint8_t event;
+    uint8_t mac[6];
+    int32_t arg;
+} status_record_t;
+
+// Tags para logging
+static const char *TAG_STATUS = "STATUS";
+
+static const char *event_names[STATUS_EV_COUNT] = {
+    [STATUS_EV_STA_CONNECTED] = "sta_connected",
+    [STATUS_EV_STA_DISCONNECTED] = "sta_disconnected",
+    [STATUS_EV_STA_GOT_IP] = "sta_got_ip",
+    [STATUS_EV_STA_LOST_IP] = "sta_lost_ip",
+    [STATUS_EV_STA_RECONNECT] = "sta_reconnect",
+    [STATUS_EV_CLIENT_JOINED] = "client_joined",
+    [STATUS_EV_CLIENT_LEFT] = "client_left",
+};
+
+// Variables globales
+static httpd_handle_t server = NULL;
+static esp_netif_t *sta = NULL;
+static esp_timer_handle_t status_timer = NULL;
+static bool push_pending = false; // Hay un envío en la cola de trabajos del servidor HTTP
+static portMUX_TYPE events_lock = portMUX_INITIALIZER_UNLOCKED;
+static status_record_t events[STATUS_EVENT_HISTORY];
+static uint32_t event_seq = 0; // Último evento registrado
+
+// Solo se usan en la tarea del servidor HTTP
+static status_state_t last;    // Último estado enviado
+static uint32_t sent_seq = 0;  // Último evento enviado
+static uint64_t last_up_bytes = 0;
+static uint64_t last_down_bytes = 0;
+static int64_t last_rate_us = 0;
+static char frame[STATUS_FRAME_SIZE];
+static size_t frame_len = 0;
+static bool frame_overflow = false;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void append(const char *format, ...)
+{
+    if (frame_overflow)
+    {
+        return;
+    }
+
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(frame + frame_len, sizeof(frame) - frame_len, format, args);
+    va_end(args);
+
+    if (len < 0 || (size_t)len >= sizeof(frame) - frame_len)
+    {
+        frame_overflow = true;
+        return;
+    }
+    frame_len += len;
+}
+
+// Añade una cadena escapada para JSON (el SSID puede contener cualquier byte)
+static void append_escaped(const char *text)
+{
+    for (; *text; text++)
+    {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\')
+        {
+            append("\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            append("\\u%04x", c);
+        }
+        else
+        {
+            append("%c", c);
+        }
+    }
+}
+
+// Lee el estado actual de la red de subida, el tráfico y los clientes del AP
+static void collect(status_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK)
+    {
+        state->sta_state = 1;
+        memcpy(state->ssid, ap_info.ssid, sizeof(state->ssid) - 1);
+        state->rssi = ap_info.rssi;
+        if (last.sta_state != 0 && abs(state->rssi - last.rssi) < STATUS_RSSI_HYSTERESIS)
+        {
+            state->rssi = last.rssi; // Pequeñas variaciones no generan tramas
+        }
+
+        esp_netif_ip_info_t ip_info;
+        if (esp_netif_get_ip_info(sta, &ip_info) == ESP_OK && ip_info.ip.addr != 0)
+        {
+            state->sta_state = 2;
+            state->ip = ip_info.ip.addr;
+        }
+    }
+
+    // El tráfico se calcula sobre al menos medio intervalo para que los envíos por eventos no den picos
+    uint64_t m[METRIC_COUNT];
+    metrics_snapshot(m);
+    int64_t now = esp_timer_get_time();
+    int64_t elapsed_us = now - last_rate_us;
+    if (elapsed_us >= STATUS_PUSH_INTERVAL_MS * 500LL)
+    {
+        uint64_t up_bytes = m[METRIC_UP_FAST_BYTES] + m[METRIC_UP_SLOW_BYTES];
+        uint64_t down_bytes = m[METRIC_DOWN_BYTES];
+        state->up_kbps = (up_bytes - last_up_bytes) * 8000 / elapsed_us;
+        state->down_kbps = (down_bytes - last_down_bytes) * 8000 / elapsed_us;
+        last_up_bytes = up_bytes;
+        last_down_bytes = down_bytes;
+        last_rate_us = now;
+    }
+    else
+    {
+        state->up_kbps = last.up_kbps;
+        state->down_kbps = last.down_kbps;
+    }
+
+    static client_info_t clients[CLIENTS_MAX]; // Fuera de la pila de la tarea del servidor HTTP
+    state->client_count = clients_get(clients, CLIENTS_MAX);
+    for (int i = 0; i < state->client_count; i++)
+    {
+        memcpy(state->clients[i].mac, clients[i].mac, sizeof(state->clients[i].mac));
+        state->clients[i].ip = clients[i].ip;
+    }
+}
+
+// Devuelve los grupos que han cambiado entre dos estados
+static uint32_t diff(const status_state_t *old, const status_state_t *new)
+{
+    uint32_t groups = 0;
+    if (old->sta_state != new->sta_state || old->ip != new->ip || old->rssi != new->rssi || strcmp(old->ssid, new->ssid) != 0)
+    {
+        groups |= STATUS_GROUP_STA;
+    }
+    if (old->up_kbps != new->up_kbps || old->down_kbps != new->down_kbps)
+    {
+        groups |= STATUS_GROUP_RATE;
+    }
+    if (old->client_count != new->client_count || memcmp(old->clients, new->clients, new->client_count * sizeof(new->clients[0])) != 0)
+    {
+        groups |= STATUS_GROUP_CLIENTS;
+    }
+    return groups;
+}
+
+// Escribe en frame los grupos indicados del estado y los eventos posteriores a from_seq; devuelve el último evento incluido
+static uint32_t build(const status_state_t *state, uint32_t groups, uint32_t from_seq)
+{
+    frame_len = 0;
+    frame_overflow = false;
+    append("{");
+
+    if (groups & STATUS_GROUP_STA)
+    {
+        append("\"sta\":{\"state\":%u,\"ssid\":\"", state->sta_state);
+        append_escaped(state->ssid);
+        append("\",\"ip\":\"" IPSTR "\",\"rssi\":%d}", IP2STR((esp_ip4_addr_t *)&state->ip), state->rssi);
+    }
+
+    if (groups & STATUS_GROUP_RATE)
+    {
+        append("%s\"rate\":{\"up\":%lu,\"down\":%lu}", frame_len > 1 ? "," : "", state->up_kbps, state->down_kbps);
+    }
+
+    if (groups & STATUS_GROUP_CLIENTS)
+    {
+        append("%s\"clients\":[", frame_len > 1 ? "," : "");
+        for (int i = 0; i < state->client_count; i++)
+        {
+            const status_client_t *client = &state->clients[i];
+            append("%s{\"mac\":\"" MACSTR "\",\"ip\":\"" IPSTR "\"}", i > 0 ? "," : "", MAC2STR(client->mac), IP2STR((esp_ip4_addr_t *)&client->ip));
+        }
+        append("]");
+    }
+
+    // Copia los eventos pendientes para no formatear dentro de la sección crítica
+    status_record_t pending[STATUS_EVENT_HISTORY];
+    int count = 0;
+    portENTER_CRITICAL(&events_lock);
+    uint32_t to_seq = event_seq;
+    for (uint32_t seq = MAX(from_seq + 1, to_seq > STATUS_EVENT_HISTORY ? to_seq - STATUS_EVENT_HISTORY + 1 : 1); seq <= to_seq; seq++)
+    {
+        pending[count++] = events[(seq - 1) % STATUS_EVENT_HISTORY];
+    }
+    portEXIT_CRITICAL(&events_lock);
+
+    if (count > 0)
+    {
+        append("%s\"events\":[", frame_len > 1 ? "," : "");
+        for (int i = 0; i < count; i++)
+        {
+            const status_record_t *record = &pending[i];
+            append("%s{\"seq\":%lu,\"t\":%lu,\"ev\":\"%s\"", i > 0 ? "," : "", record->seq, record->time_s, event_names[record->event]);
+            switch (record->event)
+            {
+            case STATUS_EV_STA_GOT_IP:
+                append(",\"ip\":\"" IPSTR "\"}", IP2STR((esp_ip4_addr_t *)&record->arg));
+                break;
+            case STATUS_EV_CLIENT_JOINED:
+            case STATUS_EV_CLIENT_LEFT:
+                append(",\"mac\":\"" MACSTR "\",\"arg\":%ld}", MAC2STR(record->mac), record->arg);
+                break;
+            default:
+                append(",\"arg\":%ld}", record->arg);
+                break;
+            }
+        }
+        append("]");
+    }
+
+    append("}");
+    return to_seq;
+}
+
+// Envía la trama a todas las pestañas suscritas
+static void broadcast(void)
+{
+    size_t count = HTTP_MAX_SOCKETS;
+    int fds[HTTP_MAX_SOCKETS];
+    if (httpd_get_client_list(server, &count, fds) != ESP_OK)
+    {
+        return;
+    }
+
+    httpd_ws_frame_t ws_frame = {
+        .final = true,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)frame,
+        .len = frame_len,
+    };
+    for (size_t i = 0; i < count; i++)
+    {
+        if (httpd_ws_get_fd_info(server, fds[i]) == HTTPD_WS_CLIENT_WEBSOCKET)
+        {
+            httpd_ws_send_frame_async(server, fds[i], &ws_frame);
+        }
+    }
+}
+
+// Trabajo en la tarea del servidor HTTP: muestrea el estado y envía solo lo que ha cambiado
+static void push_work(void *arg)
+{
+    __atomic_store_n(&push_pending, false, __ATOMIC_RELEASE);
+
+    status_state_t state;
+    collect(&state);
+
+    uint32_t groups = diff(&last, &state);
+    if (groups == 0 && __atomic_load_n(&event_seq, __ATOMIC_RELAXED) == sent_seq)
+    {
+        return;
+    }
+
+    last = state;
+    sent_seq = build(&last, groups, sent_seq);
+    if (frame_overflow)
+    {
+        ESP_LOGW(TAG_STATUS, "El estado no cabe en una trama de %d bytes", STATUS_FRAME_SIZE);
+        return;
+    }
+    broadcast();
+}
+
+// Programa un envío en la tarea del servidor HTTP si no hay ya uno pendiente
+static void request_push(void)
+{
+    if (server == NULL || __atomic_exchange_n(&push_pending, true, __ATOMIC_ACQ_REL))
+    {
+        return;
+    }
+    if (httpd_queue_work(server, push_work, NULL) != ESP_OK)
+    {
+        __atomic_store_n(&push_pending, false, __ATOMIC_RELEASE);
+    }
+}
+
+static void status_timer_cb(void *arg)
+{
+    request_push();
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t status_start(httpd_handle_t server_handle, esp_netif_t *sta_netif)
+{
+    if (server_handle == NULL)
+    {
+        return ESP_ERR_INVALID_ARG;
+    }
+    sta = sta_netif;
+
+    uint64_t m[METRIC_COUNT];
+    metrics_snapshot(m);
+    last_up_bytes = m[METRIC_UP_FAST_BYTES] + m[METRIC_UP_SLOW_BYTES];
+    last_down_bytes = m[METRIC_DOWN_BYTES];
+    last_rate_us = esp_timer_get_time();
+
+    esp_timer_create_args_t config = {
+        .callback = status_timer_cb,
+        .arg = NULL,
+        .dispatch_method = ESP_TIMER_TASK,
+        .name = "status_timer",
+    };
+    esp_err_t err = esp_timer_create(&config, &status_timer);
+    if (err != ESP_OK)
+    {
+        ESP_LOGE(TAG_STATUS, "Error al crear el timer del estado en vivo. Error %s", esp_err_to_name(err));
+        return err;
+    }
+
+    server = server_handle;
+    return esp_timer_start_periodic(status_timer, STATUS_PUSH_INTERVAL_MS * 1000ULL);
+}
+
+void status_event(status_event_t event, const uint8_t *mac, int32_t arg)
+{
+    portENTER_CRITICAL(&events_lock);
+    status_record_t *record = &events[event_seq % STATUS_EVENT_HISTORY];
+    record->seq = ++event_seq;
+    record->time_s = esp_timer_get_time() / 1000000;
+    record->event = event;
+    record->arg = arg;
+    if (mac != NULL)
+    {
+        memcpy(record->mac, mac, sizeof(record->mac));
+    }
+    else
+    {
+        memset(record->mac, 0, sizeof(record->mac));
+    }
+    portEXIT_CRITICAL(&events_lock);
+
+    request_push();
+}
+
+esp_err_t status_ws_handler(httpd_req_t *req)
+{
+    if (req->method == HTTP_GET)
+    {
+        // Negociación completada: la pestaña nueva recibe el estado completo y los eventos recientes
+        build(&last, STATUS_GROUP_ALL, 0);
+        if (frame_overflow)
+        {
+            return ESP_FAIL;
+        }
+        httpd_ws_frame_t ws_frame = {
+            .final = true,
+            .type = HTTPD_WS_TYPE_TEXT,
+            .payload = (uint8_t *)frame,
+            .len = frame_len,
+        };
+        return httpd_ws_send_frame(req, &ws_frame);
+    }
+
+    // Los mensajes de las pestañas se leen y se ignoran
+    uint8_t buf[32];
+    httpd_ws_frame_t ws_frame = {0};
+    esp_err_t err = httpd_ws_recv_frame(req, &ws_frame, 0);
+    if (err != ESP_OK || ws_frame.len > sizeof(buf))
+    {
+        return ESP_FAIL;
+    }
+    if (ws_frame.len > 0)
+    {
+        ws_frame.payload = buf;
+        err = httpd_ws_recv_frame(req, &ws_frame, ws_frame.len);
+    }
+    return err;
+}
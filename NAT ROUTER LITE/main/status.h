@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+#include "esp_netif.h"
+
+// Estado en vivo para la página web por WebSocket (/ws).
+// Un único timer reúne cada segundo el estado de la red de subida, el tráfico y los clientes del AP, y lo compara
+// con el último enviado; solo se emiten los grupos que han cambiado, como un objeto JSON compacto. El envío se hace
+// en la tarea del servidor HTTP, que recorre sus sockets y manda la misma trama a cada pestaña suscrita, sin tareas
+// ni buffers por suscriptor. Al conectarse, cada pestaña recibe el estado completo y los últimos eventos.
+
+// Definiciones del estado en vivo
+#define STATUS_PUSH_INTERVAL_MS 1000 // Intervalo de muestreo del estado
+#define STATUS_EVENT_HISTORY 8       // Eventos recientes enviados a las pestañas nuevas
+#define STATUS_RSSI_HYSTERESIS 3     // dB de cambio de RSSI necesarios para emitirlo
+#define STATUS_FRAME_SIZE 2048       // Tamaño máximo de una trama (estado completo con CLIENTS_MAX clientes)
+
+// Eventos de conexión
+typedef enum
+{
+    STATUS_EV_STA_CONNECTED = 0, // Sin argumento
+    STATUS_EV_STA_DISCONNECTED,  // Razón
+    STATUS_EV_STA_GOT_IP,        // IP
+    STATUS_EV_STA_LOST_IP,       // Sin argumento
+    STATUS_EV_STA_RECONNECT,     // Espera en ms
+    STATUS_EV_CLIENT_JOINED,     // MAC
+    STATUS_EV_CLIENT_LEFT,       // MAC, razón
+    STATUS_EV_COUNT,
+} status_event_t;
+
+esp_err_t status_start(httpd_handle_t server, esp_netif_t *sta_netif); // Inicia el muestreo periódico
+void status_event(status_event_t event, const uint8_t *mac, int32_t arg);                   // Registra un evento y lo envía sin esperar al siguiente muestreo
+esp_err_t status_ws_handler(httpd_req_t *req);                                               // Manejador de /ws
@@ -0,0 +1,106 @@
+#include "task_stats.h"
+#include "pool.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Estructuras
+typedef struct
+{
+    void *handle;
+    uint64_t runtime_us;
+} task_sample_t;
+
+// Variables globales (solo en la tarea del servidor HTTP)
+static task_sample_t previous[TASK_STATS_MAX_TASKS]; // Muestra de la consulta anterior a /tasks
+static int previous_count = 0;
+static uint64_t previous_uptime_us = 0;
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int task_stats_get(task_stats_t *stats, int max, uint64_t *uptime_us)
+{
+    UBaseType_t size = uxTaskGetNumberOfTasks() + 4; // Margen para tareas creadas mientras tanto
+    TaskStatus_t *status = pool_alloc(size * sizeof(TaskStatus_t));
+    if (status == NULL)
+    {
+        return 0;
+    }
+
+    UBaseType_t count = uxTaskGetSystemState(status, size, NULL);
+    *uptime_us = esp_timer_get_time();
+
+    int n = 0;
+    for (UBaseType_t i = 0; i < count && n < max; i++, n++)
+    {
+        task_stats_t *task = &stats[n];
+        snprintf(task->name, sizeof(task->name), "%s", status[i].pcTaskName);
+        task->handle = status[i].xHandle;
+        BaseType_t core = xTaskGetCoreID(status[i].xHandle);
+        task->core = (core == tskNO_AFFINITY) ? -1 : core;
+        task->priority = status[i].uxCurrentPriority;
+        task->stack_free = status[i].usStackHighWaterMark;
+        task->runtime_us = status[i].ulRunTimeCounter;
+    }
+
+    pool_free(status);
+    return n;
+}
+
+esp_err_t task_stats_handler(httpd_req_t *req)
+{
+    task_stats_t *stats = pool_alloc(TASK_STATS_MAX_TASKS * sizeof(task_stats_t));
+    if (stats == NULL)
+    {
+        return httpd_resp_send_500(req);
+    }
+
+    uint64_t uptime_us;
+    int count = task_stats_get(stats, TASK_STATS_MAX_TASKS, &uptime_us);
+    uint64_t window_us = uptime_us - previous_uptime_us;
+
+    char line[128];
+    httpd_resp_set_type(req, "text/plain");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+
+    // cpu: porcentaje de un núcleo desde la consulta anterior; avg: desde el arranque
+    snprintf(line, sizeof(line), "uptime_s %llu\nwindow_ms %llu\n", uptime_us / 1000000, window_us / 1000);
+    httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+
+    for (int i = 0; i < count; i++)
+    {
+        const task_stats_t *task = &stats[i];
+        uint64_t before = 0;
+        for (int j = 0; j < previous_count; j++)
+        {
+            if (previous[j].handle == task->handle && previous[j].runtime_us <= task->runtime_us)
+            {
+                before = previous[j].runtime_us;
+                break;
+            }
+        }
+
+        char core[4] = "any";
+        if (task->core >= 0)
+        {
+            snprintf(core, sizeof(core), "%d", task->core);
+        }
+        snprintf(line, sizeof(line), "task %-16s core %-3s prio %2lu cpu %5.1f%% avg %5.1f%% stack_free %lu\n", task->name, core, task->priority,
+                 window_us ? 100.0 * (task->runtime_us - before) / window_us : 0.0, uptime_us ? 100.0 * task->runtime_us / uptime_us : 0.0, task->stack_free);
+        httpd_resp_send_chunk(req, line, HTTPD_RESP_USE_STRLEN);
+    }
+
+    previous_count = count;
+    for (int i = 0; i < count; i++)
+    {
+        previous[i] = (task_sample_t){.handle = stats[i].handle, .runtime_us = stats[i].runtime_us};
+    }
+    previous_uptime_us = uptime_us;
+
+    pool_free(stats);
+    return httpd_resp_send_chunk(req, NULL, 0);
+}
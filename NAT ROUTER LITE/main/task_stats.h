@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Tiempo de CPU de cada tarea.
+// Usa las estadísticas de ejecución de FreeRTOS (CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS, reloj de esp_timer)
+// para mostrar en /tasks el núcleo, la prioridad y el reparto de CPU de cada tarea, tanto desde el arranque
+// como desde la consulta anterior, y exporta el tiempo acumulado en /metrics.
+
+// Definiciones de las estadísticas
+#define TASK_STATS_MAX_TASKS 32 // Tareas recordadas entre consultas
+
+// Datos de una tarea
+typedef struct
+{
+    char name[16];
+    void *handle;
+    int core;              // Núcleo fijado, -1 sin afinidad
+    uint32_t priority;
+    uint32_t stack_free;   // Mínimo de pila libre en bytes
+    uint64_t runtime_us;   // Tiempo de CPU desde el arranque
+} task_stats_t;
+
+int task_stats_get(task_stats_t *stats, int max, uint64_t *uptime_us); // Copia los datos de las tareas y devuelve cuántas
+esp_err_t task_stats_handler(httpd_req_t *req);                       // GET /tasks
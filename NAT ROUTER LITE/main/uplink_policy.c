@@ -0,0 +1,148 @@
+#include "uplink_policy.h"
+#include <string.h>
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+void uplink_policy_reset(uplink_policy_t *policy, uint8_t count, int current)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->count = count > UPLINK_POLICY_MAX_NETWORKS ? UPLINK_POLICY_MAX_NETWORKS : count;
+    policy->current = current < policy->count ? current : -1;
+    policy->last_ip = policy->current;
+    policy->next = -1;
+    for (int i = 0; i < UPLINK_POLICY_MAX_NETWORKS; i++)
+    {
+        policy->candidates[i].rssi = UPLINK_POLICY_UNSEEN_RSSI;
+    }
+}
+
+int uplink_policy_score(const uplink_policy_t *policy, int index)
+{
+    const uplink_candidate_t *candidate = &policy->candidates[index];
+    int failures = candidate->failures < UPLINK_POLICY_MAX_FAILURES ? candidate->failures : UPLINK_POLICY_MAX_FAILURES;
+    return candidate->rssi + (policy->count - index) * UPLINK_POLICY_PREFERENCE_DB - failures * UPLINK_POLICY_FAILURE_DB;
+}
+
+int uplink_policy_select(uplink_policy_t *policy)
+{
+    if (policy->next >= 0)
+    {
+        policy->current = policy->next;
+        policy->next = -1;
+        return policy->current;
+    }
+
+    // Sin datos de escaneo todas las redes tienen el mismo RSSI y decide el orden de preferencia menos los fallos
+    int best = -1;
+    for (int i = 0; i < policy->count; i++)
+    {
+        if (best < 0 || uplink_policy_score(policy, i) > uplink_policy_score(policy, best))
+        {
+            best = i;
+        }
+    }
+    policy->current = best;
+    return best;
+}
+
+void uplink_policy_link_lost(uplink_policy_t *policy)
+{
+    // La desconexión pedida para volver a la red preferida no es un fallo
+    if (policy->next >= 0 || policy->current < 0)
+    {
+        return;
+    }
+
+    // Si falla la vuelta a la red preferida, lo que venga después es una conmutación por fallo
+    policy->failback = false;
+
+    // La red perdida ya no cuenta con el RSSI del último escaneo: puede haber desaparecido
+    uplink_candidate_t *candidate = &policy->candidates[policy->current];
+    if (candidate->failures < UINT8_MAX)
+    {
+        candidate->failures++;
+    }
+    candidate->rssi = UPLINK_POLICY_UNSEEN_RSSI;
+    candidate->channel = 0;
+}
+
+uplink_switch_t uplink_policy_got_ip(uplink_policy_t *policy)
+{
+    if (policy->current < 0)
+    {
+        return UPLINK_SWITCH_NONE;
+    }
+
+    uplink_candidate_t *candidate = &policy->candidates[policy->current];
+    candidate->failures = 0;
+    candidate->connects++;
+    for (int i = 0; i < policy->count; i++)
+    {
+        policy->candidates[i].seen_scans = 0;
+    }
+
+    uplink_switch_t result = UPLINK_SWITCH_NONE;
+    if (policy->last_ip >= 0 && policy->last_ip != policy->current)
+    {
+        result = policy->failback ? UPLINK_SWITCH_FAILBACK : UPLINK_SWITCH_FAILOVER;
+    }
+    policy->last_ip = policy->current;
+    policy->failback = false;
+    return result;
+}
+
+void uplink_policy_scan_begin(uplink_policy_t *policy)
+{
+    for (int i = 0; i < policy->count; i++)
+    {
+        policy->candidates[i].rssi = UPLINK_POLICY_UNSEEN_RSSI;
+        policy->candidates[i].channel = 0;
+    }
+}
+
+void uplink_policy_scan_seen(uplink_policy_t *policy, int index, int8_t rssi, const uint8_t bssid[6], uint8_t channel)
+{
+    uplink_candidate_t *candidate = &policy->candidates[index];
+    if (candidate->channel != 0 && rssi <= candidate->rssi)
+    {
+        return; // Ya se vio un AP más fuerte de la misma red
+    }
+    candidate->rssi = rssi;
+    memcpy(candidate->bssid, bssid, sizeof(candidate->bssid));
+    candidate->channel = channel;
+}
+
+int uplink_policy_scan_end(uplink_policy_t *policy, bool connected)
+{
+    if (!connected || policy->current < 0)
+    {
+        return -1;
+    }
+
+    // Solo se vuelve a redes más arriba en la lista, vistas con buena señal en varios escaneos seguidos
+    int target = -1;
+    for (int i = 0; i < policy->count; i++)
+    {
+        uplink_candidate_t *candidate = &policy->candidates[i];
+        if (i < policy->current && candidate->channel != 0 && candidate->rssi >= UPLINK_POLICY_FAILBACK_RSSI)
+        {
+            candidate->seen_scans++;
+            if (target < 0 && candidate->seen_scans >= UPLINK_POLICY_FAILBACK_SCANS)
+            {
+                target = i;
+            }
+        }
+        else
+        {
+            candidate->seen_scans = 0;
+        }
+    }
+    return target;
+}
+
+void uplink_policy_failback(uplink_policy_t *policy, int index)
+{
+    policy->next = index;
+    policy->failback = true;
+    policy->candidates[index].failures = 0;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Elección de la red de subida entre las configuradas.
+// Cada red se puntúa con el RSSI del último escaneo, su puesto en la lista de preferencia y los fallos seguidos
+// al conectar. Tras una desconexión la red perdida se penaliza y se elige al momento la mejor alternativa; los
+// escaneos periódicos con conexión detectan cuándo vuelve una red preferida y piden volver a ella. Como
+// sta_policy, no depende de ESP-IDF y puede ejecutarse en el host con escaneos simulados.
+
+// Definiciones de la política
+#define UPLINK_POLICY_MAX_NETWORKS 4
+#define UPLINK_POLICY_PREFERENCE_DB 8    // Ventaja de cada puesto de la lista sobre el siguiente
+#define UPLINK_POLICY_FAILURE_DB 15      // Penalización por cada fallo seguido
+#define UPLINK_POLICY_MAX_FAILURES 4     // Fallos que cuentan para la penalización
+#define UPLINK_POLICY_UNSEEN_RSSI -90    // RSSI supuesto de una red que no apareció en el último escaneo
+#define UPLINK_POLICY_FAILBACK_RSSI -75  // RSSI mínimo de una red preferida para volver a ella
+#define UPLINK_POLICY_FAILBACK_SCANS 2   // Escaneos seguidos viéndola antes de volver
+
+// Cambio de red al obtener IP
+typedef enum
+{
+    UPLINK_SWITCH_NONE = 0,
+    UPLINK_SWITCH_FAILOVER, // A otra red tras perder la conexión
+    UPLINK_SWITCH_FAILBACK, // De vuelta a una red preferida que ha reaparecido
+} uplink_switch_t;
+
+// Lo que se sabe de cada red
+typedef struct
+{
+    int8_t rssi;          // Del último escaneo, UPLINK_POLICY_UNSEEN_RSSI si no apareció
+    uint8_t bssid[6];     // AP más fuerte del último escaneo
+    uint8_t channel;      // 0 si no apareció
+    uint8_t failures;     // Fallos seguidos al conectar
+    uint8_t seen_scans;   // Escaneos seguidos en los que cumple las condiciones para volver a ella
+    uint32_t connects;    // Conexiones con IP
+} uplink_candidate_t;
+
+typedef struct
+{
+    uint8_t count;
+    int8_t current;       // Red en uso o que se está intentando (-1 ninguna)
+    int8_t last_ip;       // Red con la que se tuvo IP por última vez (-1 ninguna)
+    int8_t next;          // Red pedida por uplink_policy_failback para el próximo intento (-1 ninguna)
+    bool failback;        // El cambio en curso es una vuelta a la red preferida
+    uplink_candidate_t candidates[UPLINK_POLICY_MAX_NETWORKS];
+} uplink_policy_t;
+
+void uplink_policy_reset(uplink_policy_t *policy, uint8_t count, int current); // Nueva lista de redes: olvida el historial
+int uplink_policy_select(uplink_policy_t *policy);                             // Red del próximo intento (-1 sin redes)
+void uplink_policy_link_lost(uplink_policy_t *policy);                         // Desconexión o intento fallido en la red actual
+uplink_switch_t uplink_policy_got_ip(uplink_policy_t *policy);                 // IP obtenida en la red actual; indica si hubo cambio de red
+void uplink_policy_scan_begin(uplink_policy_t *policy);                        // Empieza un escaneo: ninguna red vista
+void uplink_policy_scan_seen(uplink_policy_t *policy, int index, int8_t rssi, const uint8_t bssid[6], uint8_t channel); // Una red en el escaneo
+int uplink_policy_scan_end(uplink_policy_t *policy, bool connected);           // Fin del escaneo; devuelve la red a la que volver o -1
+void uplink_policy_failback(uplink_policy_t *policy, int index);               // El próximo intento irá a index
+int uplink_policy_score(const uplink_policy_t *policy, int index);             // Puntuación de una red (más es mejor)
@@ -0,0 +1,128 @@
+#include "web_assets.h"
+#include "esp_log.h"
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+// Definiciones de los recursos web
+#define WEB_HEADER_MAX_LEN 128 // Longitud máxima leída de Accept-Encoding e If-None-Match
+
+// Tags para logging
+static const char *TAG_WEB = "WEB_ASSETS";
+
+static const char *encoding_names[WEB_ENCODING_COUNT] = {"identity", "gzip", "br"};
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Lee una cabecera de la petición; devuelve false si no existe o no cabe en el buffer
+static bool get_header(httpd_req_t *req, const char *field, char *buf, size_t buf_size)
+{
+    size_t len = httpd_req_get_hdr_value_len(req, field);
+    if (len == 0 || len >= buf_size)
+    {
+        return false;
+    }
+    return httpd_req_get_hdr_value_str(req, field, buf, buf_size) == ESP_OK;
+}
+
+// Indica si la lista de Accept-Encoding admite la codificación (un q=0 explícito la rechaza)
+static bool accepts_encoding(const char *accept, const char *name)
+{
+    size_t name_len = strlen(name);
+    const char *token = accept;
+
+    while (token && *token)
+    {
+        token += strspn(token, " ,");
+        size_t token_len = strcspn(token, " ;,");
+        const char *next = strchr(token, ',');
+
+        if (token_len == name_len && strncasecmp(token, name, name_len) == 0)
+        {
+            const char *q = strstr(token + token_len, "q=");
+            return q == NULL || (next != NULL && q > next) || strtod(q + 2, NULL) > 0;
+        }
+        token = next;
+    }
+    return false;
+}
+
+// Elige la variante más pequeña que acepte el navegador
+static web_encoding_t select_encoding(httpd_req_t *req, const web_asset_t *asset)
+{
+    char accept[WEB_HEADER_MAX_LEN];
+    if (!get_header(req, "Accept-Encoding", accept, sizeof(accept)))
+    {
+        return WEB_ENCODING_IDENTITY;
+    }
+
+    for (int encoding = WEB_ENCODING_COUNT - 1; encoding > WEB_ENCODING_IDENTITY; encoding--)
+    {
+        if (asset->variants[encoding].data && accepts_encoding(accept, encoding_names[encoding]))
+        {
+            return (web_encoding_t)encoding;
+        }
+    }
+    return WEB_ENCODING_IDENTITY;
+}
+
+// Comprueba If-None-Match (lista de ETags, con o sin prefijo W/, o "*")
+static bool etag_matches(httpd_req_t *req, const char *etag)
+{
+    char if_none_match[WEB_HEADER_MAX_LEN];
+    if (!get_header(req, "If-None-Match", if_none_match, sizeof(if_none_match)))
+    {
+        return false;
+    }
+    return strcmp(if_none_match, "*") == 0 || strstr(if_none_match, etag) != NULL;
+}
+
+// MARK: FUNCIONES ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+esp_err_t web_assets_register(httpd_handle_t server)
+{
+    for (size_t i = 0; i < web_assets_count; i++)
+    {
+        httpd_uri_t uri = {
+            .uri = web_assets[i].uri,
+            .method = HTTP_GET,
+            .handler = web_assets_handler,
+            .user_ctx = (void *)&web_assets[i],
+        };
+
+        esp_err_t err = httpd_register_uri_handler(server, &uri);
+        if (err != ESP_OK)
+        {
+            ESP_LOGE(TAG_WEB, "Error al registrar el recurso %s. Error %s", web_assets[i].uri, esp_err_to_name(err));
+            return err;
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t web_assets_handler(httpd_req_t *req)
+{
+    const web_asset_t *asset = (const web_asset_t *)req->user_ctx;
+    web_encoding_t encoding = select_encoding(req, asset);
+    const web_variant_t *variant = &asset->variants[encoding];
+
+    httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+    httpd_resp_set_hdr(req, "X-Content-Type-Options", "nosniff"); // No permitir la interpretación de MIME
+    httpd_resp_set_hdr(req, "Vary", "Accept-Encoding");
+    httpd_resp_set_hdr(req, "ETag", variant->etag);
+
+    // El navegador ya tiene esta versión: no se envía el cuerpo
+    if (etag_matches(req, variant->etag))
+    {
+        httpd_resp_set_status(req, "304 Not Modified");
+        return httpd_resp_send(req, NULL, 0);
+    }
+
+    if (encoding != WEB_ENCODING_IDENTITY)
+    {
+        httpd_resp_set_hdr(req, "Content-Encoding", encoding_names[encoding]);
+    }
+    httpd_resp_set_type(req, asset->mime);
+    return httpd_resp_send(req, (const char *)variant->data, variant->len);
+}
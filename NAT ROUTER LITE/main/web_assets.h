@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// Recursos web embebidos en el firmware.
+// tools/web_assets.py genera en tiempo de compilación la tabla web_assets con cada recurso sin comprimir
+// y precomprimido en gzip/brotli, junto con un ETag fuerte por variante. El manejador elige la variante
+// según Accept-Encoding y responde 304 si el navegador ya tiene la misma versión (If-None-Match).
+
+// Codificaciones en orden de preferencia inversa
+typedef enum
+{
+    WEB_ENCODING_IDENTITY = 0,
+    WEB_ENCODING_GZIP,
+    WEB_ENCODING_BR,
+    WEB_ENCODING_COUNT,
+} web_encoding_t;
+
+typedef struct
+{
+    const uint8_t *data; // NULL si la variante no existe
+    size_t len;
+    const char *etag; // ETag entre comillas
+} web_variant_t;
+
+typedef struct
+{
+    const char *uri;
+    const char *mime;
+    const char *cache_control;
+    web_variant_t variants[WEB_ENCODING_COUNT];
+} web_asset_t;
+
+extern const web_asset_t web_assets[];
+extern const size_t web_assets_count;
+
+esp_err_t web_assets_register(httpd_handle_t server); // Registra un manejador GET por cada recurso
+esp_err_t web_assets_handler(httpd_req_t *req);      // Sirve el recurso indicado en user_ctx
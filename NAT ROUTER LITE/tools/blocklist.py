@@ -0,0 +1,177 @@
+#!/usr/bin/env python3
+"""Genera la imagen de la lista de bloqueo DNS del router y, opcionalmente, la envía.
+
+Lee listas de dominios en los formatos habituales: un dominio por línea, archivo
+hosts ("0.0.0.0 dominio") o reglas simples de Adblock ("||dominio^"). Los
+dominios se normalizan (minúsculas, IDNA), se descartan los que ya cubre un
+dominio padre de la lista (el router bloquea también los subdominios) y se
+guardan como huellas ordenadas en el formato de main/blocklist_index.h. Con
+--router la imagen se envía a POST /blocklist y el router la activa sin reiniciar;
+el envío se hace desde un cliente del punto de acceso y necesita la contraseña de
+administración (CONFIG_ROUTER_ADMIN_TOKEN) en --token.
+--domains guarda los dominios normalizados, uno por línea, para tools/blocklist_bench.c.
+
+Uso: blocklist.py --output blocklist.bin lista1.txt hosts.txt
+     blocklist.py --router 192.168.4.1 --token secreto lista1.txt
+"""
+
+import argparse
+import ipaddress
+import struct
+import sys
+import time
+import urllib.error
+import urllib.request
+import zlib
+
+MAGIC = 0x42534E44        # Igual que BLOCKLIST_MAGIC
+VERSION = 1               # BLOCKLIST_VERSION
+HEADER_SIZE = 64          # BLOCKLIST_HEADER_SIZE
+REMAINDER_BITS = 24       # BLOCKLIST_REMAINDER_BITS
+MIN_INDEX_BITS = 4        # BLOCKLIST_MIN_INDEX_BITS
+MAX_INDEX_BITS = 16       # BLOCKLIST_MAX_INDEX_BITS
+BUCKET_TARGET = 16        # Huellas por cubo buscadas al elegir el tamaño del índice
+PARTITION_SIZE = 0x60000  # Partición "blocklist" de partitions.csv
+MASK64 = (1 << 64) - 1
+
+# Nombres de los archivos hosts que no son dominios que bloquear
+IGNORED = {'localhost', 'localhost.localdomain', 'local', 'broadcasthost', 'ip6-localhost', 'ip6-loopback'}
+
+
+def fingerprint(wire):
+    # Igual que blocklist_index_hash: FNV-1a de 64 bits y el mezclador final de MurmurHash3
+    h = 14695981039346656037
+    for b in wire:
+        h = ((h ^ b) * 1099511628211) & MASK64
+    h ^= h >> 33
+    h = (h * 0xff51afd7ed558ccd) & MASK64
+    h ^= h >> 33
+    h = (h * 0xc4ceb9fe1a85ec53) & MASK64
+    h ^= h >> 33
+    return h
+
+
+def to_wire(labels):
+    return b''.join(bytes([len(label)]) + label for label in labels) + b'\0'
+
+
+def normalize(name):
+    # Devuelve las etiquetas del dominio en bytes, o None si no es un dominio que bloquear
+    name = name.strip().rstrip('.').lower()
+    if not name or name in IGNORED:
+        return None
+    try:
+        ipaddress.ip_address(name)
+        return None
+    except ValueError:
+        pass
+    try:
+        labels = [label.encode('idna') if not label.isascii() else label.encode() for label in name.split('.')]
+    except UnicodeError:
+        return None
+    if len(labels) < 2 or any(not 0 < len(label) <= 63 or b'*' in label or b'/' in label for label in labels):
+        return None
+    if sum(len(label) + 1 for label in labels) + 1 > 255:
+        return None
+    return tuple(labels)
+
+
+def parse_line(line):
+    line = line.split('#', 1)[0].strip()
+    if not line or line.startswith('!') or line.startswith('@@'):
+        return []
+    if line.startswith('||'):
+        # Adblock: solo las reglas de dominio completo sin opciones
+        rule = line[2:]
+        if not rule.endswith('^') or '$' in rule:
+            return []
+        return [rule[:-1]]
+    tokens = line.split()
+    try:
+        ipaddress.ip_address(tokens[0])
+        return tokens[1:]  # hosts
+    except ValueError:
+        return tokens[:1]
+
+
+def read_domains(paths):
+    domains = set()
+    for path in paths:
+        with open(path, encoding='utf-8', errors='replace') as f:
+            for line in f:
+                for name in parse_line(line):
+                    labels = normalize(name)
+                    if labels is not None:
+                        domains.add(labels)
+    return domains
+
+
+def drop_covered(domains):
+    # El router comprueba también los dominios padre: "ads.example.com" sobra si está "example.com"
+    return {d for d in domains if not any(d[i:] in domains for i in range(1, len(d) - 1))}
+
+
+def build(domains, created):
+    bits = min(MAX_INDEX_BITS, max(MIN_INDEX_BITS, (len(domains) // BUCKET_TARGET).bit_length()))
+    shift = 64 - bits - REMAINDER_BITS
+    entries = sorted({(h >> (64 - bits), (h >> shift) & ((1 << REMAINDER_BITS) - 1)) for h in (fingerprint(to_wire(d)) for d in domains)})
+
+    buckets = 1 << bits
+    index = [0] * (buckets + 1)
+    for bucket, _ in entries:
+        index[bucket + 1] += 1
+    for i in range(buckets):
+        index[i + 1] += index[i]
+
+    body = struct.pack('<%dI' % (buckets + 1), *index) + b''.join(r.to_bytes(3, 'big') for _, r in entries)
+    header = struct.pack('<IHBBIII', MAGIC, VERSION, bits, 0, len(entries), zlib.crc32(body), created)
+    header += bytes(HEADER_SIZE - len(header))
+    return header + body, bits, len(entries)
+
+
+def upload(router, token, image):
+    headers = {'Content-Type': 'application/octet-stream', 'X-Admin-Token': token}
+    req = urllib.request.Request('http://%s/blocklist' % router, data=image, headers=headers)
+    try:
+        with urllib.request.urlopen(req, timeout=120) as response:
+            return response.read().decode()
+    except urllib.error.HTTPError as e:
+        sys.exit('El router ha rechazado la lista: %s' % e.read().decode().strip())
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Genera la lista de bloqueo DNS del router')
+    parser.add_argument('lists', nargs='+', help='Listas de dominios, archivos hosts o reglas de Adblock')
+    parser.add_argument('--output', '-o', help='Archivo de la imagen')
+    parser.add_argument('--router', help='IP del router al que se envía la imagen')
+    parser.add_argument('--token', help='Contraseña de administración del router (X-Admin-Token)')
+    parser.add_argument('--domains', help='Archivo con los dominios normalizados (para blocklist_bench)')
+    args = parser.parse_args()
+    if not args.output and not args.router:
+        parser.error('falta --output o --router')
+    if args.router and not args.token:
+        parser.error('--router necesita --token')
+
+    domains = read_domains(args.lists)
+    kept = drop_covered(domains)
+    image, bits, count = build(kept, int(time.time()))
+    if len(image) > PARTITION_SIZE:
+        sys.exit('La imagen (%d bytes, %d dominios) no cabe en la partición de %d bytes' % (len(image), count, PARTITION_SIZE))
+
+    # Probabilidad de falso positivo de cada sufijo comprobado: huellas / 2^(bits de la huella)
+    fp = count / float(1 << (bits + REMAINDER_BITS))
+    print('%d dominios leídos, %d cubiertos por un dominio padre, %d huellas (%d colisiones)' % (len(domains), len(domains) - len(kept), count, len(kept) - count))
+    print('%d bytes (%.0f%% de la partición), %d cubos, falso positivo por sufijo %.2e' % (len(image), len(image) * 100.0 / PARTITION_SIZE, 1 << bits, fp))
+
+    if args.output:
+        with open(args.output, 'wb') as f:
+            f.write(image)
+    if args.domains:
+        with open(args.domains, 'w') as f:
+            f.writelines(b'.'.join(d).decode() + '\n' for d in sorted(domains))
+    if args.router:
+        print(upload(args.router, args.token, image).strip())
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,215 @@
+// Prueba en el host de la lista de bloqueo DNS: latencia de búsqueda y tasa de falsos positivos.
+// Carga una imagen de tools/blocklist.py y busca con el mismo código que el router (main/blocklist_index.c):
+// primero todos los dominios de la lista (deben estar todos) y después nombres aleatorios que no están en ella,
+// cuyas coincidencias son falsos positivos. La latencia medida es la del host; la del router con la flash
+// proyectada la publica GET /blocklist (lookup_ns).
+//
+// Uso: cc -O2 -I main tools/blocklist_bench.c main/blocklist_index.c -o blocklist_bench
+//      python3 tools/blocklist.py --output blocklist.bin --domains dominios.txt lista.txt
+//      ./blocklist_bench blocklist.bin dominios.txt [nombres aleatorios]
+
+#include "blocklist_index.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Definiciones de la prueba
+#define BENCH_MAX_NAME 255              // Nombre en formato de red
+#define BENCH_DEFAULT_PROBES 1000000
+#define BENCH_MIN_SECONDS 0.5           // Tiempo mínimo de medida de la latencia
+
+// Nombres en formato de red, seguidos en un único bloque
+typedef struct
+{
+    uint8_t *data;
+    size_t used;
+    size_t size;
+    uint32_t *offsets; // Inicio de cada nombre; el siguiente marca su final
+    size_t count;
+    size_t capacity;
+} bench_names_t;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Añade "ads.example.com" (ya normalizado por blocklist.py) en formato de red; false si no es válido
+static bool names_add(bench_names_t *names, const char *text)
+{
+    if (names->used + BENCH_MAX_NAME > names->size)
+    {
+        names->size = (names->size + BENCH_MAX_NAME) * 2;
+        names->data = realloc(names->data, names->size);
+    }
+    if (names->count + 2 > names->capacity)
+    {
+        names->capacity = (names->capacity + 1) * 2;
+        names->offsets = realloc(names->offsets, names->capacity * sizeof(uint32_t));
+    }
+
+    uint8_t *wire = names->data + names->used;
+    int len = 0;
+    while (*text != '\0')
+    {
+        const char *dot = strchr(text, '.');
+        int label = dot ? (int)(dot - text) : (int)strlen(text);
+        if (label == 0 || label > 63 || len + 1 + label + 1 > BENCH_MAX_NAME)
+        {
+            return false;
+        }
+        wire[len++] = label;
+        memcpy(&wire[len], text, label);
+        len += label;
+        text += label + (dot ? 1 : 0);
+    }
+    wire[len++] = 0;
+
+    names->offsets[names->count++] = names->used;
+    names->used += len;
+    names->offsets[names->count] = names->used;
+    return true;
+}
+
+// Nombre aleatorio de tres etiquetas, "<8-15 caracteres>.<6-11 caracteres>.<com|net|org|io>": se comprueban dos sufijos
+static void add_random(bench_names_t *names)
+{
+    static const char *tlds[] = {"com", "net", "org", "io"};
+    char text[64];
+    int len = 0;
+    for (int part = 0; part < 2; part++)
+    {
+        int label = part == 0 ? 8 + next_random() % 8 : 6 + next_random() % 6;
+        for (int i = 0; i < label; i++)
+        {
+            text[len++] = "abcdefghijklmnopqrstuvwxyz0123456789"[next_random() % 36];
+        }
+        text[len++] = '.';
+    }
+    strcpy(&text[len], tlds[next_random() % 4]);
+    names_add(names, text);
+}
+
+static uint8_t *read_file(const char *path, long *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+    fseek(f, 0, SEEK_END);
+    *size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *data = malloc(*size);
+    if (data != NULL && fread(data, 1, *size, f) != (size_t)*size)
+    {
+        free(data);
+        data = NULL;
+    }
+    fclose(f);
+    return data;
+}
+
+// Tiempo medio por búsqueda en ns, repitiendo los nombres hasta medir BENCH_MIN_SECONDS
+static double measure(const uint8_t *image, const bench_names_t *names, size_t *matches)
+{
+    size_t rounds = 0;
+    size_t found = 0;
+    double start = now_s();
+    double elapsed;
+    do
+    {
+        found = 0;
+        for (size_t i = 0; i < names->count; i++)
+        {
+            uint32_t offset = names->offsets[i];
+            found += blocklist_index_match(image, names->data + offset, names->offsets[i + 1] - offset);
+        }
+        rounds++;
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    *matches = found;
+    return elapsed * 1e9 / ((double)rounds * names->count);
+}
+
+// MARK: MAIN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        fprintf(stderr, "Uso: %s imagen dominios [nombres aleatorios]\n", argv[0]);
+        return 2;
+    }
+    size_t probes = argc > 3 ? strtoul(argv[3], NULL, 10) : BENCH_DEFAULT_PROBES;
+
+    long image_size = 0;
+    uint8_t *image = read_file(argv[1], &image_size);
+    if (image == NULL || !blocklist_index_check(image, image_size))
+    {
+        fprintf(stderr, "Imagen no válida: %s\n", argv[1]);
+        return 1;
+    }
+    const blocklist_header_t *header = (const blocklist_header_t *)image;
+
+    // Dominios de la lista, uno por línea
+    FILE *f = fopen(argv[2], "r");
+    if (f == NULL)
+    {
+        fprintf(stderr, "No se puede abrir %s\n", argv[2]);
+        return 1;
+    }
+    bench_names_t listed = {0};
+    char line[512];
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        line[strcspn(line, "\r\n")] = '\0';
+        if (line[0] != '\0' && !names_add(&listed, line))
+        {
+            fprintf(stderr, "Dominio no válido: %s\n", line);
+        }
+    }
+    fclose(f);
+
+    bench_names_t random = {0};
+    for (size_t i = 0; i < probes; i++)
+    {
+        add_random(&random);
+    }
+
+    size_t hits = 0;
+    size_t false_positives = 0;
+    double hit_ns = listed.count ? measure(image, &listed, &hits) : 0;
+    double miss_ns = random.count ? measure(image, &random, &false_positives) : 0;
+
+    // Cada nombre aleatorio comprueba dos sufijos
+    double expected = 2.0 * header->count / (double)(1ull << (header->index_bits + BLOCKLIST_REMAINDER_BITS));
+    printf("imagen            %ld bytes, %u huellas, %u cubos\n", image_size, header->count, 1u << header->index_bits);
+    printf("en la lista       %zu de %zu\n", hits, listed.count);
+    printf("búsqueda acierto  %.1f ns\n", hit_ns);
+    printf("búsqueda fallo    %.1f ns\n", miss_ns);
+    printf("falsos positivos  %zu de %zu (%.2e, esperado %.2e)\n", false_positives, random.count, random.count ? (double)false_positives / random.count : 0.0,
+           expected);
+
+    free(listed.data);
+    free(listed.offsets);
+    free(random.data);
+    free(random.offsets);
+    free(image);
+    return hits == listed.count ? 0 : 1;
+}
@@ -0,0 +1,262 @@
+// Prueba de carga en el host de la tabla de clientes del punto de acceso (main/clients_table.c).
+// Para cada capacidad conecta estaciones simuladas de una en una hasta llenar la tabla y, con 1, la mitad y todas
+// conectadas, mide el coste por paquete de la cuenta de bytes de la ruta de reenvío (clients_count_up/down: buscar
+// la MAC y sumar) para un cliente de la tabla y para una MAC que no está, frente a recorrer las ranuras como hacía
+// el control de tráfico. Después comprueba que una estación más se rechaza sin tocar las demás y renueva clientes
+// (desconectar uno y conectar otro) comparando cada búsqueda con una lista de referencia. La memoria es la de la
+// tabla; el resto del coste por cliente está documentado en clients.h. El router admite hasta 15 clientes (límite
+// del driver); las capacidades mayores muestran hasta dónde escala el índice.
+//
+// Uso: cc -O2 -I main tools/clients_load.c main/clients_table.c -o clients_load
+//      ./clients_load [capacidades...]
+
+#include "clients_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Definiciones de la prueba
+#define LOAD_MIN_SECONDS 0.2     // Tiempo mínimo de cada medida
+#define LOAD_PACKETS 4096        // Paquetes por vuelta de medida
+#define LOAD_CHURN 200000        // Renovaciones comprobadas por capacidad
+#define LOAD_MIN_INDEX 32        // Índice mínimo, como CLIENTS_INDEX_SIZE
+#define LOAD_PACKET_BYTES 1500
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+static volatile uint64_t sink; // Evita que el compilador elimine las búsquedas
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// La mitad de las estaciones comparten fabricante (mismos tres primeros bytes); el resto usa MAC aleatoria
+// administrada localmente, como los móviles actuales
+static void random_mac(uint8_t *mac)
+{
+    uint64_t r = next_random();
+    for (int i = 0; i < 6; i++)
+    {
+        mac[i] = (uint8_t)(r >> (8 * i));
+    }
+    if (r & (1ull << 63))
+    {
+        mac[0] = 0x24;
+        mac[1] = 0x0a;
+        mac[2] = 0xc4;
+    }
+    else
+    {
+        mac[0] = (mac[0] | 0x02) & 0xfe;
+    }
+}
+
+// Estación distinta de las count primeras de macs
+static void unique_mac(uint8_t (*macs)[6], uint32_t count, uint8_t *mac)
+{
+    for (;;)
+    {
+        random_mac(mac);
+        uint32_t i = 0;
+        while (i < count && memcmp(macs[i], mac, 6) != 0)
+        {
+            i++;
+        }
+        if (i == count)
+        {
+            return;
+        }
+    }
+}
+
+static uint32_t index_size_for(uint32_t capacity)
+{
+    uint32_t size = LOAD_MIN_INDEX;
+    while (size < 2 * capacity)
+    {
+        size <<= 1;
+    }
+    return size;
+}
+
+// Cuenta de un paquete recorriendo las ranuras (búsqueda lineal, la de referencia)
+static client_info_t *linear_find(clients_table_t *table, const uint8_t *mac)
+{
+    for (uint32_t slot = 0; slot < table->capacity; slot++)
+    {
+        if (table->entries[slot].aid != 0 && memcmp(table->entries[slot].mac, mac, 6) == 0)
+        {
+            return &table->entries[slot];
+        }
+    }
+    return NULL;
+}
+
+// MARK: MEDIDAS ------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// ns por paquete contado entre los count primeros clientes de macs (o MAC ausentes con miss)
+static double measure(clients_table_t *table, uint8_t (*macs)[6], uint32_t count, bool miss, bool linear)
+{
+    uint8_t absent[6];
+    random_mac(absent);
+    absent[5] ^= 0x5a;
+
+    size_t packets = 0;
+    double start = now_s();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < LOAD_PACKETS; i++)
+        {
+            const uint8_t *mac = macs[next_random() % count];
+            if (miss)
+            {
+                absent[4] = (uint8_t)i;
+                mac = absent;
+            }
+            client_info_t *entry = linear ? linear_find(table, mac) : clients_table_find(table, mac);
+            if (entry != NULL)
+            {
+                entry->up_packets++;
+                entry->up_bytes += LOAD_PACKET_BYTES;
+            }
+            sink += (uintptr_t)entry;
+        }
+        packets += LOAD_PACKETS;
+        elapsed = now_s() - start;
+    } while (elapsed < LOAD_MIN_SECONDS);
+    return elapsed * 1e9 / packets;
+}
+
+// Todos los clientes de macs están en su ranura y en ninguna otra
+static bool check(clients_table_t *table, uint8_t (*macs)[6], uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        client_info_t *entry = clients_table_find(table, macs[i]);
+        if (entry == NULL || entry != linear_find(table, macs[i]) || clients_table_slot(table, macs[i]) != entry - table->entries)
+        {
+            return false;
+        }
+    }
+    return table->count == count;
+}
+
+static bool run(uint32_t capacity)
+{
+    uint32_t index_size = index_size_for(capacity);
+    client_info_t *entries = malloc(capacity * sizeof(client_info_t));
+    uint8_t *index = malloc(index_size);
+    uint8_t (*macs)[6] = malloc((capacity + 1) * 6);
+    clients_table_t table;
+    clients_table_init(&table, entries, capacity, index, index_size);
+    bool ok = true;
+
+    printf("%3u clientes: tabla %u bytes (%u por cliente + índice de %u)\n", capacity, (unsigned)(capacity * sizeof(client_info_t) + index_size),
+           (unsigned)sizeof(client_info_t), index_size);
+
+    // Estaciones que se conectan de una en una; se mide con 1, la mitad y todas
+    uint32_t steps[3] = {1, (capacity + 1) / 2, capacity};
+    uint32_t connected = 0;
+    for (int s = 0; s < 3; s++)
+    {
+        if (s > 0 && steps[s] == steps[s - 1])
+        {
+            continue;
+        }
+        while (connected < steps[s])
+        {
+            unique_mac(macs, connected, macs[connected]);
+            ok = ok && clients_table_add(&table, macs[connected], (uint8_t)(connected + 1), 0) != NULL;
+            connected++;
+        }
+        ok = ok && check(&table, macs, connected);
+
+        double hit = measure(&table, macs, connected, false, false);
+        double miss = measure(&table, macs, connected, true, false);
+        double linear_hit = measure(&table, macs, connected, false, true);
+        double linear_miss = measure(&table, macs, connected, true, true);
+        printf("   %3u conectados  cliente %5.1f ns (lineal %6.1f)   MAC ausente %5.1f ns (lineal %6.1f)   %.1f Mpaquetes/s\n", connected, hit, linear_hit, miss,
+               linear_miss, 1e3 / hit);
+    }
+
+    // Una estación más no cabe y no altera a las demás
+    unique_mac(macs, capacity, macs[capacity]);
+    bool rejected = clients_table_add(&table, macs[capacity], 1, 0) == NULL && clients_table_find(&table, macs[capacity]) == NULL;
+    ok = ok && rejected && check(&table, macs, capacity);
+    printf("   tabla llena: estación %u %s\n", capacity + 1, rejected ? "rechazada, las demás intactas" : "NO RECHAZADA");
+
+    // Renovación: sale un cliente al azar y entra otro nuevo, que debe ocupar su ranura
+    uint32_t mismatches = 0;
+    for (int i = 0; i < LOAD_CHURN; i++)
+    {
+        uint32_t leaving = next_random() % capacity;
+        int slot = clients_table_slot(&table, macs[leaving]);
+        if (!clients_table_remove(&table, macs[leaving]) || clients_table_find(&table, macs[leaving]) != NULL)
+        {
+            mismatches++;
+        }
+        uint8_t mac[6];
+        unique_mac(macs, capacity, mac);
+        memcpy(macs[leaving], mac, sizeof(mac));
+        client_info_t *entry = clients_table_add(&table, macs[leaving], 1, 0);
+        if (entry == NULL || entry - table.entries != slot)
+        {
+            mismatches++;
+        }
+        if ((i & 1023) == 0 && !check(&table, macs, capacity))
+        {
+            mismatches++;
+        }
+    }
+    ok = ok && mismatches == 0 && check(&table, macs, capacity);
+    printf("   renovación: %d desconexiones y conexiones, %u errores\n", LOAD_CHURN, mismatches);
+
+    free(entries);
+    free(index);
+    free(macs);
+    return ok;
+}
+
+// MARK: MAIN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    static const uint32_t defaults[] = {3, 10, 15, 32, 64, 128};
+    bool ok = true;
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            uint32_t capacity = strtoul(argv[i], NULL, 10);
+            if (capacity == 0 || capacity > CLIENTS_TABLE_MAX_CAPACITY)
+            {
+                fprintf(stderr, "Capacidad no válida (1 a %d): %s\n", CLIENTS_TABLE_MAX_CAPACITY, argv[i]);
+                return 2;
+            }
+            ok = run(capacity) && ok;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
+        {
+            ok = run(defaults[i]) && ok;
+        }
+    }
+    printf("%s\n", ok ? "OK" : "FALLO");
+    return ok ? 0 : 1;
+}
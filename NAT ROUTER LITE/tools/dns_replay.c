@@ -0,0 +1,497 @@
+// Reproducción en el host de trazas de consultas DNS contra el núcleo del reenviador (main/dns_core.c).
+// Un servidor de subida simulado responde cada consulta tras una latencia fija y pierde un porcentaje de
+// ellas; el tiempo es simulado, así que los reenvíos y los abandonos ocurren como en el router. Cada respuesta
+// que llega a un cliente se comprueba: debe corresponder a una consulta suya sin responder, con su identificador
+// y con su pregunta byte a byte (mayúsculas incluidas). Al final cada consulta debe tener respuesta, salvo las
+// descartadas por agrupación llena, y la memoria reservada debe ser la de la caché.
+//
+// Traza: una consulta por línea, "<ms> <cliente> <nombre> [tipo]" (tipo A, AAAA, HTTPS o número; A por defecto).
+// Sin traza se genera una sintética: nombres con popularidad de Zipf y la cuarta parte de los clientes con
+// mayúsculas aleatorias (0x20).
+//
+// Uso: cc -O2 -I main tools/dns_replay.c main/dns_core.c -o dns_replay
+//      ./dns_replay [traza|-] [latencia ms] [pérdida %]
+
+#include "dns_core.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Definiciones de la prueba
+#define REPLAY_SYNTHETIC_QUERIES 200000
+#define REPLAY_SYNTHETIC_NAMES 2000
+#define REPLAY_SYNTHETIC_CLIENTS 16
+#define REPLAY_SYNTHETIC_RATE 200      // Consultas por segundo
+#define REPLAY_DEFAULT_LATENCY_MS 40
+#define REPLAY_DEFAULT_LOSS 2          // Porcentaje de consultas al servidor de subida perdidas
+#define REPLAY_TICK_MS 500             // Igual que el timeout de select en dns_forwarder.c
+#define REPLAY_MAX_SCHEDULED 4096
+#define REPLAY_OUTSTANDING_SIZE 65536  // Potencia de 2
+
+// Estructuras
+typedef struct
+{
+    uint32_t time_ms;
+    uint16_t client;
+    uint16_t type;
+    char name[256];
+} replay_query_t;
+
+// Respuesta del servidor de subida simulado pendiente de entregar
+typedef struct
+{
+    uint32_t time_ms;
+    int len;
+    uint8_t msg[DNS_MAX_PACKET];
+} replay_scheduled_t;
+
+// Consulta de un cliente sin respuesta todavía
+typedef struct
+{
+    uint32_t key; // Cliente y identificador, 0 si está libre
+    uint16_t question_len;
+    uint8_t question[DNS_MAX_KEY];
+} replay_outstanding_t;
+
+// Variables globales
+static replay_scheduled_t *scheduled;
+static int scheduled_count = 0;
+static replay_outstanding_t *outstanding;
+static uint32_t outstanding_count = 0;
+static uint32_t now = 0;
+static uint32_t latency_ms = REPLAY_DEFAULT_LATENCY_MS;
+static uint32_t loss_percent = REPLAY_DEFAULT_LOSS;
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+// Resultados
+static uint32_t answered = 0;
+static uint32_t servfails = 0;
+static uint32_t truncated = 0;
+static uint32_t mismatches = 0;
+static uint32_t unexpected = 0;
+static uint32_t upstream_sent = 0;
+static uint32_t upstream_lost = 0;
+static uint64_t allocs = 0;
+static int64_t live_blocks = 0;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t name_hash(const uint8_t *data, int len)
+{
+    uint32_t hash = 2166136261u;
+    for (int i = 0; i < len; i++)
+    {
+        hash = (hash ^ tolower(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+static replay_outstanding_t *outstanding_slot(uint32_t key, bool insert)
+{
+    uint32_t index = (key * 0x9e3779b1u) & (REPLAY_OUTSTANDING_SIZE - 1);
+    while (outstanding[index].key != 0 && outstanding[index].key != key)
+    {
+        index = (index + 1) & (REPLAY_OUTSTANDING_SIZE - 1);
+    }
+    if (outstanding[index].key == 0 && !insert)
+    {
+        return NULL;
+    }
+    return &outstanding[index];
+}
+
+// Borrado por desplazamiento hacia atrás, como en napt_table.c
+static void outstanding_remove(replay_outstanding_t *slot)
+{
+    uint32_t hole = slot - outstanding;
+    uint32_t next = hole;
+    while (true)
+    {
+        next = (next + 1) & (REPLAY_OUTSTANDING_SIZE - 1);
+        if (outstanding[next].key == 0)
+        {
+            break;
+        }
+        uint32_t home = (outstanding[next].key * 0x9e3779b1u) & (REPLAY_OUTSTANDING_SIZE - 1);
+        if (((next - home) & (REPLAY_OUTSTANDING_SIZE - 1)) >= ((next - hole) & (REPLAY_OUTSTANDING_SIZE - 1)))
+        {
+            outstanding[hole] = outstanding[next];
+            hole = next;
+        }
+    }
+    outstanding[hole].key = 0;
+    outstanding_count--;
+}
+
+// MARK: E/S DEL NÚCLEO -------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void send_client(void *ctx, const uint8_t *msg, int len, const dns_peer_t *to)
+{
+    (void)ctx;
+    uint32_t key = ((uint32_t)(to->port + 1) << 16) | ((msg[0] << 8) | msg[1]);
+    replay_outstanding_t *slot = outstanding_slot(key, false);
+    if (slot == NULL || len < 12 + slot->question_len)
+    {
+        unexpected++;
+        return;
+    }
+    if (memcmp(&msg[12], slot->question, slot->question_len) != 0)
+    {
+        mismatches++;
+    }
+    if ((msg[3] & 0x0F) == 2)
+    {
+        servfails++;
+    }
+    if (msg[2] & 0x02)
+    {
+        truncated++;
+    }
+    answered++;
+    outstanding_remove(slot);
+}
+
+// El servidor simulado responde con la pregunta en minúsculas (el peor caso para los clientes 0x20) y un registro A
+static void send_upstream(void *ctx, const uint8_t *msg, int len)
+{
+    (void)ctx;
+    upstream_sent++;
+    if (next_random() % 100 < loss_percent || scheduled_count == REPLAY_MAX_SCHEDULED)
+    {
+        upstream_lost++;
+        return;
+    }
+
+    replay_scheduled_t *s = &scheduled[scheduled_count++];
+    int question_end = 12;
+    while (question_end < len && msg[question_end] != 0)
+    {
+        question_end += 1 + msg[question_end];
+    }
+    question_end += 5;
+    uint32_t hash = name_hash(&msg[12], question_end - 16);
+
+    memcpy(s->msg, msg, question_end);
+    for (int i = 12; i < question_end - 4; i++)
+    {
+        s->msg[i] = tolower(s->msg[i]);
+    }
+    s->msg[2] = 0x81; // QR y RD
+    s->msg[3] = hash % 20 == 0 ? 0x83 : 0x80; // RA; un 5 % de los nombres no existe
+    memset(&s->msg[6], 0, 6);
+    s->len = question_end;
+    if (hash % 20 != 0)
+    {
+        uint32_t ttl = 30 + hash % 300;
+        uint8_t answer[] = {0xC0, 0x0C, 0, 1, 0, 1, ttl >> 24, ttl >> 16, ttl >> 8, ttl, 0, 4, 10, hash >> 16, hash >> 8, hash};
+        memcpy(&s->msg[s->len], answer, sizeof(answer));
+        s->len += sizeof(answer);
+        s->msg[7] = 1;
+    }
+    s->time_ms = now + latency_ms;
+}
+
+static bool blocked(const uint8_t *name, int len)
+{
+    (void)name;
+    (void)len;
+    return false;
+}
+
+static uint16_t random_id(void)
+{
+    return next_random() & 0xFFFF;
+}
+
+static void *counted_alloc(size_t size)
+{
+    allocs++;
+    live_blocks++;
+    return malloc(size);
+}
+
+static void counted_free(void *ptr)
+{
+    if (ptr != NULL)
+    {
+        live_blocks--;
+    }
+    free(ptr);
+}
+
+// MARK: TRAZA --------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static uint16_t parse_type(const char *text)
+{
+    if (text == NULL || strcasecmp(text, "A") == 0)
+    {
+        return 1;
+    }
+    if (strcasecmp(text, "AAAA") == 0)
+    {
+        return 28;
+    }
+    if (strcasecmp(text, "HTTPS") == 0)
+    {
+        return 65;
+    }
+    return (uint16_t)strtoul(text, NULL, 10);
+}
+
+static replay_query_t *read_trace(const char *path, size_t *count)
+{
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        return NULL;
+    }
+
+    size_t capacity = 1024;
+    replay_query_t *queries = malloc(capacity * sizeof(*queries));
+    char line[512];
+    *count = 0;
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char name[256], type[16];
+        unsigned long time_ms, client;
+        int fields = sscanf(line, "%lu %lu %255s %15s", &time_ms, &client, name, type);
+        if (line[0] == '#' || fields < 3)
+        {
+            continue;
+        }
+        if (*count == capacity)
+        {
+            capacity *= 2;
+            queries = realloc(queries, capacity * sizeof(*queries));
+        }
+        replay_query_t *q = &queries[(*count)++];
+        q->time_ms = time_ms;
+        q->client = client;
+        q->type = parse_type(fields > 3 ? type : NULL);
+        snprintf(q->name, sizeof(q->name), "%s", name);
+    }
+    fclose(f);
+    return queries;
+}
+
+static replay_query_t *synthetic_trace(size_t *count)
+{
+    // Popularidad de Zipf (s = 1) con la distribución acumulada
+    static double cdf[REPLAY_SYNTHETIC_NAMES];
+    double total = 0;
+    for (int i = 0; i < REPLAY_SYNTHETIC_NAMES; i++)
+    {
+        total += 1.0 / (i + 1);
+        cdf[i] = total;
+    }
+
+    replay_query_t *queries = malloc(REPLAY_SYNTHETIC_QUERIES * sizeof(*queries));
+    double time_ms = 0;
+    for (size_t n = 0; n < REPLAY_SYNTHETIC_QUERIES; n++)
+    {
+        replay_query_t *q = &queries[n];
+        double u = (next_random() >> 11) * (1.0 / 9007199254740992.0) * total;
+        int lo = 0, hi = REPLAY_SYNTHETIC_NAMES - 1;
+        while (lo < hi)
+        {
+            int mid = (lo + hi) / 2;
+            if (cdf[mid] < u)
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid;
+            }
+        }
+
+        time_ms += 1000.0 / REPLAY_SYNTHETIC_RATE * 2 * ((next_random() >> 11) * (1.0 / 9007199254740992.0));
+        q->time_ms = (uint32_t)time_ms;
+        q->client = next_random() % REPLAY_SYNTHETIC_CLIENTS;
+        q->type = lo % 3 == 0 ? 28 : 1;
+        snprintf(q->name, sizeof(q->name), "host%d.example%d.com", lo, lo % 37);
+        if (q->client % 4 == 0)
+        {
+            for (char *c = q->name; *c; c++)
+            {
+                *c = (next_random() & 1) ? toupper(*c) : *c;
+            }
+        }
+    }
+    *count = REPLAY_SYNTHETIC_QUERIES;
+    return queries;
+}
+
+// Consulta en formato de red; devuelve su longitud, 0 si el nombre no es válido
+static int build_query(const replay_query_t *q, uint16_t id, uint8_t *msg)
+{
+    static const uint8_t header[12] = {0, 0, 0x01, 0x00, 0, 1, 0, 0, 0, 0, 0, 0}; // RD
+    memcpy(msg, header, sizeof(header));
+    msg[0] = id >> 8;
+    msg[1] = id & 0xFF;
+
+    int len = 12;
+    const char *text = q->name;
+    while (*text != '\0')
+    {
+        const char *dot = strchr(text, '.');
+        int label = dot ? (int)(dot - text) : (int)strlen(text);
+        if (label == 0 || label > 63 || len + 1 + label + 5 > 12 + DNS_MAX_KEY)
+        {
+            return 0;
+        }
+        msg[len++] = label;
+        memcpy(&msg[len], text, label);
+        len += label;
+        text += label + (dot ? 1 : 0);
+    }
+    msg[len++] = 0;
+    msg[len++] = q->type >> 8;
+    msg[len++] = q->type & 0xFF;
+    msg[len++] = 0;
+    msg[len++] = 1; // IN
+    return len;
+}
+
+// Entrega las respuestas simuladas que ya han llegado, en orden de llegada
+static void deliver(dns_core_t *core, uint32_t until)
+{
+    int kept = 0;
+    for (int i = 0; i < scheduled_count; i++)
+    {
+        if ((int32_t)(scheduled[i].time_ms - until) <= 0)
+        {
+            now = scheduled[i].time_ms > now ? scheduled[i].time_ms : now;
+            dns_core_response(core, scheduled[i].msg, scheduled[i].len, now);
+        }
+        else
+        {
+            if (kept != i)
+            {
+                scheduled[kept] = scheduled[i];
+            }
+            kept++;
+        }
+    }
+    scheduled_count = kept;
+}
+
+// Avanza el tiempo simulado hasta target con los ticks del reenviador
+static void advance(dns_core_t *core, uint32_t target, uint32_t *next_tick)
+{
+    while ((int32_t)(*next_tick - target) <= 0)
+    {
+        deliver(core, *next_tick);
+        now = *next_tick;
+        dns_core_tick(core, now);
+        *next_tick += REPLAY_TICK_MS;
+    }
+    deliver(core, target);
+    now = target;
+}
+
+// MARK: MAIN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    size_t count = 0;
+    replay_query_t *queries = argc > 1 && strcmp(argv[1], "-") != 0 ? read_trace(argv[1], &count) : synthetic_trace(&count);
+    if (queries == NULL)
+    {
+        fprintf(stderr, "No se puede abrir %s\n", argv[1]);
+        return 1;
+    }
+    latency_ms = argc > 2 ? strtoul(argv[2], NULL, 10) : REPLAY_DEFAULT_LATENCY_MS;
+    loss_percent = argc > 3 ? strtoul(argv[3], NULL, 10) : REPLAY_DEFAULT_LOSS;
+
+    scheduled = malloc(REPLAY_MAX_SCHEDULED * sizeof(*scheduled));
+    outstanding = calloc(REPLAY_OUTSTANDING_SIZE, sizeof(*outstanding));
+    static dns_core_t core;
+    dns_core_io_t io = {
+        .send_client = send_client,
+        .send_upstream = send_upstream,
+        .blocked = blocked,
+        .random_id = random_id,
+        .alloc = counted_alloc,
+        .free = counted_free,
+    };
+    dns_core_init(&core, &io);
+    core.upstream = true;
+
+    static uint16_t ids[65536];
+    uint32_t next_tick = REPLAY_TICK_MS;
+    uint32_t invalid = 0;
+    uint8_t msg[DNS_MAX_PACKET];
+    double busy = 0;
+    double start = now_s();
+
+    for (size_t i = 0; i < count; i++)
+    {
+        const replay_query_t *q = &queries[i];
+        advance(&core, q->time_ms, &next_tick);
+
+        uint16_t id = ++ids[q->client];
+        int len = build_query(q, id, msg);
+        if (len == 0 || outstanding_count >= REPLAY_OUTSTANDING_SIZE / 2)
+        {
+            invalid++;
+            continue;
+        }
+        dns_peer_t peer = {.ip = 0x0A000000u + q->client, .port = q->client};
+        replay_outstanding_t *slot = outstanding_slot(((uint32_t)(peer.port + 1) << 16) | id, true);
+        if (slot->key != 0) // Identificador repetido de una consulta sin responder: se reemplaza
+        {
+            outstanding_count--;
+        }
+        slot->key = ((uint32_t)(peer.port + 1) << 16) | id;
+        slot->question_len = len - 12;
+        memcpy(slot->question, &msg[12], len - 12);
+        outstanding_count++;
+
+        double t0 = now_s();
+        dns_core_query(&core, msg, len, &peer, now);
+        busy += now_s() - t0;
+    }
+
+    // Se deja terminar las consultas pendientes (reenvíos y abandonos incluidos)
+    advance(&core, now + DNS_UPSTREAM_TIMEOUT_MS + 2 * REPLAY_TICK_MS, &next_tick);
+    double elapsed = now_s() - start;
+
+    const dns_core_stats_t *s = &core.stats;
+    uint32_t unanswered = outstanding_count;
+    printf("consultas         %zu (%u no válidas), %.1f s simulados\n", count, invalid, now / 1000.0);
+    printf("caché             %u aciertos, %u fallos, %u agrupadas (%.1f %% de aciertos)\n", s->hits, s->misses, s->coalesced,
+           s->queries ? 100.0 * s->hits / s->queries : 0.0);
+    printf("servidor          %u envíos, %u perdidos, %u abandonos\n", upstream_sent, upstream_lost, s->upstream_timeouts);
+    printf("respuestas        %u (%u SERVFAIL, %u truncadas)\n", answered, servfails, truncated);
+    printf("sin respuesta     %u (%u descartadas por agrupación llena)\n", unanswered, s->dropped);
+    printf("pregunta distinta %u\n", mismatches);
+    printf("inesperadas       %u\n", unexpected);
+    printf("memoria           %llu reservas, %lld bloques vivos, %u entradas en caché (%u bytes)\n", (unsigned long long)allocs, (long long)live_blocks,
+           s->entries, s->bytes);
+    printf("coste             %.0f ns por consulta en el núcleo, %.2f s en total\n", count ? busy * 1e9 / count : 0.0, elapsed);
+
+    bool ok = mismatches == 0 && unexpected == 0 && unanswered == s->dropped && live_blocks == (int64_t)s->entries;
+    printf("%s\n", ok ? "OK" : "FALLO");
+    free(queries);
+    free(scheduled);
+    free(outstanding);
+    return ok ? 0 : 1;
+}
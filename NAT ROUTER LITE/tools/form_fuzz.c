@@ -0,0 +1,459 @@
+// Prueba en el host del analizador de formularios (main/form.c).
+// Fuzz: genera cuerpos aleatorios (campos conocidos y desconocidos, secuencias %XX válidas, partidas o no válidas,
+// separadores codificados, nombres largos, valores que no caben) y los pasa al analizador entero, byte a byte, en
+// trozos de 64 bytes como form_recv y partidos en puntos aleatorios. Cada resultado se compara con una
+// decodificación de referencia del cuerpo completo, y unos bytes de guarda tras cada buffer detectan escrituras
+// fuera de él.
+// Tiempos: compara el analizador con el camino anterior (copiar el cuerpo a un buffer, url_decode y
+// httpd_query_key_value por campo) sobre los formularios de credenciales y del limitador.
+//
+// Uso: cc -O2 -I main tools/form_fuzz.c main/form.c -o form_fuzz
+//      (o con -g -fsanitize=address,undefined para el fuzz)
+//      ./form_fuzz [cuerpos]
+
+#include "form.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Definiciones de la prueba
+#define FUZZ_DEFAULT_BODIES 200000
+#define FUZZ_MAX_BODY 512
+#define FUZZ_GUARD 16        // Bytes de guarda tras cada buffer de valor
+#define FUZZ_GUARD_BYTE 0xA5
+#define FUZZ_RECV_CHUNK 64   // Trozo de form_recv
+#define BENCH_MIN_SECONDS 0.3
+#define BENCH_BUFFER 256     // Buffer del camino anterior
+
+// Campos del fuzz: los de las rutas reales más casos límite (buffer de un byte, nombre de FORM_KEY_MAX caracteres)
+static const struct
+{
+    const char *name;
+    size_t size;
+} fuzz_fields[] = {
+    {"ssid", 33}, {"password", 65}, {"up", 11}, {"down", 11}, {"uplink", 11}, {"k", 1}, {"abcdefghijklmnop", 8},
+};
+#define FUZZ_FIELD_COUNT (int)(sizeof(fuzz_fields) / sizeof(fuzz_fields[0]))
+
+// Resultado esperado de un campo
+typedef struct
+{
+    char value[FUZZ_MAX_BODY];
+    size_t len;
+    bool found;
+    bool truncated;
+} fuzz_expected_t;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+static volatile size_t sink; // Evita que el compilador elimine el trabajo medido
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int hex_digit(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    c = (char)tolower((unsigned char)c);
+    return c >= 'a' && c <= 'f' ? c - 'a' + 10 : -1;
+}
+
+// MARK: REFERENCIA ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Decodifica un nombre o un valor completo: %XX válido, + como espacio y cualquier otra cosa tal cual
+static size_t reference_decode(const char *src, size_t len, char *dst)
+{
+    size_t out = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        if (src[i] == '%' && i + 2 < len && hex_digit(src[i + 1]) >= 0 && hex_digit(src[i + 2]) >= 0)
+        {
+            dst[out++] = (char)(hex_digit(src[i + 1]) << 4 | hex_digit(src[i + 2]));
+            i += 2;
+        }
+        else
+        {
+            dst[out++] = src[i] == '+' ? ' ' : src[i];
+        }
+    }
+    return out;
+}
+
+// Separa el cuerpo completo por '&' y el primer '=' de cada par, y aplica las reglas del analizador:
+// solo cuenta la primera aparición de cada campo, un nombre de más de FORM_KEY_MAX no coincide con ninguno
+// y un campo sin '=' tiene valor vacío
+static void reference_parse(const char *body, size_t len, fuzz_expected_t *expected)
+{
+    memset(expected, 0, FUZZ_FIELD_COUNT * sizeof(fuzz_expected_t));
+    size_t start = 0;
+    while (start <= len)
+    {
+        const char *end = memchr(body + start, '&', len - start);
+        size_t pair_len = end != NULL ? (size_t)(end - body) - start : len - start;
+        const char *pair = body + start;
+        start += pair_len + 1;
+        if (pair_len == 0)
+        {
+            continue;
+        }
+
+        const char *eq = memchr(pair, '=', pair_len);
+        size_t key_raw = eq != NULL ? (size_t)(eq - pair) : pair_len;
+        char key[FUZZ_MAX_BODY];
+        size_t key_len = reference_decode(pair, key_raw, key);
+        if (key_len > FORM_KEY_MAX)
+        {
+            continue;
+        }
+
+        for (int i = 0; i < FUZZ_FIELD_COUNT; i++)
+        {
+            if (!expected[i].found && strlen(fuzz_fields[i].name) == key_len && memcmp(fuzz_fields[i].name, key, key_len) == 0)
+            {
+                char value[FUZZ_MAX_BODY];
+                size_t value_len = eq != NULL ? reference_decode(eq + 1, pair_len - key_raw - 1, value) : 0;
+                size_t room = fuzz_fields[i].size - 1;
+                expected[i].found = true;
+                expected[i].truncated = value_len > room;
+                expected[i].len = value_len > room ? room : value_len;
+                memcpy(expected[i].value, value, expected[i].len);
+                break;
+            }
+        }
+    }
+}
+
+// MARK: FUZZ ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void append(char *body, size_t *len, const char *text)
+{
+    size_t n = strlen(text);
+    if (*len + n < FUZZ_MAX_BODY)
+    {
+        memcpy(body + *len, text, n);
+        *len += n;
+    }
+}
+
+// Trozo de valor: mezcla de texto, secuencias %XX de todo tipo y separadores codificados
+static void append_token(char *body, size_t *len)
+{
+    static const char *tokens[] = {"a", "Mi", "+", "%20", "%3D", "%26", "%2B", "%25", "%C3%B1", "%4", "%", "%%", "%G1", "%4g", "%00",
+                                   "=", "x=y", "0123456789", "%ff", "%FF", "\xc3\xb1", "\x01", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa"};
+    uint64_t r = next_random();
+    if (r % 8 == 0 && *len + 1 < FUZZ_MAX_BODY)
+    {
+        body[(*len)++] = (char)(r >> 8); // Byte cualquiera
+        return;
+    }
+    append(body, len, tokens[(r >> 8) % (sizeof(tokens) / sizeof(tokens[0]))]);
+}
+
+static size_t random_body(char *body)
+{
+    static const char *keys[] = {"ssid", "password", "up", "down", "uplink", "k", "abcdefghijklmnop", "abcdefghijklmnopq", "%73sid",
+                                 "pass%77ord", "SSID", "u%70", "mac", "", "upp", "%", "do+wn", "ssid%00"};
+    size_t len = 0;
+
+    // Algunos cuerpos son bytes sin estructura
+    if (next_random() % 16 == 0)
+    {
+        size_t n = next_random() % FUZZ_MAX_BODY;
+        for (size_t i = 0; i < n; i++)
+        {
+            body[len++] = "ab=&%+3Df0"[next_random() % 10];
+        }
+        return len;
+    }
+
+    int pairs = next_random() % 8;
+    for (int p = 0; p < pairs; p++)
+    {
+        if (p > 0 || next_random() % 8 == 0)
+        {
+            append(body, &len, next_random() % 8 == 0 ? "&&" : "&");
+        }
+        append(body, &len, keys[next_random() % (sizeof(keys) / sizeof(keys[0]))]);
+        if (next_random() % 8 != 0)
+        {
+            append(body, &len, "=");
+        }
+        int tokens = next_random() % 6;
+        for (int t = 0; t < tokens; t++)
+        {
+            append_token(body, &len);
+        }
+    }
+    return len;
+}
+
+// Analiza el cuerpo en trozos según mode (0: entero, 1: byte a byte, 2: como form_recv, 3: cortes aleatorios) y
+// lo compara con la referencia; devuelve false y describe la diferencia si no coincide
+static bool fuzz_one(const char *body, size_t len, int mode, const fuzz_expected_t *expected)
+{
+    static char buffers[FUZZ_FIELD_COUNT][FUZZ_MAX_BODY + FUZZ_GUARD];
+    form_field_t fields[FUZZ_FIELD_COUNT];
+    for (int i = 0; i < FUZZ_FIELD_COUNT; i++)
+    {
+        memset(buffers[i], FUZZ_GUARD_BYTE, fuzz_fields[i].size + FUZZ_GUARD);
+        fields[i] = (form_field_t){.name = fuzz_fields[i].name, .value = buffers[i], .size = fuzz_fields[i].size};
+    }
+
+    form_parser_t parser;
+    form_parser_init(&parser, fields, FUZZ_FIELD_COUNT);
+    size_t pos = 0;
+    while (pos < len)
+    {
+        size_t chunk = len - pos;
+        if (mode == 1)
+        {
+            chunk = 1;
+        }
+        else if (mode == 2 && chunk > FUZZ_RECV_CHUNK)
+        {
+            chunk = FUZZ_RECV_CHUNK;
+        }
+        else if (mode == 3)
+        {
+            chunk = 1 + next_random() % chunk;
+        }
+        form_parser_feed(&parser, body + pos, chunk);
+        pos += chunk;
+    }
+    form_parser_finish(&parser);
+
+    for (int i = 0; i < FUZZ_FIELD_COUNT; i++)
+    {
+        const form_field_t *field = &fields[i];
+        const char *problem = NULL;
+        if (field->found != expected[i].found || field->truncated != expected[i].truncated || field->len != expected[i].len)
+        {
+            problem = "estado o longitud distintos";
+        }
+        else if (memcmp(field->value, expected[i].value, field->len) != 0 || field->value[field->len] != '\0')
+        {
+            problem = "valor distinto";
+        }
+        for (size_t g = 0; g < FUZZ_GUARD && problem == NULL; g++)
+        {
+            if ((uint8_t)buffers[i][field->size + g] != FUZZ_GUARD_BYTE)
+            {
+                problem = "escritura fuera del buffer";
+            }
+        }
+        if (problem != NULL)
+        {
+            printf("FALLO en %s (modo %d): %s\n   cuerpo: ", field->name, mode, problem);
+            fwrite(body, 1, len, stdout);
+            printf("\n   esperado found=%d len=%zu truncated=%d, obtenido found=%d len=%zu truncated=%d\n", expected[i].found, expected[i].len,
+                   expected[i].truncated, field->found, field->len, field->truncated);
+            return false;
+        }
+    }
+    return true;
+}
+
+// MARK: TIEMPOS ------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Camino anterior: url_decode tal como estaba en main.c
+static void url_decode(char *dst, const char *src)
+{
+    char a, b;
+    while (*src)
+    {
+        if ((*src == '%') && ((a = src[1]) && (b = src[2])) && (isxdigit((unsigned char)a) && isxdigit((unsigned char)b)))
+        {
+            if (a >= 'a')
+                a -= 'a' - 'A';
+            if (a >= 'A')
+                a -= ('A' - 10);
+            else
+                a -= '0';
+            if (b >= 'a')
+                b -= 'a' - 'A';
+            if (b >= 'A')
+                b -= ('A' - 10);
+            else
+                b -= '0';
+            *dst++ = 16 * a + b;
+            src += 3;
+        }
+        else if (*src == '+')
+        {
+            *dst++ = ' ';
+            src++;
+        }
+        else
+        {
+            *dst++ = *src++;
+        }
+    }
+    *dst = '\0';
+}
+
+// Misma búsqueda que httpd_query_key_value de ESP-IDF: recorre los pares con strchr y copia el valor
+// (devuelve 0 si lo encuentra, 1 si no cabe y -1 si no está)
+static int query_key_value(const char *query, const char *key, char *value, size_t value_size)
+{
+    const char *ptr = query;
+    size_t key_len = strlen(key);
+    while (strlen(ptr))
+    {
+        const char *value_ptr = strchr(ptr, '=');
+        if (value_ptr == NULL)
+        {
+            break;
+        }
+        size_t offset = value_ptr - ptr;
+        if (offset != key_len || strncasecmp(ptr, key, offset) != 0)
+        {
+            ptr = strchr(value_ptr, '&');
+            if (ptr == NULL)
+            {
+                break;
+            }
+            ptr++;
+            continue;
+        }
+
+        ptr = strchr(++value_ptr, '&');
+        if (ptr == NULL)
+        {
+            ptr = value_ptr + strlen(value_ptr);
+        }
+        size_t needed = ptr - value_ptr + 1;
+        size_t copy = needed < value_size ? needed : value_size;
+        memcpy(value, value_ptr, copy - 1);
+        value[copy - 1] = '\0';
+        return value_size < needed ? 1 : 0;
+    }
+    return -1;
+}
+
+// Cuerpo recibido en trozos: el camino anterior lo copia en un buffer y después decodifica y busca cada campo
+static double measure_old(const char *body, form_field_t *fields, int field_count)
+{
+    size_t len = strlen(body);
+    size_t runs = 0;
+    double start = now_s();
+    double elapsed;
+    do
+    {
+        for (int n = 0; n < 1000; n++)
+        {
+            char buf[BENCH_BUFFER];
+            char decoded[BENCH_BUFFER];
+            memcpy(buf, body, len);
+            buf[len] = '\0';
+            url_decode(decoded, buf);
+            for (int i = 0; i < field_count; i++)
+            {
+                sink += query_key_value(decoded, fields[i].name, fields[i].value, fields[i].size);
+            }
+        }
+        runs += 1000;
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed * 1e9 / runs;
+}
+
+// El analizador recibe los mismos trozos que form_recv
+static double measure_parser(const char *body, form_field_t *fields, int field_count)
+{
+    size_t len = strlen(body);
+    size_t runs = 0;
+    double start = now_s();
+    double elapsed;
+    do
+    {
+        for (int n = 0; n < 1000; n++)
+        {
+            form_parser_t parser;
+            char chunk[FUZZ_RECV_CHUNK];
+            form_parser_init(&parser, fields, field_count);
+            for (size_t pos = 0; pos < len; pos += FUZZ_RECV_CHUNK)
+            {
+                size_t size = len - pos < FUZZ_RECV_CHUNK ? len - pos : FUZZ_RECV_CHUNK;
+                memcpy(chunk, body + pos, size);
+                form_parser_feed(&parser, chunk, size);
+            }
+            form_parser_finish(&parser);
+            sink += fields[0].len;
+        }
+        runs += 1000;
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed * 1e9 / runs;
+}
+
+static void bench(const char *title, const char *body, form_field_t *fields, int field_count)
+{
+    double old_ns = measure_old(body, fields, field_count);
+    double parser_ns = measure_parser(body, fields, field_count);
+    printf("%-12s %3zu bytes   anterior %6.1f ns   analizador %6.1f ns   x%.1f\n", title, strlen(body), old_ns, parser_ns, old_ns / parser_ns);
+}
+
+// MARK: MAIN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    size_t bodies = argc > 1 ? strtoul(argv[1], NULL, 10) : FUZZ_DEFAULT_BODIES;
+    bool ok = true;
+
+    // Fuzz
+    size_t found = 0, truncated = 0;
+    for (size_t n = 0; n < bodies && ok; n++)
+    {
+        char body[FUZZ_MAX_BODY];
+        fuzz_expected_t expected[FUZZ_FIELD_COUNT];
+        size_t len = random_body(body);
+        reference_parse(body, len, expected);
+        for (int i = 0; i < FUZZ_FIELD_COUNT; i++)
+        {
+            found += expected[i].found;
+            truncated += expected[i].truncated;
+        }
+        for (int mode = 0; mode < 4 && ok; mode++)
+        {
+            ok = fuzz_one(body, len, mode, expected);
+        }
+    }
+    printf("fuzz         %zu cuerpos x 4 formas de trocear, %zu campos encontrados, %zu truncados\n", bodies, found, truncated);
+
+    // Tiempos con los formularios de las rutas
+    char ssid[33], password[65];
+    form_field_t credentials[] = {
+        {.name = "ssid", .value = ssid, .size = sizeof(ssid)},
+        {.name = "password", .value = password, .size = sizeof(password)},
+    };
+    char mac_text[18], remove[2], uplink[11], up[11], down[11];
+    form_field_t shaper[] = {
+        {.name = "mac", .value = mac_text, .size = sizeof(mac_text)},    {.name = "remove", .value = remove, .size = sizeof(remove)},
+        {.name = "uplink", .value = uplink, .size = sizeof(uplink)},     {.name = "up", .value = up, .size = sizeof(up)},
+        {.name = "down", .value = down, .size = sizeof(down)},
+    };
+    bench("credenciales", "ssid=Casa+Garc%C3%ADa+5G&password=Contrase%C3%B1a%21%23%242024+muy+larga", credentials, 2);
+    bench("limitador", "mac=AA%3ABB%3ACC%3ADD%3AEE%3AFF&up=2000&down=8000&remove=0", shaper, 5);
+    printf("pila         anterior %d bytes, analizador %zu bytes\n", 2 * BENCH_BUFFER, sizeof(form_parser_t) + FUZZ_RECV_CHUNK);
+
+    printf("%s\n", ok ? "OK" : "FALLO");
+    return ok ? 0 : 1;
+}
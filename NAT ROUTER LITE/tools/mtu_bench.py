@@ -0,0 +1,250 @@
+#!/usr/bin/env python3
+"""Mide el caudal TCP a través del router con distintas MTU de subida configuradas.
+
+Sirve para comprobar el recorte del MSS (POST /mtu) con una red de subida de MTU
+pequeña. Se ejecuta en dos equipos:
+- el extremo lejano, detrás del salto de MTU pequeña: mtu_bench.py --listen 5201
+- un cliente del punto de acceso: mtu_bench.py --router 192.168.4.1 --server IP:5201
+Para cada valor de --mtu el cliente lo configura en el router (0 es el modo
+automático, sin recorte mientras no se aprenda una MTU menor por ICMP), envía y
+recibe TCP durante --duration segundos a través del NAPT y lee de /metrics los SYN
+recortados y los fragmentos de la STA. Al terminar deja la MTU que había. Cambiar
+la MTU necesita la contraseña de administración (CONFIG_ROUTER_ADMIN_TOKEN) en --token.
+
+Para simular la red de subida con MTU pequeña, un equipo Linux entre el router y
+el extremo lejano reduce la MTU de su salida y descarta los ICMP "fragmentation
+needed" (agujero negro de PMTU, como muchos túneles y PPPoE mal configurados):
+    ip link set dev eth1 mtu 1280
+    iptables -A FORWARD -p icmp --icmp-type fragmentation-needed -j DROP
+Sin recorte los segmentos de 1460 bytes no pasan el salto y la conexión se atasca;
+con la MTU del salto el MSS recortado cabe y el caudal se recupera.
+
+Uso: mtu_bench.py --listen 5201
+     mtu_bench.py --router 192.168.4.1 --token secreto --server 203.0.113.5:5201 --mtu 0,1400,1280 --duration 10
+"""
+
+import argparse
+import json
+import os
+import re
+import socket
+import socketserver
+import struct
+import sys
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+CHUNK = 16384
+CONNECT_S = 10     # Espera máxima al abrir una conexión
+STALL_S = 3        # Sin avanzar durante este tiempo, la conexión se da por atascada
+RESULT_WAIT_S = 5  # Espera del extremo lejano a que termine una subida antes de dar su resultado
+METRICS = {
+    'clamped': re.compile(r'^router_mss_clamped_total (\d+)', re.M),
+    'frag_in': re.compile(r'^router_fragments_total\{direction="in"\} (\d+)', re.M),
+    'frag_out': re.compile(r'^router_fragments_total\{direction="out"\} (\d+)', re.M),
+    'icmp': re.compile(r'^router_pmtu_icmp_total (\d+)', re.M),
+}
+
+
+# MARK: Extremo lejano
+
+class Sink(socketserver.ThreadingTCPServer):
+    allow_reuse_address = True
+    daemon_threads = True
+
+    def __init__(self, port):
+        super().__init__(('', port), SinkHandler)
+        self.uploads = {}  # Testigo de cada subida -> bytes recibidos (None mientras sigue)
+        self.lock = threading.Condition()
+
+
+class SinkHandler(socketserver.BaseRequestHandler):
+    # Primer byte: U (subida: testigo de 8 bytes y datos), R (resultado de una subida) o D (bajada: segundos)
+    def handle(self):
+        sock = self.request
+        sock.settimeout(CONNECT_S)
+        kind = recv_exact(sock, 1)
+        if kind == b'U':
+            self.upload(sock, recv_exact(sock, 8))
+        elif kind == b'R':
+            self.result(sock, recv_exact(sock, 8))
+        elif kind == b'D':
+            self.download(sock, recv_exact(sock, 1)[0])
+
+    def upload(self, sock, token):
+        server = self.server
+        with server.lock:
+            server.uploads[token] = None
+        total = 0
+        sock.settimeout(STALL_S)
+        try:
+            while True:
+                data = sock.recv(65536)
+                if not data:
+                    break
+                total += len(data)
+        except OSError:
+            pass  # Atasco o conexión cortada: cuenta lo recibido
+        with server.lock:
+            server.uploads[token] = total
+            server.lock.notify_all()
+
+    def result(self, sock, token):
+        server = self.server
+        with server.lock:
+            server.lock.wait_for(lambda: server.uploads.get(token, 0) is not None, RESULT_WAIT_S + STALL_S)
+            total = server.uploads.pop(token, None) or 0
+        sock.sendall(struct.pack('!Q', total))
+
+    def download(self, sock, seconds):
+        data = bytes(CHUNK)
+        end = time.monotonic() + seconds
+        sock.settimeout(STALL_S)
+        try:
+            while time.monotonic() < end:
+                sock.sendall(data)
+        except OSError:
+            pass
+
+
+def recv_exact(sock, size):
+    data = b''
+    while len(data) < size:
+        part = sock.recv(size - len(data))
+        if not part:
+            raise ConnectionError('Conexión cerrada')
+        data += part
+    return data
+
+
+# MARK: Cliente del punto de acceso
+
+def router_request(router, path, data=None, token=None):
+    body = urllib.parse.urlencode(data).encode() if data is not None else None
+    headers = {'X-Admin-Token': token} if token else {}
+    req = urllib.request.Request('http://%s%s' % (router, path), data=body, headers=headers)
+    try:
+        with urllib.request.urlopen(req, timeout=10) as response:
+            return response.read().decode()
+    except urllib.error.HTTPError as e:
+        sys.exit('El router ha rechazado %s: %s' % (path, e.read().decode().strip()))
+    except OSError as e:
+        sys.exit('No se puede conectar con el router: %s' % e)
+
+
+def read_counters(router):
+    text = router_request(router, '/metrics')
+    return {name: int(m.group(1)) if (m := regex.search(text)) else 0 for name, regex in METRICS.items()}
+
+
+def configured_mtu(router):
+    match = re.search(r'^configured_mtu (\d+)', router_request(router, '/mtu'), re.M)
+    return int(match.group(1)) if match else 0
+
+
+def abort(sock):
+    # Cierre inmediato (RST): con la conexión atascada un FIN esperaría detrás de los datos sin confirmar
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_LINGER, struct.pack('ii', 1, 0))
+    sock.close()
+
+
+def run_upload(server, duration):
+    token = os.urandom(8)
+    data = bytes(CHUNK)
+    sock = socket.create_connection(server, timeout=CONNECT_S)
+    sock.sendall(b'U' + token)
+    sock.settimeout(STALL_S)
+    start = time.monotonic()
+    try:
+        while time.monotonic() - start < duration:
+            sock.sendall(data)
+    except OSError:
+        pass
+    elapsed = time.monotonic() - start
+    abort(sock)
+
+    # Lo recibido lo cuenta el extremo lejano; sin su respuesta la subida cuenta como 0
+    try:
+        with socket.create_connection(server, timeout=CONNECT_S) as control:
+            control.settimeout(RESULT_WAIT_S + STALL_S + 1)
+            control.sendall(b'R' + token)
+            total = struct.unpack('!Q', recv_exact(control, 8))[0]
+    except OSError as e:
+        print('Sin resultado de la subida del extremo lejano: %s' % e, file=sys.stderr)
+        total = 0
+    return total * 8 / max(elapsed, duration) / 1e6
+
+
+def run_download(server, duration):
+    sock = socket.create_connection(server, timeout=CONNECT_S)
+    sock.sendall(b'D' + bytes([duration]))
+    sock.settimeout(STALL_S)
+    total = 0
+    start = time.monotonic()
+    try:
+        while time.monotonic() - start < duration:
+            data = sock.recv(65536)
+            if not data:
+                break
+            total += len(data)
+    except OSError:
+        pass
+    abort(sock)
+    return total * 8 / duration / 1e6
+
+
+def sweep(args):
+    host, _, port = args.server.rpartition(':')
+    server = (host, int(port))
+    previous = configured_mtu(args.router)
+    results = []
+    try:
+        for mtu in args.mtu:
+            router_request(args.router, '/mtu', {'mtu': mtu}, args.token)
+            before = read_counters(args.router)
+            up = run_upload(server, args.duration)
+            down = run_download(server, args.duration)
+            after = read_counters(args.router)
+            result = {'mtu': mtu, 'up_mbps': up, 'down_mbps': down}
+            result.update({name: after[name] - before[name] for name in METRICS})
+            results.append(result)
+    finally:
+        router_request(args.router, '/mtu', {'mtu': previous}, args.token)
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Caudal TCP a través del router con distintas MTU de subida')
+    parser.add_argument('--listen', type=int, metavar='PORT', help='Hace de extremo lejano en este puerto')
+    parser.add_argument('--router', default='192.168.4.1', help='IP del router vista desde este cliente del AP')
+    parser.add_argument('--token', help='Contraseña de administración del router (X-Admin-Token)')
+    parser.add_argument('--server', help='IP:puerto del extremo lejano (mtu_bench.py --listen)')
+    parser.add_argument('--mtu', default='0,1400,1280', help='MTU que se prueban, separadas por comas (0: automática)')
+    parser.add_argument('--duration', type=int, default=10, help='Segundos por sentido (1 a 60)')
+    parser.add_argument('--json', action='store_true', help='Resultado en una línea JSON')
+    args = parser.parse_args()
+
+    if args.listen:
+        print('Esperando pruebas en el puerto %d' % args.listen)
+        Sink(args.listen).serve_forever()
+        return
+    if not args.server or not 1 <= args.duration <= 60:
+        parser.error('hace falta --server y una duración de 1 a 60 s')
+    if not args.token:
+        parser.error('cambiar la MTU necesita --token')
+    args.mtu = [int(v) for v in args.mtu.split(',')]
+
+    results = sweep(args)
+    if args.json:
+        print(json.dumps(results))
+        return
+    print(' MTU   subida Mbit/s  bajada Mbit/s  SYN recortados  fragmentos entrada/salida  ICMP')
+    for r in results:
+        print('%5s  %13.2f  %13.2f  %14d  %15d/%-9d  %4d' % (r['mtu'] or 'auto', r['up_mbps'], r['down_mbps'], r['clamped'], r['frag_in'], r['frag_out'], r['icmp']))
+
+
+if __name__ == '__main__':
+    main()
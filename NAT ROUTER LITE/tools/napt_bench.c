@@ -0,0 +1,390 @@
+// Prueba en el host de la tabla de conexiones NAPT (main/napt_table.c) frente a una tabla de tipo lwIP.
+// La tabla de referencia reproduce la estructura de ip4_napt.c de lwIP: entradas en un vector estático
+// enlazadas en una lista de usadas que se recorre entera en cada búsqueda. Con 100, 1000 y 5000 flujos
+// sintéticos se miden la búsqueda de un flujo existente, la de uno que no está y la renovación (borrar un
+// flujo e insertar otro). Ambas tablas deben encontrar exactamente los mismos flujos. Al final se da a cada
+// flujo una traducción y se comprueba el índice inverso (la validación de los ICMP de error) antes y después
+// de borrar la mitad de los flujos, con el tiempo de una búsqueda por la 5-tupla traducida.
+//
+// Uso: cc -O2 -I main tools/napt_bench.c main/napt_table.c -o napt_bench
+//      ./napt_bench [flujos...]
+
+#include "napt_table.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Definiciones de la prueba
+#define BENCH_MIN_SECONDS 0.2   // Tiempo mínimo de cada medida
+#define BENCH_PROBES 4096       // Claves distintas por medida
+#define BENCH_NO_INDEX 0xFFFF
+#define BENCH_NAT_IP 0x3200A8C0u // 192.168.0.50, la IP de la STA
+
+// Entrada de la tabla de referencia (como struct napt_table de lwIP)
+typedef struct
+{
+    napt_key_t key;
+    uint32_t last;
+    uint16_t mport;
+    uint16_t next;
+    uint16_t prev;
+} stock_entry_t;
+
+typedef struct
+{
+    stock_entry_t *entries;
+    uint16_t used;  // Cabeza de la lista de usadas
+    uint16_t free;  // Cabeza de la lista de libres
+    uint32_t count;
+} stock_table_t;
+
+typedef enum
+{
+    BENCH_HIT = 0,
+    BENCH_MISS,
+    BENCH_CHURN,
+} bench_op_t;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+static volatile uintptr_t sink; // Evita que el compilador elimine las búsquedas
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Flujo de un cliente del AP (192.168.4.0/24) hacia un servidor cualquiera
+static napt_key_t random_key(void)
+{
+    uint64_t r = next_random();
+    napt_key_t key;
+    memset(&key, 0, sizeof(key));
+    key.src_ip = 0x0004A8C0u | ((uint32_t)(2 + r % 250) << 24);
+    key.dst_ip = (uint32_t)(r >> 16);
+    key.src_port = (uint16_t)(1024 + (r >> 48) % 60000);
+    key.dst_port = (r & 0x100) ? 0xBB01 : 0x3500; // 443 o 53 en orden de red
+    key.proto = (r & 0x100) ? 6 : 17;
+    return key;
+}
+
+static bool key_equal(const napt_key_t *a, const napt_key_t *b)
+{
+    return a->src_ip == b->src_ip && a->dst_ip == b->dst_ip && a->src_port == b->src_port && a->dst_port == b->dst_port && a->proto == b->proto;
+}
+
+// MARK: TABLA DE REFERENCIA ------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static void stock_init(stock_table_t *table, uint32_t size)
+{
+    table->entries = calloc(size, sizeof(stock_entry_t));
+    table->used = BENCH_NO_INDEX;
+    table->free = 0;
+    table->count = 0;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        table->entries[i].next = i + 1 < size ? i + 1 : BENCH_NO_INDEX;
+    }
+}
+
+// Recorre la lista de usadas, como ip_napt_find
+static stock_entry_t *stock_find(stock_table_t *table, const napt_key_t *key)
+{
+    for (uint16_t i = table->used; i != BENCH_NO_INDEX; i = table->entries[i].next)
+    {
+        if (key_equal(&table->entries[i].key, key))
+        {
+            return &table->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static stock_entry_t *stock_insert(stock_table_t *table, const napt_key_t *key, uint32_t now)
+{
+    stock_entry_t *entry = stock_find(table, key);
+    if (entry != NULL || table->free == BENCH_NO_INDEX)
+    {
+        return entry;
+    }
+
+    uint16_t index = table->free;
+    entry = &table->entries[index];
+    table->free = entry->next;
+    entry->key = *key;
+    entry->last = now;
+    entry->prev = BENCH_NO_INDEX;
+    entry->next = table->used;
+    if (table->used != BENCH_NO_INDEX)
+    {
+        table->entries[table->used].prev = index;
+    }
+    table->used = index;
+    table->count++;
+    return entry;
+}
+
+static bool stock_remove(stock_table_t *table, const napt_key_t *key)
+{
+    stock_entry_t *entry = stock_find(table, key);
+    if (entry == NULL)
+    {
+        return false;
+    }
+
+    uint16_t index = entry - table->entries;
+    if (entry->prev != BENCH_NO_INDEX)
+    {
+        table->entries[entry->prev].next = entry->next;
+    }
+    else
+    {
+        table->used = entry->next;
+    }
+    if (entry->next != BENCH_NO_INDEX)
+    {
+        table->entries[entry->next].prev = entry->prev;
+    }
+    entry->next = table->free;
+    table->free = index;
+    table->count--;
+    return true;
+}
+
+// MARK: MEDIDAS ------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Tiempo medio por operación en ns sobre la tabla hash; flows contiene los flujos de la tabla y se actualiza al renovar
+static double measure_hash(napt_table_t *table, napt_key_t *flows, uint32_t count, bench_op_t op)
+{
+    size_t ops = 0;
+    double start = now_s();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < BENCH_PROBES; i++)
+        {
+            uint32_t index = next_random() % count;
+            if (op == BENCH_CHURN)
+            {
+                bool created;
+                napt_table_remove(table, &flows[index]);
+                flows[index] = random_key();
+                sink += (uintptr_t)napt_table_insert(table, &flows[index], 1000, &created);
+            }
+            else
+            {
+                napt_key_t key = op == BENCH_HIT ? flows[index] : random_key();
+                sink += (uintptr_t)napt_table_find(table, &key, 1000);
+            }
+        }
+        ops += BENCH_PROBES;
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed * 1e9 / ops;
+}
+
+static double measure_stock(stock_table_t *table, napt_key_t *flows, uint32_t count, bench_op_t op)
+{
+    size_t ops = 0;
+    double start = now_s();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < BENCH_PROBES; i++)
+        {
+            uint32_t index = next_random() % count;
+            if (op == BENCH_CHURN)
+            {
+                stock_remove(table, &flows[index]);
+                flows[index] = random_key();
+                sink += (uintptr_t)stock_insert(table, &flows[index], 1000);
+            }
+            else
+            {
+                napt_key_t key = op == BENCH_HIT ? flows[index] : random_key();
+                sink += (uintptr_t)stock_find(table, &key);
+            }
+        }
+        ops += BENCH_PROBES;
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+    return elapsed * 1e9 / ops;
+}
+
+// Cada tabla contiene exactamente los flujos de su lista; antes de renovar las listas son iguales y
+// una clave ausente no debe aparecer en ninguna de las dos
+static bool check(napt_table_t *table, stock_table_t *stock, const napt_key_t *flows, const napt_key_t *stock_flows, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (napt_table_find(table, &flows[i], 1000) == NULL || stock_find(stock, &stock_flows[i]) == NULL)
+        {
+            return false;
+        }
+    }
+    if (memcmp(flows, stock_flows, count * sizeof(napt_key_t)) == 0)
+    {
+        for (int i = 0; i < BENCH_PROBES; i++)
+        {
+            napt_key_t key = random_key();
+            if ((napt_table_find(table, &key, 1000) != NULL) != (stock_find(stock, &key) != NULL))
+            {
+                return false;
+            }
+        }
+    }
+    return table->count == count && stock->count == count;
+}
+
+// 5-tupla del flujo i como la ve la red de subida: origen traducido a la IP de la STA y a un puerto propio
+static napt_key_t translated_key(const napt_key_t *flow, uint32_t i)
+{
+    napt_key_t key = *flow;
+    key.src_ip = BENCH_NAT_IP;
+    key.src_port = (uint16_t)(1024 + i);
+    return key;
+}
+
+// Traduce todos los flujos y los busca por la 5-tupla traducida; tras borrar los pares, los impares deben
+// seguir apareciendo (sus ranuras se desplazan) y los pares no. Devuelve el tiempo por búsqueda en ns o -1 si falla
+static double check_translated(napt_table_t *table, const napt_key_t *flows, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        napt_table_map(table, napt_table_find(table, &flows[i], 1000), BENCH_NAT_IP, (uint16_t)(1024 + i));
+    }
+
+    size_t ops = 0;
+    double start = now_s();
+    double elapsed;
+    do
+    {
+        for (int i = 0; i < BENCH_PROBES; i++)
+        {
+            uint32_t index = next_random() % count;
+            napt_key_t key = translated_key(&flows[index], index);
+            if (napt_table_find_translated(table, &key, 1000) != napt_table_find(table, &flows[index], 1000))
+            {
+                return -1;
+            }
+        }
+        ops += BENCH_PROBES;
+        elapsed = now_s() - start;
+    } while (elapsed < BENCH_MIN_SECONDS);
+
+    for (uint32_t i = 0; i < count; i += 2)
+    {
+        napt_table_remove(table, &flows[i]);
+    }
+    for (uint32_t i = 0; i < count; i++)
+    {
+        napt_key_t key = translated_key(&flows[i], i);
+        const napt_flow_t *flow = napt_table_find_translated(table, &key, 1000);
+        if ((i % 2 == 0) ? flow != NULL : (flow == NULL || !key_equal(&flow->key, &flows[i])))
+        {
+            return -1;
+        }
+    }
+    return elapsed * 1e9 / ops;
+}
+
+// Mide una tabla de count flujos; devuelve false si las tablas no coinciden
+static bool run(uint32_t count)
+{
+    napt_table_t table;
+    stock_table_t stock;
+    if (!napt_table_init(&table, (uint32_t)((uint64_t)count * 100 / NAPT_TABLE_LOAD_PERCENT + 1)))
+    {
+        return false;
+    }
+    stock_init(&stock, count);
+
+    // Flujos distintos: una tupla repetida se vuelve a sortear
+    napt_key_t *flows = malloc(count * sizeof(napt_key_t));
+    napt_key_t *stock_flows = malloc(count * sizeof(napt_key_t));
+    for (uint32_t i = 0; i < count; i++)
+    {
+        bool created = false;
+        while (!created)
+        {
+            flows[i] = random_key();
+            napt_table_insert(&table, &flows[i], 1000, &created);
+        }
+        stock_insert(&stock, &flows[i], 1000);
+    }
+    memcpy(stock_flows, flows, count * sizeof(napt_key_t));
+    bool ok = check(&table, &stock, flows, stock_flows, count);
+
+    double results[2][3];
+    for (bench_op_t op = BENCH_HIT; op <= BENCH_CHURN; op++)
+    {
+        uint64_t seed = rng_state;
+        results[0][op] = measure_hash(&table, flows, count, op);
+        rng_state = seed; // Las dos tablas empiezan con la misma secuencia de claves
+        results[1][op] = measure_stock(&stock, stock_flows, count, op);
+    }
+
+    // Tras la renovación cada tabla sigue con sus count flujos (las dos renuevan durante el mismo tiempo, no el mismo número de veces)
+    ok = ok && check(&table, &stock, flows, stock_flows, count);
+    double translated = ok ? check_translated(&table, flows, count) : -1;
+    ok = ok && translated >= 0;
+
+    printf("%5u flujos (%u ranuras, %2.0f %% ocupada)\n", count, table.mask + 1, 100.0 * table.count / (table.mask + 1));
+    printf("   búsqueda acierto   hash %7.1f ns   lista %9.1f ns   x%.0f\n", results[0][BENCH_HIT], results[1][BENCH_HIT], results[1][BENCH_HIT] / results[0][BENCH_HIT]);
+    printf("   búsqueda fallo     hash %7.1f ns   lista %9.1f ns   x%.0f\n", results[0][BENCH_MISS], results[1][BENCH_MISS], results[1][BENCH_MISS] / results[0][BENCH_MISS]);
+    printf("   renovación         hash %7.1f ns   lista %9.1f ns   x%.0f\n", results[0][BENCH_CHURN], results[1][BENCH_CHURN],
+           results[1][BENCH_CHURN] / results[0][BENCH_CHURN]);
+    printf("   búsqueda ICMP      índice inverso %7.1f ns\n", translated);
+    if (!ok)
+    {
+        printf("   FALLO: las tablas no contienen los flujos esperados\n");
+    }
+
+    free(flows);
+    free(stock_flows);
+    free(stock.entries);
+    napt_table_deinit(&table);
+    return ok;
+}
+
+// MARK: MAIN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    static const uint32_t defaults[] = {100, 1000, 5000};
+    bool ok = true;
+    if (argc > 1)
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            uint32_t count = strtoul(argv[i], NULL, 10);
+            if (count == 0 || (uint64_t)count * 100 / NAPT_TABLE_LOAD_PERCENT + 1 > NAPT_TABLE_SIZE_MAX)
+            {
+                fprintf(stderr, "Número de flujos no válido: %s\n", argv[i]);
+                return 2;
+            }
+            ok = run(count) && ok;
+        }
+    }
+    else
+    {
+        for (size_t i = 0; i < sizeof(defaults) / sizeof(defaults[0]); i++)
+        {
+            ok = run(defaults[i]) && ok;
+        }
+    }
+    printf("%s\n", ok ? "OK" : "FALLO");
+    return ok ? 0 : 1;
+}
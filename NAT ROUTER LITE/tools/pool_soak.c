@@ -0,0 +1,258 @@
+// Prueba de resistencia en el host de las pools de bloques (main/pool_core.c) con las clases de pool.h.
+// Reproduce millones de reservas con los tamaños y las vidas de la ruta del reenviador DNS (consultas pendientes,
+// respuestas en caché, alguna respuesta EDNS grande y buffers de las estadísticas de tareas), con ráfagas que
+// llenan las pools y obligan a usar la clase siguiente o el heap, igual que pool_alloc/pool_free. Cada bloque se
+// marca con un patrón que se comprueba al liberarlo (dos reservas en el mismo bloque lo estropean). Cada millón de
+// reservas muestra los bloques en uso, los máximos, los fallbacks y los bytes que quedan en el heap; al terminar
+// todo debe volver a las pools y las listas libres deben tener todos sus bloques. Mide también el coste por
+// reserva y liberación frente a malloc/free del host con la misma secuencia.
+//
+// Uso: cc -O2 -I main tools/pool_soak.c main/pool_core.c -o pool_soak
+//      ./pool_soak [millones de reservas]
+
+#include "pool_core.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Definiciones de la prueba
+#define SOAK_DEFAULT_MILLIONS 10
+#define SOAK_LIVE_MAX 96          // Reservas vivas a la vez como máximo
+#define SOAK_NORMAL_LIVE 24       // Reservas vivas de media fuera de las ráfagas
+#define SOAK_BURST_LIVE 80        // Reservas vivas de media en una ráfaga (más que bloques hay en las pools)
+#define SOAK_BURST_EVERY 200000   // Reservas entre ráfagas
+#define SOAK_BURST_LENGTH 20000   // Reservas que dura una ráfaga
+#define SOAK_HEAP_MAX 3072        // Mayor reserva del heap (mayor que cualquier bloque)
+
+// Reserva viva
+typedef struct
+{
+    uint8_t *ptr;
+    uint32_t size;
+    uint32_t tag; // Patrón con el que se marcó
+} soak_live_t;
+
+typedef struct
+{
+    uint64_t allocs;
+    uint64_t heap_allocs;  // Servidas por el heap (mayores que un bloque o con las pools llenas)
+    uint64_t heap_bytes;   // Bytes del heap vivos
+    uint64_t heap_peak;    // Máximo de bytes del heap vivos a la vez
+    uint64_t corrupted;    // Bloques con el patrón estropeado al liberarlos
+} soak_counters_t;
+
+static uint8_t small_memory[POOL_SMALL_SIZE * POOL_SMALL_COUNT] __attribute__((aligned(4)));
+static uint8_t medium_memory[POOL_MEDIUM_SIZE * POOL_MEDIUM_COUNT] __attribute__((aligned(4)));
+static uint8_t large_memory[POOL_LARGE_SIZE * POOL_LARGE_COUNT] __attribute__((aligned(4)));
+static pool_t pools[POOL_CLASSES] = {
+    {.memory = small_memory, .block_size = POOL_SMALL_SIZE, .blocks = POOL_SMALL_COUNT},
+    {.memory = medium_memory, .block_size = POOL_MEDIUM_SIZE, .blocks = POOL_MEDIUM_COUNT},
+    {.memory = large_memory, .block_size = POOL_LARGE_SIZE, .blocks = POOL_LARGE_COUNT},
+};
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Tamaño de una reserva: sobre todo consultas y respuestas DNS pequeñas
+static uint32_t random_size(void)
+{
+    uint32_t r = next_random() % 100;
+    if (r < 70)
+    {
+        return 32 + next_random() % (POOL_SMALL_SIZE - 32 + 1);
+    }
+    if (r < 90)
+    {
+        return POOL_SMALL_SIZE + 1 + next_random() % (POOL_MEDIUM_SIZE - POOL_SMALL_SIZE);
+    }
+    if (r < 98)
+    {
+        return POOL_MEDIUM_SIZE + 1 + next_random() % (POOL_LARGE_SIZE - POOL_MEDIUM_SIZE);
+    }
+    return POOL_LARGE_SIZE + 1 + next_random() % (SOAK_HEAP_MAX - POOL_LARGE_SIZE);
+}
+
+// Como pool_alloc y pool_free, contando lo que va al heap
+static void *soak_alloc(size_t size, soak_counters_t *counters)
+{
+    void *ptr = pool_core_alloc(pools, POOL_CLASSES, size);
+    if (ptr == NULL)
+    {
+        ptr = malloc(size);
+        counters->heap_allocs++;
+        counters->heap_bytes += size;
+        if (counters->heap_bytes > counters->heap_peak)
+        {
+            counters->heap_peak = counters->heap_bytes;
+        }
+    }
+    counters->allocs++;
+    return ptr;
+}
+
+static void soak_free(void *ptr, size_t size, soak_counters_t *counters)
+{
+    if (!pool_core_free(pools, POOL_CLASSES, ptr))
+    {
+        free(ptr);
+        counters->heap_bytes -= size;
+    }
+}
+
+// Marca el principio, el medio y el final del bloque con su patrón; dos reservas en el mismo bloque coinciden al menos al principio
+static void fill(soak_live_t *live)
+{
+    uint8_t tag = (uint8_t)live->tag;
+    live->ptr[0] = tag;
+    live->ptr[live->size / 2] = tag;
+    live->ptr[live->size - 1] = tag;
+}
+
+static bool intact(const soak_live_t *live)
+{
+    uint8_t expected = (uint8_t)live->tag;
+    return live->ptr[0] == expected && live->ptr[live->size / 2] == expected && live->ptr[live->size - 1] == expected;
+}
+
+// Bloques libres de una pool, todos dentro de su memoria, alineados y sin repetir
+static bool free_list_complete(const pool_t *pool)
+{
+    uint32_t count = 0;
+    for (const pool_block_t *block = pool->free_list; block != NULL; block = block->next)
+    {
+        size_t offset = (const uint8_t *)block - pool->memory;
+        if (offset >= (size_t)pool->block_size * pool->blocks || offset % pool->block_size != 0 || ++count > pool->blocks)
+        {
+            return false;
+        }
+    }
+    return count == pool->blocks;
+}
+
+static void print_checkpoint(uint64_t allocs, const soak_counters_t *counters)
+{
+    printf("%5.0fM ", allocs / 1e6);
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        const pool_stats_t *stats = &pools[i].stats;
+        printf("  %4lu: %2u/%2u máx %2u fb %-7u", (unsigned long)stats->block_size, stats->in_use, stats->blocks, stats->high_water, stats->fallbacks);
+    }
+    printf("  heap %6llu B (máx %llu B, %llu reservas)\n", (unsigned long long)counters->heap_bytes, (unsigned long long)counters->heap_peak,
+           (unsigned long long)counters->heap_allocs);
+}
+
+// MARK: PRUEBA -------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// Ejecuta la secuencia de reservas; con heap_only todo va a malloc/free (referencia de tiempo)
+static double soak(uint64_t total, bool heap_only, soak_counters_t *counters)
+{
+    static soak_live_t live[SOAK_LIVE_MAX];
+    uint32_t live_count = 0;
+    memset(counters, 0, sizeof(*counters));
+    rng_state = 0x9E3779B97F4A7C15ull;
+    pool_core_init(pools, POOL_CLASSES);
+
+    double start = now_s();
+    for (uint64_t n = 0; n < total; n++)
+    {
+        // En una ráfaga se acumulan más reservas vivas de las que caben en las pools
+        bool burst = n % SOAK_BURST_EVERY < SOAK_BURST_LENGTH;
+        uint32_t target = burst ? SOAK_BURST_LIVE : SOAK_NORMAL_LIVE;
+
+        // Se libera una reserva al azar (vidas desordenadas, como la caché DNS) hasta volver al objetivo
+        while (live_count >= SOAK_LIVE_MAX || (live_count > 0 && next_random() % (2 * target) < live_count))
+        {
+            uint32_t i = next_random() % live_count;
+            if (!intact(&live[i]))
+            {
+                counters->corrupted++;
+            }
+            if (heap_only)
+            {
+                free(live[i].ptr);
+            }
+            else
+            {
+                soak_free(live[i].ptr, live[i].size, counters);
+            }
+            live[i] = live[--live_count];
+        }
+
+        soak_live_t *entry = &live[live_count++];
+        entry->size = random_size();
+        entry->tag = (uint32_t)n;
+        entry->ptr = heap_only ? malloc(entry->size) : soak_alloc(entry->size, counters);
+        fill(entry);
+
+        if (!heap_only && (n + 1) % 1000000 == 0)
+        {
+            print_checkpoint(n + 1, counters);
+        }
+    }
+
+    while (live_count > 0)
+    {
+        soak_live_t *entry = &live[--live_count];
+        if (!intact(entry))
+        {
+            counters->corrupted++;
+        }
+        if (heap_only)
+        {
+            free(entry->ptr);
+        }
+        else
+        {
+            soak_free(entry->ptr, entry->size, counters);
+        }
+    }
+    return (now_s() - start) * 1e9 / total;
+}
+
+// MARK: MAIN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    uint64_t millions = (argc > 1) ? strtoull(argv[1], NULL, 10) : SOAK_DEFAULT_MILLIONS;
+    if (millions == 0)
+    {
+        fprintf(stderr, "Número de reservas no válido: %s\n", argv[1]);
+        return 2;
+    }
+
+    soak_counters_t counters;
+    soak_counters_t heap_counters;
+    printf("Pools: %u x %u B, %u x %u B, %u x %u B (%u bytes)\n", POOL_SMALL_COUNT, POOL_SMALL_SIZE, POOL_MEDIUM_COUNT, POOL_MEDIUM_SIZE, POOL_LARGE_COUNT,
+           POOL_LARGE_SIZE, (unsigned)(sizeof(small_memory) + sizeof(medium_memory) + sizeof(large_memory)));
+    double pool_ns = soak(millions * 1000000, false, &counters);
+
+    bool ok = counters.corrupted == 0 && counters.heap_bytes == 0;
+    for (int i = 0; i < POOL_CLASSES; i++)
+    {
+        ok = ok && pools[i].stats.in_use == 0 && free_list_complete(&pools[i]);
+    }
+    double heap_ns = soak(millions * 1000000, true, &heap_counters);
+    ok = ok && heap_counters.corrupted == 0;
+
+    printf("Reservas: %llu, %.2f %% al heap; bloques estropeados %llu\n", (unsigned long long)counters.allocs, 100.0 * counters.heap_allocs / counters.allocs,
+           (unsigned long long)(counters.corrupted + heap_counters.corrupted));
+    printf("Reserva y liberación: pools %.1f ns, malloc/free del host %.1f ns\n", pool_ns, heap_ns);
+    printf("%s\n", ok ? "OK" : "FALLO");
+    return ok ? 0 : 1;
+}
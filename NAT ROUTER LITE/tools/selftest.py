@@ -0,0 +1,277 @@
+#!/usr/bin/env python3
+"""Ejecuta la prueba de velocidad del router (/selftest) desde un equipo.
+
+En cada sentido el equipo hace de extremo contrario al router: en subida ("up")
+el router recibe y el equipo envía; en bajada ("down") el router envía y el
+equipo recibe. El router mide Mbit/s y el uso de CPU de cada núcleo; el lado que
+recibe UDP mide además el jitter (RFC 3550) y las pérdidas. Los datagramas UDP
+llevan la cabecera de iperf 2 (secuencia, segundos y microsegundos de envío).
+
+--iface elige la IP del router que se prueba: "ap" desde un cliente del punto de
+acceso (radio del AP), "sta" desde un equipo de la red de subida WiFi o "eth"
+desde un equipo de la red de la WAN por Ethernet; --router es la IP del router
+que ve este equipo. --compare mide una tras otra la STA y la WAN por Ethernet
+(desde un equipo que llegue a las dos) y muestra la relación de caudales. Con --json el
+resultado sale en una línea JSON, para comparar entre versiones del firmware.
+
+Iniciar la prueba necesita la contraseña de administración (CONFIG_ROUTER_ADMIN_TOKEN)
+en --token y solo se admite por el punto de acceso: con --iface sta o eth, o con
+--compare, el equipo debe ser también cliente del AP y --control es la IP del AP.
+El estado se sigue consultando en --router.
+
+Uso: selftest.py --router 192.168.4.1 --proto udp --direction both --rate 20000
+     selftest.py --router 192.168.1.50 --control 192.168.4.1 --token secreto --compare 192.168.2.50 --proto tcp
+"""
+
+import argparse
+import copy
+import json
+import socket
+import struct
+import sys
+import threading
+import time
+import urllib.error
+import urllib.parse
+import urllib.request
+
+UDP_PAYLOAD = 1470  # Igual que SELFTEST_UDP_PAYLOAD
+TCP_CHUNK = 16384
+WAIT_S = 15         # Espera máxima al router (SELFTEST_WAIT_MS)
+IDLE_S = 2          # Sin datos durante este tiempo, la prueba termina (SELFTEST_IDLE_MS)
+
+
+def request(router, data=None, token=None):
+    body = urllib.parse.urlencode(data).encode() if data is not None else None
+    headers = {'X-Admin-Token': token} if token else {}
+    req = urllib.request.Request('http://%s/selftest' % router, data=body, headers=headers)
+    try:
+        with urllib.request.urlopen(req, timeout=10) as response:
+            text = response.read().decode()
+    except urllib.error.HTTPError as e:
+        sys.exit('El router ha rechazado la prueba: %s' % e.read().decode().strip())
+    return dict(line.split(' ', 1) for line in text.strip().splitlines())
+
+
+def wait_state(router, states, timeout):
+    end = time.monotonic() + timeout
+    while True:
+        state = request(router)
+        if state['state'] in states or time.monotonic() > end:
+            return state
+        time.sleep(0.2)
+
+
+def local_ip_towards(router):
+    # Con UDP connect no se envía nada; solo elige la interfaz de salida
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.connect((router, 9))
+        return s.getsockname()[0]
+
+
+def udp_header(seq):
+    now = time.time()
+    return struct.pack('!iII', seq, int(now), int(now % 1 * 1000000))
+
+
+def send_tcp(router, port, duration):
+    data = bytes(TCP_CHUNK)
+    with socket.create_connection((router, port), timeout=WAIT_S) as s:
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            s.sendall(data)
+
+
+def send_udp(router, port, duration, rate_kbps):
+    padding = bytes(UDP_PAYLOAD - 12)
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as s:
+        s.connect((router, port))
+        start = time.monotonic()
+        seq = 0
+        while True:
+            elapsed = time.monotonic() - start
+            if elapsed >= duration:
+                break
+            # Ritmo: cada datagrama sale cuando le toca según la tasa pedida
+            ahead = seq * UDP_PAYLOAD * 8 / (rate_kbps * 1000) - elapsed
+            if ahead > 0:
+                time.sleep(ahead)
+            s.send(udp_header(seq) + padding)
+            seq += 1
+        for _ in range(3):
+            s.send(udp_header(-seq) + padding)
+
+
+def receive_tcp(server, duration):
+    server.settimeout(WAIT_S)
+    conn, _ = server.accept()
+    with conn:
+        conn.settimeout(IDLE_S)
+        total = 0
+        start = last = time.monotonic()
+        while last - start < duration + IDLE_S:
+            try:
+                data = conn.recv(65536)
+            except socket.timeout:
+                break
+            if not data:
+                break
+            total += len(data)
+            last = time.monotonic()
+    return {'bytes': total, 'seconds': last - start}
+
+
+def receive_udp(server, duration):
+    server.settimeout(WAIT_S)
+    total = packets = lost = out_of_order = 0
+    next_seq = 0
+    jitter = 0.0
+    prev_transit = None
+    start = last = None
+    while True:
+        try:
+            data = server.recv(65536)
+        except socket.timeout:
+            break
+        now = time.time()
+        if len(data) < 12:
+            continue
+        if start is None:
+            start = now
+            server.settimeout(IDLE_S)
+        seq, sec, usec = struct.unpack('!iII', data[:12])
+        final = seq < 0
+        seq = -seq if final else seq
+
+        total += len(data)
+        packets += 1
+        last = now
+        if seq >= next_seq:
+            lost += seq - next_seq
+            next_seq = seq + 1
+        else:
+            out_of_order += 1
+            lost = max(lost - 1, 0)
+
+        transit = now - (sec + usec / 1000000)
+        if prev_transit is not None:
+            jitter += (abs(transit - prev_transit) - jitter) / 16
+        prev_transit = transit
+        if final or now - start >= duration + IDLE_S:
+            break
+
+    if start is None:
+        return None
+    expected = packets + lost
+    return {'bytes': total, 'seconds': last - start, 'packets': packets, 'lost': lost, 'out_of_order': out_of_order,
+            'loss_pct': 100 * lost / expected if expected else 0.0, 'jitter_ms': jitter * 1000}
+
+
+def run_up(args):
+    # El router recibe: se prepara primero y el equipo envía
+    request(args.control, {'action': 'start', 'proto': args.proto, 'mode': 'sink', 'iface': args.iface, 'port': args.port, 'duration': args.duration},
+            args.token)
+    device = wait_state(args.router, ('waiting', 'failed'), WAIT_S)
+    if device['state'] == 'failed':
+        return {}, device
+    if args.proto == 'tcp':
+        send_tcp(args.router, args.port, args.duration)
+    else:
+        send_udp(args.router, args.port, args.duration, args.rate)
+
+    device = wait_state(args.router, ('done', 'failed'), args.duration + WAIT_S)
+    result = {'direction': 'up', 'measured_by': 'router', 'mbps': float(device['mbps'])}
+    if args.proto == 'udp':
+        result.update(loss_pct=float(device['loss_pct']), jitter_ms=float(device['jitter_ms']), out_of_order=int(device['out_of_order']))
+    return result, device
+
+
+def run_down(args):
+    # El router envía: el equipo escucha antes de pedir la prueba
+    kind = socket.SOCK_STREAM if args.proto == 'tcp' else socket.SOCK_DGRAM
+    server = socket.socket(socket.AF_INET, kind)
+    server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    server.bind(('', args.port))
+    if args.proto == 'tcp':
+        server.listen(1)
+
+    measured = {}
+    receive = receive_tcp if args.proto == 'tcp' else receive_udp
+    thread = threading.Thread(target=lambda: measured.update(r=receive(server, args.duration)))
+    thread.start()
+    request(args.control, {'action': 'start', 'proto': args.proto, 'mode': 'source', 'iface': args.iface, 'peer': local_ip_towards(args.router),
+                           'port': args.port, 'duration': args.duration, 'rate': args.rate}, args.token)
+    thread.join()
+    server.close()
+
+    device = wait_state(args.router, ('done', 'failed'), WAIT_S)
+    host = measured.get('r')
+    if host is None:
+        sys.exit('No ha llegado tráfico del router (%s)' % device.get('error', '-'))
+    result = {'direction': 'down', 'measured_by': 'host', 'mbps': host['bytes'] * 8 / host['seconds'] / 1e6 if host['seconds'] else 0.0}
+    if args.proto == 'udp':
+        result.update(loss_pct=host['loss_pct'], jitter_ms=host['jitter_ms'], out_of_order=host['out_of_order'])
+    return result, device
+
+
+def run_all(args):
+    results = []
+    for direction, run in (('up', run_up), ('down', run_down)):
+        if args.direction not in (direction, 'both'):
+            continue
+        result, device = run(args)
+        if device['state'] == 'failed':
+            sys.exit('Prueba fallida en el router: %s' % device['error'])
+        result.update(proto=args.proto, iface=args.iface, cpu={k: float(v.rstrip('%')) for k, v in device.items() if k.startswith('cpu')})
+        results.append(result)
+    return results
+
+
+def main():
+    parser = argparse.ArgumentParser(description='Prueba de velocidad del router')
+    parser.add_argument('--router', default='192.168.4.1', help='IP del router vista desde este equipo')
+    parser.add_argument('--control', help='IP del punto de acceso del router para iniciar la prueba (por defecto --router)')
+    parser.add_argument('--token', help='Contraseña de administración del router (X-Admin-Token)')
+    parser.add_argument('--iface', choices=('ap', 'sta', 'eth'), default='ap', help='Interfaz del router que se prueba')
+    parser.add_argument('--compare', metavar='ETH_IP', help='Compara la STA (IP en --router) con la WAN por Ethernet (esta IP)')
+    parser.add_argument('--proto', choices=('tcp', 'udp'), default='tcp')
+    parser.add_argument('--direction', choices=('up', 'down', 'both'), default='both')
+    parser.add_argument('--port', type=int, default=5001)
+    parser.add_argument('--duration', type=int, default=10, help='Segundos por sentido (1 a 60)')
+    parser.add_argument('--rate', type=int, default=10000, help='Tasa UDP en kbit/s')
+    parser.add_argument('--json', action='store_true', help='Resultado en una línea JSON')
+    args = parser.parse_args()
+
+    if not args.token:
+        parser.error('iniciar la prueba necesita --token')
+    if not args.control:
+        if args.compare or args.iface != 'ap':
+            parser.error('con --iface sta o eth, o con --compare, hace falta --control (IP del AP)')
+        args.control = args.router
+
+    if args.compare:
+        sta_args, eth_args = copy.copy(args), copy.copy(args)
+        sta_args.iface = 'sta'
+        eth_args.iface, eth_args.router = 'eth', args.compare
+        results = run_all(sta_args) + run_all(eth_args)
+    else:
+        results = run_all(args)
+
+    if args.json:
+        print(json.dumps(results))
+        return
+    for r in results:
+        line = '%-4s %s %s  %8.2f Mbit/s' % (r['direction'], r['proto'], r['iface'], r['mbps'])
+        if 'jitter_ms' in r:
+            line += '  jitter %.3f ms  perdidos %.2f %%  desordenados %d' % (r['jitter_ms'], r['loss_pct'], r['out_of_order'])
+        line += '  CPU ' + ' '.join('%s %.1f%%' % kv for kv in sorted(r['cpu'].items()))
+        print(line)
+    if args.compare:
+        for direction in ('up', 'down'):
+            mbps = {r['iface']: r['mbps'] for r in results if r['direction'] == direction}
+            if mbps.get('sta'):
+                print('%-4s eth/sta  %.2fx' % (direction, mbps['eth'] / mbps['sta']))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,824 @@
+// Simulación en el host de la reconexión de la STA.
+// Ejecuta main/sta_policy.c y main/uplink_policy.c con la misma lógica de eventos que main.c (wifi_event_handler,
+// sta_disconnected_event_handler, sta_connect, wifi_reconnect, los escaneos y settings_changed_cb) sobre una radio
+// y unos timers simulados, con el tiempo simulado. Cada escenario es un guion de sucesos en los AP (caídas de
+// enlace, contraseña cambiada, AP apagado, red preferida que desaparece y vuelve) y mide:
+// - evento -> acción: desde la desconexión hasta el siguiente intento de conexión;
+// - pérdida -> IP e intento -> IP, como las métricas router_sta_time_to_ip y router_sta_attempt_to_ip;
+// - los timers (arranques, cancelaciones, disparos), las reservas de memoria y el coste en el host por evento.
+// Falla si dos intentos se solapan, si se reserva memoria en los manejadores o si un escenario no acaba con IP.
+// La lógica copiada de main.c está en la sección RECONEXIÓN; si cambia allí, debe cambiar aquí.
+//
+// Uso: cc -O2 -I main tools/sta_sim.c main/sta_policy.c main/uplink_policy.c -o sta_sim
+//      ./sta_sim [semilla]
+
+#include "sta_policy.h"
+#include "uplink_policy.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Definiciones de la radio simulada (tiempos típicos de un ESP32 en ms, con un ±20 % aleatorio)
+#define SIM_TARGETED_SCAN_MS 120   // Sondeo de un canal con el BSSID conocido
+#define SIM_FULL_SCAN_MS 2200      // Escaneo de todos los canales antes de asociarse
+#define SIM_ASSOC_MS 150           // Autenticación, asociación y 4-way handshake
+#define SIM_AUTH_FAIL_MS 1000      // Handshake con contraseña incorrecta hasta el fallo
+#define SIM_DHCP_MS 350            // Hasta obtener IP tras asociarse
+#define SIM_AUTHMODE_SCAN_MS 1500  // Escaneo de detección de autenticación
+#define SIM_UPLINK_SCAN_MS 1200    // Escaneo en segundo plano de las redes de subida
+#define SIM_UPLINK_SCAN_INTERVAL_MS 60000
+#define SIM_MAX_EVENTS 64
+#define SIM_MAX_SAMPLES 8192
+#define SIM_MAX_APS 2
+
+// Razones de desconexión de ESP-IDF (wifi_err_reason_t) que usa la simulación
+#define SIM_REASON_ASSOC_LEAVE 8
+#define SIM_REASON_BEACON_TIMEOUT 200
+#define SIM_REASON_NO_AP_FOUND 201
+#define SIM_REASON_AUTH_FAIL 202
+#define SIM_REASON_NO_AP_FOUND_IN_AUTHMODE_THRESHOLD 211
+
+// Autenticación guardada de una red
+#define SIM_AUTHMODE_UNKNOWN 0xFF
+#define SIM_AUTHMODE_WPA2 3
+#define SIM_AUTHMODE_WPA3 4
+
+typedef enum
+{
+    SIM_EV_STA_START = 0,
+    SIM_EV_STA_CONNECTED,
+    SIM_EV_STA_DISCONNECTED,
+    SIM_EV_STA_GOT_IP,
+    SIM_EV_SCAN_DONE,
+    SIM_EV_RECONNECT_TIMER,
+    SIM_EV_UPLINK_SCAN_TIMER,
+    SIM_EV_SCRIPT, // Suceso del guion del escenario
+} sim_event_type_t;
+
+typedef struct
+{
+    int64_t at_us;
+    uint32_t seq;     // Desempate por orden de llegada
+    uint32_t gen;     // Operación de la radio o del timer a la que pertenece (las anuladas se descartan)
+    uint8_t type;     // sim_event_type_t
+    uint8_t reason;   // Desconexión, o suceso del guion
+    int16_t arg;
+} sim_event_t;
+
+// AP de una red de subida
+typedef struct
+{
+    bool present;
+    bool password_ok;  // La contraseña guardada en el router es la del AP
+    uint8_t authmode;  // SIM_AUTHMODE_*
+    uint8_t bssid[6];
+    uint8_t channel;
+    int8_t rssi;
+} sim_ap_t;
+
+// Red guardada en los ajustes del router (como settings_network_t)
+typedef struct
+{
+    uint8_t bssid[6];
+    uint8_t channel; // 0 si no se conoce el último AP
+    uint8_t authmode;
+} sim_network_t;
+
+typedef enum
+{
+    SIM_RADIO_IDLE = 0,
+    SIM_RADIO_CONNECTING,
+    SIM_RADIO_CONNECTED,
+} sim_radio_state_t;
+
+// Resultados de un escenario
+typedef struct
+{
+    uint32_t event_to_action[SIM_MAX_SAMPLES]; // ms desde cada desconexión hasta el siguiente intento
+    uint32_t outage[SIM_MAX_SAMPLES];          // ms de cada pérdida hasta tener IP
+    uint32_t attempt_targeted[SIM_MAX_SAMPLES];
+    uint32_t attempt_full[SIM_MAX_SAMPLES];
+    size_t event_to_action_count, outage_count, targeted_count, full_count;
+    uint32_t attempts, reconnects, disconnects, got_ip, failovers, failbacks, authmode_scans, uplink_scans;
+    uint32_t timer_starts, timer_cancels, timer_fires, max_delay_ms;
+    uint32_t overlaps;          // Intentos empezados con otro en curso
+    uint32_t min_gap_ms;        // Separación mínima entre dos intentos seguidos
+    uint64_t allocations;       // Reservas de memoria dentro de los manejadores
+    uint64_t events;
+    double busy_s;              // Tiempo del host dentro de los manejadores
+} sim_result_t;
+
+// Estado de la simulación
+static struct
+{
+    int64_t now_us;
+    sim_event_t queue[SIM_MAX_EVENTS];
+    int queue_count;
+    uint32_t seq;
+
+    sim_ap_t aps[SIM_MAX_APS];
+    sim_network_t networks[SIM_MAX_APS];
+    int network_count;
+
+    sim_radio_state_t radio;
+    int radio_network;      // Red del intento o de la conexión
+    uint32_t radio_gen;
+    bool scanning;
+    uint32_t scan_gen;
+    uint32_t reconnect_gen; // Generación del timer de reconexión activo (0 si está parado)
+    int64_t last_attempt_us;
+    int64_t pending_disconnect_us; // Desconexión que espera el siguiente intento (0 si ninguna)
+    int64_t last_got_ip_us;
+    uint64_t allocations;
+
+    sim_result_t *result;
+} sim;
+
+// Estado de main.c
+static sta_policy_t sta_policy;
+static uplink_policy_t uplink_policy;
+static bool sta_connected;
+static bool authmode_scan_pending;
+static bool uplink_scan_pending;
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ull;
+
+// MARK: FUNCIONES INTERNAS -------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static uint64_t next_random(void)
+{
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return rng_state;
+}
+
+static double now_s(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Cuenta las reservas de memoria (glibc): los manejadores de main.c corren en la tarea de eventos y no deben reservar
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t count, size_t size);
+void *malloc(size_t size)
+{
+    sim.allocations++;
+    return __libc_malloc(size);
+}
+void *calloc(size_t count, size_t size)
+{
+    sim.allocations++;
+    return __libc_calloc(count, size);
+}
+
+static int64_t jitter_us(uint32_t ms)
+{
+    return (int64_t)ms * 1000 * (80 + (int64_t)(next_random() % 41)) / 100;
+}
+
+static void add_sample(uint32_t *samples, size_t *count, uint32_t value)
+{
+    if (*count < SIM_MAX_SAMPLES)
+    {
+        samples[(*count)++] = value;
+    }
+}
+
+static int compare_u32(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void print_samples(const char *title, uint32_t *samples, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    qsort(samples, count, sizeof(samples[0]), compare_u32);
+    printf("   %-22s %5zu muestras   p50 %6u ms   p95 %6u ms   máx %6u ms\n", title, count, samples[count / 2], samples[count * 95 / 100], samples[count - 1]);
+}
+
+// MARK: COLA DE EVENTOS ----------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+static bool event_before(const sim_event_t *a, const sim_event_t *b)
+{
+    return a->at_us != b->at_us ? a->at_us < b->at_us : a->seq < b->seq;
+}
+
+static void post(int64_t delay_us, sim_event_type_t type, uint32_t gen, uint8_t reason, int16_t arg)
+{
+    if (sim.queue_count == SIM_MAX_EVENTS)
+    {
+        fprintf(stderr, "Cola de eventos llena\n");
+        exit(2);
+    }
+    sim_event_t event = {.at_us = sim.now_us + delay_us, .seq = sim.seq++, .gen = gen, .type = type, .reason = reason, .arg = arg};
+    int i = sim.queue_count++;
+    while (i > 0 && event_before(&event, &sim.queue[(i - 1) / 2]))
+    {
+        sim.queue[i] = sim.queue[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    sim.queue[i] = event;
+}
+
+static sim_event_t pop(void)
+{
+    sim_event_t top = sim.queue[0];
+    sim_event_t last = sim.queue[--sim.queue_count];
+    int i = 0;
+    while (true)
+    {
+        int child = 2 * i + 1;
+        if (child >= sim.queue_count)
+        {
+            break;
+        }
+        if (child + 1 < sim.queue_count && event_before(&sim.queue[child + 1], &sim.queue[child]))
+        {
+            child++;
+        }
+        if (!event_before(&sim.queue[child], &last))
+        {
+            break;
+        }
+        sim.queue[i] = sim.queue[child];
+        i = child;
+    }
+    sim.queue[i] = last;
+    return top;
+}
+
+// MARK: RADIO Y TIMERS SIMULADOS -------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+// esp_wifi_connect: el resultado depende del AP de la red elegida y de si el intento va directo a su BSSID y canal
+static void fake_wifi_connect(int index, const uint8_t *bssid, uint8_t channel, uint8_t authmode)
+{
+    sim_result_t *r = sim.result;
+    if (sim.radio != SIM_RADIO_IDLE)
+    {
+        r->overlaps++;
+    }
+    if (sim.last_attempt_us >= 0)
+    {
+        uint32_t gap_ms = (uint32_t)((sim.now_us - sim.last_attempt_us) / 1000);
+        r->min_gap_ms = gap_ms < r->min_gap_ms ? gap_ms : r->min_gap_ms;
+    }
+    if (sim.pending_disconnect_us != 0)
+    {
+        add_sample(r->event_to_action, &r->event_to_action_count, (uint32_t)((sim.now_us - sim.pending_disconnect_us) / 1000));
+        sim.pending_disconnect_us = 0;
+    }
+    sim.last_attempt_us = sim.now_us;
+    r->attempts++;
+
+    sim.radio = SIM_RADIO_CONNECTING;
+    sim.radio_network = index;
+    uint32_t gen = ++sim.radio_gen;
+    const sim_ap_t *ap = &sim.aps[index];
+    bool targeted = channel != 0;
+    int64_t scan_us = jitter_us(targeted ? SIM_TARGETED_SCAN_MS : SIM_FULL_SCAN_MS);
+
+    if (!ap->present || (targeted && (ap->channel != channel || memcmp(ap->bssid, bssid, 6) != 0)))
+    {
+        post(scan_us, SIM_EV_STA_DISCONNECTED, gen, SIM_REASON_NO_AP_FOUND, 0);
+    }
+    else if (ap->authmode == SIM_AUTHMODE_WPA3 && authmode != SIM_AUTHMODE_WPA3)
+    {
+        post(scan_us, SIM_EV_STA_DISCONNECTED, gen, SIM_REASON_NO_AP_FOUND_IN_AUTHMODE_THRESHOLD, 0);
+    }
+    else if (!ap->password_ok)
+    {
+        post(scan_us + jitter_us(SIM_AUTH_FAIL_MS), SIM_EV_STA_DISCONNECTED, gen, SIM_REASON_AUTH_FAIL, 0);
+    }
+    else
+    {
+        int64_t connected_us = scan_us + jitter_us(SIM_ASSOC_MS);
+        post(connected_us, SIM_EV_STA_CONNECTED, gen, 0, 0);
+        post(connected_us + jitter_us(SIM_DHCP_MS), SIM_EV_STA_GOT_IP, gen, 0, 0);
+    }
+}
+
+// esp_wifi_disconnect: con un intento o una conexión en curso genera WIFI_EVENT_STA_DISCONNECTED; sin ellos no hace nada
+static void fake_wifi_disconnect(void)
+{
+    if (sim.radio != SIM_RADIO_IDLE)
+    {
+        sim.radio = SIM_RADIO_IDLE;
+        post(5000, SIM_EV_STA_DISCONNECTED, ++sim.radio_gen, SIM_REASON_ASSOC_LEAVE, 0);
+    }
+}
+
+// esp_wifi_scan_start: los AP presentes aparecen en los resultados
+static void fake_wifi_scan_start(uint32_t duration_ms)
+{
+    sim.scanning = true;
+    post(jitter_us(duration_ms), SIM_EV_SCAN_DONE, ++sim.scan_gen, 0, 0);
+}
+
+// esp_wifi_scan_stop: el escaneo termina al momento sin resultados
+static void fake_wifi_scan_stop(void)
+{
+    if (sim.scanning)
+    {
+        post(1000, SIM_EV_SCAN_DONE, ++sim.scan_gen, 0, 1);
+    }
+}
+
+// esp_timer_stop y esp_timer_start_once del timer de reconexión
+static void fake_timer_stop(void)
+{
+    if (sim.reconnect_gen != 0)
+    {
+        sim.result->timer_cancels++;
+        sim.reconnect_gen = 0;
+    }
+}
+
+static bool fake_timer_is_active(void)
+{
+    return sim.reconnect_gen != 0;
+}
+
+static void fake_timer_start_once(uint32_t delay_ms)
+{
+    static uint32_t timer_gen;
+    sim.reconnect_gen = ++timer_gen;
+    sim.result->timer_starts++;
+    post((int64_t)delay_ms * 1000, SIM_EV_RECONNECT_TIMER, sim.reconnect_gen, 0, 0);
+}
+
+// MARK: RECONEXIÓN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+// Misma lógica que main.c, con las llamadas a ESP-IDF sustituidas por la radio y los timers simulados
+
+static void sta_connect(void);
+static void wifi_reconnect(void);
+
+static void sta_connect(void)
+{
+    int index = uplink_policy_select(&uplink_policy);
+    uplink_candidate_t candidate = index >= 0 ? uplink_policy.candidates[index] : (uplink_candidate_t){0};
+
+    const uint8_t *bssid = NULL;
+    uint8_t channel = 0;
+    uint8_t authmode = SIM_AUTHMODE_UNKNOWN;
+    if (index >= 0)
+    {
+        const sim_network_t *network = &sim.networks[index];
+        bssid = candidate.channel != 0 ? candidate.bssid : network->bssid;
+        channel = candidate.channel != 0 ? candidate.channel : network->channel;
+        authmode = network->authmode;
+    }
+
+    if (!sta_policy_begin_attempt(&sta_policy, sim.now_us, channel != 0))
+    {
+        bssid = NULL;
+        channel = 0;
+    }
+    fake_wifi_connect(index, bssid, channel, authmode);
+}
+
+static void wifi_reconnect(void)
+{
+    sim.result->reconnects++;
+    uint32_t delay_ms = sta_policy_next_delay(&sta_policy, (uint32_t)next_random());
+    sim.result->max_delay_ms = delay_ms > sim.result->max_delay_ms ? delay_ms : sim.result->max_delay_ms;
+
+    fake_timer_stop();
+    fake_timer_start_once(delay_ms);
+}
+
+static void start_authmode_scan(void)
+{
+    sim.result->authmode_scans++;
+    fake_wifi_scan_start(SIM_AUTHMODE_SCAN_MS);
+    authmode_scan_pending = true;
+}
+
+static void authmode_scan_done(void)
+{
+    authmode_scan_pending = false;
+    const sim_ap_t *ap = &sim.aps[uplink_policy.current];
+    if (ap->present)
+    {
+        sim.networks[uplink_policy.current].authmode = ap->authmode; // settings_set_sta_authmode
+    }
+    wifi_reconnect();
+}
+
+static void start_uplink_scan(void)
+{
+    if (!sta_connected || sim.network_count < 2 || authmode_scan_pending || uplink_scan_pending)
+    {
+        return;
+    }
+    sim.result->uplink_scans++;
+    fake_wifi_scan_start(SIM_UPLINK_SCAN_MS);
+    uplink_scan_pending = true;
+}
+
+static void uplink_scan_done(bool stopped)
+{
+    uplink_scan_pending = false;
+    if (stopped)
+    {
+        return; // esp_wifi_scan_get_ap_records no devuelve resultados
+    }
+
+    uplink_policy_scan_begin(&uplink_policy);
+    for (int i = 0; i < sim.network_count; i++)
+    {
+        if (sim.aps[i].present)
+        {
+            uplink_policy_scan_seen(&uplink_policy, i, sim.aps[i].rssi, sim.aps[i].bssid, sim.aps[i].channel);
+        }
+    }
+    int target = uplink_policy_scan_end(&uplink_policy, sta_connected);
+    if (target >= 0)
+    {
+        uplink_policy_failback(&uplink_policy, target);
+        sta_policy_reset(&sta_policy);
+        fake_wifi_disconnect();
+    }
+}
+
+static void sta_disconnected_event_handler(uint8_t reason)
+{
+    switch (reason)
+    {
+    case SIM_REASON_NO_AP_FOUND_IN_AUTHMODE_THRESHOLD:
+        start_authmode_scan();
+        break;
+    default:
+        wifi_reconnect();
+        break;
+    }
+}
+
+// settings_changed_cb con una nueva lista de redes (current: puesto de la red en uso en la nueva lista, o -1)
+static void settings_changed_cb(int current, bool password_changed)
+{
+    uplink_policy_reset(&uplink_policy, sim.network_count, current);
+    if (!sta_connected || current != 0 || password_changed)
+    {
+        sta_policy_reset(&sta_policy);
+        fake_wifi_disconnect();
+        if (fake_timer_is_active())
+        {
+            wifi_reconnect();
+        }
+    }
+}
+
+static void wifi_event_handler(sim_event_type_t type, uint8_t reason)
+{
+    sim_result_t *r = sim.result;
+    switch (type)
+    {
+    case SIM_EV_STA_START:
+        sta_policy_link_lost(&sta_policy, sim.now_us);
+        sta_connect();
+        break;
+    case SIM_EV_STA_CONNECTED:
+        sta_connected = true;
+        break;
+    case SIM_EV_STA_DISCONNECTED:
+        r->disconnects++;
+        sim.pending_disconnect_us = sim.now_us;
+        sta_connected = false;
+        sta_policy_link_lost(&sta_policy, sim.now_us);
+        uplink_policy_link_lost(&uplink_policy);
+        if (uplink_scan_pending)
+        {
+            fake_wifi_scan_stop();
+        }
+        sta_disconnected_event_handler(reason);
+        break;
+    case SIM_EV_STA_GOT_IP:
+    {
+        r->got_ip++;
+        bool targeted = sta_policy.targeted;
+        uint32_t outage_ms, attempt_ms;
+        sta_policy_got_ip(&sta_policy, sim.now_us, &outage_ms, &attempt_ms);
+        if (outage_ms != 0)
+        {
+            add_sample(r->outage, &r->outage_count, outage_ms);
+        }
+        if (attempt_ms != 0)
+        {
+            if (targeted)
+            {
+                add_sample(r->attempt_targeted, &r->targeted_count, attempt_ms);
+            }
+            else
+            {
+                add_sample(r->attempt_full, &r->full_count, attempt_ms);
+            }
+        }
+        uplink_switch_t uplink_switch = uplink_policy_got_ip(&uplink_policy);
+        r->failovers += uplink_switch == UPLINK_SWITCH_FAILOVER;
+        r->failbacks += uplink_switch == UPLINK_SWITCH_FAILBACK;
+
+        // settings_set_sta_last_ap
+        const sim_ap_t *ap = &sim.aps[uplink_policy.current];
+        memcpy(sim.networks[uplink_policy.current].bssid, ap->bssid, 6);
+        sim.networks[uplink_policy.current].channel = ap->channel;
+        sim.networks[uplink_policy.current].authmode = ap->authmode;
+        break;
+    }
+    case SIM_EV_SCAN_DONE:
+        sim.scanning = false;
+        if (authmode_scan_pending)
+        {
+            authmode_scan_done();
+        }
+        else if (uplink_scan_pending)
+        {
+            uplink_scan_done(reason != 0);
+        }
+        break;
+    case SIM_EV_RECONNECT_TIMER:
+        r->timer_fires++;
+        sta_connect();
+        break;
+    case SIM_EV_UPLINK_SCAN_TIMER:
+        start_uplink_scan();
+        break;
+    default:
+        break;
+    }
+}
+
+// MARK: SIMULACIÓN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+typedef void (*sim_script_t)(int16_t arg);
+
+static sim_script_t script;
+
+// Prepara la radio con count AP presentes, con la contraseña correcta y sin AP conocido en los ajustes
+static void sim_reset(sim_result_t *result, int count)
+{
+    memset(&sim, 0, sizeof(sim));
+    memset(result, 0, sizeof(*result));
+    result->min_gap_ms = UINT32_MAX;
+    sim.result = result;
+    sim.last_attempt_us = -1;
+    sim.network_count = count;
+    for (int i = 0; i < count; i++)
+    {
+        sim.aps[i] = (sim_ap_t){.present = true, .password_ok = true, .authmode = SIM_AUTHMODE_WPA2, .bssid = {0x24, 0x0a, 0xc4, 0, 0, (uint8_t)i},
+                                .channel = (uint8_t)(1 + 5 * i), .rssi = (int8_t)(-55 - 10 * i)};
+        sim.networks[i].authmode = SIM_AUTHMODE_UNKNOWN;
+    }
+    memset(&sta_policy, 0, sizeof(sta_policy));
+    uplink_policy_reset(&uplink_policy, count, -1);
+    sta_connected = false;
+    authmode_scan_pending = false;
+    uplink_scan_pending = false;
+}
+
+// Corre hasta until_ms; los sucesos del guion llegan como SIM_EV_SCRIPT
+static void sim_run(int64_t until_ms)
+{
+    while (sim.queue_count > 0 && sim.queue[0].at_us <= until_ms * 1000)
+    {
+        sim_event_t event = pop();
+        sim.now_us = event.at_us;
+
+        // Resultados de una operación de la radio, del escaneo o del timer ya anulada
+        if ((event.type == SIM_EV_STA_CONNECTED || event.type == SIM_EV_STA_GOT_IP || event.type == SIM_EV_STA_DISCONNECTED) && event.gen != sim.radio_gen)
+        {
+            continue;
+        }
+        if ((event.type == SIM_EV_SCAN_DONE && event.gen != sim.scan_gen) || (event.type == SIM_EV_RECONNECT_TIMER && event.gen != sim.reconnect_gen))
+        {
+            continue;
+        }
+
+        if (event.type == SIM_EV_SCRIPT)
+        {
+            script(event.arg);
+            continue;
+        }
+        if (event.type == SIM_EV_STA_CONNECTED)
+        {
+            sim.radio = SIM_RADIO_CONNECTED;
+        }
+        else if (event.type == SIM_EV_STA_DISCONNECTED)
+        {
+            sim.radio = SIM_RADIO_IDLE;
+        }
+        else if (event.type == SIM_EV_STA_GOT_IP)
+        {
+            sim.last_got_ip_us = event.at_us;
+        }
+        else if (event.type == SIM_EV_RECONNECT_TIMER)
+        {
+            sim.reconnect_gen = 0;
+        }
+        else if (event.type == SIM_EV_UPLINK_SCAN_TIMER)
+        {
+            post((int64_t)SIM_UPLINK_SCAN_INTERVAL_MS * 1000, SIM_EV_UPLINK_SCAN_TIMER, 0, 0, 0);
+        }
+
+        uint64_t allocations = sim.allocations;
+        double start = now_s();
+        wifi_event_handler((sim_event_type_t)event.type, event.reason);
+        sim.result->busy_s += now_s() - start;
+        sim.result->allocations += sim.allocations - allocations;
+        sim.result->events++;
+    }
+    sim.now_us = until_ms * 1000;
+}
+
+// Cae el enlace con la red en uso (el AP deja de responder o expulsa a la STA)
+static void drop_link(uint8_t reason)
+{
+    if (sim.radio != SIM_RADIO_IDLE)
+    {
+        sim.radio = SIM_RADIO_IDLE;
+        post(0, SIM_EV_STA_DISCONNECTED, ++sim.radio_gen, reason, 0);
+    }
+}
+
+static void script_at(int64_t at_ms, int16_t arg)
+{
+    post(at_ms * 1000 - sim.now_us, SIM_EV_SCRIPT, 0, 0, arg);
+}
+
+// MARK: ESCENARIOS ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+#define STORM_DROPS 2000
+
+// Caídas de enlace repetidas con el AP siempre presente: cada una debe recuperarse con un intento directo
+static void storm_script(int16_t arg)
+{
+    static int drops;
+    if (arg == 0)
+    {
+        drops = 0;
+        return;
+    }
+    drop_link(next_random() % 2 ? SIM_REASON_BEACON_TIMEOUT : SIM_REASON_ASSOC_LEAVE);
+    if (++drops < STORM_DROPS)
+    {
+        script_at(sim.now_us / 1000 + 2000 + next_random() % 18000, 1);
+    }
+}
+
+// Contraseña cambiada en el AP durante 10 minutos; después se guarda la nueva en el router
+static int64_t credentials_changed_ms;
+static void auth_script(int16_t arg)
+{
+    if (arg == 1)
+    {
+        sim.aps[0].password_ok = false;
+        drop_link(SIM_REASON_AUTH_FAIL);
+    }
+    else
+    {
+        credentials_changed_ms = sim.now_us / 1000;
+        sim.aps[0].password_ok = true;
+        settings_changed_cb(0, true);
+    }
+}
+
+// El AP se apaga durante dos minutos
+static int64_t ap_back_ms;
+static void outage_script(int16_t arg)
+{
+    if (arg == 1)
+    {
+        sim.aps[0].present = false;
+        drop_link(SIM_REASON_BEACON_TIMEOUT);
+    }
+    else
+    {
+        ap_back_ms = sim.now_us / 1000;
+        sim.aps[0].present = true;
+    }
+}
+
+// La red preferida desaparece y vuelve cinco minutos después
+static void failover_script(int16_t arg)
+{
+    if (arg == 1)
+    {
+        sim.aps[0].present = false;
+        if (sim.radio_network == 0)
+        {
+            drop_link(SIM_REASON_BEACON_TIMEOUT);
+        }
+    }
+    else
+    {
+        ap_back_ms = sim.now_us / 1000;
+        sim.aps[0].present = true;
+    }
+}
+
+static void print_result(const char *title, sim_result_t *r)
+{
+    printf("%s\n", title);
+    printf("   %u intentos, %u desconexiones, %u con IP, %u cambios de red, %u vueltas a la preferida\n", r->attempts, r->disconnects, r->got_ip, r->failovers,
+           r->failbacks);
+    printf("   timer: %u arranques, %u cancelados, %u disparos, espera máxima %u ms; escaneos: %u de autenticación, %u de redes\n", r->timer_starts, r->timer_cancels,
+           r->timer_fires, r->max_delay_ms, r->authmode_scans, r->uplink_scans);
+    print_samples("evento -> acción", r->event_to_action, r->event_to_action_count);
+    print_samples("pérdida -> IP", r->outage, r->outage_count);
+    print_samples("intento directo -> IP", r->attempt_targeted, r->targeted_count);
+    print_samples("escaneo -> IP", r->attempt_full, r->full_count);
+    printf("   host: %llu eventos, %.0f ns por evento, %llu reservas; solapes %u, separación mínima %u ms\n", (unsigned long long)r->events,
+           r->events ? r->busy_s * 1e9 / r->events : 0.0, (unsigned long long)r->allocations, r->overlaps, r->min_gap_ms);
+}
+
+// Comprobaciones comunes: sin solapes ni reservas, nunca dos intentos sin espera, y el escenario acaba con IP
+static bool check(sim_result_t *r)
+{
+    bool ok = r->overlaps == 0 && r->allocations == 0 && sta_connected && r->min_gap_ms >= STA_POLICY_BACKOFF_MIN_MS * 3 / 4;
+    if (!ok)
+    {
+        printf("   FALLO: %s\n", r->overlaps ? "intentos solapados" : r->allocations ? "reservas en los manejadores" : !sta_connected ? "sin conexión al final" : "intentos sin espera");
+    }
+    return ok;
+}
+
+// MARK: MAIN ---------------------------------------------------------------------------------------------------------------------------------------------------------------------------------
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+    {
+        rng_state = strtoull(argv[1], NULL, 0) | 1;
+    }
+    static sim_result_t result;
+    bool ok = true;
+
+    // Arranque y tormenta de desconexiones
+    sim_reset(&result, 1);
+    script = storm_script;
+    storm_script(0);
+    post(0, SIM_EV_STA_START, 0, 0, 0);
+    script_at(10000, 1);
+    sim_run((int64_t)STORM_DROPS * 25000);
+    print_result("Tormenta de desconexiones (2000 caídas de enlace, AP presente)", &result);
+    ok = check(&result) && ok;
+    ok = ok && result.got_ip == STORM_DROPS + 1;
+
+    // Contraseña incorrecta durante 10 minutos y después credenciales nuevas
+    sim_reset(&result, 1);
+    script = auth_script;
+    post(0, SIM_EV_STA_START, 0, 0, 0);
+    script_at(10000, 1);
+    script_at(610000, 2);
+    sim_run(610000);
+    uint32_t storm_attempts = result.attempts;
+    sim_run(700000);
+    print_result("Fallo de autenticación (10 min) y cambio de credenciales", &result);
+    int64_t change_to_ip_ms = sim.last_got_ip_us / 1000 - credentials_changed_ms;
+    printf("   %u intentos durante el fallo; cambio de credenciales -> IP %lld ms\n", storm_attempts - 1, (long long)change_to_ip_ms);
+    ok = check(&result) && ok;
+    ok = ok && change_to_ip_ms < SIM_FULL_SCAN_MS * 2; // Sin esperar al reintento pendiente de la racha de fallos
+
+    // AP apagado durante dos minutos
+    sim_reset(&result, 1);
+    script = outage_script;
+    post(0, SIM_EV_STA_START, 0, 0, 0);
+    script_at(10000, 1);
+    script_at(130000, 2);
+    sim_run(200000);
+    print_result("AP apagado durante 2 minutos", &result);
+    printf("   AP de vuelta -> IP %lld ms\n", (long long)(sim.last_got_ip_us / 1000 - ap_back_ms));
+    ok = check(&result) && ok;
+
+    // Dos redes: la preferida desaparece y vuelve
+    sim_reset(&result, 2);
+    script = failover_script;
+    post(0, SIM_EV_STA_START, 0, 0, 0);
+    post((int64_t)SIM_UPLINK_SCAN_INTERVAL_MS * 1000, SIM_EV_UPLINK_SCAN_TIMER, 0, 0, 0);
+    script_at(10000, 1);
+    script_at(310000, 2);
+    sim_run(700000);
+    print_result("Red preferida perdida 5 minutos (dos redes)", &result);
+    printf("   red preferida de vuelta -> IP %lld ms, red final %d\n", (long long)(sim.last_got_ip_us / 1000 - ap_back_ms), uplink_policy.current);
+    ok = check(&result) && ok;
+    ok = ok && result.failovers == 1 && result.failbacks == 1 && uplink_policy.current == 0;
+
+    // AP solo WPA3: el primer intento no cumple el umbral y se detecta la autenticación
+    sim_reset(&result, 1);
+    sim.aps[0].authmode = SIM_AUTHMODE_WPA3;
+    post(0, SIM_EV_STA_START, 0, 0, 0);
+    sim_run(60000);
+    print_result("AP WPA3 con autenticación desconocida", &result);
+    ok = check(&result) && ok;
+    ok = ok && result.authmode_scans == 1;
+
+    printf("%s\n", ok ? "OK" : "FALLO");
+    return ok ? 0 : 1;
+}
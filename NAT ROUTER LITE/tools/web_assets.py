@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""Genera el código C con los recursos web embebidos.
+
+Cada recurso se incluye sin comprimir y, cuando resultan más pequeñas, en sus
+variantes gzip y brotli (esta última solo si el módulo ``brotli`` está
+instalado). El ETag de cada variante se deriva del SHA-256 del contenido original.
+
+Uso: web_assets.py --output web_assets_data.c /=ruta/main.html /favicon.ico=ruta/router.ico
+"""
+
+import argparse
+import gzip
+import hashlib
+import mimetypes
+import os
+
+try:
+    import brotli
+except ImportError:
+    brotli = None
+
+# Tipos MIME que no siempre conoce el módulo mimetypes
+MIME_TYPES = {
+    '.html': 'text/html; charset=utf-8',
+    '.css': 'text/css; charset=utf-8',
+    '.js': 'application/javascript; charset=utf-8',
+    '.json': 'application/json',
+    '.ico': 'image/x-icon',
+    '.svg': 'image/svg+xml',
+}
+
+# Las páginas se revalidan siempre con el ETag; el resto se guarda en caché un año
+CACHE_CONTROL_HTML = 'no-cache'
+CACHE_CONTROL_STATIC = 'max-age=31536000, immutable'
+
+
+def c_array(name, data):
+    lines = ['static const uint8_t %s[%d] = {' % (name, len(data))]
+    for i in range(0, len(data), 16):
+        lines.append('    ' + ', '.join('0x%02x' % b for b in data[i:i + 16]) + ',')
+    lines.append('};')
+    return '\n'.join(lines)
+
+
+def c_string(value):
+    return '"' + value.replace('\\', '\\\\').replace('"', '\\"') + '"'
+
+
+def build_asset(index, uri, path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    ext = os.path.splitext(path)[1].lower()
+    mime = MIME_TYPES.get(ext) or mimetypes.guess_type(path)[0] or 'application/octet-stream'
+    cache_control = CACHE_CONTROL_HTML if mime.startswith('text/html') else CACHE_CONTROL_STATIC
+    digest = hashlib.sha256(data).hexdigest()[:16]
+
+    variants = {'identity': data}
+    compressed = gzip.compress(data, compresslevel=9, mtime=0)
+    if len(compressed) < len(data):
+        variants['gzip'] = compressed
+    if brotli is not None:
+        compressed = brotli.compress(data, quality=11)
+        if len(compressed) < len(data):
+            variants['br'] = compressed
+
+    arrays = []
+    fields = []
+    suffixes = {'identity': '', 'gzip': '-gz', 'br': '-br'}
+    for encoding in ('identity', 'gzip', 'br'):
+        if encoding in variants:
+            name = 'asset_%d_%s' % (index, encoding)
+            arrays.append(c_array(name, variants[encoding]))
+            etag = '"%s%s"' % (digest, suffixes[encoding])
+            fields.append('            {%s, sizeof(%s), %s},' % (name, name, c_string(etag)))
+        else:
+            fields.append('            {NULL, 0, NULL},')
+
+    entry = '\n'.join([
+        '    {',
+        '        .uri = %s,' % c_string(uri),
+        '        .mime = %s,' % c_string(mime),
+        '        .cache_control = %s,' % c_string(cache_control),
+        '        .variants = {',
+        *fields,
+        '        },',
+        '    },',
+    ])
+    sizes = ', '.join('%s %d B' % (k, len(v)) for k, v in variants.items())
+    print('web_assets: %s -> %s (%s)' % (path, uri, sizes))
+    return '\n\n'.join(arrays), entry
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('--output', required=True, help='Archivo C a generar')
+    parser.add_argument('assets', nargs='+', metavar='URI=RUTA', help='Recurso a embeber y URI en la que se sirve')
+    args = parser.parse_args()
+
+    arrays = []
+    entries = []
+    for index, asset in enumerate(args.assets):
+        uri, path = asset.split('=', 1)
+        array, entry = build_asset(index, uri, path)
+        arrays.append(array)
+        entries.append(entry)
+
+    source = '\n'.join([
+        '// Generado por tools/web_assets.py. No editar.',
+        '#include "web_assets.h"',
+        '',
+        '\n\n'.join(arrays),
+        '',
+        'const web_asset_t web_assets[] = {',
+        '\n'.join(entries),
+        '};',
+        '',
+        'const size_t web_assets_count = sizeof(web_assets) / sizeof(web_assets[0]);',
+        '',
+    ])
+
+    # Solo se reescribe si cambia, para no forzar la recompilación
+    if os.path.exists(args.output):
+        with open(args.output) as f:
+            if f.read() == source:
+                return
+    with open(args.output, 'w') as f:
+        f.write(source)
+
+
+if __name__ == '__main__':
+    main()